@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * All rights reserved.
+ *
+ * This software licensed under BSD license, the text of which follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <config.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <corosync/corotypes.h>
+#include <corosync/stats_shm.h>
+
+/*
+ * How many times to try to get consistent copy before giving up
+ */
+#define STATS_SHM_READ_RETRIES		100
+
+/*
+ * Names of statistics. Order must match order of fields in structures.
+ */
+static const char *stats_shm_pg_names[] = {
+	"msg_queue_avail",
+	"msg_reserved",
+};
+
+static const char *stats_shm_srp_names[] = {
+	"orf_token_tx",
+	"orf_token_rx",
+	"memb_merge_detect_tx",
+	"memb_merge_detect_rx",
+	"memb_join_tx",
+	"memb_join_rx",
+	"mcast_tx",
+	"mcast_retx",
+	"mcast_rx",
+	"memb_commit_token_tx",
+	"memb_commit_token_rx",
+	"token_hold_cancel_tx",
+	"token_hold_cancel_rx",
+	"operational_entered",
+	"operational_token_lost",
+	"gather_entered",
+	"gather_token_lost",
+	"commit_entered",
+	"commit_token_lost",
+	"recovery_entered",
+	"recovery_token_lost",
+	"consensus_timeouts",
+	"rx_msg_dropped",
+	"time_since_token_last_received",
+	"continuous_gather",
+	"continuous_sendmsg_failures",
+	"firewall_enabled_or_nic_failure",
+	"mtt_rx_token",
+	"avg_token_workload",
+	"avg_backlog_calc",
+};
+
+static const char *stats_shm_ipcs_names[] = {
+	"global.active",
+	"global.closed",
+	"global.queued_bytes",
+	"global.outq_overflow",
+};
+
+static const char *stats_shm_knet_names[] = {
+	"enabled",
+	"connected",
+	"mtu",
+	"tx_data_packets",
+	"rx_data_packets",
+	"tx_data_bytes",
+	"rx_data_bytes",
+	"tx_ping_packets",
+	"rx_ping_packets",
+	"tx_ping_bytes",
+	"rx_ping_bytes",
+	"tx_pong_packets",
+	"rx_pong_packets",
+	"tx_pong_bytes",
+	"rx_pong_bytes",
+	"tx_pmtu_packets",
+	"rx_pmtu_packets",
+	"tx_pmtu_bytes",
+	"rx_pmtu_bytes",
+	"tx_total_packets",
+	"rx_total_packets",
+	"tx_total_bytes",
+	"rx_total_bytes",
+	"tx_total_errors",
+	"rx_total_retries",
+	"tx_pmtu_errors",
+	"tx_pmtu_retries",
+	"tx_ping_errors",
+	"tx_ping_retries",
+	"tx_pong_errors",
+	"tx_pong_retries",
+	"tx_data_errors",
+	"tx_data_retries",
+	"latency_min",
+	"latency_max",
+	"latency_ave",
+	"latency_samples",
+	"down_count",
+	"up_count",
+};
+
+#define NUM_ITEMS(a) (sizeof(a) / sizeof(a[0]))
+
+cs_error_t cs_stats_shm_map(const struct cs_stats_shm **shm)
+{
+	const struct cs_stats_shm *res_shm;
+	struct stat st;
+	void *addr;
+	int fd;
+
+	fd = shm_open(CS_STATS_SHM_NAME, O_RDONLY, 0);
+	if (fd == -1) {
+		if (errno == ENOENT) {
+			return (CS_ERR_NOT_EXIST);
+		}
+		if (errno == EACCES) {
+			return (CS_ERR_ACCESS);
+		}
+		return (CS_ERR_LIBRARY);
+	}
+
+	if (fstat(fd, &st) == -1 || st.st_size < sizeof(struct cs_stats_shm)) {
+		close(fd);
+		return (CS_ERR_LIBRARY);
+	}
+
+	addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) {
+		return (CS_ERR_LIBRARY);
+	}
+	res_shm = addr;
+
+	if (res_shm->magic != CS_STATS_SHM_MAGIC ||
+	    res_shm->version != CS_STATS_SHM_VERSION ||
+	    res_shm->size != st.st_size ||
+	    res_shm->size < CS_STATS_SHM_SIZE(res_shm->max_knet_links)) {
+		munmap(addr, st.st_size);
+		return (CS_ERR_LIBRARY);
+	}
+
+	*shm = res_shm;
+
+	return (CS_OK);
+}
+
+void cs_stats_shm_unmap(const struct cs_stats_shm *shm)
+{
+	munmap((void *)shm, shm->size);
+}
+
+cs_error_t cs_stats_shm_read(const struct cs_stats_shm *shm, struct cs_stats_shm *copy)
+{
+	uint64_t seq;
+	int retries;
+
+	for (retries = 0; retries < STATS_SHM_READ_RETRIES; retries++) {
+		seq = shm->seq;
+		if (seq & 1) {
+			/*
+			 * Writer is in the middle of update
+			 */
+			sched_yield();
+			continue;
+		}
+		__sync_synchronize();
+
+		memcpy(copy, (const void *)shm, sizeof(struct cs_stats_shm));
+		if (copy->no_knet_links <= shm->max_knet_links) {
+			memcpy(copy->knet_links, shm->knet_links,
+			    copy->no_knet_links * sizeof(struct cs_stats_shm_knet_link));
+		}
+
+		__sync_synchronize();
+		if (shm->seq == seq && copy->no_knet_links <= shm->max_knet_links) {
+			copy->seq = seq;
+			return (CS_OK);
+		}
+	}
+
+	return (CS_ERR_TRY_AGAIN);
+}
+
+static void stats_shm_iter_items(const char *prefix,
+	const char **names,
+	size_t no_names,
+	const uint64_t *values,
+	cs_stats_shm_iter_fn_t fn,
+	void *user_data)
+{
+	char key_name[CS_MAX_NAME_LENGTH];
+	size_t i;
+
+	for (i = 0; i < no_names; i++) {
+		snprintf(key_name, sizeof(key_name), "%s.%s", prefix, names[i]);
+		fn(key_name, values[i], user_data);
+	}
+}
+
+void cs_stats_shm_iter(const struct cs_stats_shm *copy, cs_stats_shm_iter_fn_t fn, void *user_data)
+{
+	const struct cs_stats_shm_knet_link *link;
+	char prefix[CS_MAX_NAME_LENGTH];
+	uint32_t i;
+
+	stats_shm_iter_items("stats.pg", stats_shm_pg_names, NUM_ITEMS(stats_shm_pg_names),
+	    (const uint64_t *)&copy->pg, fn, user_data);
+	stats_shm_iter_items("stats.srp", stats_shm_srp_names, NUM_ITEMS(stats_shm_srp_names),
+	    (const uint64_t *)&copy->srp, fn, user_data);
+	stats_shm_iter_items("stats.ipcs", stats_shm_ipcs_names, NUM_ITEMS(stats_shm_ipcs_names),
+	    (const uint64_t *)&copy->ipcs, fn, user_data);
+
+	for (i = 0; i < copy->no_knet_links && i < copy->max_knet_links; i++) {
+		link = &copy->knet_links[i];
+
+		snprintf(prefix, sizeof(prefix), "stats.knet.node%u.link%u", link->nodeid, link->link_no);
+		stats_shm_iter_items(prefix, stats_shm_knet_names, NUM_ITEMS(stats_shm_knet_names),
+		    &link->enabled, fn, user_data);
+	}
+}
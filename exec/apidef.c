@@ -53,6 +53,7 @@
 #include "main.h"
 #include "apidef.h"
 #include "service.h"
+#include "sync.h"
 
 LOGSYS_DECLARE_SUBSYS ("APIDEF");
 
@@ -107,6 +108,7 @@ static struct corosync_api_v1 apidef_corosync_api_v1 = {
 	.ipc_dispatch_iov_send = cs_ipcs_dispatch_iov_send,
 	.ipc_refcnt_inc =  cs_ipc_refcnt_inc,
 	.ipc_refcnt_dec = cs_ipc_refcnt_dec,
+	.ipc_disconnect = cs_ipc_disconnect,
 	.totem_nodeid_get = totempg_my_nodeid_get,
 	.totem_family_get = totempg_my_family_get,
 	.totem_mcast = main_mcast,
@@ -130,6 +132,7 @@ static struct corosync_api_v1 apidef_corosync_api_v1 = {
 	.schedwrk_create_nolock = schedwrk_create_nolock,
 	.schedwrk_destroy = schedwrk_destroy,
 	.sync_request = NULL, //sync_request,
+	.sync_process_resume = sync_process_resume,
 	.quorum_is_quorate = corosync_quorum_is_quorate,
 	.quorum_register_callback = corosync_quorum_register_callback,
 	.quorum_unregister_callback = corosync_quorum_unregister_callback,
@@ -594,6 +594,12 @@ static void remove_ro_entries(icmap_map_t temp_map)
 	delete_and_notify_if_changed(temp_map, "totem.cluster_name");
 	delete_and_notify_if_changed(temp_map, "quorum.provider");
 	delete_and_notify_if_changed(temp_map, "qb.ipc_type");
+	delete_and_notify_if_changed(temp_map, "qb.ipc_thread");
+	delete_and_notify_if_changed(temp_map, "qb.stats_shm");
+	delete_and_notify_if_changed(temp_map, "qb.stats_shm_group");
+	delete_and_notify_if_changed(temp_map, "qb.stats_shm_mode");
+	delete_and_notify_if_changed(temp_map, "qb.ipc_outq_max_size");
+	delete_and_notify_if_changed(temp_map, "qb.ipc_fc_credits");
 }
 
 /*
@@ -44,6 +44,8 @@
 
 #include <qb/qbloop.h>
 #include <qb/qblist.h>
+#include <qb/qbmap.h>
+#include <qb/qbutil.h>
 #include <qb/qbipcs.h>
 #include <qb/qbipc_common.h>
 
@@ -136,6 +138,26 @@ struct cmap_track_user_data {
 	void *conn;
 	cmap_track_handle_t track_handle;
 	uint64_t track_inst_handle;
+
+	/*
+	 * Coalescing tracker (window > 0). Changed keys are collected in
+	 * coalesce_map (lookup) and coalesce_list (order of first change) and
+	 * sent as one batch when timer expires or batch becomes too big.
+	 */
+	uint32_t coalesce_window;
+	qb_map_t *coalesce_map;
+	struct qb_list_head coalesce_list;
+	size_t coalesce_size;
+	corosync_timer_handle_t coalesce_timer;
+	int coalesce_timer_running;
+};
+
+struct cmap_coalesce_item {
+	struct qb_list_head list;
+	int32_t event;
+	struct icmap_notify_value new_val;
+	struct icmap_notify_value old_val;
+	char key_name[ICMAP_KEYNAME_MAXLEN + 1];
 };
 
 enum cmap_message_req_types {
@@ -161,10 +183,12 @@ static void message_handler_req_lib_cmap_get(void *conn, const void *message);
 static void message_handler_req_lib_cmap_adjust_int(void *conn, const void *message);
 static void message_handler_req_lib_cmap_iter_init(void *conn, const void *message);
 static void message_handler_req_lib_cmap_iter_next(void *conn, const void *message);
+static void message_handler_req_lib_cmap_iter_next_bulk(void *conn, const void *message);
 static void message_handler_req_lib_cmap_iter_finalize(void *conn, const void *message);
 static void message_handler_req_lib_cmap_track_add(void *conn, const void *message);
 static void message_handler_req_lib_cmap_track_delete(void *conn, const void *message);
 static void message_handler_req_lib_cmap_set_current_map(void *conn, const void *message);
+static void message_handler_req_lib_cmap_track_add_coalesced(void *conn, const void *message);
 
 static void cmap_notify_fn(int32_t event,
 		const char *key_name,
@@ -172,6 +196,14 @@ static void cmap_notify_fn(int32_t event,
 		struct icmap_notify_value old_val,
 		void *user_data);
 
+static void cmap_coalesce_notify_fn(int32_t event,
+		const char *key_name,
+		struct icmap_notify_value new_val,
+		struct icmap_notify_value old_val,
+		void *user_data);
+
+static void cmap_track_user_data_free(struct cmap_track_user_data *cmap_track_user_data);
+
 static void message_handler_req_exec_cmap_mcast(
 		const void *message,
 		unsigned int nodeid);
@@ -250,6 +282,14 @@ static struct corosync_lib_handler cmap_lib_engine[] =
 		.lib_handler_fn				= message_handler_req_lib_cmap_set_current_map,
 		.flow_control				= CS_LIB_FLOW_CONTROL_NOT_REQUIRED
 	},
+	{ /* 10 */
+		.lib_handler_fn				= message_handler_req_lib_cmap_iter_next_bulk,
+		.flow_control				= CS_LIB_FLOW_CONTROL_NOT_REQUIRED
+	},
+	{ /* 11 */
+		.lib_handler_fn				= message_handler_req_lib_cmap_track_add_coalesced,
+		.flow_control				= CS_LIB_FLOW_CONTROL_NOT_REQUIRED
+	},
 };
 
 static struct corosync_exec_handler cmap_exec_engine[] =
@@ -278,7 +318,8 @@ struct corosync_service_engine cmap_service_engine = {
 	.sync_init				= cmap_sync_init,
 	.sync_process				= cmap_sync_process,
 	.sync_activate				= cmap_sync_activate,
-	.sync_abort				= cmap_sync_abort
+	.sync_abort				= cmap_sync_abort,
+	.sync_dependency			= CS_SYNC_INDEPENDENT
 };
 
 struct corosync_service_engine *cmap_get_service_engine_ver0 (void)
@@ -311,6 +352,20 @@ static uint64_t cmap_my_config_version = 0;
 static int cmap_first_sync = 1;
 static icmap_track_t cmap_config_version_track;
 
+/*
+ * Delta sync. Config version of every member is already known by all
+ * nodes which finished last sync together, so if every member of the new
+ * ring comes from our previous ring (transitional membership) and our
+ * config version didn't change since we've sent it, there is nothing new
+ * to tell. Members of last finished sync are kept sorted.
+ */
+static unsigned int cmap_sync_member_list[PROCESSOR_COUNT_MAX];
+static unsigned int cmap_synced_member_list[PROCESSOR_COUNT_MAX];
+static size_t cmap_synced_member_list_entries = 0;
+static uint64_t cmap_sent_config_version = 0;
+static int cmap_config_version_sent = 0;
+static int cmap_sync_delta = 0;
+
 static void cmap_config_version_track_cb(
 	int32_t event,
 	const char *key_name,
@@ -331,6 +386,9 @@ static void cmap_config_version_track_cb(
 	ret = cmap_mcast_send(CMAP_MCAST_REASON_NEW_CONFIG_VERSION, 1, (char **)&key);
 	if (ret != CS_OK) {
 		log_printf(LOGSYS_LEVEL_ERROR, "Can't inform other nodes about new config version");
+	} else {
+		cmap_sent_config_version = cmap_my_config_version;
+		cmap_config_version_sent = 1;
 	}
 
 	LEAVE();
@@ -407,7 +465,7 @@ static int cmap_lib_exit_fn (void *conn)
         while (hdb_iterator_next(&conn_info->track_db,
                 (void*)&track, &track_handle) == 0) {
 
-		free(conn_info->map_fns.map_track_get_user_data(*track));
+		cmap_track_user_data_free(conn_info->map_fns.map_track_get_user_data(*track));
 
 		conn_info->map_fns.map_track_delete(*track);
 
@@ -420,6 +478,56 @@ static int cmap_lib_exit_fn (void *conn)
 	return (0);
 }
 
+static int cmap_nodeid_compare(const void *a, const void *b)
+{
+	unsigned int nodeid_a = *(const unsigned int *)a;
+	unsigned int nodeid_b = *(const unsigned int *)b;
+
+	return (nodeid_a < nodeid_b ? -1 : (nodeid_a > nodeid_b ? 1 : 0));
+}
+
+/*
+ * Returns 1 if config version doesn't have to be sent. Falls back
+ * to full sync (every node sends) whenever some member of the new ring
+ * is not in transitional membership (it joined or rejoined, possibly with
+ * different config) or didn't finish last sync with us.
+ */
+static int cmap_sync_delta_possible(
+	const unsigned int *trans_list,
+	size_t trans_list_entries,
+	const unsigned int *member_list,
+	size_t member_list_entries)
+{
+	unsigned int sorted_trans_list[PROCESSOR_COUNT_MAX];
+	size_t i;
+
+	if (cmap_first_sync || !cmap_config_version_sent ||
+	    cmap_sent_config_version != cmap_my_config_version) {
+		return (0);
+	}
+
+	if (member_list_entries > trans_list_entries) {
+		return (0);
+	}
+
+	memcpy(sorted_trans_list, trans_list, trans_list_entries * sizeof(unsigned int));
+	qsort(sorted_trans_list, trans_list_entries, sizeof(unsigned int), cmap_nodeid_compare);
+
+	for (i = 0; i < member_list_entries; i++) {
+		if (bsearch(&member_list[i], sorted_trans_list, trans_list_entries,
+		    sizeof(unsigned int), cmap_nodeid_compare) == NULL) {
+			return (0);
+		}
+
+		if (bsearch(&member_list[i], cmap_synced_member_list, cmap_synced_member_list_entries,
+		    sizeof(unsigned int), cmap_nodeid_compare) == NULL) {
+			return (0);
+		}
+	}
+
+	return (1);
+}
+
 static void cmap_sync_init (
 	const unsigned int *trans_list,
 	size_t trans_list_entries,
@@ -430,12 +538,16 @@ static void cmap_sync_init (
 
 	cmap_sync_trans_list_entries = trans_list_entries;
 	cmap_sync_member_list_entries = member_list_entries;
+	memcpy(cmap_sync_member_list, member_list, member_list_entries * sizeof(unsigned int));
 
 	if (icmap_get_uint64("totem.config_version", &cmap_my_config_version) != CS_OK) {
 		cmap_my_config_version = 0;
 	}
 
 	cmap_highest_config_version_received = cmap_my_config_version;
+
+	cmap_sync_delta = cmap_sync_delta_possible(trans_list, trans_list_entries,
+	    member_list, member_list_entries);
 }
 
 static int cmap_sync_process (void)
@@ -443,7 +555,17 @@ static int cmap_sync_process (void)
 	const char *key = "totem.config_version";
 	cs_error_t ret;
 
+	if (cmap_sync_delta) {
+		log_printf(LOGSYS_LEVEL_DEBUG, "All members in transitional membership and config version not changed -> nothing to send");
+
+		return (0);
+	}
+
 	ret = cmap_mcast_send(CMAP_MCAST_REASON_SYNC, 1, (char **)&key);
+	if (ret == CS_OK) {
+		cmap_sent_config_version = cmap_my_config_version;
+		cmap_config_version_sent = 1;
+	}
 
 	return (ret == CS_OK ? 0 : -1);
 }
@@ -451,6 +573,15 @@ static int cmap_sync_process (void)
 static void cmap_sync_activate (void)
 {
 
+	/*
+	 * Everybody agrees on config versions of current members now
+	 */
+	memcpy(cmap_synced_member_list, cmap_sync_member_list,
+	    cmap_sync_member_list_entries * sizeof(unsigned int));
+	cmap_synced_member_list_entries = cmap_sync_member_list_entries;
+	qsort(cmap_synced_member_list, cmap_synced_member_list_entries, sizeof(unsigned int),
+	    cmap_nodeid_compare);
+
 	if (cmap_sync_trans_list_entries == 0) {
 		log_printf(LOGSYS_LEVEL_DEBUG, "Single node sync -> no action");
 
@@ -699,6 +830,106 @@ reply_send:
 	api->ipc_response_send(conn, &res_lib_cmap_iter_next, sizeof(res_lib_cmap_iter_next));
 }
 
+/*
+ * Fill response with as many items as fits. Next item is taken from
+ * iterator only when worst case item still fits, so no item is ever
+ * lost because of missing space.
+ */
+static void message_handler_req_lib_cmap_iter_next_bulk(void *conn, const void *message)
+{
+	const struct req_lib_cmap_iter_next_bulk *req_lib_cmap_iter_next_bulk = message;
+	struct res_lib_cmap_iter_next_bulk *res_lib_cmap_iter_next_bulk = NULL;
+	struct res_lib_cmap_iter_next_bulk error_res_lib_cmap_iter_next_bulk;
+	struct res_lib_cmap_iter_next_bulk_item *item;
+	cs_error_t ret;
+	icmap_iter_t *iter;
+	size_t max_size;
+	size_t res_size;
+	size_t value_len;
+	size_t key_name_len;
+	icmap_value_types_t type;
+	const char *key_name;
+	struct cmap_conn_info *conn_info = (struct cmap_conn_info *)api->ipc_private_data_get (conn);
+
+	max_size = req_lib_cmap_iter_next_bulk->max_size;
+	if (max_size > CMAP_ITER_BULK_MAX_RES_SIZE) {
+		max_size = CMAP_ITER_BULK_MAX_RES_SIZE;
+	}
+	if (max_size < sizeof(*res_lib_cmap_iter_next_bulk) + CMAP_ITER_BULK_MAX_ITEM_SIZE ||
+	    req_lib_cmap_iter_next_bulk->max_items == 0) {
+		ret = CS_ERR_INVALID_PARAM;
+		goto error_exit;
+	}
+
+	ret = hdb_error_to_cs(hdb_handle_get(&conn_info->iter_db,
+				req_lib_cmap_iter_next_bulk->iter_handle, (void *)&iter));
+	if (ret != CS_OK) {
+		goto error_exit;
+	}
+
+	res_lib_cmap_iter_next_bulk = malloc(max_size);
+	if (res_lib_cmap_iter_next_bulk == NULL) {
+		(void)hdb_handle_put (&conn_info->iter_db, req_lib_cmap_iter_next_bulk->iter_handle);
+		ret = CS_ERR_NO_MEMORY;
+		goto error_exit;
+	}
+
+	memset(res_lib_cmap_iter_next_bulk, 0, sizeof(*res_lib_cmap_iter_next_bulk));
+	res_size = sizeof(*res_lib_cmap_iter_next_bulk);
+
+	while (res_lib_cmap_iter_next_bulk->no_items < req_lib_cmap_iter_next_bulk->max_items &&
+	    max_size - res_size >= CMAP_ITER_BULK_MAX_ITEM_SIZE) {
+		key_name = conn_info->map_fns.map_iter_next(*iter, &value_len, &type);
+		if (key_name == NULL) {
+			break;
+		}
+
+		item = (struct res_lib_cmap_iter_next_bulk_item *)((char *)res_lib_cmap_iter_next_bulk + res_size);
+		value_len = CMAP_ITER_BULK_MAX_VALUE_LEN;
+		if (conn_info->map_fns.map_get(key_name, item->data, &value_len, &type) != CS_OK) {
+			/*
+			 * Key was removed (or its value cannot be read) since iterator returned it.
+			 */
+			continue ;
+		}
+
+		key_name_len = strlen(key_name) + 1;
+		memcpy(item->data + value_len, key_name, key_name_len);
+		item->value_len = value_len;
+		item->key_name_len = key_name_len;
+		item->type = type;
+		item->reserved = 0;
+
+		res_size += CMAP_ITER_BULK_ITEM_SIZE(value_len, key_name_len);
+		res_lib_cmap_iter_next_bulk->no_items++;
+	}
+
+	(void)hdb_handle_put (&conn_info->iter_db, req_lib_cmap_iter_next_bulk->iter_handle);
+
+	if (res_lib_cmap_iter_next_bulk->no_items == 0) {
+		free(res_lib_cmap_iter_next_bulk);
+		ret = CS_ERR_NO_SECTIONS;
+		goto error_exit;
+	}
+
+	res_lib_cmap_iter_next_bulk->header.size = res_size;
+	res_lib_cmap_iter_next_bulk->header.id = MESSAGE_RES_CMAP_ITER_NEXT_BULK;
+	res_lib_cmap_iter_next_bulk->header.error = CS_OK;
+
+	api->ipc_response_send(conn, res_lib_cmap_iter_next_bulk, res_size);
+	free(res_lib_cmap_iter_next_bulk);
+
+	return ;
+
+error_exit:
+	memset(&error_res_lib_cmap_iter_next_bulk, 0, sizeof(error_res_lib_cmap_iter_next_bulk));
+	error_res_lib_cmap_iter_next_bulk.header.size = sizeof(error_res_lib_cmap_iter_next_bulk);
+	error_res_lib_cmap_iter_next_bulk.header.id = MESSAGE_RES_CMAP_ITER_NEXT_BULK;
+	error_res_lib_cmap_iter_next_bulk.header.error = ret;
+
+	api->ipc_response_send(conn, &error_res_lib_cmap_iter_next_bulk, sizeof(error_res_lib_cmap_iter_next_bulk));
+}
+
 static void message_handler_req_lib_cmap_iter_finalize(void *conn, const void *message)
 {
 	const struct req_lib_cmap_iter_finalize *req_lib_cmap_iter_finalize = message;
@@ -764,9 +995,251 @@ static void cmap_notify_fn(int32_t event,
 	api->ipc_dispatch_iov_send(cmap_track_user_data->conn, iov, 3);
 }
 
-static void message_handler_req_lib_cmap_track_add(void *conn, const void *message)
+static void cmap_coalesce_item_free(struct cmap_coalesce_item *item)
+{
+
+	free((void *)item->new_val.data);
+	free((void *)item->old_val.data);
+	free(item);
+}
+
+static int cmap_coalesce_value_copy(struct icmap_notify_value *dst, const struct icmap_notify_value *src)
+{
+	void *data = NULL;
+
+	if (src->len > 0) {
+		data = malloc(src->len);
+		if (data == NULL) {
+			return (-1);
+		}
+		memcpy(data, src->data, src->len);
+	}
+
+	free((void *)dst->data);
+	dst->type = src->type;
+	dst->len = src->len;
+	dst->data = data;
+
+	return (0);
+}
+
+static size_t cmap_coalesce_item_size(const struct cmap_coalesce_item *item)
+{
+
+	return (CMAP_NOTIFY_BATCH_ITEM_SIZE(item->new_val.len, item->old_val.len, strlen(item->key_name) + 1));
+}
+
+/*
+ * Send all collected changes as one batch and forget them
+ */
+static void cmap_coalesce_flush(struct cmap_track_user_data *cmap_track_user_data)
+{
+	struct res_lib_cmap_notify_batch_callback *res_lib_cmap_notify_batch_callback;
+	struct res_lib_cmap_notify_batch_item *batch_item;
+	struct cmap_coalesce_item *item;
+	struct qb_list_head *iter, *tmp_iter;
+	size_t res_size;
+	size_t key_name_len;
+	char *p;
+
+	if (cmap_track_user_data->coalesce_timer_running) {
+		api->timer_delete(cmap_track_user_data->coalesce_timer);
+		cmap_track_user_data->coalesce_timer_running = 0;
+	}
+
+	if (qb_list_empty(&cmap_track_user_data->coalesce_list)) {
+		return ;
+	}
+
+	res_size = sizeof(*res_lib_cmap_notify_batch_callback) + cmap_track_user_data->coalesce_size;
+	res_lib_cmap_notify_batch_callback = malloc(res_size);
+	if (res_lib_cmap_notify_batch_callback == NULL) {
+		log_printf(LOGSYS_LEVEL_ERROR, "Can't alloc memory for batch notification. Changes are lost.");
+	} else {
+		memset(res_lib_cmap_notify_batch_callback, 0, res_size);
+		res_lib_cmap_notify_batch_callback->header.size = res_size;
+		res_lib_cmap_notify_batch_callback->header.id = MESSAGE_RES_CMAP_NOTIFY_BATCH_CALLBACK;
+		res_lib_cmap_notify_batch_callback->header.error = CS_OK;
+		res_lib_cmap_notify_batch_callback->track_inst_handle = cmap_track_user_data->track_inst_handle;
+	}
+
+	p = (char *)res_lib_cmap_notify_batch_callback + sizeof(*res_lib_cmap_notify_batch_callback);
+
+	qb_list_for_each_safe(iter, tmp_iter, &cmap_track_user_data->coalesce_list) {
+		item = qb_list_entry(iter, struct cmap_coalesce_item, list);
+
+		if (res_lib_cmap_notify_batch_callback != NULL) {
+			batch_item = (struct res_lib_cmap_notify_batch_item *)p;
+			key_name_len = strlen(item->key_name) + 1;
+
+			batch_item->event = item->event;
+			batch_item->new_value_type = item->new_val.type;
+			batch_item->old_value_type = item->old_val.type;
+			batch_item->key_name_len = key_name_len;
+			batch_item->new_value_len = item->new_val.len;
+			batch_item->old_value_len = item->old_val.len;
+			memcpy(batch_item->data, item->new_val.data, item->new_val.len);
+			memcpy(batch_item->data + item->new_val.len, item->old_val.data, item->old_val.len);
+			memcpy(batch_item->data + item->new_val.len + item->old_val.len, item->key_name, key_name_len);
+
+			p += cmap_coalesce_item_size(item);
+			res_lib_cmap_notify_batch_callback->no_items++;
+		}
+
+		qb_map_rm(cmap_track_user_data->coalesce_map, item->key_name);
+		qb_list_del(&item->list);
+		cmap_coalesce_item_free(item);
+	}
+
+	cmap_track_user_data->coalesce_size = 0;
+
+	if (res_lib_cmap_notify_batch_callback != NULL) {
+		api->ipc_dispatch_send(cmap_track_user_data->conn, res_lib_cmap_notify_batch_callback, res_size);
+		free(res_lib_cmap_notify_batch_callback);
+	}
+}
+
+static void cmap_coalesce_timer_fn(void *data)
+{
+	struct cmap_track_user_data *cmap_track_user_data = (struct cmap_track_user_data *)data;
+
+	cmap_track_user_data->coalesce_timer_running = 0;
+
+	cmap_coalesce_flush(cmap_track_user_data);
+}
+
+/*
+ * Notify function of coalescing tracker. Change is merged with previous
+ * (not yet sent) change of the same key, so new value is always the last
+ * one and old value is the one before first change in the window.
+ */
+static void cmap_coalesce_notify_fn(int32_t event,
+		const char *key_name,
+		struct icmap_notify_value new_val,
+		struct icmap_notify_value old_val,
+		void *user_data)
+{
+	struct cmap_track_user_data *cmap_track_user_data = (struct cmap_track_user_data *)user_data;
+	struct cmap_coalesce_item *item;
+	size_t old_item_size;
+	size_t new_item_size;
+
+	item = qb_map_get(cmap_track_user_data->coalesce_map, key_name);
+
+	old_item_size = (item != NULL ? cmap_coalesce_item_size(item) : 0);
+	new_item_size = CMAP_NOTIFY_BATCH_ITEM_SIZE(new_val.len,
+	    (item != NULL ? item->old_val.len : old_val.len), strlen(key_name) + 1);
+
+	if (sizeof(struct res_lib_cmap_notify_batch_callback) + cmap_track_user_data->coalesce_size -
+	    old_item_size + new_item_size > CMAP_NOTIFY_BATCH_MAX_SIZE) {
+		cmap_coalesce_flush(cmap_track_user_data);
+		item = NULL;
+		old_item_size = 0;
+		/*
+		 * New item starts with current old value, not with the one of
+		 * the flushed item
+		 */
+		new_item_size = CMAP_NOTIFY_BATCH_ITEM_SIZE(new_val.len, old_val.len,
+		    strlen(key_name) + 1);
+	}
+
+	if (item == NULL) {
+		item = malloc(sizeof(*item));
+		if (item == NULL) {
+			goto error_exit;
+		}
+		memset(item, 0, sizeof(*item));
+		strncpy(item->key_name, key_name, ICMAP_KEYNAME_MAXLEN);
+		item->event = event;
+
+		if (cmap_coalesce_value_copy(&item->old_val, &old_val) != 0) {
+			free(item);
+			goto error_exit;
+		}
+
+		qb_list_init(&item->list);
+		qb_list_add_tail(&item->list, &cmap_track_user_data->coalesce_list);
+		qb_map_put(cmap_track_user_data->coalesce_map, item->key_name, item);
+	} else {
+		if (item->event == ICMAP_TRACK_ADD && event == ICMAP_TRACK_DELETE) {
+			/*
+			 * Key created and deleted in the window -> nothing to notify
+			 */
+			qb_map_rm(cmap_track_user_data->coalesce_map, item->key_name);
+			qb_list_del(&item->list);
+			cmap_track_user_data->coalesce_size -= old_item_size;
+			cmap_coalesce_item_free(item);
+
+			return ;
+		}
+
+		if (item->event == ICMAP_TRACK_DELETE && event == ICMAP_TRACK_ADD) {
+			item->event = ICMAP_TRACK_MODIFY;
+		} else if (item->event != ICMAP_TRACK_ADD) {
+			item->event = event;
+		}
+	}
+
+	if (cmap_coalesce_value_copy(&item->new_val, &new_val) != 0) {
+		/*
+		 * Keep previous new value and send what we have
+		 */
+		cmap_track_user_data->coalesce_size += cmap_coalesce_item_size(item) - old_item_size;
+		cmap_coalesce_flush(cmap_track_user_data);
+		goto error_exit;
+	}
+
+	cmap_track_user_data->coalesce_size += new_item_size - old_item_size;
+
+	if (!cmap_track_user_data->coalesce_timer_running) {
+		if (api->timer_add_duration((unsigned long long)cmap_track_user_data->coalesce_window *
+		    QB_TIME_NS_IN_MSEC, cmap_track_user_data, cmap_coalesce_timer_fn,
+		    &cmap_track_user_data->coalesce_timer) == 0) {
+			cmap_track_user_data->coalesce_timer_running = 1;
+		} else {
+			cmap_coalesce_flush(cmap_track_user_data);
+		}
+	}
+
+	return ;
+
+error_exit:
+	log_printf(LOGSYS_LEVEL_ERROR, "Can't alloc memory for coalesced notification of %s", key_name);
+}
+
+static void cmap_track_user_data_free(struct cmap_track_user_data *cmap_track_user_data)
+{
+	struct cmap_coalesce_item *item;
+	struct qb_list_head *iter, *tmp_iter;
+
+	if (cmap_track_user_data == NULL) {
+		return ;
+	}
+
+	if (cmap_track_user_data->coalesce_map != NULL) {
+		if (cmap_track_user_data->coalesce_timer_running) {
+			api->timer_delete(cmap_track_user_data->coalesce_timer);
+		}
+
+		qb_list_for_each_safe(iter, tmp_iter, &cmap_track_user_data->coalesce_list) {
+			item = qb_list_entry(iter, struct cmap_coalesce_item, list);
+
+			qb_list_del(&item->list);
+			cmap_coalesce_item_free(item);
+		}
+
+		qb_map_destroy(cmap_track_user_data->coalesce_map);
+	}
+
+	free(cmap_track_user_data);
+}
+
+static void cmap_track_add_send(void *conn,
+		const mar_name_t *req_key_name,
+		int32_t track_type,
+		uint64_t track_inst_handle,
+		uint32_t coalesce_window)
 {
-	const struct req_lib_cmap_track_add *req_lib_cmap_track_add = message;
 	struct res_lib_cmap_track_add res_lib_cmap_track_add;
 	cs_error_t ret;
 	cmap_track_handle_t handle = 0;
@@ -785,33 +1258,47 @@ static void message_handler_req_lib_cmap_track_add(void *conn, const void *messa
 	}
 	memset(cmap_track_user_data, 0, sizeof(*cmap_track_user_data));
 
-	if (req_lib_cmap_track_add->key_name.length > 0) {
-		key_name = (char *)req_lib_cmap_track_add->key_name.value;
+	if (coalesce_window > 0) {
+		cmap_track_user_data->coalesce_window = coalesce_window;
+		qb_list_init(&cmap_track_user_data->coalesce_list);
+		cmap_track_user_data->coalesce_map = qb_skiplist_create();
+		if (cmap_track_user_data->coalesce_map == NULL) {
+			free(cmap_track_user_data);
+			ret = CS_ERR_NO_MEMORY;
+
+			goto reply_send;
+		}
+	}
+
+	if (req_key_name->length > 0) {
+		key_name = (char *)req_key_name->value;
 	} else {
 		key_name = NULL;
 	}
 
 	ret = conn_info->map_fns.map_track_add(key_name,
-					       req_lib_cmap_track_add->track_type,
-					       cmap_notify_fn,
+					       track_type,
+					       (coalesce_window > 0 ? cmap_coalesce_notify_fn : cmap_notify_fn),
 					       cmap_track_user_data,
 					       &track);
 	if (ret != CS_OK) {
-		free(cmap_track_user_data);
+		cmap_track_user_data_free(cmap_track_user_data);
 
 		goto reply_send;
 	}
 
 	ret = hdb_error_to_cs(hdb_handle_create(&conn_info->track_db, sizeof(track), &handle));
 	if (ret != CS_OK) {
-		free(cmap_track_user_data);
+		conn_info->map_fns.map_track_delete(track);
+		cmap_track_user_data_free(cmap_track_user_data);
 
 		goto reply_send;
 	}
 
 	ret = hdb_error_to_cs(hdb_handle_get(&conn_info->track_db, handle, (void *)&hdb_track));
 	if (ret != CS_OK) {
-		free(cmap_track_user_data);
+		conn_info->map_fns.map_track_delete(track);
+		cmap_track_user_data_free(cmap_track_user_data);
 
 		goto reply_send;
 	}
@@ -819,7 +1306,7 @@ static void message_handler_req_lib_cmap_track_add(void *conn, const void *messa
 	*hdb_track = track;
 	cmap_track_user_data->conn = conn;
 	cmap_track_user_data->track_handle = handle;
-	cmap_track_user_data->track_inst_handle = req_lib_cmap_track_add->track_inst_handle;
+	cmap_track_user_data->track_inst_handle = track_inst_handle;
 
 	(void)hdb_handle_put (&conn_info->track_db, handle);
 
@@ -833,6 +1320,36 @@ reply_send:
 	api->ipc_response_send(conn, &res_lib_cmap_track_add, sizeof(res_lib_cmap_track_add));
 }
 
+static void message_handler_req_lib_cmap_track_add(void *conn, const void *message)
+{
+	const struct req_lib_cmap_track_add *req_lib_cmap_track_add = message;
+
+	cmap_track_add_send(conn, &req_lib_cmap_track_add->key_name,
+	    req_lib_cmap_track_add->track_type, req_lib_cmap_track_add->track_inst_handle, 0);
+}
+
+static void message_handler_req_lib_cmap_track_add_coalesced(void *conn, const void *message)
+{
+	const struct req_lib_cmap_track_add_coalesced *req_lib_cmap_track_add_coalesced = message;
+	struct res_lib_cmap_track_add res_lib_cmap_track_add;
+
+	if (req_lib_cmap_track_add_coalesced->window == 0 ||
+	    req_lib_cmap_track_add_coalesced->window > CMAP_TRACK_COALESCE_MAX_WINDOW) {
+		memset(&res_lib_cmap_track_add, 0, sizeof(res_lib_cmap_track_add));
+		res_lib_cmap_track_add.header.size = sizeof(res_lib_cmap_track_add);
+		res_lib_cmap_track_add.header.id = MESSAGE_RES_CMAP_TRACK_ADD;
+		res_lib_cmap_track_add.header.error = CS_ERR_INVALID_PARAM;
+
+		api->ipc_response_send(conn, &res_lib_cmap_track_add, sizeof(res_lib_cmap_track_add));
+
+		return ;
+	}
+
+	cmap_track_add_send(conn, &req_lib_cmap_track_add_coalesced->key_name,
+	    req_lib_cmap_track_add_coalesced->track_type, req_lib_cmap_track_add_coalesced->track_inst_handle,
+	    req_lib_cmap_track_add_coalesced->window);
+}
+
 static void message_handler_req_lib_cmap_track_delete(void *conn, const void *message)
 {
 	const struct req_lib_cmap_track_delete *req_lib_cmap_track_delete = message;
@@ -850,7 +1367,7 @@ static void message_handler_req_lib_cmap_track_delete(void *conn, const void *me
 
 	track_inst_handle = ((struct cmap_track_user_data *)icmap_track_get_user_data(*track))->track_inst_handle;
 
-	free(conn_info->map_fns.map_track_get_user_data(*track));
+	cmap_track_user_data_free(conn_info->map_fns.map_track_get_user_data(*track));
 
 	ret = conn_info->map_fns.map_track_delete(*track);
 
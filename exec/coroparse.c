@@ -575,6 +575,7 @@ static int main_config_parser_cb(const char *path,
 	struct key_value_list_item *kv_item;
 	struct qb_list_head *iter, *tmp_iter;
 	int uid, gid;
+	char *endptr;
 	cs_error_t cs_err;
 
 	cs_err = CS_OK;
@@ -790,6 +791,59 @@ static int main_config_parser_cb(const char *path,
 					return (0);
 				}
 			}
+			if (strcmp(path, "qb.ipc_thread") == 0) {
+				if ((strcmp(value, "yes") != 0) &&
+				    (strcmp(value, "no") != 0)) {
+					*error_string = "Invalid qb ipc_thread";
+
+					return (0);
+				}
+			}
+			if (strcmp(path, "qb.stats_shm") == 0) {
+				if ((strcmp(value, "yes") != 0) &&
+				    (strcmp(value, "no") != 0)) {
+					*error_string = "Invalid qb stats_shm";
+
+					return (0);
+				}
+			}
+			if (strcmp(path, "qb.stats_shm_group") == 0) {
+				gid = gid_determine(value);
+				if (gid == -1) {
+					*error_string = error_string_response;
+					return (0);
+				}
+				if ((cs_err = icmap_set_uint32_r(config_map, path, gid)) != CS_OK) {
+					goto icmap_set_error;
+				}
+				add_as_string = 0;
+			}
+			if (strcmp(path, "qb.stats_shm_mode") == 0) {
+				errno = 0;
+				ull = strtoull(value, &endptr, 8);
+				if (errno != 0 || endptr == value || *endptr != '\0' ||
+				    (ull & ~(unsigned long long int)0644) != 0) {
+					*error_string = "Invalid qb stats_shm_mode";
+
+					return (0);
+				}
+				if ((cs_err = icmap_set_uint32_r(config_map, path, ull)) != CS_OK) {
+					goto icmap_set_error;
+				}
+				add_as_string = 0;
+			}
+			if ((strcmp(path, "qb.ipc_outq_max_size") == 0) ||
+			    (strcmp(path, "qb.ipc_fc_credits") == 0) ||
+			    (strncmp(path, "qb.ipc_fc_priority.", strlen("qb.ipc_fc_priority.")) == 0)) {
+				val_type = ICMAP_VALUETYPE_UINT32;
+				if (safe_atoq(value, &val, val_type) != 0) {
+					goto atoi_error;
+				}
+				if ((cs_err = icmap_set_uint32_r(config_map, path, val)) != CS_OK) {
+					goto icmap_set_error;
+				}
+				add_as_string = 0;
+			}
 			break;
 
 		case MAIN_CP_CB_DATA_STATE_INTERFACE:
@@ -49,19 +49,23 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <time.h>
 #include <assert.h>
 #include <arpa/inet.h>
 #include <sys/mman.h>
+#include <stddef.h>
 
 #include <qb/qblist.h>
 #include <qb/qbmap.h>
+#include <qb/qbutil.h>
 
 #include <corosync/corotypes.h>
 #include <qb/qbipc_common.h>
 #include <corosync/corodefs.h>
 #include <corosync/logsys.h>
 #include <corosync/coroapi.h>
+#include <corosync/icmap.h>
 
 #include <corosync/cpg.h>
 #include <corosync/ipc_cpg.h>
@@ -84,6 +88,7 @@ enum cpg_message_req_types {
 	MESSAGE_REQ_EXEC_CPG_DOWNLIST_OLD = 4,
 	MESSAGE_REQ_EXEC_CPG_DOWNLIST = 5,
 	MESSAGE_REQ_EXEC_CPG_PARTIAL_MCAST = 6,
+	MESSAGE_REQ_EXEC_CPG_JOINLIST_COMPACT = 7,
 };
 
 struct zcb_mapped {
@@ -137,11 +142,10 @@ enum cpd_state {
 
 enum cpg_sync_state {
 	CPGSYNC_DOWNLIST,
+	CPGSYNC_DOWNLIST_WAIT,
 	CPGSYNC_JOINLIST
 };
 
-static struct qb_list_head joinlist_messages_head;
-
 struct cpg_pd {
 	void *conn;
  	mar_cpg_name_t group_name;
@@ -154,6 +158,9 @@ struct cpg_pd {
 	struct qb_list_head list;
 	struct qb_list_head iteration_instance_list_head;
 	struct qb_list_head zcb_mapped_list_head;
+	void *zc_recv_addr; /* Zero copy receive arena, NULL if not used */
+	size_t zc_recv_size;
+	uint64_t zc_recv_head;
 };
 
 struct cpg_iteration_instance {
@@ -194,6 +201,18 @@ struct join_list_entry {
 	mar_cpg_name_t group_name;
 };
 
+/*
+ * Compact joinlist carries every group name only once. Each group is
+ * encoded as join_list_compact_group followed by name_length bytes of
+ * group name (padded to 4 bytes) and pid_entries pids.
+ */
+struct join_list_compact_group {
+	mar_uint32_t pid_entries;
+	mar_uint32_t name_length;
+};
+
+#define JOIN_LIST_COMPACT_NAME_SIZE(len) (((len) + 3) & ~3)
+
 /*
  * Service Interfaces required by service_message_handler struct
  */
@@ -215,6 +234,10 @@ static void message_handler_req_exec_cpg_joinlist (
 	const void *message,
 	unsigned int nodeid);
 
+static void message_handler_req_exec_cpg_joinlist_compact (
+	const void *message,
+	unsigned int nodeid);
+
 static void message_handler_req_exec_cpg_mcast (
 	const void *message,
 	unsigned int nodeid);
@@ -235,6 +258,8 @@ static void exec_cpg_procjoin_endian_convert (void *msg);
 
 static void exec_cpg_joinlist_endian_convert (void *msg);
 
+static void exec_cpg_joinlist_compact_endian_convert (void *msg);
+
 static void exec_cpg_mcast_endian_convert (void *msg);
 
 static void exec_cpg_partial_mcast_endian_convert (void *msg);
@@ -267,6 +292,10 @@ static void message_handler_req_lib_cpg_iteration_next (
 	void *conn,
 	const void *message);
 
+static void message_handler_req_lib_cpg_iteration_next_bulk (
+	void *conn,
+	const void *message);
+
 static void message_handler_req_lib_cpg_iteration_finalize (
 	void *conn,
 	const void *message);
@@ -283,6 +312,10 @@ static void message_handler_req_lib_cpg_zc_execute (
 	void *conn,
 	const void *message);
 
+static void message_handler_req_lib_cpg_zc_recv_init (
+	void *conn,
+	const void *message);
+
 static int cpg_node_joinleave_send (unsigned int pid, const mar_cpg_name_t *group_name, int fn, int reason);
 
 static int cpg_exec_send_downlist(void);
@@ -314,6 +347,13 @@ static void do_proc_join(
 	unsigned int nodeid,
 	int reason);
 
+static void do_proc_join_at(
+	const mar_cpg_name_t *name,
+	uint32_t pid,
+	unsigned int nodeid,
+	int reason,
+	struct qb_list_head *list_to_add);
+
 static void do_proc_leave(
 	const mar_cpg_name_t *name,
 	uint32_t pid,
@@ -328,6 +368,9 @@ static int notify_lib_totem_membership (
 static inline int zcb_all_free (
 	struct cpg_pd *cpd);
 
+static void zc_recv_free (
+	struct cpg_pd *cpd);
+
 static char *cpg_print_group_name (
 	const mar_cpg_name_t *group);
 
@@ -388,6 +431,14 @@ static struct corosync_lib_handler cpg_lib_engine[] =
 		.lib_handler_fn				= message_handler_req_lib_cpg_partial_mcast,
 		.flow_control				= CS_LIB_FLOW_CONTROL_REQUIRED
 	},
+	{ /* 13 */
+		.lib_handler_fn				= message_handler_req_lib_cpg_zc_recv_init,
+		.flow_control				= CS_LIB_FLOW_CONTROL_NOT_REQUIRED
+	},
+	{ /* 14 - MESSAGE_REQ_CPG_ITERATIONNEXT_BULK */
+		.lib_handler_fn				= message_handler_req_lib_cpg_iteration_next_bulk,
+		.flow_control				= CS_LIB_FLOW_CONTROL_NOT_REQUIRED
+	},
 
 };
 
@@ -421,6 +472,10 @@ static struct corosync_exec_handler cpg_exec_engine[] =
 		.exec_handler_fn	= message_handler_req_exec_cpg_partial_mcast,
 		.exec_endian_convert_fn	= exec_cpg_partial_mcast_endian_convert
 	},
+	{ /* 7 - MESSAGE_REQ_EXEC_CPG_JOINLIST_COMPACT */
+		.exec_handler_fn	= message_handler_req_exec_cpg_joinlist_compact,
+		.exec_endian_convert_fn	= exec_cpg_joinlist_compact_endian_convert
+	},
 };
 
 struct corosync_service_engine cpg_service_engine = {
@@ -441,7 +496,8 @@ struct corosync_service_engine cpg_service_engine = {
 	.sync_init                              = cpg_sync_init,
 	.sync_process                           = cpg_sync_process,
 	.sync_activate                          = cpg_sync_activate,
-	.sync_abort                             = cpg_sync_abort
+	.sync_abort                             = cpg_sync_abort,
+	.sync_dependency                        = CS_SYNC_INDEPENDENT
 };
 
 struct corosync_service_engine *cpg_get_service_engine_ver0 (void)
@@ -491,13 +547,47 @@ struct req_exec_cpg_downlist {
 	mar_uint32_t nodeids[PROCESSOR_COUNT_MAX]  __attribute__((aligned(8)));
 };
 
+/*
+ * Optional capabilities of sender are advertised in trailer appended
+ * right after left_nodes entries of downlist. Older versions always send
+ * full sized downlist without trailer and never look past left_nodes
+ * entries of received downlist.
+ */
+#define CPG_DOWNLIST_TRAILER_MAGIC		0x43504743
+#define CPG_CAPABILITY_JOINLIST_COMPACT		0x00000001
+
+struct req_exec_cpg_downlist_trailer {
+	mar_uint32_t magic;
+	mar_uint32_t capabilities;
+};
+
 struct joinlist_msg {
 	mar_uint32_t sender_nodeid;
 	uint32_t pid;
 	mar_cpg_name_t group_name;
-	struct qb_list_head list;
 };
 
+/*
+ * Joinlist entries received during sync. Sorted by nodeid and pid
+ * before they are merged with process_info_list.
+ */
+static struct joinlist_msg *joinlist_messages;
+
+static size_t joinlist_messages_entries;
+
+static size_t joinlist_messages_allocated;
+
+/*
+ * Nodes whose downlist was received during current sync
+ */
+static unsigned int downlist_received_list[PROCESSOR_COUNT_MAX];
+
+static unsigned int downlist_received_entries;
+
+static unsigned int downlist_compact_capable_entries;
+
+static uint64_t sync_start_time;
+
 static struct req_exec_cpg_downlist g_req_exec_cpg_downlist;
 
 /*
@@ -530,6 +620,16 @@ static char *cpg_print_group_name(const mar_cpg_name_t *group)
 	return (res);
 }
 
+/*
+ * Compact joinlist can be used only if every member advertised support
+ * for it in its downlist
+ */
+static int cpg_joinlist_compact_allowed (void)
+{
+	return (downlist_received_entries >= my_member_list_entries &&
+		downlist_compact_capable_entries >= my_member_list_entries);
+}
+
 static void cpg_sync_init (
 	const unsigned int *trans_list,
 	size_t trans_list_entries,
@@ -542,6 +642,10 @@ static void cpg_sync_init (
 	int found;
 
 	my_sync_state = CPGSYNC_DOWNLIST;
+	sync_start_time = qb_util_nano_current_get ();
+
+	downlist_received_entries = 0;
+	downlist_compact_capable_entries = 0;
 
 	memcpy (my_member_list, member_list, member_list_entries *
 		sizeof (unsigned int));
@@ -579,6 +683,17 @@ static int cpg_sync_process (void)
 		if (res == -1) {
 			return (-1);
 		}
+		my_sync_state = CPGSYNC_DOWNLIST_WAIT;
+	}
+	if (my_sync_state == CPGSYNC_DOWNLIST_WAIT) {
+		/*
+		 * Joinlist encoding is chosen based on capabilities advertised
+		 * in downlists, so wait until all members sent one. Processing
+		 * is resumed by downlist_received_add.
+		 */
+		if (downlist_received_entries < my_member_list_entries) {
+			return (CS_SYNC_PROCESS_WAIT);
+		}
 		my_sync_state = CPGSYNC_JOINLIST;
 	}
 	if (my_sync_state == CPGSYNC_JOINLIST) {
@@ -589,6 +704,9 @@ static int cpg_sync_process (void)
 
 static void cpg_sync_activate (void)
 {
+	uint64_t sync_duration;
+	size_t joinlist_entries;
+
 	memcpy (my_old_member_list, my_member_list,
 		my_member_list_entries * sizeof (unsigned int));
 	my_old_member_list_entries = my_member_list_entries;
@@ -597,9 +715,19 @@ static void cpg_sync_activate (void)
 
 	joinlist_inform_clients ();
 
+	joinlist_entries = joinlist_messages_entries;
 	joinlist_messages_delete ();
 
 	notify_lib_totem_membership (NULL, my_member_list_entries, my_member_list);
+
+	sync_duration = (qb_util_nano_current_get () - sync_start_time) / QB_TIME_NS_IN_USEC;
+
+	log_printf (LOGSYS_LEVEL_DEBUG, "sync took %"PRIu64" us, %zu joinlist entries (%s encoding)",
+		sync_duration, joinlist_entries,
+		cpg_joinlist_compact_allowed () ? "compact" : "legacy");
+
+	icmap_set_uint64 ("runtime.services.cpg.sync.last_duration", sync_duration);
+	icmap_set_uint32 ("runtime.services.cpg.sync.joinlist_entries", joinlist_entries);
 }
 
 static void cpg_sync_abort (void)
@@ -645,6 +773,39 @@ static int notify_lib_totem_membership (
 	return CS_OK;
 }
 
+static int cpg_group_has_local_cpd (const mar_cpg_name_t *group_name)
+{
+	struct qb_list_head *iter;
+
+	qb_list_for_each(iter, &cpg_pd_list_head) {
+		struct cpg_pd *cpd = qb_list_entry (iter, struct cpg_pd, list);
+
+		if (mar_name_compare (&cpd->group_name, group_name) == 0) {
+			return (1);
+		}
+	}
+
+	return (0);
+}
+
+static void notify_lib_initial_totem_conf (void)
+{
+	struct qb_list_head *iter;
+
+	/*
+	 * Traverse thru cpds and send totem membership for cpd, where it is not send yet
+	 */
+	qb_list_for_each(iter, &cpg_pd_list_head) {
+		struct cpg_pd *cpd = qb_list_entry (iter, struct cpg_pd, list);
+
+		if ((cpd->flags & CPG_MODEL_V1_DELIVER_INITIAL_TOTEM_CONF) && (cpd->initial_totem_conf_sent == 0)) {
+			cpd->initial_totem_conf_sent = 1;
+
+			notify_lib_totem_membership (cpd->conn, my_old_member_list_entries, my_old_member_list);
+		}
+	}
+}
+
 static int notify_lib_joinlist(
 	const mar_cpg_name_t *group_name,
 	void *conn,
@@ -661,6 +822,14 @@ static int notify_lib_joinlist(
 	struct res_lib_cpg_confchg_callback *res;
 	mar_cpg_address_t *retgi;
 
+	/*
+	 * Confchg is built only when there is someone to receive it
+	 */
+	if (conn == NULL && !cpg_group_has_local_cpd (group_name)) {
+		notify_lib_initial_totem_conf ();
+		return CS_OK;
+	}
+
 	count = 0;
 
 	qb_list_for_each(iter, &process_info_list_head) {
@@ -761,18 +930,7 @@ static int notify_lib_joinlist(
 	}
 
 
-	/*
-	 * Traverse thru cpds and send totem membership for cpd, where it is not send yet
-	 */
-	qb_list_for_each(iter, &cpg_pd_list_head) {
-		struct cpg_pd *cpd = qb_list_entry (iter, struct cpg_pd, list);
-
-		if ((cpd->flags & CPG_MODEL_V1_DELIVER_INITIAL_TOTEM_CONF) && (cpd->initial_totem_conf_sent == 0)) {
-			cpd->initial_totem_conf_sent = 1;
-
-			notify_lib_totem_membership (cpd->conn, my_old_member_list_entries, my_old_member_list);
-		}
-	}
+	notify_lib_initial_totem_conf ();
 
 	return CS_OK;
 }
@@ -872,14 +1030,39 @@ static void downlist_inform_clients (void)
 /*
  * Remove processes that might have left the group while we were suspended.
  */
+/*
+ * Joinlist messages are sorted in the same order as process_info_list
+ * (nodeid, pid) and by group name for same process.
+ */
+static int joinlist_msg_compare (const void *a, const void *b)
+{
+	const struct joinlist_msg *msg_a = a;
+	const struct joinlist_msg *msg_b = b;
+
+	if (msg_a->sender_nodeid != msg_b->sender_nodeid) {
+		return (msg_a->sender_nodeid < msg_b->sender_nodeid ? -1 : 1);
+	}
+
+	if (msg_a->pid != msg_b->pid) {
+		return (msg_a->pid < msg_b->pid ? -1 : 1);
+	}
+
+	return (mar_name_compare (&msg_a->group_name, &msg_b->group_name));
+}
+
+/*
+ * Remove processes that might have left the group while we were suspended.
+ * Expects sorted joinlist_messages.
+ */
 static void joinlist_remove_zombie_pi_entries (void)
 {
 	struct qb_list_head *pi_iter, *tmp_iter;
-	struct qb_list_head *jl_iter;
 	struct process_info *pi;
 	struct joinlist_msg *stored_msg;
+	size_t i, j;
 	int found;
 
+	i = 0;
 	qb_list_for_each_safe(pi_iter, tmp_iter, &process_info_list_head) {
 		pi = qb_list_entry (pi_iter, struct process_info, list);
 
@@ -890,20 +1073,29 @@ static void joinlist_remove_zombie_pi_entries (void)
 			continue ;
 		}
 
+		/*
+		 * Skip joinlist messages sorted before process
+		 */
+		while (i < joinlist_messages_entries &&
+		    (joinlist_messages[i].sender_nodeid < pi->nodeid ||
+		     (joinlist_messages[i].sender_nodeid == pi->nodeid &&
+		      joinlist_messages[i].pid < pi->pid))) {
+			i++;
+		}
+
 		/*
 		 * Try to find message in joinlist messages
 		 */
 		found = 0;
-		qb_list_for_each(jl_iter, &joinlist_messages_head) {
-			stored_msg = qb_list_entry(jl_iter, struct joinlist_msg, list);
+		for (j = i; j < joinlist_messages_entries; j++) {
+			stored_msg = &joinlist_messages[j];
 
-			if (stored_msg->sender_nodeid == api->totem_nodeid_get()) {
-				continue ;
+			if (stored_msg->sender_nodeid != pi->nodeid ||
+			    stored_msg->pid != pi->pid) {
+				break ;
 			}
 
-			if (pi->nodeid == stored_msg->sender_nodeid &&
-			    pi->pid == stored_msg->pid &&
-			    mar_name_compare (&pi->group, &stored_msg->group_name) == 0) {
+			if (mar_name_compare (&pi->group, &stored_msg->group_name) == 0) {
 				found = 1;
 				break ;
 			}
@@ -918,15 +1110,25 @@ static void joinlist_remove_zombie_pi_entries (void)
 static void joinlist_inform_clients (void)
 {
 	struct joinlist_msg *stored_msg;
+	struct process_info *pi;
+	struct qb_list_head *pos;
 	struct qb_list_head *iter;
-	unsigned int i;
+	size_t i;
+	int found;
 
-	i = 0;
-	qb_list_for_each(iter, &joinlist_messages_head) {
-		stored_msg = qb_list_entry(iter, struct joinlist_msg, list);
+	qsort (joinlist_messages, joinlist_messages_entries, sizeof (struct joinlist_msg),
+		joinlist_msg_compare);
 
-		log_printf (LOG_DEBUG, "joinlist_messages[%u] group:%s, ip:%s, pid:%d",
-			i++, cpg_print_group_name(&stored_msg->group_name),
+	/*
+	 * Both joinlist_messages and process_info_list are sorted by nodeid
+	 * and pid, so they are merged in one pass
+	 */
+	pos = &process_info_list_head;
+	for (i = 0; i < joinlist_messages_entries; i++) {
+		stored_msg = &joinlist_messages[i];
+
+		log_printf (LOG_DEBUG, "joinlist_messages[%zu] group:%s, ip:%s, pid:%d",
+			i, cpg_print_group_name(&stored_msg->group_name),
 			(char*)api->totem_ifaces_print(stored_msg->sender_nodeid),
 			stored_msg->pid);
 
@@ -935,29 +1137,92 @@ static void joinlist_inform_clients (void)
 			continue ;
 		}
 
-		do_proc_join (&stored_msg->group_name, stored_msg->pid, stored_msg->sender_nodeid,
-			CONFCHG_CPG_REASON_NODEUP);
+		/* Ignore duplicates */
+		if (i > 0 && joinlist_msg_compare (stored_msg, stored_msg - 1) == 0) {
+			continue ;
+		}
+
+		/*
+		 * Skip processes sorted before message
+		 */
+		while (pos->next != &process_info_list_head) {
+			pi = qb_list_entry (pos->next, struct process_info, list);
+
+			if (pi->nodeid > stored_msg->sender_nodeid ||
+			    (pi->nodeid == stored_msg->sender_nodeid && pi->pid >= stored_msg->pid)) {
+				break ;
+			}
+			pos = pos->next;
+		}
+
+		/*
+		 * Same process can be joined into more groups. If not found,
+		 * iter points to the last entry of such processes.
+		 */
+		found = 0;
+		iter = pos;
+		while (iter->next != &process_info_list_head) {
+			pi = qb_list_entry (iter->next, struct process_info, list);
+
+			if (pi->nodeid != stored_msg->sender_nodeid || pi->pid != stored_msg->pid) {
+				break ;
+			}
+
+			if (mar_name_compare (&pi->group, &stored_msg->group_name) == 0) {
+				found = 1;
+				break ;
+			}
+			iter = iter->next;
+		}
+
+		if (!found) {
+			do_proc_join_at (&stored_msg->group_name, stored_msg->pid,
+				stored_msg->sender_nodeid, CONFCHG_CPG_REASON_NODEUP, iter);
+		}
 	}
 
 	joinlist_remove_zombie_pi_entries ();
 }
 
-static void joinlist_messages_delete (void)
+static int joinlist_messages_add (
+	unsigned int nodeid,
+	uint32_t pid,
+	const mar_cpg_name_t *group_name)
 {
 	struct joinlist_msg *stored_msg;
-	struct qb_list_head *iter, *tmp_iter;
+	size_t new_allocated;
+
+	if (joinlist_messages_entries == joinlist_messages_allocated) {
+		new_allocated = (joinlist_messages_allocated ? joinlist_messages_allocated * 2 : 64);
 
-	qb_list_for_each_safe(iter, tmp_iter, &joinlist_messages_head) {
-		stored_msg = qb_list_entry(iter, struct joinlist_msg, list);
-		qb_list_del (&stored_msg->list);
-		free (stored_msg);
+		stored_msg = realloc (joinlist_messages, new_allocated * sizeof (struct joinlist_msg));
+		if (stored_msg == NULL) {
+			log_printf(LOGSYS_LEVEL_WARNING, "Unable to allocate joinlist entry");
+			return (-1);
+		}
+
+		joinlist_messages = stored_msg;
+		joinlist_messages_allocated = new_allocated;
 	}
-	qb_list_init (&joinlist_messages_head);
+
+	stored_msg = &joinlist_messages[joinlist_messages_entries++];
+	stored_msg->sender_nodeid = nodeid;
+	stored_msg->pid = pid;
+	memcpy(&stored_msg->group_name, group_name, sizeof(mar_cpg_name_t));
+
+	return (0);
+}
+
+static void joinlist_messages_delete (void)
+{
+	free (joinlist_messages);
+	joinlist_messages = NULL;
+	joinlist_messages_entries = 0;
+	joinlist_messages_allocated = 0;
 }
 
 static char *cpg_exec_init_fn (struct corosync_api_v1 *corosync_api)
 {
-	qb_list_init (&joinlist_messages_head);
 	api = corosync_api;
 	return (NULL);
 }
@@ -983,6 +1248,7 @@ static void cpg_pd_finalize (struct cpg_pd *cpd)
 	struct cpg_iteration_instance *cpii;
 
 	zcb_all_free(cpd);
+	zc_recv_free(cpd);
 	qb_list_for_each_safe(iter, tmp_iter, &(cpd->iteration_instance_list_head)) {
 		cpii = qb_list_entry (iter, struct cpg_iteration_instance, list);
 
@@ -1055,6 +1321,67 @@ static void exec_cpg_joinlist_endian_convert (void *msg_v)
 	}
 }
 
+/*
+ * Returns size of compact joinlist group including name and pids or 0
+ * if group doesn't fit into remaining bytes of message
+ */
+static size_t joinlist_compact_group_size (
+	const struct join_list_compact_group *jlg,
+	size_t remaining)
+{
+	size_t size;
+
+	if (remaining < sizeof (struct join_list_compact_group) ||
+	    jlg->name_length > CPG_MAX_NAME_LENGTH) {
+		return (0);
+	}
+
+	size = sizeof (struct join_list_compact_group) + JOIN_LIST_COMPACT_NAME_SIZE(jlg->name_length);
+	if (size > remaining ||
+	    jlg->pid_entries > (remaining - size) / sizeof (mar_uint32_t)) {
+		return (0);
+	}
+
+	return (size + jlg->pid_entries * sizeof (mar_uint32_t));
+}
+
+static void exec_cpg_joinlist_compact_endian_convert (void *msg_v)
+{
+	char *msg = msg_v;
+	struct qb_ipc_response_header *res = (struct qb_ipc_response_header *)msg;
+	char *pos = msg + sizeof(struct qb_ipc_response_header);
+	struct join_list_compact_group *jlg;
+	mar_uint32_t *pids;
+	size_t group_size;
+	uint32_t i;
+
+	swab_mar_int32_t (&res->size);
+
+	while (pos < msg + res->size) {
+		jlg = (struct join_list_compact_group *)pos;
+		if ((size_t)(msg + res->size - pos) < sizeof (struct join_list_compact_group)) {
+			break ;
+		}
+
+		jlg->pid_entries = swab32(jlg->pid_entries);
+		jlg->name_length = swab32(jlg->name_length);
+
+		group_size = joinlist_compact_group_size (jlg, msg + res->size - pos);
+		if (group_size == 0) {
+			break ;
+		}
+
+		pids = (mar_uint32_t *)(pos + sizeof (struct join_list_compact_group) +
+			JOIN_LIST_COMPACT_NAME_SIZE(jlg->name_length));
+
+		for (i = 0; i < jlg->pid_entries; i++) {
+			pids[i] = swab32(pids[i]);
+		}
+
+		pos += group_size;
+	}
+}
+
 static void exec_cpg_downlist_endian_convert_old (void *msg)
 {
 }
@@ -1062,14 +1389,27 @@ static void exec_cpg_downlist_endian_convert_old (void *msg)
 static void exec_cpg_downlist_endian_convert (void *msg)
 {
 	struct req_exec_cpg_downlist *req_exec_cpg_downlist = msg;
+	struct req_exec_cpg_downlist_trailer *trailer;
 	unsigned int i;
 
+	swab_coroipc_request_header_t (&req_exec_cpg_downlist->header);
 	req_exec_cpg_downlist->left_nodes = swab32(req_exec_cpg_downlist->left_nodes);
 	req_exec_cpg_downlist->old_members = swab32(req_exec_cpg_downlist->old_members);
 
-	for (i = 0; i < req_exec_cpg_downlist->left_nodes; i++) {
+	for (i = 0; i < req_exec_cpg_downlist->left_nodes && i < PROCESSOR_COUNT_MAX; i++) {
 		req_exec_cpg_downlist->nodeids[i] = swab32(req_exec_cpg_downlist->nodeids[i]);
 	}
+
+	if (req_exec_cpg_downlist->left_nodes <= PROCESSOR_COUNT_MAX &&
+	    req_exec_cpg_downlist->header.size ==
+	    offsetof (struct req_exec_cpg_downlist, nodeids) +
+	    req_exec_cpg_downlist->left_nodes * sizeof (mar_uint32_t) +
+	    sizeof (struct req_exec_cpg_downlist_trailer)) {
+		trailer = (struct req_exec_cpg_downlist_trailer *)
+			&req_exec_cpg_downlist->nodeids[req_exec_cpg_downlist->left_nodes];
+		trailer->magic = swab32(trailer->magic);
+		trailer->capabilities = swab32(trailer->capabilities);
+	}
 }
 
 
@@ -1112,21 +1452,20 @@ static struct process_info *process_info_find(const mar_cpg_name_t *group_name,
 	return NULL;
 }
 
-static void do_proc_join(
+/*
+ * Add new process after list_to_add entry of process_info_list and notify
+ * clients. Caller is responsible for keeping list sorted.
+ */
+static void do_proc_join_at(
 	const mar_cpg_name_t *name,
 	uint32_t pid,
 	unsigned int nodeid,
-	int reason)
+	int reason,
+	struct qb_list_head *list_to_add)
 {
 	struct process_info *pi;
-	struct process_info *pi_entry;
 	mar_cpg_address_t notify_info;
-	struct qb_list_head *list;
-	struct qb_list_head *list_to_add = NULL;
 
-	if (process_info_find (name, pid, nodeid) != NULL) {
-		return ;
- 	}
 	pi = malloc (sizeof (struct process_info));
 	if (!pi) {
 		log_printf(LOGSYS_LEVEL_WARNING, "Unable to allocate process_info struct");
@@ -1137,29 +1476,47 @@ static void do_proc_join(
 	memcpy(&pi->group, name, sizeof(*name));
 	qb_list_init(&pi->list);
 
+	qb_list_add (&pi->list, list_to_add);
+
+	notify_info.pid = pi->pid;
+	notify_info.nodeid = nodeid;
+	notify_info.reason = reason;
+
+	notify_lib_joinlist(&pi->group, NULL,
+			    1, &notify_info,
+			    0, NULL,
+			    MESSAGE_RES_CPG_CONFCHG_CALLBACK);
+}
+
+static void do_proc_join(
+	const mar_cpg_name_t *name,
+	uint32_t pid,
+	unsigned int nodeid,
+	int reason)
+{
+	struct process_info *pi_entry;
+	struct qb_list_head *list;
+	struct qb_list_head *list_to_add = NULL;
+
+	if (process_info_find (name, pid, nodeid) != NULL) {
+		return ;
+ 	}
+
 	/*
 	 * Insert new process in sorted order so synchronization works properly
 	 */
 	list_to_add = &process_info_list_head;
 	qb_list_for_each(list, &process_info_list_head) {
 		pi_entry = qb_list_entry(list, struct process_info, list);
-		if (pi_entry->nodeid > pi->nodeid ||
-			(pi_entry->nodeid == pi->nodeid && pi_entry->pid > pi->pid)) {
+		if (pi_entry->nodeid > nodeid ||
+			(pi_entry->nodeid == nodeid && pi_entry->pid > pid)) {
 
 			break;
 		}
 		list_to_add = list;
 	}
-	qb_list_add (&pi->list, list_to_add);
 
-	notify_info.pid = pi->pid;
-	notify_info.nodeid = nodeid;
-	notify_info.reason = reason;
-
-	notify_lib_joinlist(&pi->group, NULL,
-			    1, &notify_info,
-			    0, NULL,
-			    MESSAGE_RES_CPG_CONFCHG_CALLBACK);
+	do_proc_join_at (name, pid, nodeid, reason, list_to_add);
 }
 
 static void do_proc_leave(
@@ -1192,12 +1549,83 @@ static void do_proc_leave(
 	}
 }
 
+/*
+ * Remember that downlist from nodeid was received during current sync
+ */
+static void downlist_received_add (unsigned int nodeid, uint32_t capabilities)
+{
+	unsigned int i;
+	int member = 0;
+
+	for (i = 0; i < my_member_list_entries; i++) {
+		if (my_member_list[i] == nodeid) {
+			member = 1;
+			break;
+		}
+	}
+
+	if (!member) {
+		return ;
+	}
+
+	for (i = 0; i < downlist_received_entries; i++) {
+		if (downlist_received_list[i] == nodeid) {
+			return ;
+		}
+	}
+
+	downlist_received_list[downlist_received_entries++] = nodeid;
+
+	if (capabilities & CPG_CAPABILITY_JOINLIST_COMPACT) {
+		downlist_compact_capable_entries++;
+	}
+
+	if (my_sync_state == CPGSYNC_DOWNLIST_WAIT &&
+	    downlist_received_entries >= my_member_list_entries) {
+		api->sync_process_resume ();
+	}
+}
+
+/*
+ * Returns pointer to trailer of compact downlist or NULL if downlist
+ * was sent by node without trailer support
+ */
+static const struct req_exec_cpg_downlist_trailer *downlist_trailer_get (
+	const struct req_exec_cpg_downlist *req_exec_cpg_downlist)
+{
+	const struct req_exec_cpg_downlist_trailer *trailer;
+	size_t trailer_offset;
+
+	if (req_exec_cpg_downlist->left_nodes > PROCESSOR_COUNT_MAX) {
+		return (NULL);
+	}
+
+	trailer_offset = offsetof (struct req_exec_cpg_downlist, nodeids) +
+		req_exec_cpg_downlist->left_nodes * sizeof (mar_uint32_t);
+
+	if (req_exec_cpg_downlist->header.size !=
+	    trailer_offset + sizeof (struct req_exec_cpg_downlist_trailer)) {
+		return (NULL);
+	}
+
+	trailer = (const struct req_exec_cpg_downlist_trailer *)
+		((const char *)req_exec_cpg_downlist + trailer_offset);
+
+	if (trailer->magic != CPG_DOWNLIST_TRAILER_MAGIC) {
+		return (NULL);
+	}
+
+	return (trailer);
+}
+
 static void message_handler_req_exec_cpg_downlist_old (
 	const void *message,
 	unsigned int nodeid)
 {
 	log_printf (LOGSYS_LEVEL_WARNING, "downlist OLD from node 0x%x",
 		nodeid);
+
+	downlist_received_add (nodeid, 0);
 }
 
 static void message_handler_req_exec_cpg_downlist(
@@ -1205,9 +1633,14 @@ static void message_handler_req_exec_cpg_downlist(
 	unsigned int nodeid)
 {
 	const struct req_exec_cpg_downlist *req_exec_cpg_downlist = message;
+	const struct req_exec_cpg_downlist_trailer *trailer;
 
 	log_printf (LOGSYS_LEVEL_WARNING, "downlist left_list: %d received",
 			req_exec_cpg_downlist->left_nodes);
+
+	trailer = downlist_trailer_get (req_exec_cpg_downlist);
+
+	downlist_received_add (nodeid, (trailer != NULL ? trailer->capabilities : 0));
 }
 
 
@@ -1252,23 +1685,128 @@ static void message_handler_req_exec_cpg_joinlist (
 	const char *message = message_v;
 	const struct qb_ipc_response_header *res = (const struct qb_ipc_response_header *)message;
 	const struct join_list_entry *jle = (const struct join_list_entry *)(message + sizeof(struct qb_ipc_response_header));
-	struct joinlist_msg *stored_msg;
 
 	log_printf(LOGSYS_LEVEL_DEBUG, "got joinlist message from node 0x%x",
 		nodeid);
 
 	while ((const char*)jle < message + res->size) {
-		stored_msg = malloc (sizeof (struct joinlist_msg));
-		memset(stored_msg, 0, sizeof (struct joinlist_msg));
-		stored_msg->sender_nodeid = nodeid;
-		stored_msg->pid = jle->pid;
-		memcpy(&stored_msg->group_name, &jle->group_name, sizeof(mar_cpg_name_t));
-		qb_list_init (&stored_msg->list);
-		qb_list_add (&stored_msg->list, &joinlist_messages_head);
+		if (joinlist_messages_add (nodeid, jle->pid, &jle->group_name) != 0) {
+			return ;
+		}
 		jle++;
 	}
 }
 
+/* Got a compact proclist from another node */
+static void message_handler_req_exec_cpg_joinlist_compact (
+	const void *message_v,
+	unsigned int nodeid)
+{
+	const char *message = message_v;
+	const struct qb_ipc_response_header *res = (const struct qb_ipc_response_header *)message;
+	const char *pos = message + sizeof(struct qb_ipc_response_header);
+	const struct join_list_compact_group *jlg;
+	const mar_uint32_t *pids;
+	mar_cpg_name_t group_name;
+	size_t group_size;
+	uint32_t i;
+
+	log_printf(LOGSYS_LEVEL_DEBUG, "got compact joinlist message from node 0x%x",
+		nodeid);
+
+	while (pos < message + res->size) {
+		jlg = (const struct join_list_compact_group *)pos;
+
+		group_size = joinlist_compact_group_size (jlg, message + res->size - pos);
+		if (group_size == 0) {
+			log_printf(LOGSYS_LEVEL_WARNING, "Malformed compact joinlist from node 0x%x",
+				nodeid);
+			return ;
+		}
+
+		memset (&group_name, 0, sizeof (group_name));
+		group_name.length = jlg->name_length;
+		memcpy (group_name.value, pos + sizeof (struct join_list_compact_group), jlg->name_length);
+
+		pids = (const mar_uint32_t *)(pos + sizeof (struct join_list_compact_group) +
+			JOIN_LIST_COMPACT_NAME_SIZE(jlg->name_length));
+
+		for (i = 0; i < jlg->pid_entries; i++) {
+			if (joinlist_messages_add (nodeid, pids[i], &group_name) != 0) {
+				return ;
+			}
+		}
+
+		pos += group_size;
+	}
+}
+
+/*
+ * Store message into zero copy receive arena of cpd and send descriptor.
+ * Returns -1 if there is not enough free space in arena, so message
+ * has to be sent thru regular IPC, and -2 if tail written by client
+ * is invalid.
+ */
+static int zc_recv_deliver (
+	struct cpg_pd *cpd,
+	const struct res_lib_cpg_deliver_callback *res_lib_cpg_mcast,
+	const void *msg,
+	size_t msglen)
+{
+	struct coroipcs_zc_recv_header *zc_recv_header = cpd->zc_recv_addr;
+	struct res_lib_cpg_zc_deliver_callback res_lib_cpg_zc_deliver;
+	size_t data_size = cpd->zc_recv_size - CPG_ZC_RECV_HEADER_SIZE;
+	size_t entry_len;
+	uint64_t offset;
+	uint64_t skip;
+	uint64_t tail;
+
+	/*
+	 * Tail is written by client, so it's read only once and checked
+	 */
+	__sync_synchronize ();
+	tail = zc_recv_header->tail;
+	if (tail > cpd->zc_recv_head || cpd->zc_recv_head - tail > data_size) {
+		return (-2);
+	}
+
+	/*
+	 * Keep entries 8 bytes aligned and contiguous. If entry doesn't fit
+	 * into rest of the ring, rest is skipped and entry starts from beginning.
+	 */
+	entry_len = (msglen + 7) & ~((size_t)7);
+	offset = cpd->zc_recv_head % data_size;
+	skip = 0;
+	if (offset + entry_len > data_size) {
+		skip = data_size - offset;
+		offset = 0;
+	}
+
+	if (entry_len > data_size || entry_len + skip > data_size ||
+	    entry_len + skip > data_size - (cpd->zc_recv_head - tail)) {
+		return (-1);
+	}
+
+	memcpy ((char *)cpd->zc_recv_addr + CPG_ZC_RECV_HEADER_SIZE + offset, msg, msglen);
+	cpd->zc_recv_head += skip + entry_len;
+
+	res_lib_cpg_zc_deliver.header.id = MESSAGE_RES_CPG_ZC_DELIVER_CALLBACK;
+	res_lib_cpg_zc_deliver.header.size = sizeof(res_lib_cpg_zc_deliver);
+	res_lib_cpg_zc_deliver.header.error = CS_OK;
+	memcpy(&res_lib_cpg_zc_deliver.group_name, &res_lib_cpg_mcast->group_name,
+		sizeof(mar_cpg_name_t));
+	res_lib_cpg_zc_deliver.msglen = msglen;
+	res_lib_cpg_zc_deliver.nodeid = res_lib_cpg_mcast->nodeid;
+	res_lib_cpg_zc_deliver.pid = res_lib_cpg_mcast->pid;
+	res_lib_cpg_zc_deliver.offset = offset;
+	res_lib_cpg_zc_deliver.release = cpd->zc_recv_head;
+
+	api->ipc_dispatch_send (cpd->conn, &res_lib_cpg_zc_deliver,
+		sizeof(res_lib_cpg_zc_deliver));
+
+	return (0);
+}
+
 static void message_handler_req_exec_cpg_mcast (
 	const void *message,
 	unsigned int nodeid)
@@ -1318,7 +1856,25 @@ static void message_handler_req_exec_cpg_mcast (
 				return ;
 			}
 
-			api->ipc_dispatch_iov_send (cpd->conn, iovec, 2);
+			if (cpd->zc_recv_addr == NULL || msglen < CPG_ZC_RECV_MIN_MSGLEN) {
+				api->ipc_dispatch_iov_send (cpd->conn, iovec, 2);
+				continue;
+			}
+
+			switch (zc_recv_deliver (cpd, &res_lib_cpg_mcast, iovec[1].iov_base, msglen)) {
+			case 0:
+				break;
+			case -1:
+				api->ipc_dispatch_iov_send (cpd->conn, iovec, 2);
+				break;
+			default:
+				log_printf(LOGSYS_LEVEL_WARNING,
+					"Invalid zero copy receive arena state of client pid %u, disconnecting",
+					cpd->pid);
+				zc_recv_free (cpd);
+				api->ipc_disconnect (cpd->conn);
+				break;
+			}
 		}
 	}
 }
@@ -1385,17 +1941,122 @@ static void message_handler_req_exec_cpg_partial_mcast (
 
 static int cpg_exec_send_downlist(void)
 {
-	struct iovec iov;
+	struct iovec iov[2];
+	struct req_exec_cpg_downlist_trailer trailer;
+	size_t downlist_size;
+
+	/*
+	 * Only used part of nodeids is sent, followed by capabilities trailer
+	 */
+	downlist_size = offsetof (struct req_exec_cpg_downlist, nodeids) +
+		g_req_exec_cpg_downlist.left_nodes * sizeof (mar_uint32_t);
+
+	trailer.magic = CPG_DOWNLIST_TRAILER_MAGIC;
+	trailer.capabilities = CPG_CAPABILITY_JOINLIST_COMPACT;
 
 	g_req_exec_cpg_downlist.header.id = SERVICE_ID_MAKE(CPG_SERVICE, MESSAGE_REQ_EXEC_CPG_DOWNLIST);
-	g_req_exec_cpg_downlist.header.size = sizeof(struct req_exec_cpg_downlist);
+	g_req_exec_cpg_downlist.header.size = downlist_size + sizeof (trailer);
 
 	g_req_exec_cpg_downlist.old_members = my_old_member_list_entries;
 
-	iov.iov_base = (void *)&g_req_exec_cpg_downlist;
-	iov.iov_len = g_req_exec_cpg_downlist.header.size;
+	iov[0].iov_base = (void *)&g_req_exec_cpg_downlist;
+	iov[0].iov_len = downlist_size;
+	iov[1].iov_base = (void *)&trailer;
+	iov[1].iov_len = sizeof (trailer);
 
-	return (api->totem_mcast (&iov, 1, TOTEM_AGREED));
+	return (api->totem_mcast (iov, 2, TOTEM_AGREED));
+}
+
+static int joinlist_local_pi_compare (const void *a, const void *b)
+{
+	const struct process_info *pi_a = *(const struct process_info * const *)a;
+	const struct process_info *pi_b = *(const struct process_info * const *)b;
+	int res;
+
+	res = mar_name_compare (&pi_a->group, &pi_b->group);
+	if (res != 0) {
+		return (res);
+	}
+
+	if (pi_a->pid != pi_b->pid) {
+		return (pi_a->pid < pi_b->pid ? -1 : 1);
+	}
+
+	return (0);
+}
+
+/*
+ * Send local processes grouped by group name, so each name is sent only once
+ */
+static int cpg_exec_send_joinlist_compact(int count)
+{
+	struct qb_list_head *iter;
+	struct qb_ipc_response_header *res;
+	struct process_info **local_pi;
+	struct join_list_compact_group *jlg;
+	struct iovec req_exec_cpg_iovec;
+	mar_uint32_t *pids;
+	char *buf;
+	char *pos;
+	int i, j;
+	int ret;
+
+	local_pi = malloc (sizeof (struct process_info *) * count);
+	buf = malloc (sizeof(struct qb_ipc_response_header) + count *
+		(sizeof (struct join_list_compact_group) +
+		 JOIN_LIST_COMPACT_NAME_SIZE(CPG_MAX_NAME_LENGTH) + sizeof (mar_uint32_t)));
+	if (local_pi == NULL || buf == NULL) {
+		log_printf(LOGSYS_LEVEL_WARNING, "Unable to allocate joinlist buffer");
+		free (local_pi);
+		free (buf);
+		return -1;
+	}
+
+	i = 0;
+	qb_list_for_each(iter, &process_info_list_head) {
+		struct process_info *pi = qb_list_entry (iter, struct process_info, list);
+
+		if (pi->nodeid == api->totem_nodeid_get ()) {
+			local_pi[i++] = pi;
+		}
+	}
+
+	qsort (local_pi, count, sizeof (struct process_info *), joinlist_local_pi_compare);
+
+	res = (struct qb_ipc_response_header *)buf;
+	pos = buf + sizeof(struct qb_ipc_response_header);
+
+	for (i = 0; i < count; i = j) {
+		jlg = (struct join_list_compact_group *)pos;
+		jlg->name_length = local_pi[i]->group.length;
+		pos += sizeof (struct join_list_compact_group);
+
+		memset (pos, 0, JOIN_LIST_COMPACT_NAME_SIZE(jlg->name_length));
+		memcpy (pos, local_pi[i]->group.value, jlg->name_length);
+		pos += JOIN_LIST_COMPACT_NAME_SIZE(jlg->name_length);
+
+		pids = (mar_uint32_t *)pos;
+		for (j = i; j < count &&
+		    mar_name_compare (&local_pi[j]->group, &local_pi[i]->group) == 0; j++) {
+			*pids++ = local_pi[j]->pid;
+		}
+		jlg->pid_entries = j - i;
+		pos = (char *)pids;
+	}
+
+	res->id = SERVICE_ID_MAKE(CPG_SERVICE, MESSAGE_REQ_EXEC_CPG_JOINLIST_COMPACT);
+	res->size = pos - buf;
+	res->error = CS_OK;
+
+	req_exec_cpg_iovec.iov_base = buf;
+	req_exec_cpg_iovec.iov_len = res->size;
+
+	ret = api->totem_mcast (&req_exec_cpg_iovec, 1, TOTEM_AGREED);
+
+	free (local_pi);
+	free (buf);
+
+	return (ret);
 }
 
 static int cpg_exec_send_joinlist(void)
@@ -1419,6 +2080,10 @@ static int cpg_exec_send_joinlist(void)
 	if (!count)
 		return 0;
 
+	if (cpg_joinlist_compact_allowed ()) {
+		return (cpg_exec_send_joinlist_compact (count));
+	}
+
 	buf = alloca(sizeof(struct qb_ipc_response_header) + sizeof(struct join_list_entry) * count);
 	if (!buf) {
 		log_printf(LOGSYS_LEVEL_WARNING, "Unable to allocate joinlist buffer");
@@ -1788,6 +2453,60 @@ static void message_handler_req_lib_cpg_zc_free (
 		res_header.size);
 }
 
+static void zc_recv_free (
+	struct cpg_pd *cpd)
+{
+
+	if (cpd->zc_recv_addr != NULL) {
+		munmap (cpd->zc_recv_addr, cpd->zc_recv_size);
+		cpd->zc_recv_addr = NULL;
+	}
+}
+
+static void message_handler_req_lib_cpg_zc_recv_init (
+	void *conn,
+	const void *message)
+{
+	const struct req_lib_cpg_zc_recv_init *req_lib_cpg_zc_recv_init = message;
+	struct res_lib_cpg_zc_recv_init res_lib_cpg_zc_recv_init;
+	struct cpg_pd *cpd = (struct cpg_pd *)api->ipc_private_data_get (conn);
+	char path[CPG_ZC_PATH_LEN];
+	void *addr = NULL;
+	cs_error_t error = CS_OK;
+
+	memcpy (path, req_lib_cpg_zc_recv_init->path_to_file, CPG_ZC_PATH_LEN);
+	path[CPG_ZC_PATH_LEN - 1] = '\0';
+
+	log_printf(LOGSYS_LEVEL_DEBUG, "zero copy receive arena path: %s", path);
+
+	if (cpd->zc_recv_addr != NULL) {
+		error = CS_ERR_EXIST;
+		goto response_send;
+	}
+
+	if (req_lib_cpg_zc_recv_init->map_size <= CPG_ZC_RECV_HEADER_SIZE + CPG_ZC_RECV_MIN_MSGLEN) {
+		error = CS_ERR_INVALID_PARAM;
+		goto response_send;
+	}
+
+	if (memory_map (path, req_lib_cpg_zc_recv_init->map_size, &addr) == -1) {
+		error = CS_ERR_NO_RESOURCES;
+		goto response_send;
+	}
+
+	cpd->zc_recv_addr = addr;
+	cpd->zc_recv_size = req_lib_cpg_zc_recv_init->map_size;
+	cpd->zc_recv_head = 0;
+	((struct coroipcs_zc_recv_header *)addr)->tail = 0;
+
+response_send:
+	res_lib_cpg_zc_recv_init.header.size = sizeof (res_lib_cpg_zc_recv_init);
+	res_lib_cpg_zc_recv_init.header.id = MESSAGE_RES_CPG_ZC_RECV_INIT;
+	res_lib_cpg_zc_recv_init.header.error = error;
+	api->ipc_response_send (conn, &res_lib_cpg_zc_recv_init,
+		sizeof (res_lib_cpg_zc_recv_init));
+}
+
 /* Fragmented mcast message from the library */
 static void message_handler_req_lib_cpg_partial_mcast (void *conn, const void *message)
 {
@@ -2214,6 +2933,93 @@ error_exit:
 		sizeof (res_lib_cpg_iterationnext));
 }
 
+static void message_handler_req_lib_cpg_iteration_next_bulk (
+	void *conn,
+	const void *message)
+{
+	const struct req_lib_cpg_iterationnext_bulk *req_lib_cpg_iterationnext_bulk = message;
+	struct res_lib_cpg_iterationnext_bulk res_lib_cpg_iterationnext_bulk;
+	struct res_lib_cpg_iterationnext_bulk *res = &res_lib_cpg_iterationnext_bulk;
+	struct cpg_iteration_instance *cpg_iteration_instance;
+	struct qb_list_head *next;
+	cs_error_t error = CS_OK;
+	uint32_t max_entries;
+	uint32_t entries;
+	size_t res_size;
+	int res_get;
+	struct process_info *pi;
+
+	log_printf (LOGSYS_LEVEL_DEBUG, "cpg iteration next bulk");
+
+	res_size = sizeof (res_lib_cpg_iterationnext_bulk);
+	entries = 0;
+
+	res_get = hdb_handle_get (&cpg_iteration_handle_t_db,
+			req_lib_cpg_iterationnext_bulk->iteration_handle,
+			(void *)&cpg_iteration_instance);
+
+	if (res_get != 0) {
+		error = CS_ERR_LIBRARY;
+		goto error_exit;
+	}
+
+	max_entries = req_lib_cpg_iterationnext_bulk->max_entries;
+	if (max_entries > CPG_ITERATION_BULK_MAX_ENTRIES) {
+		max_entries = CPG_ITERATION_BULK_MAX_ENTRIES;
+	}
+
+	if (max_entries == 0) {
+		error = CS_ERR_INVALID_PARAM;
+		goto error_put;
+	}
+
+	if (cpg_iteration_instance->current_pointer->next == &cpg_iteration_instance->items_list_head) {
+		error = CS_ERR_NO_SECTIONS;
+		goto error_put;
+	}
+
+	res = malloc (sizeof (*res) + max_entries * sizeof (mar_cpg_iteration_description_t));
+	if (res == NULL) {
+		res = &res_lib_cpg_iterationnext_bulk;
+		error = CS_ERR_NO_MEMORY;
+		goto error_put;
+	}
+
+	/*
+	 * Copy as many entries as fits into response
+	 */
+	for (next = cpg_iteration_instance->current_pointer->next;
+	    next != &cpg_iteration_instance->items_list_head && entries < max_entries;
+	    next = next->next) {
+		pi = qb_list_entry (next, struct process_info, list);
+
+		res->description[entries].nodeid = pi->nodeid;
+		res->description[entries].pid = pi->pid;
+		memcpy (&res->description[entries].group,
+			&pi->group,
+			sizeof (mar_cpg_name_t));
+
+		cpg_iteration_instance->current_pointer = next;
+		entries++;
+	}
+
+	res_size = sizeof (*res) + entries * sizeof (mar_cpg_iteration_description_t);
+
+error_put:
+	hdb_handle_put (&cpg_iteration_handle_t_db, req_lib_cpg_iterationnext_bulk->iteration_handle);
+error_exit:
+	res->header.size = res_size;
+	res->header.id = MESSAGE_RES_CPG_ITERATIONNEXT_BULK;
+	res->header.error = error;
+	res->entries = entries;
+
+	api->ipc_response_send (conn, res, res_size);
+
+	if (res != &res_lib_cpg_iterationnext_bulk) {
+		free (res);
+	}
+}
+
 static void message_handler_req_lib_cpg_iteration_finalize (
 	void *conn,
 	const void *message)
@@ -45,6 +45,21 @@
 
 #define ICMAP_MAX_VALUE_LEN	(16*1024)
 
+/*
+ * Values up to this length are changed in place when type and length
+ * stays the same. Old value is kept on stack for trackers.
+ */
+#define ICMAP_INPLACE_MAX_LEN	64
+
+/*
+ * Small items (all integer types and short strings) are allocated from
+ * slabs of ICMAP_SLAB_CHUNKS chunks with fixed size. Every map has its own
+ * slabs, so maps used by different threads don't share free list. Freed
+ * chunks are kept in free list and slabs are released only by icmap_fini_r.
+ */
+#define ICMAP_SLAB_CHUNK_SIZE	64
+#define ICMAP_SLAB_CHUNKS	256
+
 struct icmap_item {
 	char *key_name;
 	icmap_value_types_t type;
@@ -52,8 +67,28 @@ struct icmap_item {
 	char value[];
 };
 
+union icmap_slab_chunk {
+	union icmap_slab_chunk *next;
+	char data[ICMAP_SLAB_CHUNK_SIZE];
+};
+
+struct icmap_slab {
+	struct icmap_slab *next;
+	union icmap_slab_chunk chunks[ICMAP_SLAB_CHUNKS];
+};
+
+/*
+ * Item which is being changed in place by current thread and copy of its
+ * old value. Tracker may call icmap_set_r again, so icmap_set_r saves and
+ * restores previous values around notification.
+ */
+static __thread struct icmap_item *icmap_inplace_item = NULL;
+static __thread struct icmap_item *icmap_inplace_old_item = NULL;
+
 struct icmap_map {
 	qb_map_t *qb_map;
+	struct icmap_slab *slab_list;
+	union icmap_slab_chunk *slab_free_list;
 };
 
 static icmap_map_t icmap_global_map;
@@ -170,18 +205,77 @@ int32_t icmap_qbtt_to_tt(int32_t track_type)
 	return (res);
 }
 
+static struct icmap_item *icmap_item_alloc(const icmap_map_t map, size_t value_len)
+{
+	struct icmap_slab *slab;
+	union icmap_slab_chunk *chunk;
+	int i;
+
+	if (sizeof(struct icmap_item) + value_len > ICMAP_SLAB_CHUNK_SIZE) {
+		return (malloc(sizeof(struct icmap_item) + value_len));
+	}
+
+	if (map->slab_free_list == NULL) {
+		slab = malloc(sizeof(*slab));
+		if (slab == NULL) {
+			return (NULL);
+		}
+
+		for (i = 0; i < ICMAP_SLAB_CHUNKS - 1; i++) {
+			slab->chunks[i].next = &slab->chunks[i + 1];
+		}
+		slab->chunks[ICMAP_SLAB_CHUNKS - 1].next = NULL;
+		map->slab_free_list = &slab->chunks[0];
+
+		slab->next = map->slab_list;
+		map->slab_list = slab;
+	}
+
+	chunk = map->slab_free_list;
+	map->slab_free_list = chunk->next;
+
+	return ((struct icmap_item *)chunk);
+}
+
+static void icmap_item_free(const icmap_map_t map, struct icmap_item *item)
+{
+	union icmap_slab_chunk *chunk;
+
+	if (sizeof(struct icmap_item) + item->value_len > ICMAP_SLAB_CHUNK_SIZE) {
+		free(item);
+		return ;
+	}
+
+	chunk = (union icmap_slab_chunk *)item;
+	chunk->next = map->slab_free_list;
+	map->slab_free_list = chunk;
+}
+
+static void icmap_slab_free_all(const icmap_map_t map)
+{
+	struct icmap_slab *slab;
+
+	while (map->slab_list != NULL) {
+		slab = map->slab_list;
+		map->slab_list = slab->next;
+		free(slab);
+	}
+	map->slab_free_list = NULL;
+}
+
 static void icmap_map_free_cb(uint32_t event,
 		char* key, void* old_value,
 		void* value, void* user_data)
 {
 	struct icmap_item *item = (struct icmap_item *)old_value;
+	icmap_map_t map = (icmap_map_t)user_data;
 
 	/*
-	 * value == old_value -> fast_adjust_int was used, don't free data
+	 * value == old_value -> value was changed in place, don't free data
 	 */
 	if (item != NULL && value != old_value) {
 		free(item->key_name);
-		free(item);
+		icmap_item_free(map, item);
 	}
 }
 
@@ -193,12 +287,13 @@ cs_error_t icmap_init_r(icmap_map_t *result)
 	if (*result == NULL) {
 		return (CS_ERR_NO_MEMORY);
 	}
+	memset(*result, 0, sizeof(struct icmap_map));
 
         (*result)->qb_map = qb_trie_create();
 	if ((*result)->qb_map == NULL)
 		return (CS_ERR_INIT);
 
-	err = qb_map_notify_add((*result)->qb_map, NULL, icmap_map_free_cb, QB_MAP_NOTIFY_FREE, NULL);
+	err = qb_map_notify_add((*result)->qb_map, NULL, icmap_map_free_cb, QB_MAP_NOTIFY_FREE, *result);
 
 	return (qb_to_cs_error(err));
 }
@@ -237,6 +332,7 @@ void icmap_fini_r(const icmap_map_t map)
 {
 
 	qb_map_destroy(map->qb_map);
+	icmap_slab_free_all(map);
 	free(map);
 
 	return;
@@ -413,6 +509,9 @@ cs_error_t icmap_set_r(
 	struct icmap_item *new_item;
 	size_t new_value_len;
 	size_t new_item_size;
+	uint64_t old_item_buf[(sizeof(struct icmap_item) + ICMAP_INPLACE_MAX_LEN + 7) / 8];
+	struct icmap_item *saved_inplace_item;
+	struct icmap_item *saved_inplace_old_item;
 
 	if (value == NULL || key_name == NULL) {
 		return (CS_ERR_INVALID_PARAM);
@@ -450,8 +549,38 @@ cs_error_t icmap_set_r(
 		new_value_len = icmap_get_valuetype_len(type);
 	}
 
+	if (item != NULL && item->type == type && item->value_len == new_value_len &&
+	    new_value_len <= ICMAP_INPLACE_MAX_LEN) {
+		/*
+		 * Same type and size -> change value in place. Map only needs to
+		 * be told about change when somebody tracks it.
+		 */
+		if (map == icmap_global_map && !qb_list_empty(&icmap_track_list_head)) {
+			memcpy(old_item_buf, item, sizeof(struct icmap_item) + item->value_len);
+		}
+
+		memcpy(item->value, value, new_value_len);
+		if (type == ICMAP_VALUETYPE_STRING) {
+			((char *)item->value)[new_value_len - 1] = 0;
+		}
+
+		if (map == icmap_global_map && !qb_list_empty(&icmap_track_list_head)) {
+			saved_inplace_item = icmap_inplace_item;
+			saved_inplace_old_item = icmap_inplace_old_item;
+
+			icmap_inplace_item = item;
+			icmap_inplace_old_item = (struct icmap_item *)old_item_buf;
+			qb_map_put(map->qb_map, item->key_name, item);
+
+			icmap_inplace_item = saved_inplace_item;
+			icmap_inplace_old_item = saved_inplace_old_item;
+		}
+
+		return (CS_OK);
+	}
+
 	new_item_size = sizeof(struct icmap_item) + new_value_len;
-	new_item = malloc(new_item_size);
+	new_item = icmap_item_alloc(map, new_value_len);
 	if (new_item == NULL) {
 		return (CS_ERR_NO_MEMORY);
 	}
@@ -460,7 +589,8 @@ cs_error_t icmap_set_r(
 	if (item == NULL) {
 		new_item->key_name = strdup(key_name);
 		if (new_item->key_name == NULL) {
-			free(new_item);
+			new_item->value_len = new_value_len;
+			icmap_item_free(map, new_item);
 			return (CS_ERR_NO_MEMORY);
 		}
 	} else {
@@ -1122,6 +1252,13 @@ static void icmap_notify_fn(uint32_t event, char *key, void *old_value, void *va
 		return ;
 	}
 
+	/*
+	 * Value changed in place by icmap_set_r -> use saved old value
+	 */
+	if (old_item != NULL && old_item == new_item && old_item == icmap_inplace_item) {
+		old_item = icmap_inplace_old_item;
+	}
+
 	if (new_item != NULL) {
 		new_val.type = new_item->type;
 		new_val.len = new_item->value_len;
@@ -37,12 +37,19 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <assert.h>
 #include <sys/uio.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <semaphore.h>
 
 #include <qb/qbdefs.h>
 #include <qb/qblist.h>
+#include <qb/qbatomic.h>
 #include <qb/qbutil.h>
 #include <qb/qbloop.h>
 #include <qb/qbipcs.h>
@@ -80,12 +87,157 @@ struct cs_ipcs_mapper {
 	char name[CS_IPCS_MAPPER_SERV_NAME];
 };
 
-struct outq_item {
-	void *msg;
-	size_t mlen;
+/*
+ * Events which can't be delivered immediately are stored in per connection
+ * byte ring. Every entry is uint32_t length followed by the event itself,
+ * both may wrap around the end of the ring. Ring starts small, grows on
+ * demand up to outq_max_size and is shrunk again once it is drained.
+ */
+#define OUTQ_INITIAL_SIZE		(64 * 1024)
+#define OUTQ_DEFAULT_MAX_SIZE		(64 * 1024 * 1024)
+
+static size_t outq_max_size = OUTQ_DEFAULT_MAX_SIZE;
+
+/*
+ * Flow control credits. When totem queue is not nearly empty, every
+ * connection may send ipc_fc_credits * fc_priority flow controlled requests
+ * per token rotation, so one greedy client can't starve the others.
+ * Credits are refilled lazily, when connection sees new ipc_fc_generation.
+ *
+ * libqb can't stop reading of single connection, so when a connection runs
+ * out of credits, reading of requests of whole service is stopped until the
+ * token is sent. Requests which were already read are always processed.
+ */
+#define IPC_FC_DEFAULT_CREDITS		64
+
+static uint32_t ipc_fc_credits = IPC_FC_DEFAULT_CREDITS;
+static uint32_t ipc_fc_generation;
+static int32_t ipc_fc_credits_exhausted[SERVICES_COUNT_MAX]; /* boolean */
+static int32_t ipc_fc_token_callback_pending; /* boolean */
+static void *ipc_fc_token_callback_handle;
+
+/*
+ * Optional IPC thread (qb.ipc_thread). libqb IPC services then run on own
+ * loop in separate thread, which accepts connections, reads and checks
+ * requests and passes them to the main thread through lock-free single
+ * producer / single consumer ring. Main thread processes at most
+ * IPC_THREAD_DISPATCH_BUDGET of them per loop iteration with low priority,
+ * so busy clients can't delay the token.
+ *
+ * Everything touching service state (connection callbacks, lib handlers)
+ * still happens in the main thread. Connection callbacks are passed as
+ * synchronous calls, IPC thread waits for the result.
+ *
+ * Requests are copied into preallocated ring slots (bigger ones are
+ * allocated). When the ring gets IPC_THREAD_RING_HIGH full, IPC thread stops
+ * reading of requests by rate limit, until main thread drains the ring to
+ * IPC_THREAD_RING_LOW. Only if the ring gets full anyway (requests already
+ * being dispatched, connection calls), IPC thread waits on condition
+ * variable for main thread.
+ *
+ * libqb connections are used only by the IPC thread (or by the main thread
+ * while the IPC thread waits for result of synchronous call). Responses,
+ * events, disconnects and releases of references are copied to the command
+ * list and sent/executed by the IPC thread, including queuing of events
+ * (outq_flush runs on IPC loop). Main thread doesn't take libqb references,
+ * it counts its own references in context->main_refs and IPC thread holds
+ * one libqb reference for all of them, released when main_refs drops to 0.
+ * Requests of connection are always in the ring before the call of its
+ * destroyed callback, so they need no reference.
+ */
+#define IPC_THREAD_RING_SIZE		1024
+#define IPC_THREAD_RING_HIGH		(IPC_THREAD_RING_SIZE * 3 / 4)
+#define IPC_THREAD_RING_LOW		(IPC_THREAD_RING_SIZE / 4)
+#define IPC_THREAD_SLOT_DATA_SIZE	1024
+#define IPC_THREAD_DISPATCH_BUDGET	64
+
+#define IPC_THREAD_RING_OPEN		0
+#define IPC_THREAD_RING_THROTTLED	1
+#define IPC_THREAD_RING_RESUMING	2
+
+enum cs_ipcs_thread_msg_type {
+	CS_IPCS_THREAD_MSG_REQUEST,
+	CS_IPCS_THREAD_MSG_CALL,
+	CS_IPCS_THREAD_MSG_DISCONNECT,
+	CS_IPCS_THREAD_MSG_UNREF,
+	CS_IPCS_THREAD_MSG_RESPONSE,
+	CS_IPCS_THREAD_MSG_EVENT,
+	CS_IPCS_THREAD_MSG_CLEAR_STATS,
+	CS_IPCS_THREAD_MSG_RATE_LIMIT,
+	CS_IPCS_THREAD_MSG_RING_RESUME,
+	CS_IPCS_THREAD_MSG_STOP,
+};
+
+enum cs_ipcs_thread_call_type {
+	CS_IPCS_THREAD_CALL_ACCEPT,
+	CS_IPCS_THREAD_CALL_CREATED,
+	CS_IPCS_THREAD_CALL_CLOSED,
+	CS_IPCS_THREAD_CALL_DESTROYED,
+};
+
+struct cs_ipcs_thread_call {
+	enum cs_ipcs_thread_call_type type;
+	uid_t euid;
+	gid_t egid;
+	int32_t res;
+	sem_t done;
+};
+
+struct cs_ipcs_thread_msg {
 	struct qb_list_head list;
+	enum cs_ipcs_thread_msg_type type;
+	qb_ipcs_connection_t *conn;
+	struct cs_ipcs_thread_call *call;
+	int32_t valid;
+	int32_t allocated; /* boolean, request didn't fit into ring slot */
+	size_t size;
+	char data[0];
 };
 
+static int32_t ipc_thread_enabled = 0; /* boolean */
+static int32_t ipc_thread_running = 0; /* boolean */
+static int32_t ipc_thread_exited = 0; /* boolean, set by IPC thread */
+static pthread_t ipc_thread;
+static qb_loop_t *ipc_thread_loop = NULL;
+static int32_t ipc_thread_call_in_progress = 0; /* boolean, main thread only */
+
+/*
+ * IPC thread -> main thread. Head is written only by main thread,
+ * tail only by IPC thread. Head is moved after message is processed,
+ * so slot of the tail is always free.
+ */
+static struct cs_ipcs_thread_msg *ipc_thread_ring[IPC_THREAD_RING_SIZE];
+static struct cs_ipcs_thread_msg *ipc_thread_ring_slot[IPC_THREAD_RING_SIZE];
+static int32_t ipc_thread_ring_head = 0;
+static int32_t ipc_thread_ring_tail = 0;
+static int32_t ipc_thread_ring_wakeup = 0; /* boolean, byte is in pipe */
+static int ipc_thread_ring_pipe[2];
+static int32_t ipc_thread_ring_throttled = IPC_THREAD_RING_OPEN;
+static struct cs_ipcs_thread_msg ipc_thread_resume_msg;
+static pthread_mutex_t ipc_thread_ring_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ipc_thread_ring_cond = PTHREAD_COND_INITIALIZER;
+static int32_t ipc_thread_ring_waiting = 0; /* boolean, IPC thread waits for space */
+
+/*
+ * Main thread -> IPC thread. Commands for libqb connections (responses,
+ * events, disconnects, releasing of references). Order of commands is kept.
+ */
+static pthread_mutex_t ipc_thread_cmd_mutex = PTHREAD_MUTEX_INITIALIZER;
+static QB_LIST_DECLARE (ipc_thread_cmd_list);
+static int ipc_thread_cmd_pipe[2];
+static struct cs_ipcs_thread_msg ipc_thread_stop_msg;
+
+/*
+ * Request rate limit of services, used only by the thread owning IPC loop
+ */
+static int32_t ipc_fc_rate[SERVICES_COUNT_MAX];
+
+/*
+ * Connections with context, maintained by main thread. Used for stats
+ * instead of libqb connection list, which belongs to the IPC thread.
+ */
+static QB_LIST_DECLARE (ipc_conn_list);
+
 static struct cs_ipcs_mapper ipcs_mapper[SERVICES_COUNT_MAX];
 
 static int32_t cs_ipcs_job_add(enum qb_loop_priority p,	void *data, qb_loop_job_dispatch_fn fn);
@@ -95,6 +247,17 @@ static int32_t cs_ipcs_dispatch_mod(enum qb_loop_priority p, int32_t fd, int32_t
 	void *data, qb_ipcs_dispatch_fn_t fn);
 static int32_t cs_ipcs_dispatch_del(int32_t fd);
 static void outq_flush (void *data);
+static void cs_ipcs_disconnect (qb_ipcs_connection_t *c);
+static void cs_ipcs_thread_unref (qb_ipcs_connection_t *c);
+static int32_t cs_ipcs_thread_post_needed (void);
+static int cs_ipcs_thread_iov_post (enum cs_ipcs_thread_msg_type type, qb_ipcs_connection_t *c,
+	const struct iovec *iov, unsigned int iov_len);
+static qb_loop_t *cs_ipcs_loop_get(void);
+static void cs_ipcs_thread_clear_stats(void);
+static void cs_ipcs_thread_stop(void);
+static void cs_ipcs_check_for_flow_control(void);
+static void cs_ipcs_rate_limit_apply(const int32_t *rates);
+static void cs_ipcs_rate_limit_set(const int32_t *rates);
 
 
 static struct qb_ipcs_poll_handlers corosync_poll_funcs = {
@@ -119,6 +282,21 @@ static struct qb_ipcs_service_handlers corosync_service_funcs = {
 	.connection_destroyed	= cs_ipcs_connection_destroyed,
 };
 
+static int32_t cs_ipcs_thread_connection_accept (qb_ipcs_connection_t *c, uid_t euid, gid_t egid);
+static void cs_ipcs_thread_connection_created(qb_ipcs_connection_t *c);
+static int32_t cs_ipcs_thread_msg_process(qb_ipcs_connection_t *c,
+		void *data, size_t size);
+static int32_t cs_ipcs_thread_connection_closed (qb_ipcs_connection_t *c);
+static void cs_ipcs_thread_connection_destroyed (qb_ipcs_connection_t *c);
+
+static struct qb_ipcs_service_handlers corosync_thread_service_funcs = {
+	.connection_accept	= cs_ipcs_thread_connection_accept,
+	.connection_created	= cs_ipcs_thread_connection_created,
+	.msg_process		= cs_ipcs_thread_msg_process,
+	.connection_closed	= cs_ipcs_thread_connection_closed,
+	.connection_destroyed	= cs_ipcs_thread_connection_destroyed,
+};
+
 static struct ipcs_global_stats global_stats;
 
 static const char* cs_ipcs_serv_short_name(int32_t service_id)
@@ -163,6 +341,8 @@ void cs_ipc_allow_connections(int32_t allow)
 
 int32_t cs_ipcs_service_destroy(int32_t service_id)
 {
+	cs_ipcs_thread_stop();
+
 	if (ipcs_mapper[service_id].inst) {
 		qb_ipcs_destroy(ipcs_mapper[service_id].inst);
 		ipcs_mapper[service_id].inst = NULL;
@@ -259,6 +439,25 @@ static char * pid_to_name (pid_t pid, char *out_name, size_t name_len)
 	return out_name;
 }
 
+/*
+ * Priority (weight of flow control credits) can be configured per
+ * process name in qb.ipc_fc_priority.NAME
+ */
+static void cs_ipcs_fc_priority_set(struct cs_ipcs_conn_context *context)
+{
+	char key_name[ICMAP_KEYNAME_MAXLEN];
+	uint32_t priority;
+
+	if (context->proc_name[0] == '\0') {
+		return;
+	}
+
+	snprintf(key_name, ICMAP_KEYNAME_MAXLEN, "qb.ipc_fc_priority.%s", context->proc_name);
+	if (icmap_get_uint32(key_name, &priority) == CS_OK && priority > 0) {
+		context->fc_priority = priority;
+	}
+}
+
 static void cs_ipcs_connection_created(qb_ipcs_connection_t *c)
 {
 	int32_t service = 0;
@@ -273,20 +472,31 @@ static void cs_ipcs_connection_created(qb_ipcs_connection_t *c)
 	size += corosync_service[service]->private_data_size;
 	context = calloc(1, size);
 	if (context == NULL) {
-		qb_ipcs_disconnect(c);
+		cs_ipcs_disconnect(c);
 		return;
 	}
 
-	qb_list_init(&context->outq_head);
+	context->conn = c;
+	context->outq_buf = NULL;
+	context->outq_size = 0;
+	context->outq_head = 0;
 	context->queuing = QB_FALSE;
 	context->queued = 0;
 	context->sent = 0;
+	context->fc_priority = 1;
+	/* Different generation makes first request fill the credits */
+	context->fc_generation = ipc_fc_generation - 1;
+	/*
+	 * Called for IPC thread, which holds libqb reference for main thread
+	 */
+	context->main_refs = (ipc_thread_call_in_progress ? 1 : 0);
 
 	qb_ipcs_context_set(c, context);
+	qb_list_add_tail(&context->list, &ipc_conn_list);
 
 	if (corosync_service[service]->lib_init_fn(c) != 0) {
 		log_printf(LOG_ERR, "lib_init_fn failed, disconnecting");
-		qb_ipcs_disconnect(c);
+		cs_ipcs_disconnect(c);
 		return;
 	}
 
@@ -295,20 +505,54 @@ static void cs_ipcs_connection_created(qb_ipcs_connection_t *c)
 	if (!pid_to_name (stats.client_pid, context->proc_name, sizeof(context->proc_name))) {
 		context->proc_name[0] = '\0';
 	}
+	cs_ipcs_fc_priority_set(context);
 	stats_ipcs_add_connection(service, stats.client_pid, c);
 	global_stats.active++;
 }
 
+/*
+ * Release one of the main thread references of connection created by IPC
+ * thread. Last one releases libqb reference held by IPC thread.
+ */
+static void cs_ipcs_main_ref_release(struct cs_ipcs_conn_context *context)
+{
+	assert(context->main_refs > 0);
+
+	context->main_refs--;
+	if (context->main_refs == 0) {
+		cs_ipcs_thread_unref(context->conn);
+	}
+}
+
 void cs_ipc_refcnt_inc(void *conn)
 {
+	struct cs_ipcs_conn_context *context = qb_ipcs_context_get(conn);
+
+	if (context != NULL && context->main_refs > 0) {
+		context->main_refs++;
+		return ;
+	}
+
 	qb_ipcs_connection_ref(conn);
 }
 
 void cs_ipc_refcnt_dec(void *conn)
 {
+	struct cs_ipcs_conn_context *context = qb_ipcs_context_get(conn);
+
+	if (context != NULL && context->main_refs > 0) {
+		cs_ipcs_main_ref_release(context);
+		return ;
+	}
+
 	qb_ipcs_connection_unref(conn);
 }
 
+void cs_ipc_disconnect(void *conn)
+{
+	cs_ipcs_disconnect(conn);
+}
+
 void *cs_ipcs_private_data_get(void *conn)
 {
 	struct cs_ipcs_conn_context *cnx;
@@ -319,20 +563,14 @@ void *cs_ipcs_private_data_get(void *conn)
 static void cs_ipcs_connection_destroyed (qb_ipcs_connection_t *c)
 {
 	struct cs_ipcs_conn_context *context;
-	struct qb_list_head *list, *tmp_iter;
-	struct outq_item *outq_item;
 
 	log_printf(LOG_DEBUG, "%s() ", __func__);
 
 	context = qb_ipcs_context_get(c);
 	if (context) {
-		qb_list_for_each_safe(list, tmp_iter, &(context->outq_head)) {
-			outq_item = qb_list_entry (list, struct outq_item, list);
-
-			qb_list_del (list);
-			free (outq_item->msg);
-			free (outq_item);
-		}
+		qb_list_del(&context->list);
+		global_stats.queued_bytes -= context->queued_bytes;
+		free(context->outq_buf);
 		free(context);
 	}
 }
@@ -342,6 +580,7 @@ static int32_t cs_ipcs_connection_closed (qb_ipcs_connection_t *c)
 	int32_t res = 0;
 	int32_t service = qb_ipcs_service_id_get(c);
 	struct qb_ipcs_connection_stats stats;
+	struct cs_ipcs_conn_context *context;
 
 	log_printf(LOG_DEBUG, "%s() ", __func__);
 	res = corosync_service[service]->lib_exit_fn(c);
@@ -349,7 +588,7 @@ static int32_t cs_ipcs_connection_closed (qb_ipcs_connection_t *c)
 		return res;
 	}
 
-	qb_loop_job_del(cs_poll_handle_get(), QB_LOOP_HIGH, c, outq_flush);
+	qb_loop_job_del(cs_ipcs_loop_get(), QB_LOOP_HIGH, c, outq_flush);
 
 	qb_ipcs_connection_stats_get(c, &stats, QB_FALSE);
 
@@ -357,6 +596,12 @@ static int32_t cs_ipcs_connection_closed (qb_ipcs_connection_t *c)
 
 	global_stats.active--;
 	global_stats.closed++;
+
+	context = qb_ipcs_context_get(c);
+	if (context != NULL && context->main_refs > 0) {
+		cs_ipcs_main_ref_release(context);
+	}
+
 	return 0;
 }
 
@@ -364,7 +609,13 @@ int cs_ipcs_response_iov_send (void *conn,
 	const struct iovec *iov,
 	unsigned int iov_len)
 {
-	int32_t rc = qb_ipcs_response_sendv(conn, iov, iov_len);
+	int32_t rc;
+
+	if (cs_ipcs_thread_post_needed()) {
+		return (cs_ipcs_thread_iov_post(CS_IPCS_THREAD_MSG_RESPONSE, conn, iov, iov_len));
+	}
+
+	rc = qb_ipcs_response_sendv(conn, iov, iov_len);
 	if (rc >= 0) {
 		return 0;
 	}
@@ -373,48 +624,163 @@ int cs_ipcs_response_iov_send (void *conn,
 
 int cs_ipcs_response_send(void *conn, const void *msg, size_t mlen)
 {
-	int32_t rc = qb_ipcs_response_send(conn, msg, mlen);
-	if (rc >= 0) {
-		return 0;
+	struct iovec iov;
+
+	iov.iov_base = (void *)msg;
+	iov.iov_len = mlen;
+
+	return (cs_ipcs_response_iov_send(conn, &iov, 1));
+}
+
+static void outq_copy_in (struct cs_ipcs_conn_context *context,
+	size_t pos, const void *data, size_t len)
+{
+	size_t first;
+
+	pos %= context->outq_size;
+	first = context->outq_size - pos;
+	if (first > len) {
+		first = len;
 	}
-	return rc;
+
+	memcpy (context->outq_buf + pos, data, first);
+	memcpy (context->outq_buf, (const char *)data + first, len - first);
+}
+
+static void outq_copy_out (struct cs_ipcs_conn_context *context,
+	size_t pos, void *data, size_t len)
+{
+	size_t first;
+
+	pos %= context->outq_size;
+	first = context->outq_size - pos;
+	if (first > len) {
+		first = len;
+	}
+
+	memcpy (data, context->outq_buf + pos, first);
+	memcpy ((char *)data + first, context->outq_buf, len - first);
+}
+
+/*
+ * Make sure there is space for bytes more in the ring. Returns -1 if
+ * connection would exceed outq_max_size or memory can't be allocated.
+ */
+static int outq_reserve (struct cs_ipcs_conn_context *context, size_t bytes)
+{
+	size_t needed = context->queued_bytes + bytes;
+	size_t new_size;
+	char *new_buf;
+
+	if (needed <= context->outq_size) {
+		return (0);
+	}
+
+	if (outq_max_size != 0 && needed > outq_max_size) {
+		return (-1);
+	}
+
+	new_size = (context->outq_size != 0 ? context->outq_size : OUTQ_INITIAL_SIZE);
+	while (new_size < needed) {
+		new_size *= 2;
+	}
+	if (outq_max_size != 0 && new_size > outq_max_size) {
+		new_size = outq_max_size;
+	}
+
+	new_buf = malloc (new_size);
+	if (new_buf == NULL) {
+		return (-1);
+	}
+
+	/*
+	 * Queued entries are moved to the beginning of new ring
+	 */
+	if (context->queued_bytes != 0) {
+		outq_copy_out (context, context->outq_head, new_buf, context->queued_bytes);
+	}
+
+	free (context->outq_buf);
+	context->outq_buf = new_buf;
+	context->outq_size = new_size;
+	context->outq_head = 0;
+
+	return (0);
 }
 
 static void outq_flush (void *data)
 {
 	qb_ipcs_connection_t *conn = data;
-	struct qb_list_head *list, *tmp_iter;
-	struct outq_item *outq_item;
 	int32_t rc;
 	struct cs_ipcs_conn_context *context = qb_ipcs_context_get(conn);
+	struct iovec iov[2];
+	uint32_t iov_len;
+	uint32_t mlen;
+	uint32_t batch = 0;
+	size_t pos;
 
-	qb_list_for_each_safe(list, tmp_iter, &(context->outq_head)) {
-		outq_item = qb_list_entry (list, struct outq_item, list);
+	/*
+	 * Send as many queued events as client accepts. Events are passed
+	 * to libqb directly from the ring, wrapped one as two iovecs.
+	 */
+	while (context->queued_bytes != 0) {
+		outq_copy_out (context, context->outq_head, &mlen, sizeof (mlen));
+
+		pos = (context->outq_head + sizeof (mlen)) % context->outq_size;
+		iov[0].iov_base = context->outq_buf + pos;
+		if (context->outq_size - pos >= mlen) {
+			iov[0].iov_len = mlen;
+			iov_len = 1;
+		} else {
+			iov[0].iov_len = context->outq_size - pos;
+			iov[1].iov_base = context->outq_buf;
+			iov[1].iov_len = mlen - iov[0].iov_len;
+			iov_len = 2;
+		}
 
-		rc = qb_ipcs_event_send(conn, outq_item->msg, outq_item->mlen);
+		rc = qb_ipcs_event_sendv(conn, iov, iov_len);
 		if (rc < 0 && rc != -EAGAIN) {
 			errno = -rc;
-			qb_perror(LOG_ERR, "qb_ipcs_event_send");
+			qb_perror(LOG_ERR, "qb_ipcs_event_sendv");
 			return;
 		} else if (rc == -EAGAIN) {
 			break;
 		}
-		assert(rc == outq_item->mlen);
+		assert(rc == mlen);
 		context->sent++;
 		context->queued--;
+		batch++;
+
+		context->outq_head = (context->outq_head + sizeof (mlen) + mlen) % context->outq_size;
+		context->queued_bytes -= sizeof (mlen) + mlen;
+		global_stats.queued_bytes -= sizeof (mlen) + mlen;
+	}
 
-		qb_list_del (list);
-		free (outq_item->msg);
-		free (outq_item);
+	if (batch != 0) {
+		context->flush_batch_last = batch;
+		if (batch > context->flush_batch_max) {
+			context->flush_batch_max = batch;
+		}
 	}
-	if (qb_list_empty (&context->outq_head)) {
+
+	if (context->queued_bytes == 0) {
 		context->queuing = QB_FALSE;
 		log_printf(LOGSYS_LEVEL_INFO, "Q empty, queued:%d sent:%d.",
 			context->queued, context->sent);
 		context->queued = 0;
 		context->sent = 0;
+		context->outq_head = 0;
+
+		/*
+		 * Give back memory of grown ring
+		 */
+		if (context->outq_size > OUTQ_INITIAL_SIZE) {
+			free (context->outq_buf);
+			context->outq_buf = NULL;
+			context->outq_size = 0;
+		}
 	} else {
-		qb_loop_job_add(cs_poll_handle_get(), QB_LOOP_HIGH, conn, outq_flush);
+		qb_loop_job_add(cs_ipcs_loop_get(), QB_LOOP_HIGH, conn, outq_flush);
 	}
 }
 
@@ -422,17 +788,23 @@ static void msg_send_or_queue(qb_ipcs_connection_t *conn, const struct iovec *io
 {
 	int32_t rc = 0;
 	int32_t i;
-	int32_t bytes_msg = 0;
-	struct outq_item *outq_item;
-	char *write_buf = 0;
+	uint32_t bytes_msg = 0;
+	size_t tail;
 	struct cs_ipcs_conn_context *context = qb_ipcs_context_get(conn);
 
 	for (i = 0; i < iov_len; i++) {
 		bytes_msg += iov[i].iov_len;
 	}
 
+	if (context->outq_overflow) {
+		/*
+		 * Connection is already being disconnected
+		 */
+		return;
+	}
+
 	if (!context->queuing) {
-		assert(qb_list_empty (&context->outq_head));
+		assert(context->queued_bytes == 0);
 		rc = qb_ipcs_event_sendv(conn, iov, iov_len);
 		if (rc == bytes_msg) {
 			context->sent++;
@@ -442,33 +814,37 @@ static void msg_send_or_queue(qb_ipcs_connection_t *conn, const struct iovec *io
 			context->queued = 0;
 			context->sent = 0;
 			context->queuing = QB_TRUE;
-			qb_loop_job_add(cs_poll_handle_get(), QB_LOOP_HIGH, conn, outq_flush);
+			qb_loop_job_add(cs_ipcs_loop_get(), QB_LOOP_HIGH, conn, outq_flush);
 		} else {
-			log_printf(LOGSYS_LEVEL_ERROR, "event_send retuned %d, expected %d!", rc, bytes_msg);
+			log_printf(LOGSYS_LEVEL_ERROR, "event_send retuned %d, expected %u!", rc, bytes_msg);
 			return;
 		}
 	}
-	outq_item = malloc (sizeof (struct outq_item));
-	if (outq_item == NULL) {
-		qb_ipcs_disconnect(conn);
-		return;
-	}
-	outq_item->msg = malloc (bytes_msg);
-	if (outq_item->msg == NULL) {
-		free (outq_item);
-		qb_ipcs_disconnect(conn);
+
+	if (outq_reserve (context, sizeof (bytes_msg) + bytes_msg) != 0) {
+		log_printf(LOGSYS_LEVEL_WARNING,
+			"Unable to queue event for client %s (%"PRIu64" bytes queued), disconnecting",
+			context->proc_name, context->queued_bytes);
+		context->outq_overflow = 1;
+		global_stats.outq_overflow++;
+		cs_ipcs_disconnect(conn);
 		return;
 	}
 
-	write_buf = outq_item->msg;
+	tail = context->outq_head + context->queued_bytes;
+	outq_copy_in (context, tail, &bytes_msg, sizeof (bytes_msg));
+	tail += sizeof (bytes_msg);
 	for (i = 0; i < iov_len; i++) {
-		memcpy (write_buf, iov[i].iov_base, iov[i].iov_len);
-		write_buf += iov[i].iov_len;
+		outq_copy_in (context, tail, iov[i].iov_base, iov[i].iov_len);
+		tail += iov[i].iov_len;
 	}
-	outq_item->mlen = bytes_msg;
-	qb_list_init (&outq_item->list);
-	qb_list_add_tail (&outq_item->list, &context->outq_head);
+
 	context->queued++;
+	context->queued_bytes += sizeof (bytes_msg) + bytes_msg;
+	global_stats.queued_bytes += sizeof (bytes_msg) + bytes_msg;
+	if (context->queued_bytes > context->queued_bytes_max) {
+		context->queued_bytes_max = context->queued_bytes;
+	}
 }
 
 int cs_ipcs_dispatch_send(void *conn, const void *msg, size_t mlen)
@@ -476,20 +852,132 @@ int cs_ipcs_dispatch_send(void *conn, const void *msg, size_t mlen)
 	struct iovec iov;
 	iov.iov_base = (void *)msg;
 	iov.iov_len = mlen;
-	msg_send_or_queue (conn, &iov, 1);
-	return 0;
+	return (cs_ipcs_dispatch_iov_send(conn, &iov, 1));
 }
 
 int cs_ipcs_dispatch_iov_send (void *conn,
 	const struct iovec *iov,
 	unsigned int iov_len)
 {
+	if (cs_ipcs_thread_post_needed()) {
+		return (cs_ipcs_thread_iov_post(CS_IPCS_THREAD_MSG_EVENT, conn, iov, iov_len));
+	}
+
 	msg_send_or_queue(conn, iov, iov_len);
 	return 0;
 }
 
-static int32_t cs_ipcs_msg_process(qb_ipcs_connection_t *c,
-		void *data, size_t size)
+static int cs_ipcs_fc_token_sent(enum totem_callback_token_type type, const void *data)
+{
+	/*
+	 * Queue was drained by token, so re-evaluate queue level, give
+	 * every connection new credits and resume reading of requests
+	 */
+	corosync_recheck_the_q_level(NULL);
+
+	ipc_fc_generation++;
+	memset(ipc_fc_credits_exhausted, 0, sizeof(ipc_fc_credits_exhausted));
+	cs_ipcs_check_for_flow_control();
+
+	if (ipc_fc_totem_queue_level == TOTEM_Q_LEVEL_CRITICAL) {
+		/*
+		 * Reading is still stopped, check again after next token.
+		 * Callback is kept by returning -1.
+		 */
+		return (-1);
+	}
+
+	ipc_fc_token_callback_pending = QB_FALSE;
+
+	return (0);
+}
+
+static void cs_ipcs_fc_token_callback_add(void)
+{
+	if (ipc_fc_token_callback_pending) {
+		return ;
+	}
+
+	ipc_fc_token_callback_pending = QB_TRUE;
+	totempg_callback_token_create(&ipc_fc_token_callback_handle,
+		TOTEM_CALLBACK_TOKEN_SENT, 1, cs_ipcs_fc_token_sent, NULL);
+}
+
+/*
+ * Take one flow control credit of connection. When the connection used all
+ * of its credits for current token rotation, reading of requests of the
+ * service is stopped until the token is sent.
+ */
+static void cs_ipcs_fc_credit_take(int32_t service, struct cs_ipcs_conn_context *context)
+{
+	uint32_t credits;
+
+	if (ipc_fc_totem_queue_level == TOTEM_Q_LEVEL_LOW) {
+		return ;
+	}
+
+	if (context->fc_generation != ipc_fc_generation) {
+		switch (ipc_fc_totem_queue_level) {
+		case TOTEM_Q_LEVEL_GOOD:
+			credits = ipc_fc_credits;
+			break;
+		case TOTEM_Q_LEVEL_HIGH:
+			credits = ipc_fc_credits / 4;
+			break;
+		default:
+			credits = 0;
+			break;
+		}
+		if (credits == 0 && ipc_fc_totem_queue_level != TOTEM_Q_LEVEL_CRITICAL) {
+			credits = 1;
+		}
+
+		context->fc_credits = credits * context->fc_priority;
+		context->fc_generation = ipc_fc_generation;
+	}
+
+	if (context->fc_credits > 0) {
+		context->fc_credits--;
+	}
+
+	if (context->fc_credits > 0) {
+		return ;
+	}
+
+	context->fc_throttled++;
+
+	if (!ipc_fc_credits_exhausted[service]) {
+		ipc_fc_credits_exhausted[service] = QB_TRUE;
+		cs_ipcs_check_for_flow_control();
+	}
+	cs_ipcs_fc_token_callback_add();
+}
+
+/*
+ * Checks which don't need any state of main thread, so they can be done
+ * by IPC thread
+ */
+static int32_t cs_ipcs_request_valid(qb_ipcs_connection_t *c,
+		const void *data, size_t size)
+{
+	const struct qb_ipc_request_header *request_pt = data;
+	int32_t service = qb_ipcs_service_id_get(c);
+
+	if (size < sizeof (struct qb_ipc_request_header) ||
+	    request_pt->size != size) {
+		return (QB_FALSE);
+	}
+
+	if (request_pt->id < 0 ||
+	    request_pt->id >= corosync_service[service]->lib_engine_count) {
+		return (QB_FALSE);
+	}
+
+	return (QB_TRUE);
+}
+
+static int32_t cs_ipcs_request_process(qb_ipcs_connection_t *c,
+		void *data, size_t size, int32_t valid)
 {
 	struct qb_ipc_response_header response;
 	struct qb_ipc_request_header *request_pt = (struct qb_ipc_request_header *)data;
@@ -497,15 +985,28 @@ static int32_t cs_ipcs_msg_process(qb_ipcs_connection_t *c,
 	int32_t send_ok = 0;
 	int32_t is_async_call = QB_FALSE;
 	ssize_t res = -1;
-	int sending_allowed_private_data;
+	int sending_allowed_private_data = 0;
 	struct cs_ipcs_conn_context *cnx;
 
-	send_ok = corosync_sending_allowed (service,
-			request_pt->id,
-			request_pt,
-			&sending_allowed_private_data);
+	if (valid) {
+		send_ok = corosync_sending_allowed (service,
+				request_pt->id,
+				request_pt,
+				&sending_allowed_private_data);
+	} else {
+		send_ok = -EINVAL;
+	}
+
+	if (send_ok >= 0 &&
+	    corosync_service[service]->lib_engine[request_pt->id].flow_control == CS_LIB_FLOW_CONTROL_REQUIRED) {
+		cnx = qb_ipcs_context_get(c);
+		if (cnx) {
+			cs_ipcs_fc_credit_take(service, cnx);
+		}
+	}
 
-	is_async_call = (service == CPG_SERVICE && request_pt->id == 2);
+	is_async_call = (size >= sizeof (struct qb_ipc_request_header) &&
+		service == CPG_SERVICE && request_pt->id == 2);
 
 	/*
 	 * This happens when the message contains some kind of invalid
@@ -525,7 +1026,7 @@ static int32_t cs_ipcs_msg_process(qb_ipcs_connection_t *c,
 			log_printf(LOGSYS_LEVEL_INFO, "*** %s() invalid message! size:%d error:%d",
 				__func__, response.size, response.error);
 		} else {
-			qb_ipcs_response_send (c,
+			cs_ipcs_response_send (c,
 				&response,
 				sizeof (response));
 		}
@@ -542,7 +1043,7 @@ static int32_t cs_ipcs_msg_process(qb_ipcs_connection_t *c,
 			response.size = sizeof (response);
 			response.id = 0;
 			response.error = CS_ERR_TRY_AGAIN;
-			qb_ipcs_response_send (c,
+			cs_ipcs_response_send (c,
 				&response,
 				sizeof (response));
 		} else {
@@ -562,106 +1063,835 @@ static int32_t cs_ipcs_msg_process(qb_ipcs_connection_t *c,
 	return res;
 }
 
-
-static int32_t cs_ipcs_job_add(enum qb_loop_priority p,	void *data, qb_loop_job_dispatch_fn fn)
+static int32_t cs_ipcs_msg_process(qb_ipcs_connection_t *c,
+		void *data, size_t size)
 {
-	return qb_loop_job_add(cs_poll_handle_get(), p, data, fn);
+	return (cs_ipcs_request_process(c, data, size,
+		cs_ipcs_request_valid(c, data, size)));
 }
 
-static int32_t cs_ipcs_dispatch_add(enum qb_loop_priority p, int32_t fd, int32_t events,
-	void *data, qb_ipcs_dispatch_fn_t fn)
+static int32_t cs_ipcs_in_ipc_thread(void)
 {
-	return qb_loop_poll_add(cs_poll_handle_get(), p, fd, events, data, fn);
+	return (ipc_thread_running && pthread_equal(pthread_self(), ipc_thread));
 }
 
-static int32_t cs_ipcs_dispatch_mod(enum qb_loop_priority p, int32_t fd, int32_t events,
-	void *data, qb_ipcs_dispatch_fn_t fn)
+/*
+ * Operation on libqb connection has to be passed to the IPC thread
+ */
+static int32_t cs_ipcs_thread_post_needed(void)
 {
-	return qb_loop_poll_mod(cs_poll_handle_get(), p, fd, events, data, fn);
+	return (ipc_thread_running && !cs_ipcs_in_ipc_thread());
 }
 
-static int32_t cs_ipcs_dispatch_del(int32_t fd)
+static void cs_ipcs_thread_pipe_write(int fd)
 {
-	return qb_loop_poll_del(cs_poll_handle_get(), fd);
+	char c = 0;
+	ssize_t res;
+
+	do {
+		res = write(fd, &c, 1);
+	} while (res == -1 && errno == EINTR);
 }
 
-static void cs_ipcs_low_fds_event(int32_t not_enough, int32_t fds_available)
+static void cs_ipcs_thread_pipe_drain(int fd)
 {
-	ipc_not_enough_fds_left = not_enough;
-	if (not_enough) {
-		log_printf(LOGSYS_LEVEL_WARNING, "refusing new connections (fds_available:%d)",
-			fds_available);
-	} else {
-		log_printf(LOGSYS_LEVEL_NOTICE, "allowing new connections (fds_available:%d)",
-			fds_available);
+	char buf[64];
 
+	while (read(fd, buf, sizeof(buf)) > 0) {
+		;
 	}
 }
 
-int32_t cs_ipcs_q_level_get(void)
+static uint32_t cs_ipcs_thread_ring_used(void)
 {
-	return ipc_fc_totem_queue_level;
+	return ((uint32_t)qb_atomic_int_get(&ipc_thread_ring_tail) -
+		(uint32_t)qb_atomic_int_get(&ipc_thread_ring_head));
 }
 
-static qb_loop_timer_handle ipcs_check_for_flow_control_timer;
-static void cs_ipcs_check_for_flow_control(void)
+/*
+ * Called by IPC thread. Waits while the ring is full.
+ */
+static void cs_ipcs_thread_ring_space_wait(void)
 {
-	int32_t i;
-	int32_t fc_enabled;
-
-	for (i = 0; i < SERVICES_COUNT_MAX; i++) {
-		if (corosync_service[i] == NULL || ipcs_mapper[i].inst == NULL) {
-			continue;
-		}
-		fc_enabled = QB_IPCS_RATE_OFF;
-		if (ipc_fc_is_quorate == 1 ||
-			corosync_service[i]->allow_inquorate == CS_LIB_ALLOW_INQUORATE) {
-			/*
-			 * we are quorate
-			 * now check flow control
-			 */
-			if (ipc_fc_totem_queue_level != TOTEM_Q_LEVEL_CRITICAL &&
-			    ipc_fc_sync_in_process == 0) {
-				fc_enabled = QB_FALSE;
-			} else if (ipc_fc_totem_queue_level != TOTEM_Q_LEVEL_CRITICAL &&
-			    i == VOTEQUORUM_SERVICE) {
-				/*
-				 * Allow message processing for votequorum service even
-				 * in sync phase
-				 */
-				fc_enabled = QB_FALSE;
-			} else {
-				fc_enabled = QB_IPCS_RATE_OFF_2;
-			}
-		}
-		if (fc_enabled) {
-			qb_ipcs_request_rate_limit(ipcs_mapper[i].inst, fc_enabled);
-
-			qb_loop_timer_add(cs_poll_handle_get(), QB_LOOP_MED, 1*QB_TIME_NS_IN_MSEC,
-			       NULL, corosync_recheck_the_q_level, &ipcs_check_for_flow_control_timer);
-		} else if (ipc_fc_totem_queue_level == TOTEM_Q_LEVEL_LOW) {
-			qb_ipcs_request_rate_limit(ipcs_mapper[i].inst, QB_IPCS_RATE_FAST);
-		} else if (ipc_fc_totem_queue_level == TOTEM_Q_LEVEL_GOOD) {
-			qb_ipcs_request_rate_limit(ipcs_mapper[i].inst, QB_IPCS_RATE_NORMAL);
-		} else if (ipc_fc_totem_queue_level == TOTEM_Q_LEVEL_HIGH) {
-			qb_ipcs_request_rate_limit(ipcs_mapper[i].inst, QB_IPCS_RATE_SLOW);
+	while (cs_ipcs_thread_ring_used() >= IPC_THREAD_RING_SIZE) {
+		pthread_mutex_lock(&ipc_thread_ring_mutex);
+		qb_atomic_int_set(&ipc_thread_ring_waiting, 1);
+		__sync_synchronize();
+		if (cs_ipcs_thread_ring_used() >= IPC_THREAD_RING_SIZE) {
+			pthread_cond_wait(&ipc_thread_ring_cond, &ipc_thread_ring_mutex);
 		}
+		qb_atomic_int_set(&ipc_thread_ring_waiting, 0);
+		pthread_mutex_unlock(&ipc_thread_ring_mutex);
 	}
 }
 
-static void cs_ipcs_fc_quorum_changed(int quorate, void *context)
+/*
+ * Called by IPC thread. Stops reading of requests when the ring is
+ * getting full.
+ */
+static void cs_ipcs_thread_ring_push(struct cs_ipcs_thread_msg *msg)
 {
-	ipc_fc_is_quorate = quorate;
-	cs_ipcs_check_for_flow_control();
+	int32_t rates[SERVICES_COUNT_MAX];
+	uint32_t tail = ipc_thread_ring_tail;
+	int32_t i;
+
+	cs_ipcs_thread_ring_space_wait();
+
+	ipc_thread_ring[tail % IPC_THREAD_RING_SIZE] = msg;
+	qb_atomic_int_set(&ipc_thread_ring_tail, tail + 1);
+
+	if (qb_atomic_int_compare_and_exchange(&ipc_thread_ring_wakeup, 0, 1)) {
+		cs_ipcs_thread_pipe_write(ipc_thread_ring_pipe[1]);
+	}
+
+	if (cs_ipcs_thread_ring_used() >= IPC_THREAD_RING_HIGH &&
+	    qb_atomic_int_compare_and_exchange(&ipc_thread_ring_throttled,
+	    IPC_THREAD_RING_OPEN, IPC_THREAD_RING_THROTTLED)) {
+		for (i = 0; i < SERVICES_COUNT_MAX; i++) {
+			rates[i] = QB_IPCS_RATE_OFF;
+		}
+		cs_ipcs_rate_limit_apply(rates);
+	}
 }
 
-static void cs_ipcs_totem_queue_level_changed(enum totem_q_level level)
+/*
+ * Called by main thread. Message stays in the ring (and its slot) until
+ * cs_ipcs_thread_ring_advance.
+ */
+static struct cs_ipcs_thread_msg *cs_ipcs_thread_ring_peek(void)
 {
-	ipc_fc_totem_queue_level = level;
-	cs_ipcs_check_for_flow_control();
+	uint32_t head = ipc_thread_ring_head;
+
+	if (head == (uint32_t)qb_atomic_int_get(&ipc_thread_ring_tail)) {
+		return (NULL);
+	}
+
+	return (ipc_thread_ring[head % IPC_THREAD_RING_SIZE]);
 }
 
-void cs_ipcs_sync_state_changed(int32_t sync_in_process)
+/*
+ * Called by main thread
+ */
+static void cs_ipcs_thread_ring_advance(void)
+{
+	qb_atomic_int_set(&ipc_thread_ring_head, ipc_thread_ring_head + 1);
+	__sync_synchronize();
+
+	if (qb_atomic_int_get(&ipc_thread_ring_waiting)) {
+		pthread_mutex_lock(&ipc_thread_ring_mutex);
+		pthread_cond_signal(&ipc_thread_ring_cond);
+		pthread_mutex_unlock(&ipc_thread_ring_mutex);
+	}
+}
+
+static void cs_ipcs_thread_cmd_process(struct cs_ipcs_thread_msg *msg)
+{
+	struct iovec iov;
+	int32_t rc;
+
+	switch (msg->type) {
+	case CS_IPCS_THREAD_MSG_DISCONNECT:
+		qb_ipcs_disconnect(msg->conn);
+		break;
+	case CS_IPCS_THREAD_MSG_UNREF:
+		qb_ipcs_connection_unref(msg->conn);
+		break;
+	case CS_IPCS_THREAD_MSG_RESPONSE:
+		rc = qb_ipcs_response_send(msg->conn, msg->data, msg->size);
+		if (rc < 0) {
+			errno = -rc;
+			qb_perror(LOG_DEBUG, "qb_ipcs_response_send");
+		}
+		break;
+	case CS_IPCS_THREAD_MSG_EVENT:
+		iov.iov_base = msg->data;
+		iov.iov_len = msg->size;
+		msg_send_or_queue(msg->conn, &iov, 1);
+		break;
+	case CS_IPCS_THREAD_MSG_CLEAR_STATS:
+		cs_ipcs_thread_clear_stats();
+		break;
+	case CS_IPCS_THREAD_MSG_RATE_LIMIT:
+		cs_ipcs_rate_limit_set((const int32_t *)msg->data);
+		break;
+	case CS_IPCS_THREAD_MSG_RING_RESUME:
+		qb_atomic_int_set(&ipc_thread_ring_throttled, IPC_THREAD_RING_OPEN);
+		cs_ipcs_rate_limit_apply(ipc_fc_rate);
+		return ;
+	case CS_IPCS_THREAD_MSG_STOP:
+		qb_loop_stop(ipc_thread_loop);
+		return ;
+	default:
+		assert(0);
+		break;
+	}
+
+	free(msg);
+}
+
+/*
+ * Passes command to the IPC thread or executes it directly when
+ * there is no IPC thread (anymore)
+ */
+static void cs_ipcs_thread_cmd_post(struct cs_ipcs_thread_msg *msg)
+{
+	int was_empty;
+
+	if (!ipc_thread_running) {
+		cs_ipcs_thread_cmd_process(msg);
+		return ;
+	}
+
+	pthread_mutex_lock(&ipc_thread_cmd_mutex);
+	was_empty = qb_list_empty(&ipc_thread_cmd_list);
+	qb_list_add_tail(&msg->list, &ipc_thread_cmd_list);
+	pthread_mutex_unlock(&ipc_thread_cmd_mutex);
+
+	if (was_empty) {
+		cs_ipcs_thread_pipe_write(ipc_thread_cmd_pipe[1]);
+	}
+}
+
+static void cs_ipcs_thread_cmd_list_process(void)
+{
+	QB_LIST_DECLARE (cmds);
+	struct qb_list_head *iter, *tmp_iter;
+	struct cs_ipcs_thread_msg *msg;
+
+	pthread_mutex_lock(&ipc_thread_cmd_mutex);
+	qb_list_splice(&ipc_thread_cmd_list, &cmds);
+	qb_list_init(&ipc_thread_cmd_list);
+	pthread_mutex_unlock(&ipc_thread_cmd_mutex);
+
+	qb_list_for_each_safe(iter, tmp_iter, &cmds) {
+		msg = qb_list_entry(iter, struct cs_ipcs_thread_msg, list);
+		qb_list_del(&msg->list);
+		cs_ipcs_thread_cmd_process(msg);
+	}
+}
+
+static int32_t cs_ipcs_thread_cmd_dispatch(int32_t fd, int32_t revents, void *data)
+{
+	cs_ipcs_thread_pipe_drain(fd);
+	cs_ipcs_thread_cmd_list_process();
+
+	return (0);
+}
+
+/*
+ * Release reference of connection taken by main thread. Last reference
+ * frees the connection, which must happen in IPC thread.
+ */
+static void cs_ipcs_thread_unref(qb_ipcs_connection_t *c)
+{
+	struct cs_ipcs_thread_msg *msg;
+
+	if (!ipc_thread_running) {
+		qb_ipcs_connection_unref(c);
+		return ;
+	}
+
+	msg = malloc(sizeof(*msg));
+	if (msg == NULL) {
+		log_printf(LOGSYS_LEVEL_ERROR, "Can't allocate memory, leaking IPC connection reference");
+		return ;
+	}
+
+	msg->type = CS_IPCS_THREAD_MSG_UNREF;
+	msg->conn = c;
+	cs_ipcs_thread_cmd_post(msg);
+}
+
+/*
+ * Copy iovec into command for IPC thread. Connection is kept alive by the
+ * main thread references until the command is processed.
+ */
+static int cs_ipcs_thread_iov_post(enum cs_ipcs_thread_msg_type type, qb_ipcs_connection_t *c,
+	const struct iovec *iov, unsigned int iov_len)
+{
+	struct cs_ipcs_thread_msg *msg;
+	size_t size = 0;
+	size_t pos = 0;
+	unsigned int i;
+
+	for (i = 0; i < iov_len; i++) {
+		size += iov[i].iov_len;
+	}
+
+	msg = malloc(sizeof(*msg) + size);
+	if (msg == NULL) {
+		log_printf(LOGSYS_LEVEL_ERROR, "Can't allocate memory for IPC message");
+		return (-ENOMEM);
+	}
+
+	msg->type = type;
+	msg->conn = c;
+	msg->call = NULL;
+	msg->size = size;
+	for (i = 0; i < iov_len; i++) {
+		memcpy(msg->data + pos, iov[i].iov_base, iov[i].iov_len);
+		pos += iov[i].iov_len;
+	}
+
+	cs_ipcs_thread_cmd_post(msg);
+
+	return (0);
+}
+
+static void cs_ipcs_disconnect(qb_ipcs_connection_t *c)
+{
+	struct cs_ipcs_thread_msg *msg;
+	struct cs_ipcs_conn_context *context;
+
+	if (!cs_ipcs_thread_post_needed()) {
+		qb_ipcs_disconnect(c);
+		return ;
+	}
+
+	context = qb_ipcs_context_get(c);
+	if (context == NULL || context->main_refs == 0) {
+		/*
+		 * Main thread holds no reference. Only happens when creating of
+		 * connection failed and then IPC thread disconnects it itself.
+		 */
+		return ;
+	}
+
+	msg = malloc(sizeof(*msg));
+	if (msg == NULL) {
+		log_printf(LOGSYS_LEVEL_ERROR, "Can't allocate memory, unable to disconnect IPC connection");
+		return ;
+	}
+
+	msg->type = CS_IPCS_THREAD_MSG_DISCONNECT;
+	msg->conn = c;
+	cs_ipcs_thread_cmd_post(msg);
+}
+
+/*
+ * Executed by main thread for IPC thread
+ */
+static void cs_ipcs_thread_call_process(qb_ipcs_connection_t *c, struct cs_ipcs_thread_call *call)
+{
+	switch (call->type) {
+	case CS_IPCS_THREAD_CALL_ACCEPT:
+		call->res = cs_ipcs_connection_accept(c, call->euid, call->egid);
+		break;
+	case CS_IPCS_THREAD_CALL_CREATED:
+		ipc_thread_call_in_progress = 1;
+		cs_ipcs_connection_created(c);
+		ipc_thread_call_in_progress = 0;
+		call->res = 0;
+		break;
+	case CS_IPCS_THREAD_CALL_CLOSED:
+		call->res = cs_ipcs_connection_closed(c);
+		break;
+	case CS_IPCS_THREAD_CALL_DESTROYED:
+		cs_ipcs_connection_destroyed(c);
+		call->res = 0;
+		break;
+	}
+
+	/*
+	 * call (and message) lives on the stack of IPC thread, don't touch it
+	 * after this
+	 */
+	sem_post(&call->done);
+}
+
+/*
+ * Called by main thread. Lets IPC thread read requests again when the
+ * ring was drained enough.
+ */
+static void cs_ipcs_thread_ring_resume_check(void)
+{
+	if (cs_ipcs_thread_ring_used() > IPC_THREAD_RING_LOW ||
+	    !qb_atomic_int_compare_and_exchange(&ipc_thread_ring_throttled,
+	    IPC_THREAD_RING_THROTTLED, IPC_THREAD_RING_RESUMING)) {
+		return ;
+	}
+
+	ipc_thread_resume_msg.type = CS_IPCS_THREAD_MSG_RING_RESUME;
+	cs_ipcs_thread_cmd_post(&ipc_thread_resume_msg);
+}
+
+static void cs_ipcs_thread_ring_process(int32_t budget)
+{
+	struct cs_ipcs_thread_msg *msg;
+
+	while (budget != 0 && (msg = cs_ipcs_thread_ring_peek()) != NULL) {
+		switch (msg->type) {
+		case CS_IPCS_THREAD_MSG_REQUEST:
+			cs_ipcs_request_process(msg->conn, msg->data, msg->size, msg->valid);
+			if (msg->allocated) {
+				free(msg);
+			}
+			break;
+		case CS_IPCS_THREAD_MSG_CALL:
+			cs_ipcs_thread_call_process(msg->conn, msg->call);
+			break;
+		default:
+			assert(0);
+			break;
+		}
+		cs_ipcs_thread_ring_advance();
+
+		if (budget > 0) {
+			budget--;
+		}
+	}
+}
+
+static int32_t cs_ipcs_thread_ring_dispatch(int32_t fd, int32_t revents, void *data)
+{
+	cs_ipcs_thread_pipe_drain(fd);
+	qb_atomic_int_set(&ipc_thread_ring_wakeup, 0);
+
+	cs_ipcs_thread_ring_process(IPC_THREAD_DISPATCH_BUDGET);
+	cs_ipcs_thread_ring_resume_check();
+
+	/*
+	 * Budget exhausted, come back in next loop iteration
+	 */
+	if (ipc_thread_ring_head != qb_atomic_int_get(&ipc_thread_ring_tail) &&
+	    qb_atomic_int_compare_and_exchange(&ipc_thread_ring_wakeup, 0, 1)) {
+		cs_ipcs_thread_pipe_write(ipc_thread_ring_pipe[1]);
+	}
+
+	return (0);
+}
+
+/*
+ * Executed by IPC thread, waits for main thread
+ */
+static int32_t cs_ipcs_thread_call(qb_ipcs_connection_t *c, struct cs_ipcs_thread_call *call)
+{
+	struct cs_ipcs_thread_msg msg;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = CS_IPCS_THREAD_MSG_CALL;
+	msg.conn = c;
+	msg.call = call;
+
+	sem_init(&call->done, 0, 0);
+	cs_ipcs_thread_ring_push(&msg);
+	while (sem_wait(&call->done) != 0 && errno == EINTR) {
+		;
+	}
+	sem_destroy(&call->done);
+
+	return (call->res);
+}
+
+static int32_t cs_ipcs_thread_connection_accept (qb_ipcs_connection_t *c, uid_t euid, gid_t egid)
+{
+	struct cs_ipcs_thread_call call;
+
+	if (!cs_ipcs_in_ipc_thread()) {
+		return (cs_ipcs_connection_accept(c, euid, egid));
+	}
+
+	call.type = CS_IPCS_THREAD_CALL_ACCEPT;
+	call.euid = euid;
+	call.egid = egid;
+
+	return (cs_ipcs_thread_call(c, &call));
+}
+
+static void cs_ipcs_thread_connection_created(qb_ipcs_connection_t *c)
+{
+	struct cs_ipcs_thread_call call;
+
+	if (!cs_ipcs_in_ipc_thread()) {
+		cs_ipcs_connection_created(c);
+		return ;
+	}
+
+	/*
+	 * Reference for the main thread, see cs_ipcs_conn_context.main_refs
+	 */
+	qb_ipcs_connection_ref(c);
+
+	call.type = CS_IPCS_THREAD_CALL_CREATED;
+	(void)cs_ipcs_thread_call(c, &call);
+
+	if (qb_ipcs_context_get(c) == NULL) {
+		/*
+		 * Main thread failed to create context
+		 */
+		qb_ipcs_disconnect(c);
+		qb_ipcs_connection_unref(c);
+	}
+}
+
+static int32_t cs_ipcs_thread_connection_closed (qb_ipcs_connection_t *c)
+{
+	struct cs_ipcs_thread_call call;
+
+	if (!cs_ipcs_in_ipc_thread()) {
+		return (cs_ipcs_connection_closed(c));
+	}
+
+	call.type = CS_IPCS_THREAD_CALL_CLOSED;
+	return (cs_ipcs_thread_call(c, &call));
+}
+
+static void cs_ipcs_thread_connection_destroyed (qb_ipcs_connection_t *c)
+{
+	struct cs_ipcs_thread_call call;
+
+	if (!cs_ipcs_in_ipc_thread()) {
+		cs_ipcs_connection_destroyed(c);
+		return ;
+	}
+
+	/*
+	 * Event queue is flushed by IPC loop
+	 */
+	qb_loop_job_del(ipc_thread_loop, QB_LOOP_HIGH, c, outq_flush);
+
+	call.type = CS_IPCS_THREAD_CALL_DESTROYED;
+	(void)cs_ipcs_thread_call(c, &call);
+}
+
+static int32_t cs_ipcs_thread_msg_process(qb_ipcs_connection_t *c,
+		void *data, size_t size)
+{
+	struct cs_ipcs_thread_msg *msg;
+
+	if (!cs_ipcs_in_ipc_thread()) {
+		return (cs_ipcs_msg_process(c, data, size));
+	}
+
+	/*
+	 * Data is valid only during this callback, so it has to be copied
+	 */
+	cs_ipcs_thread_ring_space_wait();
+	if (size <= IPC_THREAD_SLOT_DATA_SIZE) {
+		msg = ipc_thread_ring_slot[ipc_thread_ring_tail % IPC_THREAD_RING_SIZE];
+		msg->allocated = QB_FALSE;
+	} else {
+		msg = malloc(sizeof(*msg) + size);
+		if (msg == NULL) {
+			log_printf(LOGSYS_LEVEL_ERROR, "Can't allocate memory for IPC request, disconnecting");
+			qb_ipcs_disconnect(c);
+			return (-ENOMEM);
+		}
+		msg->allocated = QB_TRUE;
+	}
+
+	msg->type = CS_IPCS_THREAD_MSG_REQUEST;
+	msg->conn = c;
+	msg->call = NULL;
+	msg->valid = cs_ipcs_request_valid(c, data, size);
+	msg->size = size;
+	memcpy(msg->data, data, size);
+
+	cs_ipcs_thread_ring_push(msg);
+
+	return (0);
+}
+
+static void *cs_ipcs_thread_fn(void *arg)
+{
+	qb_loop_run(ipc_thread_loop);
+
+	qb_atomic_int_set(&ipc_thread_exited, 1);
+	cs_ipcs_thread_pipe_write(ipc_thread_ring_pipe[1]);
+
+	return (NULL);
+}
+
+static int cs_ipcs_thread_pipe_create(int fds[2])
+{
+	if (pipe(fds) != 0) {
+		return (-1);
+	}
+
+	if (fcntl(fds[0], F_SETFL, O_NONBLOCK) != 0 ||
+	    fcntl(fds[1], F_SETFL, O_NONBLOCK) != 0) {
+		close(fds[0]);
+		close(fds[1]);
+		return (-1);
+	}
+
+	return (0);
+}
+
+/*
+ * Called before first service is created, so it's known which loop
+ * IPC services belong to
+ */
+static void cs_ipcs_thread_init(void)
+{
+	static int32_t initialized = 0;
+	char *str;
+	int32_t i;
+
+	if (initialized) {
+		return ;
+	}
+	initialized = 1;
+
+	if (icmap_get_string("qb.ipc_thread", &str) != CS_OK) {
+		return ;
+	}
+	if (strcmp(str, "yes") == 0) {
+		ipc_thread_enabled = 1;
+	}
+	free(str);
+
+	if (!ipc_thread_enabled) {
+		return ;
+	}
+
+	ipc_thread_loop = qb_loop_create();
+	if (ipc_thread_loop == NULL ||
+	    cs_ipcs_thread_pipe_create(ipc_thread_ring_pipe) != 0 ||
+	    cs_ipcs_thread_pipe_create(ipc_thread_cmd_pipe) != 0) {
+		log_printf(LOGSYS_LEVEL_ERROR, "Can't initialize IPC thread");
+		corosync_exit_error(COROSYNC_DONE_FATAL_ERR);
+	}
+
+	for (i = 0; i < IPC_THREAD_RING_SIZE; i++) {
+		ipc_thread_ring_slot[i] = malloc(sizeof(struct cs_ipcs_thread_msg) +
+			IPC_THREAD_SLOT_DATA_SIZE);
+		if (ipc_thread_ring_slot[i] == NULL) {
+			log_printf(LOGSYS_LEVEL_ERROR, "Can't allocate memory for IPC thread ring");
+			corosync_exit_error(COROSYNC_DONE_FATAL_ERR);
+		}
+	}
+
+	qb_loop_poll_add(cs_poll_handle_get(), QB_LOOP_LOW, ipc_thread_ring_pipe[0],
+		POLLIN, NULL, cs_ipcs_thread_ring_dispatch);
+	qb_loop_poll_add(ipc_thread_loop, QB_LOOP_HIGH, ipc_thread_cmd_pipe[0],
+		POLLIN, NULL, cs_ipcs_thread_cmd_dispatch);
+
+	log_printf(LOGSYS_LEVEL_NOTICE, "IPC is serviced by separate thread");
+}
+
+static void cs_ipcs_thread_start(void)
+{
+	if (!ipc_thread_enabled) {
+		return ;
+	}
+
+	if (pthread_create(&ipc_thread, NULL, cs_ipcs_thread_fn, NULL) != 0) {
+		log_printf(LOGSYS_LEVEL_ERROR, "Can't create IPC thread");
+		corosync_exit_error(COROSYNC_DONE_FATAL_ERR);
+	}
+	ipc_thread_running = 1;
+}
+
+/*
+ * Stop IPC thread, so services can be destroyed by main thread.
+ * IPC thread may wait for main thread, so ring is processed until
+ * the thread exits.
+ */
+static void cs_ipcs_thread_stop(void)
+{
+	struct pollfd pfd;
+	int32_t i;
+
+	if (!ipc_thread_running) {
+		return ;
+	}
+
+	ipc_thread_stop_msg.type = CS_IPCS_THREAD_MSG_STOP;
+	cs_ipcs_thread_cmd_post(&ipc_thread_stop_msg);
+
+	pfd.fd = ipc_thread_ring_pipe[0];
+	pfd.events = POLLIN;
+	while (!qb_atomic_int_get(&ipc_thread_exited)) {
+		(void)poll(&pfd, 1, 10);
+		cs_ipcs_thread_pipe_drain(ipc_thread_ring_pipe[0]);
+		qb_atomic_int_set(&ipc_thread_ring_wakeup, 0);
+		cs_ipcs_thread_ring_process(-1);
+	}
+
+	pthread_join(ipc_thread, NULL);
+	ipc_thread_running = 0;
+	ipc_thread_ring_throttled = IPC_THREAD_RING_OPEN;
+
+	/*
+	 * Finish what IPC thread left behind, now directly
+	 */
+	cs_ipcs_thread_ring_process(-1);
+	cs_ipcs_thread_cmd_list_process();
+
+	for (i = 0; i < IPC_THREAD_RING_SIZE; i++) {
+		free(ipc_thread_ring_slot[i]);
+		ipc_thread_ring_slot[i] = NULL;
+	}
+
+	log_printf(LOGSYS_LEVEL_DEBUG, "IPC thread stopped");
+}
+
+
+static qb_loop_t *cs_ipcs_loop_get(void)
+{
+	if (ipc_thread_enabled) {
+		return (ipc_thread_loop);
+	}
+
+	return (cs_poll_handle_get());
+}
+
+static int32_t cs_ipcs_job_add(enum qb_loop_priority p,	void *data, qb_loop_job_dispatch_fn fn)
+{
+	return qb_loop_job_add(cs_ipcs_loop_get(), p, data, fn);
+}
+
+static int32_t cs_ipcs_dispatch_add(enum qb_loop_priority p, int32_t fd, int32_t events,
+	void *data, qb_ipcs_dispatch_fn_t fn)
+{
+	return qb_loop_poll_add(cs_ipcs_loop_get(), p, fd, events, data, fn);
+}
+
+static int32_t cs_ipcs_dispatch_mod(enum qb_loop_priority p, int32_t fd, int32_t events,
+	void *data, qb_ipcs_dispatch_fn_t fn)
+{
+	return qb_loop_poll_mod(cs_ipcs_loop_get(), p, fd, events, data, fn);
+}
+
+static int32_t cs_ipcs_dispatch_del(int32_t fd)
+{
+	return qb_loop_poll_del(cs_ipcs_loop_get(), fd);
+}
+
+static void cs_ipcs_low_fds_event(int32_t not_enough, int32_t fds_available)
+{
+	ipc_not_enough_fds_left = not_enough;
+	if (not_enough) {
+		log_printf(LOGSYS_LEVEL_WARNING, "refusing new connections (fds_available:%d)",
+			fds_available);
+	} else {
+		log_printf(LOGSYS_LEVEL_NOTICE, "allowing new connections (fds_available:%d)",
+			fds_available);
+
+	}
+}
+
+int32_t cs_ipcs_q_level_get(void)
+{
+	return ipc_fc_totem_queue_level;
+}
+
+/*
+ * Request rate limit of service. Reading of requests is stopped when
+ * inquorate, during sync, when totem queue is critical and when some
+ * connection of the service used all of its flow control credits.
+ */
+static int32_t cs_ipcs_fc_rate_get(int32_t service)
+{
+	if (ipc_fc_is_quorate == 0 &&
+	    corosync_service[service]->allow_inquorate != CS_LIB_ALLOW_INQUORATE) {
+		return (QB_IPCS_RATE_OFF);
+	}
+
+	if (ipc_fc_totem_queue_level == TOTEM_Q_LEVEL_CRITICAL) {
+		return (QB_IPCS_RATE_OFF_2);
+	}
+
+	/*
+	 * Allow message processing for votequorum service even
+	 * in sync phase
+	 */
+	if (ipc_fc_sync_in_process && service != VOTEQUORUM_SERVICE) {
+		return (QB_IPCS_RATE_OFF_2);
+	}
+
+	if (ipc_fc_credits_exhausted[service]) {
+		return (QB_IPCS_RATE_OFF);
+	}
+
+	switch (ipc_fc_totem_queue_level) {
+	case TOTEM_Q_LEVEL_LOW:
+		return (QB_IPCS_RATE_FAST);
+	case TOTEM_Q_LEVEL_GOOD:
+		return (QB_IPCS_RATE_NORMAL);
+	default:
+		return (QB_IPCS_RATE_SLOW);
+	}
+}
+
+/*
+ * Called by the thread owning IPC loop
+ */
+static void cs_ipcs_rate_limit_apply(const int32_t *rates)
+{
+	int32_t i;
+
+	for (i = 0; i < SERVICES_COUNT_MAX; i++) {
+		if (ipcs_mapper[i].inst == NULL) {
+			continue;
+		}
+		qb_ipcs_request_rate_limit(ipcs_mapper[i].inst, rates[i]);
+	}
+}
+
+/*
+ * Called by the thread owning IPC loop. While IPC thread ring is throttled,
+ * rates are only remembered and applied when it resumes.
+ */
+static void cs_ipcs_rate_limit_set(const int32_t *rates)
+{
+	memcpy(ipc_fc_rate, rates, sizeof(ipc_fc_rate));
+
+	if (qb_atomic_int_get(&ipc_thread_ring_throttled) == IPC_THREAD_RING_OPEN) {
+		cs_ipcs_rate_limit_apply(ipc_fc_rate);
+	}
+}
+
+static void cs_ipcs_check_for_flow_control(void)
+{
+	int32_t rates[SERVICES_COUNT_MAX];
+	struct iovec iov;
+	int32_t i;
+
+	for (i = 0; i < SERVICES_COUNT_MAX; i++) {
+		rates[i] = QB_IPCS_RATE_FAST;
+		if (corosync_service[i] == NULL || ipcs_mapper[i].inst == NULL) {
+			continue;
+		}
+		rates[i] = cs_ipcs_fc_rate_get(i);
+	}
+
+	if (cs_ipcs_thread_post_needed()) {
+		/*
+		 * Rate limit changes polling of IPC loop, which belongs to the
+		 * IPC thread
+		 */
+		iov.iov_base = rates;
+		iov.iov_len = sizeof(rates);
+		(void)cs_ipcs_thread_iov_post(CS_IPCS_THREAD_MSG_RATE_LIMIT, NULL, &iov, 1);
+		return ;
+	}
+
+	cs_ipcs_rate_limit_set(rates);
+}
+
+static void cs_ipcs_fc_quorum_changed(int quorate, void *context)
+{
+	ipc_fc_is_quorate = quorate;
+	cs_ipcs_check_for_flow_control();
+}
+
+static void cs_ipcs_totem_queue_level_changed(enum totem_q_level level)
+{
+	ipc_fc_totem_queue_level = level;
+	cs_ipcs_check_for_flow_control();
+
+	if (level == TOTEM_Q_LEVEL_CRITICAL) {
+		/*
+		 * Reading of requests is stopped, so nothing else would
+		 * re-evaluate queue level
+		 */
+		cs_ipcs_fc_token_callback_add();
+	}
+}
+
+void cs_ipcs_sync_state_changed(int32_t sync_in_process)
 {
 	ipc_fc_sync_in_process = sync_in_process;
 	cs_ipcs_check_for_flow_control();
@@ -675,7 +1905,8 @@ void cs_ipcs_get_global_stats(struct ipcs_global_stats *ipcs_stats)
 cs_error_t cs_ipcs_get_conn_stats(int service_id, uint32_t pid, void *conn_ptr, struct ipcs_conn_stats *ipcs_stats)
 {
 	struct cs_ipcs_conn_context *cnx;
-	qb_ipcs_connection_t *c, *prev;
+	struct qb_list_head *iter;
+	qb_ipcs_connection_t *c;
 	int found = 0;
 
 	if (corosync_service[service_id] == NULL || ipcs_mapper[service_id].inst == NULL) {
@@ -684,12 +1915,9 @@ cs_error_t cs_ipcs_get_conn_stats(int service_id, uint32_t pid, void *conn_ptr,
 
 	qb_ipcs_stats_get(ipcs_mapper[service_id].inst, &ipcs_stats->srv, QB_FALSE);
 
-	for (c = qb_ipcs_connection_first_get(ipcs_mapper[service_id].inst);
-	     c;
-	     prev = c, c = qb_ipcs_connection_next_get(ipcs_mapper[service_id].inst, prev), qb_ipcs_connection_unref(prev)) {
-
-		cnx = qb_ipcs_context_get(c);
-		if (cnx == NULL) continue;
+	qb_list_for_each(iter, &ipc_conn_list) {
+		cnx = qb_list_entry(iter, struct cs_ipcs_conn_context, list);
+		c = cnx->conn;
 		if (c != conn_ptr) continue;
 
 		qb_ipcs_connection_stats_get(c, &ipcs_stats->conn, QB_FALSE);
@@ -706,36 +1934,64 @@ cs_error_t cs_ipcs_get_conn_stats(int service_id, uint32_t pid, void *conn_ptr,
 	return CS_OK;
 }
 
-void cs_ipcs_clear_stats()
+/*
+ * Clear stats maintained by sending of events and libqb stats of
+ * connections. Executed by IPC thread when it's running. Connection
+ * list is changed only during synchronous calls, so it can be walked.
+ */
+static void cs_ipcs_thread_clear_stats(void)
 {
 	struct cs_ipcs_conn_context *cnx;
 	struct ipcs_conn_stats ipcs_stats;
-	qb_ipcs_connection_t *c, *prev;
-	int service_id;
+	struct qb_list_head *iter;
 
-	/* Global stats are easy */
-	memset(&global_stats, 0, sizeof(global_stats));
+	global_stats.outq_overflow = 0;
 
-	for (service_id = 0; service_id < SERVICES_COUNT_MAX; service_id++) {
-		if (!ipcs_mapper[service_id].inst) {
-			continue;
-		}
+	qb_list_for_each(iter, &ipc_conn_list) {
+		cnx = qb_list_entry(iter, struct cs_ipcs_conn_context, list);
 
-		for (c = qb_ipcs_connection_first_get(ipcs_mapper[service_id].inst);
-		     c;
-		     prev = c, c = qb_ipcs_connection_next_get(ipcs_mapper[service_id].inst, prev), qb_ipcs_connection_unref(prev)) {
-			/* Get stats with 'clear_after_read' set */
-			qb_ipcs_connection_stats_get(c, &ipcs_stats.conn, QB_TRUE);
+		/* Get stats with 'clear_after_read' set */
+		qb_ipcs_connection_stats_get(cnx->conn, &ipcs_stats.conn, QB_TRUE);
 
-			/* Our own stats */
-			cnx = qb_ipcs_context_get(c);
-			if (cnx == NULL) continue;
-			cnx->invalid_request = 0;
-			cnx->overload = 0;
-			cnx->sent = 0;
+		cnx->sent = 0;
+		cnx->queued_bytes_max = cnx->queued_bytes;
+		cnx->flush_batch_last = 0;
+		cnx->flush_batch_max = 0;
+	}
+}
 
-		}
+void cs_ipcs_clear_stats()
+{
+	struct cs_ipcs_conn_context *cnx;
+	struct cs_ipcs_thread_msg *msg;
+	struct qb_list_head *iter;
+
+	/* queued_bytes is current state, not counter */
+	global_stats.active = 0;
+	global_stats.closed = 0;
+
+	qb_list_for_each(iter, &ipc_conn_list) {
+		cnx = qb_list_entry(iter, struct cs_ipcs_conn_context, list);
+
+		/* Our own stats maintained by request processing */
+		cnx->invalid_request = 0;
+		cnx->overload = 0;
+		cnx->fc_throttled = 0;
 	}
+
+	if (!cs_ipcs_thread_post_needed()) {
+		cs_ipcs_thread_clear_stats();
+		return ;
+	}
+
+	msg = malloc(sizeof(*msg));
+	if (msg == NULL) {
+		log_printf(LOGSYS_LEVEL_ERROR, "Can't allocate memory, unable to clear IPC stats");
+		return ;
+	}
+	msg->type = CS_IPCS_THREAD_MSG_CLEAR_STATS;
+	msg->conn = NULL;
+	cs_ipcs_thread_cmd_post(msg);
 }
 
 static enum qb_ipc_type cs_get_ipc_type (void)
@@ -800,10 +2056,12 @@ const char *cs_ipcs_service_init(struct corosync_service_engine *service)
 		"Initializing IPC on %s [%d]",
 		ipcs_mapper[service->id].name,
 		ipcs_mapper[service->id].id);
+	cs_ipcs_thread_init();
+
 	ipcs_mapper[service->id].inst = qb_ipcs_create(ipcs_mapper[service->id].name,
 		ipcs_mapper[service->id].id,
 		cs_get_ipc_type(),
-		&corosync_service_funcs);
+		(ipc_thread_enabled ? &corosync_thread_service_funcs : &corosync_service_funcs));
 	assert(ipcs_mapper[service->id].inst);
 	qb_ipcs_poll_handlers_set(ipcs_mapper[service->id].inst,
 		&corosync_poll_funcs);
@@ -817,13 +2075,28 @@ const char *cs_ipcs_service_init(struct corosync_service_engine *service)
 
 void cs_ipcs_init(void)
 {
+	uint32_t outq_max_size_u32;
+
 	api = apidef_get ();
 
-	qb_loop_poll_low_fds_event_set(cs_poll_handle_get(), cs_ipcs_low_fds_event);
+	qb_loop_poll_low_fds_event_set(cs_ipcs_loop_get(), cs_ipcs_low_fds_event);
 
 	api->quorum_register_callback (cs_ipcs_fc_quorum_changed, NULL);
 	totempg_queue_level_register_callback (cs_ipcs_totem_queue_level_changed);
 
 	global_stats.active = 0;
 	global_stats.closed = 0;
+	global_stats.queued_bytes = 0;
+	global_stats.outq_overflow = 0;
+
+	if (icmap_get_uint32("qb.ipc_outq_max_size", &outq_max_size_u32) == CS_OK) {
+		outq_max_size = outq_max_size_u32;
+	}
+	log_printf(LOGSYS_LEVEL_DEBUG, "IPC out-queue limit is %zu bytes per connection", outq_max_size);
+
+	if (icmap_get_uint32("qb.ipc_fc_credits", &ipc_fc_credits) != CS_OK || ipc_fc_credits == 0) {
+		ipc_fc_credits = IPC_FC_DEFAULT_CREDITS;
+	}
+
+	cs_ipcs_thread_start();
 }
@@ -33,12 +33,26 @@
  */
 
 struct cs_ipcs_conn_context {
-	struct qb_list_head outq_head;
+	struct qb_list_head list; /* ipc_conn_list, main thread only */
+	qb_ipcs_connection_t *conn;
+	char *outq_buf; /* ring of queued events, each prefixed by uint32_t length */
+	size_t outq_size;
+	size_t outq_head;
+	int32_t outq_overflow;
 	int32_t queuing;
 	uint32_t queued;
+	uint64_t queued_bytes;
+	uint64_t queued_bytes_max;
 	uint64_t invalid_request;
 	uint64_t overload;
 	uint32_t sent;
+	uint32_t flush_batch_last;
+	uint32_t flush_batch_max;
+	uint32_t fc_priority;
+	uint32_t fc_credits;
+	uint32_t fc_generation;
+	uint64_t fc_throttled;
+	int32_t main_refs; /* references held by main thread, IPC thread mode only */
 	char proc_name[32];
 	char data[1];
 };
@@ -47,6 +61,8 @@ struct ipcs_global_stats
 {
 	uint64_t active;
 	uint64_t closed;
+	uint64_t queued_bytes;
+	uint64_t outq_overflow;
 };
 
 struct ipcs_conn_stats
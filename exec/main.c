@@ -101,6 +101,7 @@
 #endif
 
 #include <qb/qbdefs.h>
+#include <qb/qblist.h>
 #include <qb/qblog.h>
 #include <qb/qbloop.h>
 #include <qb/qbutil.h>
@@ -167,6 +168,26 @@ static const char *corosync_lock_file = LOCALSTATEDIR"/run/corosync.pid";
 
 static int ip_version = AF_INET;
 
+/*
+ * Startup instrumentation. Duration of every startup phase (usec) is stored
+ * in runtime.startup.PHASE
+ */
+static uint64_t startup_start_time;
+static int startup_operational = 0;
+
+static uint64_t startup_phase_store (const char *phase, uint64_t phase_start)
+{
+	char key_name[ICMAP_KEYNAME_MAXLEN];
+	uint64_t now;
+
+	now = qb_util_nano_current_get ();
+
+	snprintf (key_name, ICMAP_KEYNAME_MAXLEN, "runtime.startup.%s", phase);
+	icmap_set_uint64 (key_name, (now - phase_start) / QB_TIME_NS_IN_USEC);
+
+	return (now);
+}
+
 qb_loop_t *cs_poll_handle_get (void)
 {
 	return (corosync_poll_handle);
@@ -237,6 +258,7 @@ static void corosync_blackbox_write_to_file (void)
 static void unlink_all_completed (void)
 {
 	api->timer_delete (corosync_stats_timer_handle);
+	stats_shm_fini ();
 	qb_loop_stop (corosync_poll_handle);
 	icmap_fini();
 }
@@ -290,6 +312,13 @@ static void corosync_sync_completed (void)
 		"Completed service synchronization, ready to provide service.");
 	sync_in_process = 0;
 
+	if (!startup_operational) {
+		startup_operational = 1;
+		log_printf (LOGSYS_LEVEL_INFO, "Time to operational: %"PRIu64" ms",
+			(uint64_t)((startup_phase_store ("operational", startup_start_time) -
+			startup_start_time) / QB_TIME_NS_IN_MSEC));
+	}
+
 	cs_ipcs_sync_state_changed(sync_in_process);
 	cs_ipc_allow_connections(1);
 	/*
@@ -320,6 +349,8 @@ static int corosync_sync_callbacks_retrieve (
 	callbacks->sync_process = corosync_service[service_id]->sync_process;
 	callbacks->sync_activate = corosync_service[service_id]->sync_activate;
 	callbacks->sync_abort = corosync_service[service_id]->sync_abort;
+	callbacks->independent =
+		(corosync_service[service_id]->sync_dependency == CS_SYNC_INDEPENDENT);
 	return (0);
 }
 
@@ -480,11 +511,6 @@ static void corosync_mlockall (void)
 static void corosync_totem_stats_updater (void *data)
 {
 	totempg_stats_t * stats;
-	uint32_t total_mtt_rx_token;
-	uint32_t total_backlog_calc;
-	uint32_t total_token_holdtime;
-	int t, prev;
-	int32_t token_count;
 	const char *cstr;
 
 	stats = api->totem_get_stats();
@@ -514,39 +540,17 @@ static void corosync_totem_stats_updater (void *data)
 		stats->srp->firewall_enabled_or_nic_failure = 0;
 	}
 
-	total_mtt_rx_token = 0;
-	total_token_holdtime = 0;
-	total_backlog_calc = 0;
-	token_count = 0;
-	t = stats->srp->latest_token;
-	while (1) {
-		if (t == 0)
-			prev = TOTEM_TOKEN_STATS_MAX - 1;
-		else
-			prev = t - 1;
-		if (prev == stats->srp->earliest_token)
-			break;
-		/* if tx == 0, then dropped token (not ours) */
-		if (stats->srp->token[t].tx != 0 ||
-			(stats->srp->token[t].rx - stats->srp->token[prev].rx) > 0 ) {
-			total_mtt_rx_token += (stats->srp->token[t].rx - stats->srp->token[prev].rx);
-			total_token_holdtime += (stats->srp->token[t].tx - stats->srp->token[t].rx);
-			total_backlog_calc += stats->srp->token[t].backlog_calc;
-			token_count++;
-		}
-		t = prev;
-	}
-	if (token_count) {
-		stats->srp->mtt_rx_token = (total_mtt_rx_token / token_count);
-		stats->srp->avg_token_workload = (total_token_holdtime / token_count);
-		stats->srp->avg_backlog_calc = (total_backlog_calc / token_count);
-	}
-
+	/*
+	 * mtt_rx_token, avg_token_workload and avg_backlog_calc are
+	 * maintained by totemsrp for every token (as EWMA)
+	 */
 	stats->srp->time_since_token_last_received = qb_util_nano_current_get () / QB_TIME_NS_IN_MSEC -
 		stats->srp->token[stats->srp->latest_token].rx;
 
 	stats_trigger_trackers();
 
+	stats_shm_update();
+
 	api->timer_add_duration (1500 * MILLI_2_NANO_SECONDS, NULL,
 		corosync_totem_stats_updater,
 		&corosync_stats_timer_handle);
@@ -554,6 +558,16 @@ static void corosync_totem_stats_updater (void *data)
 
 static void corosync_totem_stats_init (void)
 {
+	char *str;
+
+	if (icmap_get_string("qb.stats_shm", &str) == CS_OK) {
+		if (strcmp(str, "yes") == 0 && stats_shm_init() != CS_OK) {
+			log_printf (LOGSYS_LEVEL_WARNING,
+				"Unable to publish stats in shared memory");
+		}
+		free(str);
+	}
+
 	/* start stats timer */
 	api->timer_add_duration (1500 * MILLI_2_NANO_SECONDS, NULL,
 		corosync_totem_stats_updater,
@@ -704,21 +718,15 @@ static void corosync_ring_id_store (
 	}
 }
 
-static qb_loop_timer_handle recheck_the_q_level_timer;
 void corosync_recheck_the_q_level(void *data)
 {
 	totempg_check_q_level(corosync_group_handle);
-	if (cs_ipcs_q_level_get() == TOTEM_Q_LEVEL_CRITICAL) {
-		qb_loop_timer_add(cs_poll_handle_get(), QB_LOOP_MED, 1*QB_TIME_NS_IN_MSEC,
-			NULL, corosync_recheck_the_q_level, &recheck_the_q_level_timer);
-	}
 }
 
 struct sending_allowed_private_data_struct {
 	int reserved_msgs;
 };
 
-
 int corosync_sending_allowed (
 	unsigned int service,
 	unsigned int id,
@@ -729,7 +737,29 @@ int corosync_sending_allowed (
 		(struct sending_allowed_private_data_struct *)sending_allowed_private_data;
 	struct iovec reserve_iovec;
 	struct qb_ipc_request_header *header = (struct qb_ipc_request_header *)msg;
-	int sending_allowed;
+	int flow_control_required;
+
+	pd->reserved_msgs = 0;
+
+	/* Message ID out of range */
+	if (id >= corosync_service[service]->lib_engine_count) {
+		return -EINVAL;
+	}
+
+	/*
+	 * Refuse requests before reservation, so nothing has to be released
+	 */
+	if (corosync_quorum_is_quorate() != 1 &&
+	    corosync_service[service]->allow_inquorate != CS_LIB_ALLOW_INQUORATE) {
+		return -EHOSTUNREACH;
+	}
+
+	flow_control_required =
+	    (corosync_service[service]->lib_engine[id].flow_control != CS_LIB_FLOW_CONTROL_NOT_REQUIRED);
+
+	if (flow_control_required && sync_in_process) {
+		return -EINPROGRESS;
+	}
 
 	reserve_iovec.iov_base = (char *)header;
 	reserve_iovec.iov_len = header->size;
@@ -741,30 +771,11 @@ int corosync_sending_allowed (
 		return -EINVAL;
 	}
 
-	/* Message ID out of range */
-	if (id >= corosync_service[service]->lib_engine_count) {
-		return -EINVAL;
-	}
-
-	sending_allowed = QB_FALSE;
-	if (corosync_quorum_is_quorate() == 1 ||
-	    corosync_service[service]->allow_inquorate == CS_LIB_ALLOW_INQUORATE) {
-		// we are quorate
-		// now check flow control
-		if (corosync_service[service]->lib_engine[id].flow_control == CS_LIB_FLOW_CONTROL_NOT_REQUIRED) {
-			sending_allowed = QB_TRUE;
-		} else if (pd->reserved_msgs && sync_in_process == 0) {
-			sending_allowed = QB_TRUE;
-		} else if (pd->reserved_msgs == 0) {
-			return -ENOBUFS;
-		} else /* (sync_in_process) */ {
-			return -EINPROGRESS;
-		}
-	} else {
-		return -EHOSTUNREACH;
+	if (flow_control_required && pd->reserved_msgs == 0) {
+		return -ENOBUFS;
 	}
 
-	return (sending_allowed);
+	return (QB_TRUE);
 }
 
 void corosync_sending_allowed_release (void *sending_allowed_private_data)
@@ -772,7 +783,7 @@ void corosync_sending_allowed_release (void *sending_allowed_private_data)
 	struct sending_allowed_private_data_struct *pd =
 		(struct sending_allowed_private_data_struct *)sending_allowed_private_data;
 
-	if (pd->reserved_msgs == -1) {
+	if (pd->reserved_msgs <= 0) {
 		return;
 	}
 	totempg_groups_joined_release (pd->reserved_msgs);
@@ -1018,6 +1029,8 @@ static void set_icmap_ro_keys_flag (void)
 	 */
 	icmap_set_ro_access("internal_configuration.", CS_TRUE, CS_TRUE);
 	icmap_set_ro_access("runtime.services.", CS_TRUE, CS_TRUE);
+	icmap_set_ro_access("runtime.sync.", CS_TRUE, CS_TRUE);
+	icmap_set_ro_access("runtime.startup.", CS_TRUE, CS_TRUE);
 	icmap_set_ro_access("runtime.config.", CS_TRUE, CS_TRUE);
 	icmap_set_ro_access("runtime.totem.", CS_TRUE, CS_TRUE);
 	icmap_set_ro_access("uidgid.config.", CS_TRUE, CS_TRUE);
@@ -1039,6 +1052,12 @@ static void set_icmap_ro_keys_flag (void)
 	icmap_set_ro_access("totem.nodeid", CS_FALSE, CS_TRUE);
 	icmap_set_ro_access("totem.clear_node_high_bit", CS_FALSE, CS_TRUE);
 	icmap_set_ro_access("qb.ipc_type", CS_FALSE, CS_TRUE);
+	icmap_set_ro_access("qb.ipc_thread", CS_FALSE, CS_TRUE);
+	icmap_set_ro_access("qb.stats_shm", CS_FALSE, CS_TRUE);
+	icmap_set_ro_access("qb.stats_shm_group", CS_FALSE, CS_TRUE);
+	icmap_set_ro_access("qb.stats_shm_mode", CS_FALSE, CS_TRUE);
+	icmap_set_ro_access("qb.ipc_outq_max_size", CS_FALSE, CS_TRUE);
+	icmap_set_ro_access("qb.ipc_fc_credits", CS_FALSE, CS_TRUE);
 	icmap_set_ro_access("config.reload_in_progress", CS_FALSE, CS_TRUE);
 	icmap_set_ro_access("config.totemconfig_reload_in_progress", CS_FALSE, CS_TRUE);
 }
@@ -1046,15 +1065,18 @@ static void set_icmap_ro_keys_flag (void)
 static void main_service_ready (void)
 {
 	int res;
+	uint64_t services_start;
 
 	/*
 	 * This must occur after totempg is initialized because "this_ip" must be set
 	 */
+	services_start = qb_util_nano_current_get ();
 	res = corosync_service_defaults_link_and_init (api);
 	if (res == -1) {
 		log_printf (LOGSYS_LEVEL_ERROR, "Could not initialize default services");
 		corosync_exit_error (COROSYNC_DONE_INIT_SERVICES);
 	}
+	(void)startup_phase_store ("services", services_start);
 	cs_ipcs_init();
 	corosync_totem_stats_init ();
 	corosync_fplay_control_init ();
@@ -1210,6 +1232,9 @@ int main (int argc, char **argv, char **envp)
 	struct scheduler_pause_timeout_data scheduler_pause_timeout_data;
 	long int tmpli;
 	char *ep;
+	uint64_t phase_start;
+
+	startup_start_time = qb_util_nano_current_get ();
 
 	/* default configuration
 	 */
@@ -1309,6 +1334,7 @@ int main (int argc, char **argv, char **envp)
 		syslog (LOGSYS_LEVEL_ERROR, "%s", error_string);
 		corosync_exit_error (COROSYNC_DONE_MAINCONFIGREAD);
 	}
+	phase_start = startup_phase_store ("config_parse", startup_start_time);
 
 	if (stats_map_init(api) != CS_OK) {
 		fprintf (stderr, "Corosync Executive couldn't initialize statistics component.\n");
@@ -1330,6 +1356,7 @@ int main (int argc, char **argv, char **envp)
 		syslog (LOGSYS_LEVEL_ERROR, "%s", error_string);
 		corosync_exit_error (COROSYNC_DONE_LOGCONFIGREAD);
 	}
+	phase_start = startup_phase_store ("log_config", phase_start);
 
 	if (!testonly) {
 		log_printf (LOGSYS_LEVEL_NOTICE, "Corosync Cluster Engine ('%s'): started and ready to provide service.", VERSION);
@@ -1390,6 +1417,7 @@ int main (int argc, char **argv, char **envp)
 		log_printf (LOGSYS_LEVEL_ERROR, "%s", error_string);
 		corosync_exit_error (COROSYNC_DONE_MAINCONFIGREAD);
 	}
+	phase_start = startup_phase_store ("totem_config", phase_start);
 
 	if (testonly) {
 		corosync_exit_error (COROSYNC_DONE_EXIT);
@@ -1484,6 +1512,7 @@ int main (int argc, char **argv, char **envp)
 	if ((flock_err = corosync_flock (corosync_lock_file, getpid ())) != COROSYNC_DONE_EXIT) {
 		corosync_exit_error (flock_err);
 	}
+	phase_start = startup_phase_store ("process_setup", phase_start);
 
 	/*
 	 * if totempg_initialize doesn't have root priveleges, it cannot
@@ -1515,6 +1544,7 @@ int main (int argc, char **argv, char **envp)
 		corosync_group_handle,
 		&corosync_group,
 		1);
+	(void)startup_phase_store ("totem_init", phase_start);
 
 	/*
 	 * Drop root privleges to user 'corosync'
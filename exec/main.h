@@ -120,6 +120,8 @@ extern void cs_ipc_refcnt_inc(void *conn);
 
 extern void cs_ipc_refcnt_dec(void *conn);
 
+extern void cs_ipc_disconnect(void *conn);
+
 extern void cs_ipc_allow_connections(int32_t allow);
 
 int coroparse_configparse (icmap_map_t config_map, const char **error_string);
@@ -54,6 +54,7 @@
 
 #include <qb/qbipcs.h>
 #include <qb/qbloop.h>
+#include <qb/qbutil.h>
 
 LOGSYS_DECLARE_SUBSYS ("SERV");
 
@@ -123,6 +124,8 @@ char *corosync_service_link_and_init (
 	char *name_sufix;
 	char key_name[ICMAP_KEYNAME_MAXLEN];
 	char *init_result;
+	uint64_t init_start;
+	uint64_t init_duration;
 
 	/*
 	 * Initialize service
@@ -135,12 +138,14 @@ char *corosync_service_link_and_init (
 		service_engine->config_init_fn (corosync_api);
 	}
 
+	init_start = qb_util_nano_current_get ();
 	if (service_engine->exec_init_fn) {
 		init_result = service_engine->exec_init_fn (corosync_api);
 		if (init_result) {
 			return (init_result);
 		}
 	}
+	init_duration = (qb_util_nano_current_get () - init_start) / QB_TIME_NS_IN_USEC;
 
 	/*
 	 * Store service in cmap db
@@ -160,6 +165,9 @@ char *corosync_service_link_and_init (
 	snprintf(key_name, ICMAP_KEYNAME_MAXLEN, "runtime.services.%s.service_id", name_sufix);
 	icmap_set_uint16(key_name, service_engine->id);
 
+	snprintf(key_name, ICMAP_KEYNAME_MAXLEN, "runtime.services.%s.init_duration", name_sufix);
+	icmap_set_uint64(key_name, init_duration);
+
 	for (fn = 0; fn < service_engine->exec_engine_count; fn++) {
 		snprintf(key_name, ICMAP_KEYNAME_MAXLEN, "runtime.services.%s.%d.tx", name_sufix, fn);
 		icmap_set_uint64(key_name, 0);
@@ -334,7 +342,10 @@ static unsigned int service_unlink_and_exit (
 }
 
 /*
- * Links default services into the executive
+ * Links default services into the executive. Services are initialized
+ * one by one in order of default_services, because exec_init_fn of later
+ * services depends on earlier ones (cmap, quorum provider) and all of
+ * them use icmap and the main loop, which are not thread safe.
  */
 unsigned int corosync_service_defaults_link_and_init (struct corosync_api_v1 *corosync_api)
 {
@@ -36,13 +36,17 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
+#include <errno.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 #include <unistd.h>
 #include <libknet.h>
 
 #include <qb/qblist.h>
+#include <qb/qbutil.h>
 #include <qb/qbipcs.h>
 #include <qb/qbipc_common.h>
 
@@ -50,11 +54,13 @@
 #include <corosync/coroapi.h>
 #include <corosync/logsys.h>
 #include <corosync/icmap.h>
+#include <corosync/stats_shm.h>
 #include <corosync/totem/totemstats.h>
 
 #include "util.h"
 #include "ipcs_stats.h"
 #include "stats.h"
+#include "timeline.h"
 
 LOGSYS_DECLARE_SUBSYS ("STATS");
 
@@ -62,7 +68,7 @@ static qb_map_t *stats_map;
 
 /* Convert iterator number to text and a stats pointer */
 struct cs_stats_conv {
-	enum {STAT_PG, STAT_SRP, STAT_KNET, STAT_KNET_HANDLE, STAT_IPCSC, STAT_IPCSG} type;
+	enum {STAT_PG, STAT_SRP, STAT_KNET, STAT_KNET_HANDLE, STAT_IPCSC, STAT_IPCSG, STAT_TIMELINE} type;
 	const char *name;
 	const size_t offset;
 	const icmap_value_types_t value_type;
@@ -105,6 +111,62 @@ struct cs_stats_conv cs_srp_stats[] = {
 	{ STAT_SRP, "avg_backlog_calc",       offsetof(totemsrp_stats_t, avg_backlog_calc),       ICMAP_VALUETYPE_UINT32},
 };
 
+/*
+ * Token metrics maintained by totemsrp (totemsrp_token_metric_t). Not part
+ * of cs_srp_stats, so layout of stats shared memory is not affected.
+ */
+#define TOKEN_METRIC_STATS(name, field) \
+	{ STAT_SRP, name "_samples", offsetof(totemsrp_stats_t, field.samples), ICMAP_VALUETYPE_UINT64}, \
+	{ STAT_SRP, name "_sum",     offsetof(totemsrp_stats_t, field.sum),     ICMAP_VALUETYPE_UINT64}, \
+	{ STAT_SRP, name "_min",     offsetof(totemsrp_stats_t, field.min),     ICMAP_VALUETYPE_UINT32}, \
+	{ STAT_SRP, name "_max",     offsetof(totemsrp_stats_t, field.max),     ICMAP_VALUETYPE_UINT32}, \
+	{ STAT_SRP, name "_p50",     offsetof(totemsrp_stats_t, field.p50),     ICMAP_VALUETYPE_UINT32}, \
+	{ STAT_SRP, name "_p99",     offsetof(totemsrp_stats_t, field.p99),     ICMAP_VALUETYPE_UINT32}
+
+#define TOKEN_METRIC_HIST_BUCKET(name, field, bucket, bound) \
+	{ STAT_SRP, name "_hist_le_" bound, offsetof(totemsrp_stats_t, field.hist[bucket]), ICMAP_VALUETYPE_UINT64}
+
+/* Must match TOTEM_TOKEN_STATS_HIST_BOUNDS */
+#define TOKEN_METRIC_HIST(name, field) \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 0, "1"), \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 1, "2"), \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 2, "5"), \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 3, "10"), \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 4, "20"), \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 5, "50"), \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 6, "100"), \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 7, "200"), \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 8, "500"), \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 9, "1000"), \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 10, "2000"), \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 11, "5000"), \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 12, "inf")
+
+/* Must match TOTEM_TOKEN_STATS_BACKLOG_HIST_BOUNDS */
+#define TOKEN_METRIC_BACKLOG_HIST(name, field) \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 0, "0"), \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 1, "1"), \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 2, "2"), \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 3, "4"), \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 4, "8"), \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 5, "16"), \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 6, "32"), \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 7, "64"), \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 8, "128"), \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 9, "256"), \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 10, "512"), \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 11, "1024"), \
+	TOKEN_METRIC_HIST_BUCKET(name, field, 12, "inf")
+
+struct cs_stats_conv cs_srp_token_stats[] = {
+	TOKEN_METRIC_STATS("mtt_rx_token", token_rotation),
+	TOKEN_METRIC_HIST("mtt_rx_token", token_rotation),
+	TOKEN_METRIC_STATS("token_workload", token_workload),
+	TOKEN_METRIC_HIST("token_workload", token_workload),
+	TOKEN_METRIC_STATS("backlog_calc", token_backlog),
+	TOKEN_METRIC_BACKLOG_HIST("backlog_calc", token_backlog),
+};
+
 struct cs_stats_conv cs_knet_stats[] = {
 	{ STAT_KNET, "enabled",          offsetof(struct knet_link_status, enabled),                ICMAP_VALUETYPE_UINT8},
 	{ STAT_KNET, "connected",        offsetof(struct knet_link_status, connected),              ICMAP_VALUETYPE_UINT8},
@@ -177,6 +239,13 @@ struct cs_stats_conv cs_ipcs_conn_stats[] = {
 	{ STAT_IPCSC, "invalid_request", offsetof(struct ipcs_conn_stats, cnx.invalid_request),  ICMAP_VALUETYPE_UINT64},
 	{ STAT_IPCSC, "overload",        offsetof(struct ipcs_conn_stats, cnx.overload),         ICMAP_VALUETYPE_UINT64},
 	{ STAT_IPCSC, "sent",            offsetof(struct ipcs_conn_stats, cnx.sent),             ICMAP_VALUETYPE_UINT32},
+	{ STAT_IPCSC, "queued_bytes",    offsetof(struct ipcs_conn_stats, cnx.queued_bytes),     ICMAP_VALUETYPE_UINT64},
+	{ STAT_IPCSC, "queued_bytes_max", offsetof(struct ipcs_conn_stats, cnx.queued_bytes_max), ICMAP_VALUETYPE_UINT64},
+	{ STAT_IPCSC, "flush_batch_last", offsetof(struct ipcs_conn_stats, cnx.flush_batch_last), ICMAP_VALUETYPE_UINT32},
+	{ STAT_IPCSC, "flush_batch_max", offsetof(struct ipcs_conn_stats, cnx.flush_batch_max),  ICMAP_VALUETYPE_UINT32},
+	{ STAT_IPCSC, "fc_priority",     offsetof(struct ipcs_conn_stats, cnx.fc_priority),      ICMAP_VALUETYPE_UINT32},
+	{ STAT_IPCSC, "fc_credits",      offsetof(struct ipcs_conn_stats, cnx.fc_credits),       ICMAP_VALUETYPE_UINT32},
+	{ STAT_IPCSC, "fc_throttled",    offsetof(struct ipcs_conn_stats, cnx.fc_throttled),     ICMAP_VALUETYPE_UINT64},
 	{ STAT_IPCSC, "procname",        offsetof(struct ipcs_conn_stats, cnx.proc_name),        ICMAP_VALUETYPE_STRING},
 	{ STAT_IPCSC, "requests",        offsetof(struct ipcs_conn_stats, conn.requests),        ICMAP_VALUETYPE_UINT64},
 	{ STAT_IPCSC, "responses",       offsetof(struct ipcs_conn_stats, conn.responses),       ICMAP_VALUETYPE_UINT64},
@@ -189,14 +258,26 @@ struct cs_stats_conv cs_ipcs_conn_stats[] = {
 struct cs_stats_conv cs_ipcs_global_stats[] = {
 	{ STAT_IPCSG, "global.active",        offsetof(struct ipcs_global_stats, active),           ICMAP_VALUETYPE_UINT64},
 	{ STAT_IPCSG, "global.closed",        offsetof(struct ipcs_global_stats, closed),           ICMAP_VALUETYPE_UINT64},
+	{ STAT_IPCSG, "global.queued_bytes",  offsetof(struct ipcs_global_stats, queued_bytes),     ICMAP_VALUETYPE_UINT64},
+	{ STAT_IPCSG, "global.outq_overflow", offsetof(struct ipcs_global_stats, outq_overflow),    ICMAP_VALUETYPE_UINT64},
+};
+
+struct cs_stats_conv cs_timeline_stats[] = {
+	{ STAT_TIMELINE, "seq",   offsetof(struct timeline_entry, seq),   ICMAP_VALUETYPE_UINT64},
+	{ STAT_TIMELINE, "time",  offsetof(struct timeline_entry, time),  ICMAP_VALUETYPE_UINT64},
+	{ STAT_TIMELINE, "event", offsetof(struct timeline_entry, event), ICMAP_VALUETYPE_STRING},
+	{ STAT_TIMELINE, "arg",   offsetof(struct timeline_entry, arg),   ICMAP_VALUETYPE_UINT32},
+	{ STAT_TIMELINE, "value", offsetof(struct timeline_entry, value), ICMAP_VALUETYPE_UINT32},
 };
 
 #define NUM_PG_STATS (sizeof(cs_pg_stats) / sizeof(struct cs_stats_conv))
 #define NUM_SRP_STATS (sizeof(cs_srp_stats) / sizeof(struct cs_stats_conv))
+#define NUM_SRP_TOKEN_STATS (sizeof(cs_srp_token_stats) / sizeof(struct cs_stats_conv))
 #define NUM_KNET_STATS (sizeof(cs_knet_stats) / sizeof(struct cs_stats_conv))
 #define NUM_KNET_HANDLE_STATS (sizeof(cs_knet_handle_stats) / sizeof(struct cs_stats_conv))
 #define NUM_IPCSC_STATS (sizeof(cs_ipcs_conn_stats) / sizeof(struct cs_stats_conv))
 #define NUM_IPCSG_STATS (sizeof(cs_ipcs_global_stats) / sizeof(struct cs_stats_conv))
+#define NUM_TIMELINE_STATS (sizeof(cs_timeline_stats) / sizeof(struct cs_stats_conv))
 
 /* What goes in the trie */
 struct stats_item {
@@ -260,7 +341,7 @@ static void stats_rm_entry(const char *key)
 
 cs_error_t stats_map_init(const struct corosync_api_v1 *corosync_api)
 {
-	int i;
+	int i, j;
 	char param[ICMAP_KEYNAME_MAXLEN];
 
 	api = corosync_api;
@@ -279,10 +360,20 @@ cs_error_t stats_map_init(const struct corosync_api_v1 *corosync_api)
 		sprintf(param, "stats.srp.%s", cs_srp_stats[i].name);
 		stats_add_entry(param, &cs_srp_stats[i]);
 	}
+	for (i = 0; i<NUM_SRP_TOKEN_STATS; i++) {
+		sprintf(param, "stats.srp.%s", cs_srp_token_stats[i].name);
+		stats_add_entry(param, &cs_srp_token_stats[i]);
+	}
 	for (i = 0; i<NUM_IPCSG_STATS; i++) {
 		sprintf(param, "stats.ipcs.%s", cs_ipcs_global_stats[i].name);
 		stats_add_entry(param, &cs_ipcs_global_stats[i]);
 	}
+	for (j = 0; j < TIMELINE_ENTRIES; j++) {
+		for (i = 0; i<NUM_TIMELINE_STATS; i++) {
+			sprintf(param, "stats.timeline.%02d.%s", j, cs_timeline_stats[i].name);
+			stats_add_entry(param, &cs_timeline_stats[i]);
+		}
+	}
 
 	/* KNET and IPCS stats are added when appropriate */
 	return CS_OK;
@@ -300,6 +391,8 @@ cs_error_t stats_map_get(const char *key_name,
 	struct ipcs_conn_stats ipcs_conn_stats;
 	struct ipcs_global_stats ipcs_global_stats;
 	struct knet_handle_stats knet_handle_stats;
+	struct timeline_entry timeline_entry;
+	int timeline_idx;
 	int res;
 	int nodeid;
 	int link_no;
@@ -340,7 +433,7 @@ cs_error_t stats_map_get(const char *key_name,
 				return CS_ERR_NOT_EXIST;
 			}
 
-			/* Always get the latest stats */
+			/* Snapshot of the whole link is shared by all its keys for a short time */
 			res = totemknet_link_get_status((knet_node_id_t)nodeid, (uint8_t)link_no, &link_status);
 			if (res != CS_OK) {
 				return CS_ERR_LIBRARY;
@@ -361,6 +454,13 @@ cs_error_t stats_map_get(const char *key_name,
 			cs_ipcs_get_global_stats(&ipcs_global_stats);
 			stats_map_set_value(statinfo, &ipcs_global_stats, value, value_len, type);
 			break;
+		case STAT_TIMELINE:
+			if (sscanf(key_name, "stats.timeline.%d.", &timeline_idx) != 1 ||
+			    timeline_get(timeline_idx, &timeline_entry) != 0) {
+				return CS_ERR_NOT_EXIST;
+			}
+			stats_map_set_value(statinfo, &timeline_entry, value, value_len, type);
+			break;
 		default:
 			return CS_ERR_LIBRARY;
 	}
@@ -666,3 +766,197 @@ void stats_ipcs_del_connection(int service_id, uint32_t pid, void *ptr)
 		stats_rm_entry(param);
 	}
 }
+
+/*
+ * Read-only copy of stats in shared memory (qb.stats_shm). Sections of
+ * struct cs_stats_shm are arrays of uint64_t in the same order as
+ * cs_*_stats tables above, so tables are used to fill them.
+ */
+#define CS_STATS_SHM_DEFAULT_MODE	(S_IRUSR | S_IWUSR | S_IRGRP)
+
+static struct cs_stats_shm *stats_shm;
+static size_t stats_shm_size;
+static struct totemknet_link_stats *stats_shm_links;
+
+static uint64_t stats_conv_get_uint64(const struct cs_stats_conv *conv, const void *stat_array)
+{
+	const char *ptr = (const char *)stat_array + conv->offset;
+	uint8_t u8;
+	int32_t i32;
+	uint32_t u32;
+	uint64_t u64;
+
+	switch (conv->value_type) {
+	case ICMAP_VALUETYPE_UINT8:
+		memcpy(&u8, ptr, sizeof(u8));
+		return (u8);
+	case ICMAP_VALUETYPE_INT32:
+		memcpy(&i32, ptr, sizeof(i32));
+		return ((uint64_t)i32);
+	case ICMAP_VALUETYPE_UINT32:
+		memcpy(&u32, ptr, sizeof(u32));
+		return (u32);
+	case ICMAP_VALUETYPE_UINT64:
+		memcpy(&u64, ptr, sizeof(u64));
+		return (u64);
+	default:
+		return (0);
+	}
+}
+
+static void stats_shm_fill(uint64_t *dst,
+			   const struct cs_stats_conv *conv,
+			   size_t no_stats,
+			   const void *stat_array)
+{
+	size_t i;
+
+	for (i = 0; i < no_stats; i++) {
+		dst[i] = stats_conv_get_uint64(&conv[i], stat_array);
+	}
+}
+
+cs_error_t stats_shm_init(void)
+{
+	void *addr;
+	int fd;
+	uint32_t shm_gid;
+	uint32_t shm_mode = CS_STATS_SHM_DEFAULT_MODE;
+
+	if (sizeof(struct cs_stats_shm_pg) != NUM_PG_STATS * sizeof(uint64_t) ||
+	    sizeof(struct cs_stats_shm_srp) != NUM_SRP_STATS * sizeof(uint64_t) ||
+	    sizeof(struct cs_stats_shm_ipcs) != NUM_IPCSG_STATS * sizeof(uint64_t) ||
+	    sizeof(struct cs_stats_shm_knet_link) - offsetof(struct cs_stats_shm_knet_link, enabled) !=
+	    NUM_KNET_STATS * sizeof(uint64_t)) {
+		log_printf(LOGSYS_LEVEL_ERROR, "Stats shared memory layout doesn't match stats map");
+		return (CS_ERR_LIBRARY);
+	}
+
+	stats_shm_links = malloc(sizeof(*stats_shm_links) * CS_STATS_SHM_MAX_KNET_LINKS);
+	if (stats_shm_links == NULL) {
+		return (CS_ERR_NO_MEMORY);
+	}
+
+	/*
+	 * Remove object possibly left by previous (crashed) instance
+	 */
+	shm_unlink(CS_STATS_SHM_NAME);
+
+	stats_shm_size = CS_STATS_SHM_SIZE(CS_STATS_SHM_MAX_KNET_LINKS);
+
+	(void)icmap_get_uint32("qb.stats_shm_mode", &shm_mode);
+
+	fd = shm_open(CS_STATS_SHM_NAME, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+	if (fd == -1) {
+		LOGSYS_PERROR(errno, LOGSYS_LEVEL_ERROR, "Can't create stats shared memory %s",
+		    CS_STATS_SHM_NAME);
+		goto error_free;
+	}
+
+	/*
+	 * Object is created accessible only by owner. Group is changed before
+	 * access is granted, so no other group can ever open it. Mode is set
+	 * by fchmod because shm_open mode is subject of umask.
+	 */
+	if (icmap_get_uint32("qb.stats_shm_group", &shm_gid) == CS_OK &&
+	    fchown(fd, -1, shm_gid) == -1) {
+		LOGSYS_PERROR(errno, LOGSYS_LEVEL_ERROR, "Can't change group of stats shared memory");
+		goto error_close;
+	}
+
+	if (fchmod(fd, S_IRUSR | S_IWUSR | shm_mode) == -1) {
+		LOGSYS_PERROR(errno, LOGSYS_LEVEL_ERROR, "Can't change mode of stats shared memory");
+		goto error_close;
+	}
+
+	if (ftruncate(fd, stats_shm_size) == -1) {
+		LOGSYS_PERROR(errno, LOGSYS_LEVEL_ERROR, "Can't resize stats shared memory");
+		goto error_close;
+	}
+
+	addr = mmap(NULL, stats_shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) {
+		LOGSYS_PERROR(errno, LOGSYS_LEVEL_ERROR, "Can't map stats shared memory");
+		goto error_close;
+	}
+	close(fd);
+
+	stats_shm = addr;
+	stats_shm->size = stats_shm_size;
+	stats_shm->max_knet_links = CS_STATS_SHM_MAX_KNET_LINKS;
+	stats_shm->version = CS_STATS_SHM_VERSION;
+	__sync_synchronize();
+	/*
+	 * Magic is set last so readers never see partially initialized header
+	 */
+	stats_shm->magic = CS_STATS_SHM_MAGIC;
+
+	stats_shm_update();
+
+	log_printf(LOGSYS_LEVEL_DEBUG, "Stats published in shared memory %s", CS_STATS_SHM_NAME);
+
+	return (CS_OK);
+
+error_close:
+	close(fd);
+	shm_unlink(CS_STATS_SHM_NAME);
+error_free:
+	free(stats_shm_links);
+	stats_shm_links = NULL;
+
+	return (CS_ERR_LIBRARY);
+}
+
+void stats_shm_update(void)
+{
+	totempg_stats_t *pg_stats;
+	struct ipcs_global_stats ipcs_global_stats;
+	size_t no_links;
+	size_t i;
+
+	if (stats_shm == NULL) {
+		return ;
+	}
+
+	/*
+	 * Gather everything before entering write section to keep it short
+	 */
+	pg_stats = api->totem_get_stats();
+	cs_ipcs_get_global_stats(&ipcs_global_stats);
+	no_links = CS_STATS_SHM_MAX_KNET_LINKS;
+	if (totemknet_link_get_status_all(stats_shm_links, &no_links) != CS_OK) {
+		no_links = 0;
+	}
+
+	stats_shm->seq++;
+	__sync_synchronize();
+
+	stats_shm->update_time = qb_util_nano_from_epoch_get();
+	stats_shm_fill((uint64_t *)&stats_shm->pg, cs_pg_stats, NUM_PG_STATS, pg_stats);
+	stats_shm_fill((uint64_t *)&stats_shm->srp, cs_srp_stats, NUM_SRP_STATS, pg_stats->srp);
+	stats_shm_fill((uint64_t *)&stats_shm->ipcs, cs_ipcs_global_stats, NUM_IPCSG_STATS, &ipcs_global_stats);
+
+	for (i = 0; i < no_links; i++) {
+		stats_shm->knet_links[i].nodeid = stats_shm_links[i].nodeid;
+		stats_shm->knet_links[i].link_no = stats_shm_links[i].link_no;
+		stats_shm_fill(&stats_shm->knet_links[i].enabled, cs_knet_stats, NUM_KNET_STATS,
+		    &stats_shm_links[i].link_status);
+	}
+	stats_shm->no_knet_links = no_links;
+
+	__sync_synchronize();
+	stats_shm->seq++;
+}
+
+void stats_shm_fini(void)
+{
+	if (stats_shm == NULL) {
+		return ;
+	}
+
+	shm_unlink(CS_STATS_SHM_NAME);
+	munmap(stats_shm, stats_shm_size);
+	stats_shm = NULL;
+	free(stats_shm_links);
+	stats_shm_links = NULL;
+}
@@ -65,6 +65,10 @@ void *stats_map_track_get_user_data(icmap_track_t icmap_track);
 
 void stats_trigger_trackers(void);
 
+cs_error_t stats_shm_init(void);
+void stats_shm_update(void);
+void stats_shm_fini(void);
+
 
 void stats_ipcs_add_connection(int service_id, uint32_t pid, void *ptr);
 void stats_ipcs_del_connection(int service_id, uint32_t pid, void *ptr);
@@ -52,11 +52,14 @@
 #include <corosync/totem/totempg.h>
 #include <corosync/totem/totem.h>
 #include <corosync/logsys.h>
+#include <corosync/icmap.h>
 #include <qb/qbipc_common.h>
+#include <qb/qbutil.h>
 #include "schedwrk.h"
 #include "quorum.h"
 #include "sync.h"
 #include "main.h"
+#include "timeline.h"
 
 LOGSYS_DECLARE_SUBSYS ("SYNC");
 
@@ -87,6 +90,10 @@ struct service_entry {
 	void (*sync_activate) (void);
 	enum sync_process_state state;
 	char name[128];
+	int independent;
+	int processed;
+	uint64_t process_duration;
+	uint32_t process_calls;
 };
 
 struct processor_entry {
@@ -99,8 +106,14 @@ struct req_exec_service_build_message {
 	struct memb_ring_id ring_id __attribute__((aligned(8)));
 	int service_list_entries __attribute__((aligned(8)));
 	int service_list[128] __attribute__((aligned(8)));
+	/*
+	 * Sent only by nodes supporting pipelined sync. Older nodes send
+	 * message without this field.
+	 */
+	int service_independent[128] __attribute__((aligned(8)));
 };
 
+
 struct req_exec_barrier_message {
 	struct qb_ipc_request_header header __attribute__((aligned(8)));
 	struct memb_ring_id ring_id __attribute__((aligned(8)));
@@ -112,8 +125,33 @@ static struct memb_ring_id my_ring_id;
 
 static int my_processing_idx = 0;
 
+/*
+ * Services from my_processing_idx to my_processing_end (excluded) are
+ * processed together and share one barrier
+ */
+static int my_processing_end = 0;
+
+/*
+ * Set when all members support pipelined sync
+ */
+static int my_pipeline_enabled = 0;
+
+static uint64_t my_sync_start_time;
+
+static uint64_t my_group_start_time;
+
+static uint64_t my_barrier_start_time;
+
+static uint32_t my_barriers;
+
 static hdb_handle_t my_schedwrk_handle;
 
+/*
+ * Set when all unprocessed services returned CS_SYNC_PROCESS_WAIT, so
+ * schedwrk was stopped until one of them calls sync_process_resume
+ */
+static int my_process_waiting = 0;
+
 static struct processor_entry my_processor_list[PROCESSOR_COUNT_MAX];
 
 static unsigned int my_member_list[PROCESSOR_COUNT_MAX];
@@ -188,9 +226,42 @@ int sync_init (
 	return (0);
 }
 
+/*
+ * Durations are in microseconds
+ */
+static void sync_service_stats_store (const struct service_entry *service, uint64_t barrier_duration)
+{
+	char key_name[ICMAP_KEYNAME_MAXLEN];
+
+	snprintf (key_name, ICMAP_KEYNAME_MAXLEN, "runtime.sync.services.%d.name",
+		service->service_id);
+	icmap_set_string (key_name, service->name);
+
+	snprintf (key_name, ICMAP_KEYNAME_MAXLEN, "runtime.sync.services.%d.process_duration",
+		service->service_id);
+	icmap_set_uint64 (key_name, service->process_duration);
+
+	snprintf (key_name, ICMAP_KEYNAME_MAXLEN, "runtime.sync.services.%d.barrier_duration",
+		service->service_id);
+	icmap_set_uint64 (key_name, barrier_duration);
+
+	snprintf (key_name, ICMAP_KEYNAME_MAXLEN, "runtime.sync.services.%d.barrier",
+		service->service_id);
+	icmap_set_uint32 (key_name, my_barriers);
+}
+
+static void sync_stats_store (void)
+{
+	icmap_set_uint64 ("runtime.sync.last_duration",
+		(qb_util_nano_current_get () - my_sync_start_time) / QB_TIME_NS_IN_USEC);
+	icmap_set_uint32 ("runtime.sync.barriers", my_barriers);
+	icmap_set_uint8 ("runtime.sync.pipelined", my_pipeline_enabled);
+}
+
 static void sync_barrier_handler (unsigned int nodeid, const void *msg)
 {
 	const struct req_exec_barrier_message *req_exec_barrier_message = msg;
+	uint64_t barrier_duration;
 	int i;
 	int barrier_reached = 1;
 
@@ -211,16 +282,32 @@ static void sync_barrier_handler (unsigned int nodeid, const void *msg)
 		}
 	}
 	if (barrier_reached) {
-		log_printf (LOGSYS_LEVEL_DEBUG, "Committing synchronization for %s",
-			my_service_list[my_processing_idx].name);
-		my_service_list[my_processing_idx].state = ACTIVATE;
+		uint64_t activate_start;
+
+		barrier_duration = (qb_util_nano_current_get () - my_barrier_start_time) / QB_TIME_NS_IN_USEC;
+		my_barriers++;
+		timeline_record (TIMELINE_SYNC_BARRIER_REACHED, 0, my_barriers);
+
+		for (i = my_processing_idx; i < my_processing_end; i++) {
+			log_printf (LOGSYS_LEVEL_DEBUG, "Committing synchronization for %s",
+				my_service_list[i].name);
+			my_service_list[i].state = ACTIVATE;
+
+			activate_start = qb_util_nano_current_get ();
+			if (my_sync_callbacks_retrieve(my_service_list[i].service_id, NULL) != -1) {
+				my_service_list[i].sync_activate ();
+			}
+			timeline_record (TIMELINE_SYNC_ACTIVATE, my_service_list[i].service_id,
+				(qb_util_nano_current_get () - activate_start) / QB_TIME_NS_IN_USEC);
 
-		if (my_sync_callbacks_retrieve(my_service_list[my_processing_idx].service_id, NULL) != -1) {
-			my_service_list[my_processing_idx].sync_activate ();
+			sync_service_stats_store (&my_service_list[i], barrier_duration);
 		}
 
-		my_processing_idx += 1;
+		my_processing_idx = my_processing_end;
 		if (my_service_list_entries == my_processing_idx) {
+			timeline_record (TIMELINE_SYNC_COMPLETED, 0,
+				(qb_util_nano_current_get () - my_sync_start_time) / QB_TIME_NS_IN_USEC);
+			sync_stats_store ();
 			sync_synchronization_completed ();
 		} else {
 			sync_process_enter ();
@@ -249,19 +336,28 @@ static int service_entry_compare (const void *a, const void *b)
 	return (service_entry_a->service_id > service_entry_b->service_id);
 }
 
-static void sync_service_build_handler (unsigned int nodeid, const void *msg)
+static void sync_service_build_handler (unsigned int nodeid, const void *msg, unsigned int msg_len)
 {
 	const struct req_exec_service_build_message *req_exec_service_build_message = msg;
 	int i, j;
 	int barrier_reached = 1;
 	int found;
 	int qsort_trigger = 0;
+	int has_independent;
 
 	if (memcmp (&my_ring_id, &req_exec_service_build_message->ring_id,
 		sizeof (struct memb_ring_id)) != 0) {
 		log_printf (LOGSYS_LEVEL_DEBUG, "service build for old ring - discarding");
 		return;
 	}
+
+	has_independent = (msg_len >= sizeof (struct req_exec_service_build_message));
+	if (!has_independent && my_pipeline_enabled) {
+		log_printf (LOGSYS_LEVEL_DEBUG,
+			"Node %u doesn't support pipelined sync", nodeid);
+		my_pipeline_enabled = 0;
+	}
+
 	for (i = 0; i < req_exec_service_build_message->service_list_entries; i++) {
 
 		found = 0;
@@ -269,6 +365,13 @@ static void sync_service_build_handler (unsigned int nodeid, const void *msg)
 			if (req_exec_service_build_message->service_list[i] ==
 				my_service_list[j].service_id) {
 				found = 1;
+				/*
+				 * Service is independent only if all nodes agree
+				 */
+				if (!has_independent ||
+				    !req_exec_service_build_message->service_independent[i]) {
+					my_service_list[j].independent = 0;
+				}
 				break;
 			}
 		}
@@ -287,6 +390,9 @@ static void sync_service_build_handler (unsigned int nodeid, const void *msg)
 				dummy_sync_process;
 			my_service_list[my_service_list_entries].sync_activate =
 				dummy_sync_activate;
+			my_service_list[my_service_list_entries].independent =
+				(has_independent &&
+				 req_exec_service_build_message->service_independent[i]);
 			my_service_list_entries += 1;
 
 			qsort_trigger = 1;
@@ -325,7 +431,7 @@ static void sync_deliver_fn (
 			sync_barrier_handler (nodeid, msg);
 			break;
 		case MESSAGE_REQ_SYNC_SERVICE_BUILD:
-			sync_service_build_handler (nodeid, msg);
+			sync_service_build_handler (nodeid, msg, msg_len);
 			break;
 	}
 }
@@ -368,6 +474,8 @@ static void service_build_message_transmit (struct req_exec_service_build_messag
 static void sync_barrier_enter (void)
 {
 	my_state = SYNC_BARRIER;
+	my_barrier_start_time = qb_util_nano_current_get ();
+	timeline_record (TIMELINE_SYNC_BARRIER_ENTER, 0, my_barriers + 1);
 	barrier_message_transmit ();
 }
 
@@ -394,6 +502,7 @@ static void sync_process_call_init (void)
 	}
 
 	for (i = 0; i < my_service_list_entries; i++) {
+		timeline_record (TIMELINE_SYNC_INIT, my_service_list[i].service_id, 0);
 		if (my_sync_callbacks_retrieve(my_service_list[i].service_id, NULL) != -1) {
 			my_service_list[i].sync_init (my_trans_list,
 				my_trans_list_entries, my_member_list,
@@ -421,6 +530,29 @@ static void sync_process_enter (void)
 		my_processor_list[i].received = 0;
 	}
 
+	/*
+	 * Consecutive independent services are processed together. List of
+	 * services and their independence is same on all nodes, so all nodes
+	 * agree on the groups.
+	 */
+	my_processing_end = my_processing_idx + 1;
+	if (my_pipeline_enabled && my_service_list[my_processing_idx].independent) {
+		while (my_processing_end < my_service_list_entries &&
+		    my_service_list[my_processing_end].independent) {
+			my_processing_end++;
+		}
+	}
+
+	for (i = my_processing_idx; i < my_processing_end; i++) {
+		my_service_list[i].processed = 0;
+		my_service_list[i].process_duration = 0;
+		my_service_list[i].process_calls = 0;
+	}
+	my_group_start_time = qb_util_nano_current_get ();
+	my_process_waiting = 0;
+	timeline_record (TIMELINE_SYNC_PROCESS, my_service_list[my_processing_idx].service_id,
+		my_processing_end - my_processing_idx);
+
 	schedwrk_create (&my_schedwrk_handle,
 		schedwrk_processor,
 		NULL);
@@ -448,6 +580,9 @@ static void sync_servicelist_build_enter (
 	my_member_list_entries = member_list_entries;
 
 	my_processing_idx = 0;
+	my_processing_end = 0;
+	my_pipeline_enabled = 1;
+	my_barriers = 0;
 
 	memset(my_service_list, 0, sizeof (struct service_entry) * SERVICES_COUNT_MAX);
 	my_service_list_entries = 0;
@@ -468,12 +603,16 @@ static void sync_servicelist_build_enter (
 		my_service_list[my_service_list_entries].sync_process = sync_callbacks.sync_process;
 		my_service_list[my_service_list_entries].sync_abort = sync_callbacks.sync_abort;
 		my_service_list[my_service_list_entries].sync_activate = sync_callbacks.sync_activate;
+		my_service_list[my_service_list_entries].independent = sync_callbacks.independent;
 		my_service_list_entries += 1;
 	}
 
+	memset(&service_build, 0, sizeof (service_build));
 	for (i = 0; i < my_service_list_entries; i++) {
 		service_build.service_list[i] =
 			my_service_list[i].service_id;
+		service_build.service_independent[i] =
+			my_service_list[i].independent;
 	}
 	service_build.service_list_entries = my_service_list_entries;
 
@@ -486,22 +625,67 @@ static void sync_servicelist_build_enter (
 static int schedwrk_processor (const void *context)
 {
 	int res = 0;
+	int all_processed = 1;
+	int all_waiting = 1;
+	int i;
 
-	if (my_service_list[my_processing_idx].state == PROCESS) {
-		if (my_sync_callbacks_retrieve(my_service_list[my_processing_idx].service_id, NULL) != -1) {
-			res = my_service_list[my_processing_idx].sync_process ();
+	for (i = my_processing_idx; i < my_processing_end; i++) {
+		if (my_service_list[i].state != PROCESS || my_service_list[i].processed) {
+			continue;
+		}
+
+		if (my_sync_callbacks_retrieve(my_service_list[i].service_id, NULL) != -1) {
+			res = my_service_list[i].sync_process ();
+			my_service_list[i].process_calls++;
 		} else {
 			res = 0;
 		}
 		if (res == 0) {
-			sync_barrier_enter();
+			my_service_list[i].processed = 1;
+			my_service_list[i].process_duration =
+				(qb_util_nano_current_get () - my_group_start_time) / QB_TIME_NS_IN_USEC;
+			timeline_record (TIMELINE_SYNC_PROCESS_DONE, my_service_list[i].service_id,
+				my_service_list[i].process_calls);
 		} else {
-			return (-1);
+			all_processed = 0;
+			if (res != CS_SYNC_PROCESS_WAIT) {
+				all_waiting = 0;
+			}
 		}
 	}
+
+	if (!all_processed) {
+		if (all_waiting) {
+			/*
+			 * Nothing to do until message is delivered. Stop
+			 * schedwrk (returning 0 destroys it), service will
+			 * resume processing by calling sync_process_resume
+			 */
+			my_process_waiting = 1;
+			return (0);
+		}
+		return (-1);
+	}
+
+	sync_barrier_enter();
+
 	return (0);
 }
 
+void sync_process_resume (void)
+{
+	ENTER();
+
+	if (my_state != SYNC_PROCESS || !my_process_waiting) {
+		return ;
+	}
+
+	my_process_waiting = 0;
+	schedwrk_create (&my_schedwrk_handle,
+		schedwrk_processor,
+		NULL);
+}
+
 void sync_start (
         const unsigned int *member_list,
         size_t member_list_entries,
@@ -509,6 +693,8 @@ void sync_start (
 {
 	ENTER();
 	memcpy (&my_ring_id, ring_id, sizeof (struct memb_ring_id));
+	my_sync_start_time = qb_util_nano_current_get ();
+	timeline_record (TIMELINE_SYNC_START, 0, member_list_entries);
 
 	sync_servicelist_build_enter (member_list, member_list_entries,
 		ring_id);
@@ -527,11 +713,22 @@ void sync_save_transitional (
 
 void sync_abort (void)
 {
+	int i;
+
 	ENTER();
+	timeline_record (TIMELINE_SYNC_ABORT, 0, 0);
 	if (my_state == SYNC_PROCESS) {
-		schedwrk_destroy (my_schedwrk_handle);
-		if (my_sync_callbacks_retrieve(my_service_list[my_processing_idx].service_id, NULL) != -1) {
-			my_service_list[my_processing_idx].sync_abort ();
+		if (!my_process_waiting) {
+			schedwrk_destroy (my_schedwrk_handle);
+		}
+		my_process_waiting = 0;
+		for (i = my_processing_idx; i < my_processing_end; i++) {
+			if (my_service_list[i].processed) {
+				continue;
+			}
+			if (my_sync_callbacks_retrieve(my_service_list[i].service_id, NULL) != -1) {
+				my_service_list[i].sync_abort ();
+			}
 		}
 	}
 
@@ -46,6 +46,7 @@ struct sync_callbacks {
 	void (*sync_activate) (void);
 	void (*sync_abort) (void);
 	const char *name;
+	int independent;
 };
 
 extern int sync_init (
@@ -66,6 +67,8 @@ extern void sync_save_transitional (
 
 extern void sync_abort (void);
 
+extern void sync_process_resume (void);
+
 extern void sync_memb_list_determine (const struct memb_ring_id *ring_id);
 
 extern void sync_memb_list_abort (void);
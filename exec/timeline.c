@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * All rights reserved.
+ *
+ * This software licensed under BSD license, the text of which follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <config.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <qb/qbdefs.h>
+#include <qb/qbutil.h>
+
+#include "timeline.h"
+
+struct timeline_record {
+	uint64_t seq;
+	uint64_t time;
+	enum timeline_event event;
+	uint32_t arg;
+	uint32_t value;
+};
+
+static const char *timeline_event_names[] = {
+	[TIMELINE_NONE] = "none",
+	[TIMELINE_TOTEM_GATHER] = "totem_gather",
+	[TIMELINE_TOTEM_COMMIT] = "totem_commit",
+	[TIMELINE_TOTEM_RECOVERY] = "totem_recovery",
+	[TIMELINE_TOTEM_OPERATIONAL] = "totem_operational",
+	[TIMELINE_SYNC_START] = "sync_start",
+	[TIMELINE_SYNC_INIT] = "sync_init",
+	[TIMELINE_SYNC_PROCESS] = "sync_process",
+	[TIMELINE_SYNC_PROCESS_DONE] = "sync_process_done",
+	[TIMELINE_SYNC_BARRIER_ENTER] = "sync_barrier_enter",
+	[TIMELINE_SYNC_BARRIER_REACHED] = "sync_barrier_reached",
+	[TIMELINE_SYNC_ACTIVATE] = "sync_activate",
+	[TIMELINE_SYNC_COMPLETED] = "sync_completed",
+	[TIMELINE_SYNC_ABORT] = "sync_abort",
+};
+
+static struct timeline_record timeline[TIMELINE_ENTRIES];
+
+/*
+ * Number of recorded events. Next event goes to timeline_seq % TIMELINE_ENTRIES.
+ */
+static uint64_t timeline_seq;
+
+void timeline_record (enum timeline_event event, uint32_t arg, uint32_t value)
+{
+	struct timeline_record *rec;
+
+	rec = &timeline[timeline_seq % TIMELINE_ENTRIES];
+	timeline_seq++;
+
+	rec->seq = timeline_seq;
+	rec->time = qb_util_nano_current_get () / QB_TIME_NS_IN_USEC;
+	rec->event = event;
+	rec->arg = arg;
+	rec->value = value;
+}
+
+int timeline_get (unsigned int idx, struct timeline_entry *entry)
+{
+	const struct timeline_record *rec;
+	uint64_t first;
+
+	if (idx >= TIMELINE_ENTRIES) {
+		return (-1);
+	}
+
+	memset (entry, 0, sizeof (*entry));
+
+	first = (timeline_seq > TIMELINE_ENTRIES ? timeline_seq - TIMELINE_ENTRIES : 0);
+	if (first + idx >= timeline_seq) {
+		strcpy (entry->event, timeline_event_names[TIMELINE_NONE]);
+		return (0);
+	}
+
+	rec = &timeline[(first + idx) % TIMELINE_ENTRIES];
+	entry->seq = rec->seq;
+	entry->time = rec->time;
+	entry->arg = rec->arg;
+	entry->value = rec->value;
+	strncpy (entry->event, timeline_event_names[rec->event], TIMELINE_EVENT_NAME_LEN - 1);
+
+	return (0);
+}
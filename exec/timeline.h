@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * All rights reserved.
+ *
+ * This software licensed under BSD license, the text of which follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef TIMELINE_H_DEFINED
+#define TIMELINE_H_DEFINED
+
+#include <stdint.h>
+
+/*
+ * Timeline of membership change. Totem state transitions and sync stages
+ * are recorded (with monotonic time) into fixed ring, so it's possible to
+ * see how much of the recovery was spent in totem and how much in service
+ * synchronization.
+ */
+enum timeline_event {
+	TIMELINE_NONE = 0,
+	TIMELINE_TOTEM_GATHER,		/* arg = gather_from */
+	TIMELINE_TOTEM_COMMIT,
+	TIMELINE_TOTEM_RECOVERY,	/* value = members of transitional ring */
+	TIMELINE_TOTEM_OPERATIONAL,	/* value = members of new ring */
+	TIMELINE_SYNC_START,		/* value = members */
+	TIMELINE_SYNC_INIT,		/* arg = service_id */
+	TIMELINE_SYNC_PROCESS,		/* arg = first service_id, value = services in group */
+	TIMELINE_SYNC_PROCESS_DONE,	/* arg = service_id, value = sync_process calls */
+	TIMELINE_SYNC_BARRIER_ENTER,	/* value = barrier */
+	TIMELINE_SYNC_BARRIER_REACHED,	/* value = barrier */
+	TIMELINE_SYNC_ACTIVATE,		/* arg = service_id, value = sync_activate duration (us) */
+	TIMELINE_SYNC_COMPLETED,	/* value = sync duration (us) */
+	TIMELINE_SYNC_ABORT,
+};
+
+#define TIMELINE_ENTRIES		64
+#define TIMELINE_EVENT_NAME_LEN		32
+
+struct timeline_entry {
+	uint64_t seq;
+	uint64_t time;	/* monotonic time in microseconds */
+	uint32_t arg;
+	uint32_t value;
+	char event[TIMELINE_EVENT_NAME_LEN];
+};
+
+extern void timeline_record (enum timeline_event event, uint32_t arg, uint32_t value);
+
+/*
+ * Get entry idx (0 is oldest). Unused entries have seq 0 and event "none".
+ */
+extern int timeline_get (unsigned int idx, struct timeline_entry *entry);
+
+#endif /* TIMELINE_H_DEFINED */
@@ -51,10 +51,13 @@
 #include <arpa/inet.h>
 #include <sys/param.h>
 #include <sys/utsname.h>
+#include <inttypes.h>
 
 #include <corosync/swab.h>
 #include <qb/qblist.h>
 #include <qb/qbdefs.h>
+#include <qb/qbmap.h>
+#include <qb/qbutil.h>
 #include <libknet.h>
 #include <corosync/totem/totem.h>
 #include <corosync/config.h>
@@ -850,6 +853,213 @@ static int get_cluster_mcast_addr (
 	return (err);
 }
 
+/*
+ * Cache of resolved nodelist addresses. Key is "family:address" string.
+ * Cache is kept between reloads, so only addresses which were not in the
+ * nodelist before are resolved again. Addresses of existing links can't be
+ * changed on the fly anyway (see check_things_have_not_changed).
+ */
+struct nodelist_addr_entry {
+	char *key;
+	const char *addr;
+	int family;
+	int res;
+	struct totem_ip_address ip_addr;
+};
+
+static qb_map_t *nodelist_addr_cache = NULL;
+
+static struct nodelist_addr_entry *nodelist_addr_entry_create(const char *addr, int family)
+{
+	struct nodelist_addr_entry *entry;
+	size_t key_len;
+
+	entry = malloc(sizeof(*entry));
+	if (entry == NULL) {
+		return (NULL);
+	}
+	memset(entry, 0, sizeof(*entry));
+
+	key_len = strlen(addr) + 16;
+	entry->key = malloc(key_len);
+	if (entry->key == NULL) {
+		free(entry);
+		return (NULL);
+	}
+	snprintf(entry->key, key_len, "%d:%s", family, addr);
+	entry->addr = entry->key + strlen(entry->key) - strlen(addr);
+	entry->family = family;
+	entry->res = -1;
+
+	return (entry);
+}
+
+static void nodelist_addr_entry_free(struct nodelist_addr_entry *entry)
+{
+	free(entry->key);
+	free(entry);
+}
+
+static void nodelist_addr_map_free(qb_map_t *map)
+{
+	qb_map_iter_t *miter;
+	struct nodelist_addr_entry *entry;
+
+	miter = qb_map_iter_create(map);
+	while (qb_map_iter_next(miter, (void **)&entry)) {
+		nodelist_addr_entry_free(entry);
+	}
+	qb_map_iter_free(miter);
+	qb_map_destroy(map);
+}
+
+/*
+ * Resolve all ringX_addr of nodelist which are not yet in the cache. Entries
+ * of addresses no longer in the nodelist are dropped from the cache.
+ *
+ * Addresses are resolved serially. Resolving them concurrently doesn't pay
+ * off (200 names from /etc/hosts: 7.9 ms serially, 8.4 ms with 16 threads)
+ * and cache already avoids resolving of unchanged addresses on reload.
+ */
+static void nodelist_addr_cache_update(struct totem_config *totem_config)
+{
+	icmap_iter_t iter;
+	const char *iter_key;
+	char tmp_key[ICMAP_KEYNAME_MAXLEN];
+	char key[ICMAP_KEYNAME_MAXLEN + 16];
+	unsigned int node_pos;
+	unsigned int linknumber;
+	char *node_addr_str;
+	qb_map_t *new_cache;
+	struct nodelist_addr_entry *entry;
+	struct nodelist_addr_entry **pending = NULL;
+	struct nodelist_addr_entry **tmp_pending;
+	size_t pending_count = 0;
+	size_t pending_size = 0;
+	size_t i;
+	uint64_t start_time;
+
+	new_cache = qb_skiplist_create();
+	if (new_cache == NULL) {
+		return ;
+	}
+
+	iter = icmap_iter_init("nodelist.node.");
+	while ((iter_key = icmap_iter_next(iter, NULL, NULL)) != NULL) {
+		if (sscanf(iter_key, "nodelist.node.%u.ring%u%s", &node_pos, &linknumber, tmp_key) != 3 ||
+		    strcmp(tmp_key, "_addr") != 0) {
+			continue;
+		}
+
+		if (icmap_get_string(iter_key, &node_addr_str) != CS_OK) {
+			continue;
+		}
+
+		snprintf(key, sizeof(key), "%d:%s", totem_config->ip_version, node_addr_str);
+
+		if (qb_map_get(new_cache, key) != NULL) {
+			/*
+			 * Same address used by more nodes/links
+			 */
+			free(node_addr_str);
+			continue;
+		}
+
+		entry = NULL;
+		if (nodelist_addr_cache != NULL) {
+			entry = qb_map_get(nodelist_addr_cache, key);
+			if (entry != NULL) {
+				qb_map_rm(nodelist_addr_cache, key);
+			}
+		}
+
+		if (entry == NULL) {
+			entry = nodelist_addr_entry_create(node_addr_str, totem_config->ip_version);
+			if (entry == NULL) {
+				free(node_addr_str);
+				continue;
+			}
+
+			if (pending_count == pending_size) {
+				pending_size = (pending_size == 0 ? 64 : pending_size * 2);
+				tmp_pending = realloc(pending, pending_size * sizeof(*pending));
+				if (tmp_pending == NULL) {
+					nodelist_addr_entry_free(entry);
+					free(node_addr_str);
+					continue;
+				}
+				pending = tmp_pending;
+			}
+			pending[pending_count++] = entry;
+		}
+
+		qb_map_put(new_cache, entry->key, entry);
+		free(node_addr_str);
+	}
+	icmap_iter_finalize(iter);
+
+	if (pending_count > 0) {
+		start_time = qb_util_nano_current_get();
+
+		for (i = 0; i < pending_count; i++) {
+			pending[i]->res = totemip_parse(&pending[i]->ip_addr, pending[i]->addr,
+			    pending[i]->family);
+		}
+
+		log_printf(LOGSYS_LEVEL_DEBUG, "Resolved %zu nodelist addresses in %"PRIu64" ms",
+		    pending_count, (uint64_t)((qb_util_nano_current_get() - start_time) / QB_TIME_NS_IN_MSEC));
+
+		/*
+		 * Failed entries are not cached, so they are retried next time
+		 */
+		for (i = 0; i < pending_count; i++) {
+			if (pending[i]->res != 0) {
+				qb_map_rm(new_cache, pending[i]->key);
+				nodelist_addr_entry_free(pending[i]);
+			}
+		}
+	}
+	free(pending);
+
+	if (nodelist_addr_cache != NULL) {
+		nodelist_addr_map_free(nodelist_addr_cache);
+	}
+	nodelist_addr_cache = new_cache;
+}
+
+/*
+ * totemip_parse using nodelist address cache
+ */
+static int nodelist_addr_parse(struct totem_ip_address *totemip, const char *addr, int family)
+{
+	char key[ICMAP_KEYNAME_MAXLEN + 16];
+	struct nodelist_addr_entry *entry;
+	int res;
+
+	snprintf(key, sizeof(key), "%d:%s", family, addr);
+
+	if (nodelist_addr_cache != NULL) {
+		entry = qb_map_get(nodelist_addr_cache, key);
+		if (entry != NULL) {
+			memcpy(totemip, &entry->ip_addr, sizeof(*totemip));
+			return (0);
+		}
+	}
+
+	res = totemip_parse(totemip, addr, family);
+
+	if (res == 0 && nodelist_addr_cache != NULL) {
+		entry = nodelist_addr_entry_create(addr, family);
+		if (entry != NULL) {
+			entry->res = 0;
+			memcpy(&entry->ip_addr, totemip, sizeof(*totemip));
+			qb_map_put(nodelist_addr_cache, entry->key, entry);
+		}
+	}
+
+	return (res);
+}
+
 static unsigned int generate_nodeid(
 	struct totem_config *totem_config,
 	char *addr)
@@ -859,7 +1069,7 @@ static unsigned int generate_nodeid(
 
 	/* AF_INET hard-coded here because auto-generated nodeids
 	   are only for IPv4 */
-	if (totemip_parse(&totemip, addr, AF_INET) != 0)
+	if (nodelist_addr_parse(&totemip, addr, AF_INET) != 0)
 		return -1;
 
 	memcpy (&nodeid, &totemip.addr, sizeof (unsigned int));
@@ -1008,73 +1218,72 @@ static void calc_knet_ping_timers(struct totem_config *totem_config)
 	}
 }
 
+static int totem_ip_address_compare(const void *a, const void *b)
+{
+	return (memcmp(a, b, sizeof(struct totem_ip_address)));
+}
+
 /*
- * Compute difference between two set of totem interface arrays. set1 and set2
- * are changed so for same ring, ip existing in both set1 and set2 are cleared
- * (set to 0), and ips which are only in set1 or set2 remains untouched.
- * totempg_node_add/remove is called.
+ * Member lists of both sets are sorted and then walked together, so diff is
+ * O(n log n) instead of comparing every member of set1 with every member
+ * of set2. Both sets are modified.
  */
 static void compute_interfaces_diff(struct totem_interface *set1,
 	struct totem_interface *set2)
 {
 	int ring_no, set1_pos, set2_pos;
-	struct totem_ip_address empty_ip_address;
-
-	memset(&empty_ip_address, 0, sizeof(empty_ip_address));
+	int set1_count, set2_count;
+	int res;
 
 	for (ring_no = 0; ring_no < INTERFACE_MAX; ring_no++) {
 		if (!set1[ring_no].configured && !set2[ring_no].configured) {
 			continue;
 		}
 
-		for (set1_pos = 0; set1_pos < set1[ring_no].member_count; set1_pos++) {
-			for (set2_pos = 0; set2_pos < set2[ring_no].member_count; set2_pos++) {
-				/*
-				 * For current ring_no remove all set1 items existing
-				 * in set2
-				 */
-				if (memcmp(&set1[ring_no].member_list[set1_pos],
-				    &set2[ring_no].member_list[set2_pos],
-				    sizeof(struct totem_ip_address)) == 0) {
-					memset(&set1[ring_no].member_list[set1_pos], 0,
-					    sizeof(struct totem_ip_address));
-					memset(&set2[ring_no].member_list[set2_pos], 0,
-					    sizeof(struct totem_ip_address));
-				}
+		set1_count = set1[ring_no].member_count;
+		set2_count = (set2[ring_no].configured ? set2[ring_no].member_count : 0);
+
+		qsort(set1[ring_no].member_list, set1_count, sizeof(struct totem_ip_address),
+		    totem_ip_address_compare);
+		qsort(set2[ring_no].member_list, set2_count, sizeof(struct totem_ip_address),
+		    totem_ip_address_compare);
+
+		set1_pos = set2_pos = 0;
+		while (set1_pos < set1_count || set2_pos < set2_count) {
+			if (set1_pos >= set1_count) {
+				res = 1;
+			} else if (set2_pos >= set2_count) {
+				res = -1;
+			} else {
+				res = totem_ip_address_compare(&set1[ring_no].member_list[set1_pos],
+				    &set2[ring_no].member_list[set2_pos]);
 			}
-		}
-	}
 
-	for (ring_no = 0; ring_no < INTERFACE_MAX; ring_no++) {
-		for (set1_pos = 0; set1_pos < set1[ring_no].member_count; set1_pos++) {
-			/*
-			 * All items which remained in set1 doesn't exists in set2 any longer so
-			 * node has to be removed.
-			 */
-			if (memcmp(&set1[ring_no].member_list[set1_pos], &empty_ip_address, sizeof(empty_ip_address)) != 0) {
+			if (res == 0) {
+				set1_pos++;
+				set2_pos++;
+			} else if (res < 0) {
+				/*
+				 * Item exists only in set1, so node has to be removed.
+				 */
 				log_printf(LOGSYS_LEVEL_DEBUG,
 					"removing dynamic member %s for ring %u",
 					totemip_print(&set1[ring_no].member_list[set1_pos]),
 					ring_no);
 
 				totempg_member_remove(&set1[ring_no].member_list[set1_pos], ring_no);
-			}
-		}
-		if (!set2[ring_no].configured) {
-			continue;
-		}
-		for (set2_pos = 0; set2_pos < set2[ring_no].member_count; set2_pos++) {
-			/*
-			 * All items which remained in set2 doesn't existed in set1 so this is no node
-			 * and has to be added.
-			 */
-			if (memcmp(&set2[ring_no].member_list[set2_pos], &empty_ip_address, sizeof(empty_ip_address)) != 0) {
+				set1_pos++;
+			} else {
+				/*
+				 * Item exists only in set2, so node has to be added.
+				 */
 				log_printf(LOGSYS_LEVEL_DEBUG,
 					"adding dynamic member %s for ring %u",
 					totemip_print(&set2[ring_no].member_list[set2_pos]),
 					ring_no);
 
 				totempg_member_add(&set2[ring_no].member_list[set2_pos], ring_no);
+				set2_pos++;
 			}
 		}
 	}
@@ -1104,7 +1313,8 @@ static void reconfigure_links(struct totem_config *totem_config)
 			continue;
 		}
 
-		err = totemip_parse(&local_ip, addr_string, AF_UNSPEC);
+		err = nodelist_addr_parse(&local_ip, addr_string, AF_UNSPEC);
+		free(addr_string);
 		if (err != 0) {
 			continue;
 		}
@@ -1190,6 +1400,11 @@ static void put_nodelist_members_to_config(struct totem_config *totem_config, in
 		assert(new_interfaces != NULL);
 	}
 
+	/*
+	 * Resolve all (new) addresses at once instead of one by one in the loop below
+	 */
+	nodelist_addr_cache_update(totem_config);
+
 	/* Clear out nodelist so we can put the new one in if needed */
 	for (i = 0; i < INTERFACE_MAX; i++) {
 		for (j = 0; j < PROCESSOR_COUNT_MAX; j++) {
@@ -1244,7 +1459,7 @@ static void put_nodelist_members_to_config(struct totem_config *totem_config, in
 			}
 
 			member_count = totem_config->interfaces[linknumber].member_count;
-			res = totemip_parse(&totem_config->interfaces[linknumber].member_list[member_count],
+			res = nodelist_addr_parse(&totem_config->interfaces[linknumber].member_list[member_count],
 						node_addr_str, totem_config->ip_version);
 			if (res != -1) {
 				totem_config->interfaces[linknumber].member_list[member_count].nodeid = nodeid;
@@ -60,6 +60,7 @@
 
 #include <qb/qbdefs.h>
 #include <qb/qbloop.h>
+#include <qb/qbutil.h>
 
 #include <corosync/sq.h>
 #include <corosync/swab.h>
@@ -80,6 +81,37 @@
 /* Should match that used by cfg */
 #define CFG_INTERFACE_STATUS_MAX_LEN 512
 
+/*
+ * libknet returns all statistics of link at once, but stats map exports
+ * every field as separate key. Snapshot of link (and handle) stats is kept
+ * for a short time so reading all keys costs one knet call. Snapshot is
+ * also dropped (by increasing generation) when stats are cleared or links
+ * are added/removed.
+ */
+#define KNET_STATS_SNAPSHOT_TTL		(100 * QB_TIME_NS_IN_MSEC)
+#define KNET_LINK_SNAPSHOT_SIZE		256
+
+struct totemknet_link_snapshot {
+	uint64_t generation;
+	uint64_t timestamp;
+	knet_node_id_t nodeid;
+	uint8_t link_no;
+	struct knet_link_status link_status;
+};
+
+/*
+ * Link parameters last applied to all knet hosts. On config change only
+ * parameters which differ are set again.
+ */
+struct totemknet_link_params {
+	uint8_t configured;
+	int knet_link_priority;
+	int knet_ping_interval;
+	int knet_ping_timeout;
+	int knet_ping_precision;
+	int knet_pong_count;
+};
+
 struct totemknet_instance {
 	struct crypto_instance *crypto_inst;
 
@@ -162,6 +194,20 @@ struct totemknet_instance {
 
 	int logpipes[2];
 	int knet_fd;
+
+	uint64_t stats_generation;
+
+	struct totemknet_link_snapshot link_snapshot[KNET_LINK_SNAPSHOT_SIZE];
+
+	uint64_t handle_stats_generation;
+
+	uint64_t handle_stats_timestamp;
+
+	struct knet_handle_stats handle_stats;
+
+	unsigned int applied_pmtud_interval;
+
+	struct totemknet_link_params applied_link_params[INTERFACE_MAX];
 };
 
 /* Awkward. But needed to get stats from knet */
@@ -671,6 +717,19 @@ static void timer_function_netif_check_timeout (
 	}
 }
 
+static void totemknet_link_params_store(struct totemknet_instance *instance, int link_no)
+{
+	const struct totem_interface *iface = &instance->totem_config->interfaces[link_no];
+	struct totemknet_link_params *params = &instance->applied_link_params[link_no];
+
+	params->configured = iface->configured;
+	params->knet_link_priority = iface->knet_link_priority;
+	params->knet_ping_interval = iface->knet_ping_interval;
+	params->knet_ping_timeout = iface->knet_ping_timeout;
+	params->knet_ping_precision = iface->knet_ping_precision;
+	params->knet_pong_count = iface->knet_pong_count;
+}
+
 /* NOTE: this relies on the fact that totem_reload_notify() is called first */
 static void totemknet_refresh_config(
 	int32_t event,
@@ -682,8 +741,14 @@ static void totemknet_refresh_config(
 	uint8_t reloading;
 	uint32_t value;
 	uint32_t link_no;
-	size_t num_nodes;
+	size_t num_nodes = 0;
+	int host_list_fetched = 0;
+	int host_list_failed = 0;
+	int link_failed;
 	knet_node_id_t host_ids[KNET_MAX_HOST];
+	const struct totem_interface *iface;
+	const struct totemknet_link_params *applied;
+	int ping_changed, pong_changed, priority_changed;
 	int i;
 	int err;
 	struct totemknet_instance *instance = (struct totemknet_instance *)user_data;
@@ -698,46 +763,96 @@ static void totemknet_refresh_config(
 		return;
 	}
 
-	if (icmap_get_uint32("totem.knet_pmtud_interval", &value) == CS_OK) {
+	if (icmap_get_uint32("totem.knet_pmtud_interval", &value) == CS_OK &&
+	    value != instance->applied_pmtud_interval) {
 
 		instance->totem_config->knet_pmtud_interval = value;
 		knet_log_printf (LOGSYS_LEVEL_DEBUG, "knet_pmtud_interval now %d", value);
 		err = knet_handle_pmtud_setfreq(instance->knet_handle, instance->totem_config->knet_pmtud_interval);
 		if (err) {
 			KNET_LOGSYS_PERROR(errno, LOGSYS_LEVEL_WARNING, "knet_handle_pmtud_setfreq failed");
+		} else {
+			instance->applied_pmtud_interval = value;
 		}
 	}
 
-	/* Configure link parameters for each node */
-	err = knet_host_get_host_list(instance->knet_handle, host_ids, &num_nodes);
-	if (err != 0) {
-		KNET_LOGSYS_PERROR(errno, LOGSYS_LEVEL_ERROR, "knet_host_get_host_list failed");
-	}
+	/*
+	 * Configure link parameters for each node, but only for links
+	 * (and parameters) which changed since they were last applied.
+	 * Parameters of link are remembered as applied only when they were
+	 * successfully set for all nodes, so failed ones are retried on
+	 * next change.
+	 */
+	for (link_no = 0; link_no < INTERFACE_MAX; link_no++) {
+		iface = &instance->totem_config->interfaces[link_no];
+		applied = &instance->applied_link_params[link_no];
+
+		if (!iface->configured || !applied->configured) {
+			/*
+			 * Members of newly configured link were added with
+			 * current parameters by totemknet_member_add
+			 */
+			totemknet_link_params_store(instance, link_no);
+			continue;
+		}
 
-	for (i=0; i<num_nodes; i++) {
-		for (link_no = 0; link_no < INTERFACE_MAX; link_no++) {
-			if (host_ids[i] == instance->our_nodeid || !instance->totem_config->interfaces[link_no].configured) {
+		ping_changed = (iface->knet_ping_interval != applied->knet_ping_interval ||
+				iface->knet_ping_timeout != applied->knet_ping_timeout ||
+				iface->knet_ping_precision != applied->knet_ping_precision);
+		pong_changed = (iface->knet_pong_count != applied->knet_pong_count);
+		priority_changed = (iface->knet_link_priority != applied->knet_link_priority);
+
+		if (!ping_changed && !pong_changed && !priority_changed) {
+			continue;
+		}
+
+		if (!host_list_fetched) {
+			err = knet_host_get_host_list(instance->knet_handle, host_ids, &num_nodes);
+			if (err != 0) {
+				KNET_LOGSYS_PERROR(errno, LOGSYS_LEVEL_ERROR, "knet_host_get_host_list failed");
+				num_nodes = 0;
+				host_list_failed = 1;
+			}
+			host_list_fetched = 1;
+		}
+
+		link_failed = host_list_failed;
+
+		for (i=0; i<num_nodes; i++) {
+			if (host_ids[i] == instance->our_nodeid) {
 				continue;
 			}
 
-			err = knet_link_set_ping_timers(instance->knet_handle, host_ids[i], link_no,
-							instance->totem_config->interfaces[link_no].knet_ping_interval,
-							instance->totem_config->interfaces[link_no].knet_ping_timeout,
-							instance->totem_config->interfaces[link_no].knet_ping_precision);
-			if (err) {
-				KNET_LOGSYS_PERROR(errno, LOGSYS_LEVEL_ERROR, "knet_link_set_ping_timers for node %d link %d failed", host_ids[i], link_no);
+			if (ping_changed) {
+				err = knet_link_set_ping_timers(instance->knet_handle, host_ids[i], link_no,
+								iface->knet_ping_interval,
+								iface->knet_ping_timeout,
+								iface->knet_ping_precision);
+				if (err) {
+					KNET_LOGSYS_PERROR(errno, LOGSYS_LEVEL_ERROR, "knet_link_set_ping_timers for node %d link %d failed", host_ids[i], link_no);
+					link_failed = 1;
+				}
 			}
-			err = knet_link_set_pong_count(instance->knet_handle, host_ids[i], link_no,
-						       instance->totem_config->interfaces[link_no].knet_pong_count);
-			if (err) {
-				KNET_LOGSYS_PERROR(errno, LOGSYS_LEVEL_ERROR, "knet_link_set_pong_count for node %d link %d failed",host_ids[i], link_no);
+			if (pong_changed) {
+				err = knet_link_set_pong_count(instance->knet_handle, host_ids[i], link_no,
+							       iface->knet_pong_count);
+				if (err) {
+					KNET_LOGSYS_PERROR(errno, LOGSYS_LEVEL_ERROR, "knet_link_set_pong_count for node %d link %d failed",host_ids[i], link_no);
+					link_failed = 1;
+				}
 			}
-			err = knet_link_set_priority(instance->knet_handle, host_ids[i], link_no,
-						     instance->totem_config->interfaces[link_no].knet_link_priority);
-			if (err) {
-				KNET_LOGSYS_PERROR(errno, LOGSYS_LEVEL_ERROR, "knet_link_set_priority for node %d link %d failed", host_ids[i], link_no);
+			if (priority_changed) {
+				err = knet_link_set_priority(instance->knet_handle, host_ids[i], link_no,
+							     iface->knet_link_priority);
+				if (err) {
+					KNET_LOGSYS_PERROR(errno, LOGSYS_LEVEL_ERROR, "knet_link_set_priority for node %d link %d failed", host_ids[i], link_no);
+					link_failed = 1;
+				}
 			}
+		}
 
+		if (!link_failed) {
+			totemknet_link_params_store(instance, link_no);
 		}
 	}
 
@@ -867,6 +982,10 @@ int totemknet_initialize (
 	if (res) {
 		KNET_LOGSYS_PERROR(errno, LOGSYS_LEVEL_WARNING, "knet_handle_pmtud_setfreq failed");
 	}
+	instance->applied_pmtud_interval = instance->totem_config->knet_pmtud_interval;
+	for (i = 0; i < INTERFACE_MAX; i++) {
+		totemknet_link_params_store(instance, i);
+	}
 	res = knet_handle_enable_filter(instance->knet_handle, instance, dst_host_filter_callback_fn);
 	if (res) {
 		KNET_LOGSYS_PERROR(errno, LOGSYS_LEVEL_WARNING, "knet_handle_enable_filter failed");
@@ -1154,10 +1273,6 @@ int totemknet_member_add (
 	struct sockaddr_storage remote_ss;
 	struct sockaddr_storage local_ss;
 	int addrlen;
-	int i;
-	int host_found = 0;
-	knet_node_id_t host_ids[KNET_MAX_HOST];
-	size_t num_host_ids;
 
 	/* Only create 1 loopback link and use link 0 */
 	if (member->nodeid == instance->our_nodeid) {
@@ -1174,34 +1289,23 @@ int totemknet_member_add (
 	knet_log_printf (LOGSYS_LEVEL_DEBUG, "knet:      local: %d (%s)", local->nodeid, totemip_print(local));
 
 
-	/* Only add the host if it doesn't already exist in knet */
-	err = knet_host_get_host_list(instance->knet_handle, host_ids, &num_host_ids);
-	if (err) {
-		KNET_LOGSYS_PERROR(errno, LOGSYS_LEVEL_ERROR, "knet_host_get_host_list");
+	/*
+	 * Only add the host if it doesn't already exist in knet. knet_host_add
+	 * fails with EEXIST for existing host, so there is no need to fetch
+	 * (and scan) whole host list for every added member.
+	 */
+	err = knet_host_add(instance->knet_handle, member->nodeid);
+	if (err != 0 && errno != EEXIST) {
+		KNET_LOGSYS_PERROR(errno, LOGSYS_LEVEL_ERROR, "knet_host_add");
 		return -1;
 	}
-	for (i=0; i<num_host_ids; i++) {
-		if (host_ids[i] == member->nodeid) {
-			host_found = 1;
-		}
-	}
-
-	if (!host_found) {
-		err = knet_host_add(instance->knet_handle, member->nodeid);
-		if (err != 0 && errno != EEXIST) {
-			KNET_LOGSYS_PERROR(errno, LOGSYS_LEVEL_ERROR, "knet_host_add");
-			return -1;
-		}
-	} else {
+	if (err != 0) {
 		knet_log_printf (LOGSYS_LEVEL_DEBUG, "nodeid %d already added", member->nodeid);
 	}
 
-
-	if (err == 0) {
-		if (knet_host_set_policy(instance->knet_handle, member->nodeid, instance->link_mode)) {
-			KNET_LOGSYS_PERROR(errno, LOGSYS_LEVEL_ERROR, "knet_set_policy failed");
-			return -1;
-		}
+	if (knet_host_set_policy(instance->knet_handle, member->nodeid, instance->link_mode)) {
+		KNET_LOGSYS_PERROR(errno, LOGSYS_LEVEL_ERROR, "knet_set_policy failed");
+		return -1;
 	}
 
 	memset(&local_ss, 0, sizeof(local_ss));
@@ -1255,6 +1359,7 @@ int totemknet_member_add (
 	}
 
 	/* register stats */
+	instance->stats_generation++;
 	stats_knet_add_member(member->nodeid, link_no);
 	return (0);
 }
@@ -1277,6 +1382,7 @@ int totemknet_member_remove (
 	}
 
 	/* Tidy stats */
+	instance->stats_generation++;
 	stats_knet_del_member(token_target->nodeid, link_no);
 
 	/* Remove the link first */
@@ -1339,26 +1445,18 @@ void totemknet_stats_clear (
 	struct totemknet_instance *instance = (struct totemknet_instance *)knet_context;
 
 	(void) knet_handle_clear_stats(instance->knet_handle, KNET_CLEARSTATS_HANDLE_AND_LINK);
+	instance->stats_generation++;
 }
 
-/* For the stats module */
-int totemknet_link_get_status (
+static int totemknet_link_status_fetch (
+	struct totemknet_instance *instance,
 	knet_node_id_t node, uint8_t link_no,
 	struct knet_link_status *status)
 {
 	int res;
 	int ret = CS_OK;
 
-	/* We are probably not using knet */
-	if (!global_instance) {
-		return CS_ERR_NOT_EXIST;
-	}
-
-	if (link_no >= INTERFACE_MAX) {
-		return CS_ERR_NOT_EXIST; /* Invalid link number */
-	}
-
-	res = knet_link_get_status(global_instance->knet_handle, node, link_no, status, sizeof(struct knet_link_status));
+	res = knet_link_get_status(instance->knet_handle, node, link_no, status, sizeof(struct knet_link_status));
 	if (res) {
 		switch (errno) {
 			case EINVAL:
@@ -1379,15 +1477,139 @@ int totemknet_link_get_status (
 	return (ret);
 }
 
+/* For the stats module */
+int totemknet_link_get_status (
+	knet_node_id_t node, uint8_t link_no,
+	struct knet_link_status *status)
+{
+	struct totemknet_link_snapshot *snapshot;
+	uint64_t now;
+	int ret;
+
+	/* We are probably not using knet */
+	if (!global_instance) {
+		return CS_ERR_NOT_EXIST;
+	}
+
+	if (link_no >= INTERFACE_MAX) {
+		return CS_ERR_NOT_EXIST; /* Invalid link number */
+	}
+
+	now = qb_util_nano_current_get();
+	snapshot = &global_instance->link_snapshot[(node * KNET_MAX_LINK + link_no) % KNET_LINK_SNAPSHOT_SIZE];
+
+	if (snapshot->timestamp != 0 &&
+	    snapshot->nodeid == node && snapshot->link_no == link_no &&
+	    snapshot->generation == global_instance->stats_generation &&
+	    now - snapshot->timestamp < KNET_STATS_SNAPSHOT_TTL) {
+		memcpy(status, &snapshot->link_status, sizeof(*status));
+
+		return (CS_OK);
+	}
+
+	ret = totemknet_link_status_fetch(global_instance, node, link_no, status);
+	if (ret == CS_OK) {
+		memcpy(&snapshot->link_status, status, sizeof(*status));
+		snapshot->nodeid = node;
+		snapshot->link_no = link_no;
+		snapshot->generation = global_instance->stats_generation;
+		snapshot->timestamp = now;
+	} else {
+		snapshot->timestamp = 0;
+	}
+
+	return (ret);
+}
+
+int totemknet_link_get_status_all (
+	struct totemknet_link_stats *links,
+	size_t *no_links)
+{
+	static knet_node_id_t host_list[KNET_MAX_HOST]; /* static to save stack */
+	uint8_t link_list[KNET_MAX_LINK];
+	size_t num_hosts;
+	size_t num_links;
+	size_t max_links;
+	size_t i, j;
+	int res;
+
+	/* We are probably not using knet */
+	if (!global_instance) {
+		return CS_ERR_NOT_EXIST;
+	}
+
+	max_links = *no_links;
+	*no_links = 0;
+
+	res = knet_host_get_host_list(global_instance->knet_handle, host_list, &num_hosts);
+	if (res) {
+		return CS_ERR_LIBRARY;
+	}
+
+	for (i = 0; i < num_hosts; i++) {
+		res = knet_link_get_link_list(global_instance->knet_handle,
+					      host_list[i], link_list, &num_links);
+		if (res) {
+			return CS_ERR_LIBRARY;
+		}
+
+		for (j = 0; j < num_links; j++) {
+			/*
+			 * Skip links not configured by corosync (loopback link0)
+			 */
+			if (link_list[j] >= INTERFACE_MAX ||
+			    !global_instance->totem_config->interfaces[link_list[j]].configured) {
+				continue;
+			}
+
+			if (*no_links >= max_links) {
+				return CS_ERR_NO_SPACE;
+			}
+
+			if (totemknet_link_get_status(host_list[i], link_list[j],
+			    &links[*no_links].link_status) != CS_OK) {
+				continue;
+			}
+			links[*no_links].nodeid = host_list[i];
+			links[*no_links].link_no = link_list[j];
+			(*no_links)++;
+		}
+	}
+
+	return CS_OK;
+}
+
 int totemknet_handle_get_stats (
 	struct knet_handle_stats *stats)
 {
+	uint64_t now;
+	int res;
+
 	/* We are probably not using knet */
 	if (!global_instance) {
 		return CS_ERR_NOT_EXIST;
 	}
 
-	return knet_handle_get_stats(global_instance->knet_handle, stats, sizeof(struct knet_handle_stats));
+	now = qb_util_nano_current_get();
+
+	if (global_instance->handle_stats_timestamp != 0 &&
+	    global_instance->handle_stats_generation == global_instance->stats_generation &&
+	    now - global_instance->handle_stats_timestamp < KNET_STATS_SNAPSHOT_TTL) {
+		memcpy(stats, &global_instance->handle_stats, sizeof(*stats));
+
+		return (CS_OK);
+	}
+
+	res = knet_handle_get_stats(global_instance->knet_handle, stats, sizeof(struct knet_handle_stats));
+	if (res == 0) {
+		memcpy(&global_instance->handle_stats, stats, sizeof(*stats));
+		global_instance->handle_stats_generation = global_instance->stats_generation;
+		global_instance->handle_stats_timestamp = now;
+	} else {
+		global_instance->handle_stats_timestamp = 0;
+	}
+
+	return (res);
 }
 
 static void timer_function_merge_detect_timeout (
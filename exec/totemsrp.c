@@ -88,6 +88,7 @@
 #include "totemnet.h"
 
 #include "cs_queue.h"
+#include "timeline.h"
 
 #define LOCALHOST_IP				inet_addr("127.0.0.1")
 #define QUEUE_RTR_ITEMS_SIZE_MAX		16384 /* allow 16384 retransmit items */
@@ -766,15 +767,94 @@ static int pause_flush (struct totemsrp_instance *instance)
 	return (res);
 }
 
+static const uint32_t token_metric_time_hist_bounds[TOTEM_TOKEN_STATS_HIST_BUCKETS] =
+	TOTEM_TOKEN_STATS_HIST_BOUNDS;
+
+static const uint32_t token_metric_backlog_hist_bounds[TOTEM_TOKEN_STATS_HIST_BUCKETS] =
+	TOTEM_TOKEN_STATS_BACKLOG_HIST_BOUNDS;
+
+static uint32_t token_metric_percentile (
+	const totemsrp_token_metric_t *metric,
+	const uint32_t *hist_bounds,
+	unsigned int pct)
+{
+	uint64_t wanted;
+	uint64_t sum;
+	int i;
+
+	wanted = (metric->samples * pct + 99) / 100;
+	sum = 0;
+	for (i = 0; i < TOTEM_TOKEN_STATS_HIST_BUCKETS; i++) {
+		sum += metric->hist[i];
+		if (sum >= wanted) {
+			break;
+		}
+	}
+
+	if (i == TOTEM_TOKEN_STATS_HIST_BUCKETS || hist_bounds[i] > metric->max) {
+		return (metric->max);
+	}
+
+	return (hist_bounds[i]);
+}
+
+/*
+ * Add one sample to metric and return new average. hist_bounds are upper
+ * bounds of histogram buckets (TOTEM_TOKEN_STATS_HIST_BUCKETS items).
+ */
+static uint32_t token_metric_update (
+	totemsrp_token_metric_t *metric,
+	const uint32_t *hist_bounds,
+	uint32_t value)
+{
+	int i;
+
+	if (metric->samples == 0) {
+		metric->ewma = (uint64_t)value << TOTEM_TOKEN_STATS_EWMA_SHIFT;
+		metric->min = metric->max = value;
+	} else {
+		metric->ewma = metric->ewma - (metric->ewma >> TOTEM_TOKEN_STATS_EWMA_SHIFT) + value;
+		if (value < metric->min) {
+			metric->min = value;
+		}
+		if (value > metric->max) {
+			metric->max = value;
+		}
+	}
+	metric->samples++;
+	metric->sum += value;
+
+	for (i = 0; i < TOTEM_TOKEN_STATS_HIST_BUCKETS - 1; i++) {
+		if (value <= hist_bounds[i]) {
+			break;
+		}
+	}
+	metric->hist[i]++;
+
+	metric->p50 = token_metric_percentile (metric, hist_bounds, 50);
+	metric->p99 = token_metric_percentile (metric, hist_bounds, 99);
+
+	return (metric->ewma >> TOTEM_TOKEN_STATS_EWMA_SHIFT);
+}
+
+/*
+ * Records token times into ring (used for token warnings) and updates
+ * token metrics. Token rotation is measured when token is received,
+ * workload and backlog when it is sent.
+ */
 static int token_event_stats_collector (enum totem_callback_token_type type, const void *void_instance)
 {
 	struct totemsrp_instance *instance = (struct totemsrp_instance *)void_instance;
+	totemsrp_token_stats_t *token;
 	uint32_t time_now;
+	uint32_t prev_rx;
 	unsigned long long nano_secs = qb_util_nano_current_get ();
 
 	time_now = (nano_secs / QB_TIME_NS_IN_MSEC);
 
 	if (type == TOTEM_CALLBACK_TOKEN_RECEIVED) {
+		prev_rx = instance->stats.token[instance->stats.latest_token].rx;
+
 		/* incr latest token the index */
 		if (instance->stats.latest_token == (TOTEM_TOKEN_STATS_MAX - 1))
 			instance->stats.latest_token = 0;
@@ -795,8 +875,25 @@ static int token_event_stats_collector (enum totem_callback_token_type type, con
 
 		instance->stats.token[instance->stats.latest_token].rx = time_now;
 		instance->stats.token[instance->stats.latest_token].tx = 0; /* in case we drop the token */
+		instance->stats.token[instance->stats.latest_token].backlog_calc = 0;
+
+		if (prev_rx != 0 && time_now >= prev_rx) {
+			instance->stats.mtt_rx_token = token_metric_update (
+				&instance->stats.token_rotation, token_metric_time_hist_bounds,
+				time_now - prev_rx);
+		}
 	} else {
-		instance->stats.token[instance->stats.latest_token].tx = time_now;
+		token = &instance->stats.token[instance->stats.latest_token];
+		token->tx = time_now;
+
+		if (token->rx != 0 && time_now >= token->rx) {
+			instance->stats.avg_token_workload = token_metric_update (
+				&instance->stats.token_workload, token_metric_time_hist_bounds,
+				time_now - token->rx);
+			instance->stats.avg_backlog_calc = token_metric_update (
+				&instance->stats.token_backlog, token_metric_backlog_hist_bounds,
+				token->backlog_calc);
+		}
 	}
 	return 0;
 }
@@ -1953,6 +2050,12 @@ static void memb_state_operational_enter (struct totemsrp_instance *instance)
 	instance->last_released = 0;
 	instance->my_set_retrans_flg = 0;
 
+	/*
+	 * Recorded before configuration is delivered, because delivery
+	 * starts sync
+	 */
+	timeline_record (TIMELINE_TOTEM_OPERATIONAL, 0, instance->my_new_memb_entries);
+
 	/*
 	 * Deliver transitional configuration to application
 	 */
@@ -2188,6 +2291,7 @@ static void memb_state_gather_enter (
 
 	instance->memb_state = MEMB_STATE_GATHER;
 	instance->stats.gather_entered++;
+	timeline_record (TIMELINE_TOTEM_GATHER, gather_from, 0);
 
 	if (gather_from == TOTEMSRP_GSFROM_THE_CONSENSUS_TIMEOUT_EXPIRED) {
 		/*
@@ -2237,6 +2341,7 @@ static void memb_state_commit_enter (
 		"entering COMMIT state.");
 
 	instance->memb_state = MEMB_STATE_COMMIT;
+	timeline_record (TIMELINE_TOTEM_COMMIT, 0, 0);
 	reset_token_retransmit_timeout (instance); // REVIEWED
 	reset_token_timeout (instance); // REVIEWED
 
@@ -2442,6 +2547,7 @@ originated:
 
 	instance->memb_state = MEMB_STATE_RECOVERY;
 	instance->stats.recovery_entered++;
+	timeline_record (TIMELINE_TOTEM_RECOVERY, 0, instance->my_trans_memb_entries);
 	instance->stats.continuous_gather = 0;
 
 	return;
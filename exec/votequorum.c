@@ -57,44 +57,55 @@
 
 LOGSYS_DECLARE_SUBSYS ("VOTEQ");
 
+/*
+ * All state of votequorum is declared with VQ_STATE. vqsim builds
+ * votequorum with VOTEQUORUM_THREAD_STATE defined, so every thread
+ * runs its own independent votequorum instance.
+ */
+#ifdef VOTEQUORUM_THREAD_STATE
+#define VQ_STATE static __thread
+#else
+#define VQ_STATE static
+#endif
+
 /*
  * interface with corosync
  */
 
-static struct corosync_api_v1 *corosync_api;
+VQ_STATE struct corosync_api_v1 *corosync_api;
 
 /*
  * votequorum global config vars
  */
 
 
-static char qdevice_name[VOTEQUORUM_QDEVICE_MAX_NAME_LEN];
-static struct cluster_node *qdevice = NULL;
-static unsigned int qdevice_timeout = VOTEQUORUM_QDEVICE_DEFAULT_TIMEOUT;
-static unsigned int qdevice_sync_timeout = VOTEQUORUM_QDEVICE_DEFAULT_SYNC_TIMEOUT;
-static uint8_t qdevice_can_operate = 1;
-static void *qdevice_reg_conn = NULL;
-static uint8_t qdevice_master_wins = 0;
+VQ_STATE char qdevice_name[VOTEQUORUM_QDEVICE_MAX_NAME_LEN];
+VQ_STATE struct cluster_node *qdevice = NULL;
+VQ_STATE unsigned int qdevice_timeout = VOTEQUORUM_QDEVICE_DEFAULT_TIMEOUT;
+VQ_STATE unsigned int qdevice_sync_timeout = VOTEQUORUM_QDEVICE_DEFAULT_SYNC_TIMEOUT;
+VQ_STATE uint8_t qdevice_can_operate = 1;
+VQ_STATE void *qdevice_reg_conn = NULL;
+VQ_STATE uint8_t qdevice_master_wins = 0;
 
-static uint8_t two_node = 0;
+VQ_STATE uint8_t two_node = 0;
 
-static uint8_t wait_for_all = 0;
-static uint8_t wait_for_all_status = 0;
+VQ_STATE uint8_t wait_for_all = 0;
+VQ_STATE uint8_t wait_for_all_status = 0;
 
-static enum {ATB_NONE, ATB_LOWEST, ATB_HIGHEST, ATB_LIST} auto_tie_breaker = ATB_NONE, initial_auto_tie_breaker = ATB_NONE;
-static int lowest_node_id = -1;
-static int highest_node_id = -1;
+VQ_STATE enum {ATB_NONE, ATB_LOWEST, ATB_HIGHEST, ATB_LIST} auto_tie_breaker = ATB_NONE, initial_auto_tie_breaker = ATB_NONE;
+VQ_STATE int lowest_node_id = -1;
+VQ_STATE int highest_node_id = -1;
 
 #define DEFAULT_LMS_WIN   10000
-static uint8_t last_man_standing = 0;
-static uint32_t last_man_standing_window = DEFAULT_LMS_WIN;
+VQ_STATE uint8_t last_man_standing = 0;
+VQ_STATE uint32_t last_man_standing_window = DEFAULT_LMS_WIN;
 
-static uint8_t allow_downscale = 0;
-static uint32_t ev_barrier = 0;
+VQ_STATE uint8_t allow_downscale = 0;
+VQ_STATE uint32_t ev_barrier = 0;
 
-static uint8_t ev_tracking = 0;
-static uint32_t ev_tracking_barrier = 0;
-static int ev_tracking_fd = -1;
+VQ_STATE uint8_t ev_tracking = 0;
+VQ_STATE uint32_t ev_tracking_barrier = 0;
+VQ_STATE int ev_tracking_fd = -1;
 
 /*
  * votequorum_exec defines/structs/forward definitions
@@ -148,6 +159,8 @@ struct req_exec_quorum_qdevice_reconfigure {
 static void votequorum_exec_send_expectedvotes_notification(void);
 static int votequorum_exec_send_quorum_notification(void *conn, uint64_t context);
 static int votequorum_exec_send_nodelist_notification(void *conn, uint64_t context);
+static void votequorum_notification_schedule(int notification);
+static void votequorum_notifications_flush(void);
 
 #define VOTEQUORUM_RECONFIG_PARAM_EXPECTED_VOTES 1
 #define VOTEQUORUM_RECONFIG_PARAM_NODE_VOTES     2
@@ -193,28 +206,52 @@ struct cluster_node {
  * votequorum internal quorum status
  */
 
-static uint8_t quorum;
-static uint8_t cluster_is_quorate;
+VQ_STATE uint8_t quorum;
+VQ_STATE uint8_t cluster_is_quorate;
 
 /*
  * votequorum membership data
  */
 
-static struct cluster_node *us;
-static struct qb_list_head cluster_members_list;
-static unsigned int quorum_members[PROCESSOR_COUNT_MAX];
-static unsigned int previous_quorum_members[PROCESSOR_COUNT_MAX];
-static unsigned int atb_nodelist[PROCESSOR_COUNT_MAX];
-static int quorum_members_entries = 0;
-static int previous_quorum_members_entries = 0;
-static int atb_nodelist_entries = 0;
-static struct memb_ring_id quorum_ringid;
+VQ_STATE struct cluster_node *us;
+VQ_STATE struct qb_list_head cluster_members_list;
+VQ_STATE unsigned int quorum_members[PROCESSOR_COUNT_MAX];
+VQ_STATE unsigned int previous_quorum_members[PROCESSOR_COUNT_MAX];
+VQ_STATE unsigned int atb_nodelist[PROCESSOR_COUNT_MAX];
+VQ_STATE int quorum_members_entries = 0;
+VQ_STATE int previous_quorum_members_entries = 0;
+VQ_STATE int atb_nodelist_entries = 0;
+VQ_STATE struct memb_ring_id quorum_ringid;
 
 /*
  * pre allocate all cluster_nodes + one for qdevice
  */
-static struct cluster_node cluster_nodes[PROCESSOR_COUNT_MAX+2];
-static int cluster_nodes_entries = 0;
+VQ_STATE struct cluster_node cluster_nodes[PROCESSOR_COUNT_MAX+2];
+VQ_STATE int cluster_nodes_entries = 0;
+
+/*
+ * nodeid -> cluster_node lookup table (open addressing, linear probing).
+ * qdevice is not stored in the table.
+ */
+#define NODE_HASH_BITS		10
+#define NODE_HASH_SIZE		(1 << NODE_HASH_BITS)
+
+#if NODE_HASH_SIZE < 2 * (PROCESSOR_COUNT_MAX + 2)
+#error NODE_HASH_SIZE is too small for PROCESSOR_COUNT_MAX
+#endif
+
+VQ_STATE struct cluster_node *cluster_nodes_hash[NODE_HASH_SIZE];
+
+/*
+ * Totals of nodes in NODESTATE_MEMBER state (without qdevice), maintained
+ * on every change of node state, votes or expected_votes. Highest
+ * expected_votes can't be decreased incrementally so it's recomputed
+ * lazily when node with highest value changes or leaves.
+ */
+VQ_STATE unsigned int members_total_votes = 0;
+VQ_STATE unsigned int members_count = 0;
+VQ_STATE unsigned int members_highest_expected = 0;
+VQ_STATE int members_highest_expected_dirty = 0;
 
 /*
  * votequorum tracking
@@ -227,24 +264,46 @@ struct quorum_pd {
 	void *conn;
 };
 
-static struct qb_list_head trackers_list;
+VQ_STATE struct qb_list_head trackers_list;
+
+/*
+ * Notifications for trackers are not sent right away, but coalesced
+ * and sent at the end of current delivery batch (or sync activation),
+ * and only when content differs from last sent notification.
+ */
+#define VOTEQUORUM_NOTIFY_NODELIST	1
+#define VOTEQUORUM_NOTIFY_EXPECTEDVOTES	2
+#define VOTEQUORUM_NOTIFY_QUORUM	4
+
+VQ_STATE int notifications_pending = 0;
+VQ_STATE corosync_timer_handle_t notification_timer;
+VQ_STATE int notification_timer_set = 0;
+
+VQ_STATE char last_quorum_notification[sizeof(struct res_lib_votequorum_quorum_notification) +
+	sizeof(struct votequorum_node) * (PROCESSOR_COUNT_MAX + 2)];
+VQ_STATE int last_quorum_notification_size = 0;
+VQ_STATE char last_nodelist_notification[sizeof(struct res_lib_votequorum_nodelist_notification) +
+	sizeof(uint32_t) * PROCESSOR_COUNT_MAX];
+VQ_STATE int last_nodelist_notification_size = 0;
+VQ_STATE uint32_t last_expectedvotes_notification = 0;
+VQ_STATE int last_expectedvotes_notification_sent = 0;
 
 /*
  * votequorum timers
  */
 
-static corosync_timer_handle_t qdevice_timer;
-static int qdevice_timer_set = 0;
-static corosync_timer_handle_t last_man_standing_timer;
-static int last_man_standing_timer_set = 0;
-static int sync_nodeinfo_sent = 0;
-static int sync_wait_for_poll_or_timeout = 0;
+VQ_STATE corosync_timer_handle_t qdevice_timer;
+VQ_STATE int qdevice_timer_set = 0;
+VQ_STATE corosync_timer_handle_t last_man_standing_timer;
+VQ_STATE int last_man_standing_timer_set = 0;
+VQ_STATE int sync_nodeinfo_sent = 0;
+VQ_STATE int sync_wait_for_poll_or_timeout = 0;
 
 /*
  * Service Interfaces required by service_message_handler struct
  */
 
-static int sync_in_progress = 0;
+VQ_STATE int sync_in_progress = 0;
 
 static void votequorum_sync_init (
 	const unsigned int *trans_list,
@@ -257,7 +316,7 @@ static int votequorum_sync_process (void);
 static void votequorum_sync_activate (void);
 static void votequorum_sync_abort (void);
 
-static quorum_set_quorate_fn_t quorum_callback;
+VQ_STATE quorum_set_quorate_fn_t quorum_callback;
 
 /*
  * votequorum_exec handler and definitions
@@ -409,7 +468,8 @@ static struct corosync_service_engine votequorum_service_engine = {
 	.sync_init			= votequorum_sync_init,
 	.sync_process			= votequorum_sync_process,
 	.sync_activate			= votequorum_sync_activate,
-	.sync_abort			= votequorum_sync_abort
+	.sync_abort			= votequorum_sync_abort,
+	.sync_dependency		= CS_SYNC_INDEPENDENT
 };
 
 struct corosync_service_engine *votequorum_get_service_engine_ver0 (void)
@@ -431,6 +491,136 @@ static struct default_service votequorum_service[] = {
 
 #define max(a,b) (((a) > (b)) ? (a) : (b))
 
+static unsigned int node_hash(unsigned int nodeid)
+{
+	return ((nodeid * 2654435761U) >> (32 - NODE_HASH_BITS));
+}
+
+static void node_hash_add(struct cluster_node *node)
+{
+	unsigned int i;
+
+	for (i = node_hash(node->node_id);
+	     cluster_nodes_hash[i] != NULL;
+	     i = (i + 1) & (NODE_HASH_SIZE - 1));
+
+	cluster_nodes_hash[i] = node;
+}
+
+static struct cluster_node *node_hash_find(unsigned int nodeid)
+{
+	unsigned int i;
+
+	for (i = node_hash(nodeid);
+	     cluster_nodes_hash[i] != NULL;
+	     i = (i + 1) & (NODE_HASH_SIZE - 1)) {
+		if ((unsigned int)cluster_nodes_hash[i]->node_id == nodeid) {
+			return cluster_nodes_hash[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void node_hash_del(struct cluster_node *node)
+{
+	unsigned int i, j, k;
+
+	for (i = node_hash(node->node_id);
+	     cluster_nodes_hash[i] != node;
+	     i = (i + 1) & (NODE_HASH_SIZE - 1)) {
+		if (cluster_nodes_hash[i] == NULL) {
+			return ;
+		}
+	}
+
+	cluster_nodes_hash[i] = NULL;
+
+	/*
+	 * Move following entries of the chain back, so lookup doesn't stop on the hole
+	 */
+	for (j = (i + 1) & (NODE_HASH_SIZE - 1);
+	     cluster_nodes_hash[j] != NULL;
+	     j = (j + 1) & (NODE_HASH_SIZE - 1)) {
+		k = node_hash(cluster_nodes_hash[j]->node_id);
+		if ((j > i && (k <= i || k > j)) ||
+		    (j < i && (k <= i && k > j))) {
+			cluster_nodes_hash[i] = cluster_nodes_hash[j];
+			cluster_nodes_hash[j] = NULL;
+			i = j;
+		}
+	}
+}
+
+/*
+ * Add (or remove) node to (from) members totals
+ */
+static void node_account(const struct cluster_node *node, int add)
+{
+	if (node->node_id == VOTEQUORUM_QDEVICE_NODEID ||
+	    node->state != NODESTATE_MEMBER) {
+		return ;
+	}
+
+	if (add) {
+		members_total_votes += node->votes;
+		members_count++;
+		if (node->expected_votes > members_highest_expected) {
+			members_highest_expected = node->expected_votes;
+		}
+	} else {
+		members_total_votes -= node->votes;
+		members_count--;
+		if (node->expected_votes == members_highest_expected) {
+			members_highest_expected_dirty = 1;
+		}
+	}
+}
+
+static unsigned int members_highest_expected_get(void)
+{
+	struct qb_list_head *tmp;
+	struct cluster_node *node;
+
+	if (members_highest_expected_dirty) {
+		members_highest_expected = 0;
+		qb_list_for_each(tmp, &cluster_members_list) {
+			node = qb_list_entry(tmp, struct cluster_node, list);
+			if (node->state == NODESTATE_MEMBER) {
+				members_highest_expected = max(members_highest_expected, node->expected_votes);
+			}
+		}
+		members_highest_expected_dirty = 0;
+	}
+
+	return members_highest_expected;
+}
+
+/*
+ * All changes of node state, votes and expected_votes must go thru these
+ * functions to keep members totals in sync
+ */
+static void node_set_state(struct cluster_node *node, nodestate_t state)
+{
+	node_account(node, 0);
+	node->state = state;
+	node_account(node, 1);
+}
+
+static void node_set_votes(struct cluster_node *node, uint32_t votes)
+{
+	node_account(node, 0);
+	node->votes = votes;
+	node_account(node, 1);
+}
+
+static void node_set_expected_votes(struct cluster_node *node, uint32_t expected_votes)
+{
+	node_account(node, 0);
+	node->expected_votes = expected_votes;
+	node_account(node, 1);
+}
+
 static void node_add_ordered(struct cluster_node *newnode)
 {
 	struct cluster_node *node = NULL;
@@ -445,11 +635,12 @@ static void node_add_ordered(struct cluster_node *newnode)
 		}
 	}
 
-	if (!node) {
-		qb_list_add(&newnode->list, &cluster_members_list);
-	} else {
-		qb_list_add_tail(&newnode->list, &node->list);
-	}
+	/*
+	 * Insert before first node with higher nodeid (or at the end of the
+	 * list, when tmp is the list head)
+	 */
+	qb_list_add_tail(&newnode->list, tmp);
+	node_hash_add(newnode);
 
 	LEAVE();
 }
@@ -478,6 +669,8 @@ static struct cluster_node *allocate_node(unsigned int nodeid)
 			log_printf(LOGSYS_LEVEL_CRIT, "Unable to find memory for node %u data!!", nodeid);
 			goto out;
 		}
+		node_account(cl, 0);
+		node_hash_del(cl);
 		qb_list_del(tmp);
 	}
 
@@ -496,7 +689,6 @@ out:
 static struct cluster_node *find_node_by_nodeid(unsigned int nodeid)
 {
 	struct cluster_node *node;
-	struct qb_list_head *tmp;
 
 	ENTER();
 
@@ -510,16 +702,10 @@ static struct cluster_node *find_node_by_nodeid(unsigned int nodeid)
 		return qdevice;
 	}
 
-	qb_list_for_each(tmp, &cluster_members_list) {
-		node = qb_list_entry(tmp, struct cluster_node, list);
-		if (node->node_id == nodeid) {
-			LEAVE();
-			return node;
-		}
-	}
+	node = node_hash_find(nodeid);
 
 	LEAVE();
-	return NULL;
+	return node;
 }
 
 static void get_lowest_node_id(void)
@@ -531,11 +717,17 @@ static void get_lowest_node_id(void)
 
 	lowest_node_id = us->node_id;
 
+	/*
+	 * cluster_members_list is sorted by nodeid
+	 */
 	qb_list_for_each(tmp, &cluster_members_list) {
 		node = qb_list_entry(tmp, struct cluster_node, list);
-		if ((node->state == NODESTATE_MEMBER) &&
-		    (node->node_id < lowest_node_id)) {
+		if (node->node_id >= lowest_node_id) {
+			break;
+		}
+		if (node->state == NODESTATE_MEMBER) {
 			lowest_node_id = node->node_id;
+			break;
 		}
 	}
 	log_printf(LOGSYS_LEVEL_DEBUG, "lowest node id: %d us: %d", lowest_node_id, us->node_id);
@@ -553,11 +745,17 @@ static void get_highest_node_id(void)
 
 	highest_node_id = us->node_id;
 
-	qb_list_for_each(tmp, &cluster_members_list) {
+	/*
+	 * cluster_members_list is sorted by nodeid
+	 */
+	for (tmp = cluster_members_list.prev; tmp != &cluster_members_list; tmp = tmp->prev) {
 		node = qb_list_entry(tmp, struct cluster_node, list);
-		if ((node->state == NODESTATE_MEMBER) &&
-		    (node->node_id > highest_node_id)) {
+		if (node->node_id <= highest_node_id) {
+			break;
+		}
+		if (node->state == NODESTATE_MEMBER) {
 			highest_node_id = node->node_id;
+			break;
 		}
 	}
 	log_printf(LOGSYS_LEVEL_DEBUG, "highest node id: %d us: %d", highest_node_id, us->node_id);
@@ -569,17 +767,13 @@ static void get_highest_node_id(void)
 static int check_low_node_id_partition(void)
 {
 	struct cluster_node *node = NULL;
-	struct qb_list_head *tmp;
 	int found = 0;
 
 	ENTER();
 
-	qb_list_for_each(tmp, &cluster_members_list) {
-		node = qb_list_entry(tmp, struct cluster_node, list);
-		if ((node->state == NODESTATE_MEMBER) &&
-		    (node->node_id == lowest_node_id)) {
-				found = 1;
-		}
+	node = find_node_by_nodeid(lowest_node_id);
+	if ((node) && (node->state == NODESTATE_MEMBER)) {
+		found = 1;
 	}
 
 	LEAVE();
@@ -589,17 +783,13 @@ static int check_low_node_id_partition(void)
 static int check_high_node_id_partition(void)
 {
 	struct cluster_node *node = NULL;
-	struct qb_list_head *tmp;
 	int found = 0;
 
 	ENTER();
 
-	qb_list_for_each(tmp, &cluster_members_list) {
-		node = qb_list_entry(tmp, struct cluster_node, list);
-		if ((node->state == NODESTATE_MEMBER) &&
-		    (node->node_id == highest_node_id)) {
-				found = 1;
-		}
+	node = find_node_by_nodeid(highest_node_id);
+	if ((node) && (node->state == NODESTATE_MEMBER)) {
+		found = 1;
 	}
 
 	LEAVE();
@@ -904,12 +1094,10 @@ static void update_ev_tracking_barrier(uint32_t ev_t_barrier)
 
 static int calculate_quorum(int allow_decrease, unsigned int max_expected, unsigned int *ret_total_votes)
 {
-	struct qb_list_head *nodelist;
-	struct cluster_node *node;
-	unsigned int total_votes = 0;
-	unsigned int highest_expected = 0;
+	unsigned int total_votes;
+	unsigned int highest_expected;
 	unsigned int newquorum, q1, q2;
-	unsigned int total_nodes = 0;
+	unsigned int total_nodes;
 
 	ENTER();
 
@@ -917,18 +1105,12 @@ static int calculate_quorum(int allow_decrease, unsigned int max_expected, unsig
 		max_expected = max(ev_barrier, max_expected);
 	}
 
-	qb_list_for_each(nodelist, &cluster_members_list) {
-		node = qb_list_entry(nodelist, struct cluster_node, list);
-
-		log_printf(LOGSYS_LEVEL_DEBUG, "node %u state=%d, votes=%u, expected=%u",
-			   node->node_id, node->state, node->votes, node->expected_votes);
+	total_votes = members_total_votes;
+	total_nodes = members_count;
+	highest_expected = members_highest_expected_get();
 
-		if (node->state == NODESTATE_MEMBER) {
-			highest_expected = max(highest_expected, node->expected_votes);
-			total_votes += node->votes;
-			total_nodes++;
-		}
-	}
+	log_printf(LOGSYS_LEVEL_DEBUG, "members=%u, votes=%u, highest expected=%u",
+		   total_nodes, total_votes, highest_expected);
 
 	if (us->flags & NODE_FLAGS_QDEVICE_CAST_VOTE) {
 		log_printf(LOGSYS_LEVEL_DEBUG, "node 0 state=1, votes=%u", qdevice->votes);
@@ -985,7 +1167,7 @@ static void update_node_expected_votes(int new_expected_votes)
 			node = qb_list_entry(nodelist, struct cluster_node, list);
 
 			if (node->state == NODESTATE_MEMBER) {
-				node->expected_votes = new_expected_votes;
+				node_set_expected_votes(node, new_expected_votes);
 			}
 		}
 	}
@@ -1066,7 +1248,7 @@ static void are_we_quorate(unsigned int total_votes)
 	    (sync_in_progress == 0)) {
 		quorum_callback(quorum_members, quorum_members_entries,
 				cluster_is_quorate, &quorum_ringid);
-		votequorum_exec_send_quorum_notification(NULL, 0L);
+		votequorum_notification_schedule(VOTEQUORUM_NOTIFY_QUORUM);
 	}
 
 	LEAVE();
@@ -1074,21 +1256,11 @@ static void are_we_quorate(unsigned int total_votes)
 
 static void get_total_votes(unsigned int *totalvotes, unsigned int *current_members)
 {
-	unsigned int total_votes = 0;
-	unsigned int cluster_members = 0;
-	struct qb_list_head *nodelist;
-	struct cluster_node *node;
+	unsigned int total_votes = members_total_votes;
+	unsigned int cluster_members = members_count;
 
 	ENTER();
 
-	qb_list_for_each(nodelist, &cluster_members_list) {
-		node = qb_list_entry(nodelist, struct cluster_node, list);
-		if (node->state == NODESTATE_MEMBER) {
-			cluster_members++;
-			total_votes += node->votes;
-		}
-	}
-
 	if (qdevice->votes) {
 		total_votes += qdevice->votes;
 		cluster_members++;
@@ -1121,8 +1293,8 @@ static void recalculate_quorum(int allow_decrease, int by_current_nodes)
 	 */
 	log_printf(LOGSYS_LEVEL_DEBUG, "total_votes=%d, expected_votes=%d", total_votes, us->expected_votes);
 	if (total_votes > us->expected_votes) {
-		us->expected_votes = total_votes;
-		votequorum_exec_send_expectedvotes_notification();
+		node_set_expected_votes(us, total_votes);
+		votequorum_notification_schedule(VOTEQUORUM_NOTIFY_EXPECTEDVOTES);
 	}
 
 	if ((ev_tracking) &&
@@ -1513,15 +1685,16 @@ static char *votequorum_readconfig(int runtime)
 	}
 
 	if (have_nodelist) {
-		us->votes = node_votes;
-		us->expected_votes = node_expected_votes;
+		node_set_votes(us, node_votes);
+		node_set_expected_votes(us, node_expected_votes);
 	} else {
-		us->votes = 1;
-		icmap_get_uint32("quorum.votes", &us->votes);
+		node_votes = 1;
+		icmap_get_uint32("quorum.votes", &node_votes);
+		node_set_votes(us, node_votes);
 	}
 
 	if (expected_votes) {
-		us->expected_votes = expected_votes;
+		node_set_expected_votes(us, expected_votes);
 	}
 
 	/*
@@ -1769,6 +1942,10 @@ static int votequorum_exec_send_quorum_notification(void *conn, uint64_t context
 	}
 
 	size = sizeof(struct res_lib_votequorum_quorum_notification) + sizeof(struct votequorum_node) * cluster_members;
+	/*
+	 * Padding is compared with last notification too
+	 */
+	memset(buf, 0, size);
 
 	res_lib_votequorum_notification = (struct res_lib_votequorum_quorum_notification *)&buf;
 	res_lib_votequorum_notification->quorate = cluster_is_quorate;
@@ -1797,6 +1974,15 @@ static int votequorum_exec_send_quorum_notification(void *conn, uint64_t context
 	} else {
 		struct quorum_pd *qpd;
 
+		if (size == last_quorum_notification_size &&
+		    memcmp(last_quorum_notification, buf, size) == 0) {
+			log_printf(LOGSYS_LEVEL_DEBUG, "Quorum callback not changed, not sending");
+			LEAVE();
+			return 0;
+		}
+		memcpy(last_quorum_notification, buf, size);
+		last_quorum_notification_size = size;
+
 		qb_list_for_each(tmp, &trackers_list) {
 			qpd = qb_list_entry(tmp, struct quorum_pd, list);
 			res_lib_votequorum_notification->context = qpd->tracking_context;
@@ -1822,6 +2008,10 @@ static int votequorum_exec_send_nodelist_notification(void *conn, uint64_t conte
 	log_printf(LOGSYS_LEVEL_DEBUG, "Sending nodelist callback. ring_id = %d/%lld", quorum_ringid.nodeid, quorum_ringid.seq);
 
 	size = sizeof(struct res_lib_votequorum_nodelist_notification) + sizeof(uint32_t) * quorum_members_entries;
+	/*
+	 * Padding is compared with last notification too
+	 */
+	memset(buf, 0, size);
 
 	res_lib_votequorum_notification = (struct res_lib_votequorum_nodelist_notification *)&buf;
 	res_lib_votequorum_notification->node_list_entries = quorum_members_entries;
@@ -1845,6 +2035,15 @@ static int votequorum_exec_send_nodelist_notification(void *conn, uint64_t conte
 	} else {
 		struct quorum_pd *qpd;
 
+		if (size == last_nodelist_notification_size &&
+		    memcmp(last_nodelist_notification, buf, size) == 0) {
+			log_printf(LOGSYS_LEVEL_DEBUG, "Nodelist callback not changed, not sending");
+			LEAVE();
+			return 0;
+		}
+		memcpy(last_nodelist_notification, buf, size);
+		last_nodelist_notification_size = size;
+
 		qb_list_for_each(tmp, &trackers_list) {
 			qpd = qb_list_entry(tmp, struct quorum_pd, list);
 			res_lib_votequorum_notification->context = qpd->tracking_context;
@@ -1865,6 +2064,14 @@ static void votequorum_exec_send_expectedvotes_notification(void)
 
 	ENTER();
 
+	if (last_expectedvotes_notification_sent &&
+	    last_expectedvotes_notification == us->expected_votes) {
+		LEAVE();
+		return ;
+	}
+	last_expectedvotes_notification = us->expected_votes;
+	last_expectedvotes_notification_sent = 1;
+
 	log_printf(LOGSYS_LEVEL_DEBUG, "Sending expected votes callback");
 
 	res_lib_votequorum_expectedvotes_notification.header.id = MESSAGE_RES_VOTEQUORUM_EXPECTEDVOTES_NOTIFICATION;
@@ -1882,6 +2089,63 @@ static void votequorum_exec_send_expectedvotes_notification(void)
 	LEAVE();
 }
 
+static void votequorum_notification_timer_fn(void *arg)
+{
+	ENTER();
+
+	notification_timer_set = 0;
+	votequorum_notifications_flush();
+
+	LEAVE();
+}
+
+/*
+ * Zero timer fires after all messages of current delivery batch are processed
+ */
+static void votequorum_notification_schedule(int notification)
+{
+	ENTER();
+
+	notifications_pending |= notification;
+
+	if (!notification_timer_set) {
+		if (corosync_api->timer_add_duration(0, NULL,
+		    votequorum_notification_timer_fn, &notification_timer) == 0) {
+			notification_timer_set = 1;
+		} else {
+			log_printf(LOGSYS_LEVEL_ERROR, "Unable to schedule notifications, sending now");
+			votequorum_notifications_flush();
+		}
+	}
+
+	LEAVE();
+}
+
+static void votequorum_notifications_flush(void)
+{
+	int pending = notifications_pending;
+
+	ENTER();
+
+	notifications_pending = 0;
+	if (notification_timer_set) {
+		corosync_api->timer_delete(notification_timer);
+		notification_timer_set = 0;
+	}
+
+	if (pending & VOTEQUORUM_NOTIFY_NODELIST) {
+		votequorum_exec_send_nodelist_notification(NULL, 0LL);
+	}
+	if (pending & VOTEQUORUM_NOTIFY_EXPECTEDVOTES) {
+		votequorum_exec_send_expectedvotes_notification();
+	}
+	if (pending & VOTEQUORUM_NOTIFY_QUORUM) {
+		votequorum_exec_send_quorum_notification(NULL, 0L);
+	}
+
+	LEAVE();
+}
+
 static void exec_votequorum_qdevice_reconfigure_endian_convert (void *message)
 {
 	ENTER();
@@ -2102,11 +2366,11 @@ static void message_handler_req_exec_votequorum_nodeinfo (
 
 	/* Update node state */
 	node->flags = req_exec_quorum_nodeinfo->flags;
-	node->votes = req_exec_quorum_nodeinfo->votes;
-	node->state = NODESTATE_MEMBER;
+	node_set_votes(node, req_exec_quorum_nodeinfo->votes);
+	node_set_state(node, NODESTATE_MEMBER);
 
 	if (node->flags & NODE_FLAGS_LEAVING) {
-		node->state = NODESTATE_LEAVING;
+		node_set_state(node, NODESTATE_LEAVING);
 		allow_downgrade = 1;
 		by_node = 1;
 	}
@@ -2114,13 +2378,13 @@ static void message_handler_req_exec_votequorum_nodeinfo (
 	if ((!cluster_is_quorate) &&
 	    (node->flags & NODE_FLAGS_QUORATE)) {
 		allow_downgrade = 1;
-		us->expected_votes = req_exec_quorum_nodeinfo->expected_votes;
+		node_set_expected_votes(us, req_exec_quorum_nodeinfo->expected_votes);
 	}
 
 	if (node->flags & NODE_FLAGS_QUORATE || (ev_tracking)) {
-		node->expected_votes = req_exec_quorum_nodeinfo->expected_votes;
+		node_set_expected_votes(node, req_exec_quorum_nodeinfo->expected_votes);
 	} else {
-		node->expected_votes = us->expected_votes;
+		node_set_expected_votes(node, us->expected_votes);
 	}
 
 	if ((last_man_standing) && (node->votes > 1)) {
@@ -2181,10 +2445,10 @@ static void message_handler_req_exec_votequorum_reconfigure (
 	{
 	case VOTEQUORUM_RECONFIG_PARAM_EXPECTED_VOTES:
 		update_node_expected_votes(req_exec_quorum_reconfigure->value);
-		votequorum_exec_send_expectedvotes_notification();
+		votequorum_notification_schedule(VOTEQUORUM_NOTIFY_EXPECTEDVOTES);
 		update_ev_barrier(req_exec_quorum_reconfigure->value);
 		if (ev_tracking) {
-		    us->expected_votes = max(us->expected_votes, ev_tracking_barrier);
+		    node_set_expected_votes(us, max(us->expected_votes, ev_tracking_barrier));
 		}
 		recalculate_quorum(1, 0);  /* Allow decrease */
 		break;
@@ -2195,7 +2459,7 @@ static void message_handler_req_exec_votequorum_reconfigure (
 			LEAVE();
 			return;
 		}
-		node->votes = req_exec_quorum_reconfigure->value;
+		node_set_votes(node, req_exec_quorum_reconfigure->value);
 		recalculate_quorum(1, 0);  /* Allow decrease */
 		break;
 
@@ -2261,6 +2525,16 @@ static char *votequorum_exec_init_fn (struct corosync_api_v1 *api)
 	qdevice = NULL;
 	us = NULL;
 	memset(cluster_nodes, 0, sizeof(cluster_nodes));
+	memset(cluster_nodes_hash, 0, sizeof(cluster_nodes_hash));
+	notifications_pending = 0;
+	notification_timer_set = 0;
+	last_quorum_notification_size = 0;
+	last_nodelist_notification_size = 0;
+	last_expectedvotes_notification_sent = 0;
+	members_total_votes = 0;
+	members_count = 0;
+	members_highest_expected = 0;
+	members_highest_expected_dirty = 0;
 
 	/*
 	 * Allocate a cluster_node for qdevice
@@ -2284,8 +2558,8 @@ static char *votequorum_exec_init_fn (struct corosync_api_v1 *api)
 
 	icmap_set_uint32("runtime.votequorum.this_node_id", us->node_id);
 
-	us->state = NODESTATE_MEMBER;
-	us->votes = 1;
+	node_set_state(us, NODESTATE_MEMBER);
+	node_set_votes(us, 1);
 	us->flags |= NODE_FLAGS_FIRST;
 
 	error = votequorum_readconfig(VOTEQUORUM_READCONFIG_STARTUP);
@@ -2368,7 +2642,7 @@ static void votequorum_sync_init (
 			left_nodes = 1;
 			node = find_node_by_nodeid(quorum_members[i]);
 			if (node) {
-				node->state = NODESTATE_DEAD;
+				node_set_state(node, NODESTATE_DEAD);
 			}
 		}
 	}
@@ -2422,7 +2696,7 @@ static int votequorum_sync_process (void)
 			votequorum_exec_send_qdevice_reg(VOTEQUORUM_QDEVICE_OPERATION_REGISTER,
 							 qdevice_name);
 		}
-		votequorum_exec_send_nodelist_notification(NULL, 0LL);
+		votequorum_notification_schedule(VOTEQUORUM_NOTIFY_NODELIST);
 		sync_nodeinfo_sent = 1;
 	}
 
@@ -2442,7 +2716,8 @@ static void votequorum_sync_activate (void)
 	recalculate_quorum(0, 0);
 	quorum_callback(quorum_members, quorum_members_entries,
 			cluster_is_quorate, &quorum_ringid);
-	votequorum_exec_send_quorum_notification(NULL, 0L);
+	votequorum_notification_schedule(VOTEQUORUM_NOTIFY_QUORUM);
+	votequorum_notifications_flush();
 
 	sync_in_progress = 0;
 }
@@ -2712,13 +2987,13 @@ static void message_handler_req_lib_votequorum_setvotes (void *conn, const void
 	 * Check votes is valid
 	 */
 	saved_votes = node->votes;
-	node->votes = req_lib_votequorum_setvotes->votes;
+	node_set_votes(node, req_lib_votequorum_setvotes->votes);
 
 	newquorum = calculate_quorum(1, 0, &total_votes);
 
 	if (newquorum < total_votes / 2 ||
 	    newquorum > total_votes) {
-		node->votes = saved_votes;
+		node_set_votes(node, saved_votes);
 		error = CS_ERR_INVALID_PARAM;
 		goto error_exit;
 	}
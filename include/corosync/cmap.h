@@ -72,6 +72,11 @@ typedef uint64_t cmap_track_handle_t;
  */
 #define CMAP_KEYNAME_MINLEN            3
 
+/*
+ * Minimal size of buffer passed to cmap_iter_next_bulk
+ */
+#define CMAP_ITER_BULK_MIN_BUF_LEN     (32 * 1024)
+
 /*
  * Tracking values.
  */
@@ -86,6 +91,19 @@ typedef uint64_t cmap_track_handle_t;
  */
 #define CMAP_TRACK_PREFIX	8
 
+/**
+ * Changes are not notified one by one, but collected for short time (window)
+ * and then sent to the client at once. Every changed key is notified only once
+ * with the last value as new_value and value before the first change in the window
+ * as old_value. Used only in adding track.
+ */
+#define CMAP_TRACK_COALESCE	16
+
+/**
+ * Coalescing window (in ms) used when CMAP_TRACK_COALESCE is passed to cmap_track_add
+ */
+#define CMAP_TRACK_COALESCE_DEFAULT_WINDOW	100
+
 /**
  * Possible types of value. Binary is raw data without trailing zero with given length
  */
@@ -120,6 +138,18 @@ struct cmap_notify_value {
 	const void *data;
 };
 
+/**
+ * @brief Item returned by cmap_iter_next_bulk
+ *
+ * key_name and value point to the buffer passed to cmap_iter_next_bulk.
+ */
+struct cmap_bulk_item {
+	const char *key_name;
+	cmap_value_types_t type;
+	size_t value_len;
+	const void *value;
+};
+
 /**
  * Prototype for notify callback function. Even is one of CMAP_TRACK_* event, key_name is
  * changed key, new and old_value contains values or are zeroed (in other words, type is non
@@ -340,6 +370,32 @@ extern cs_error_t cmap_iter_next(
  */
 extern cs_error_t cmap_iter_finalize(cmap_handle_t handle, cmap_iter_handle_t iter_handle);
 
+/**
+ * @brief Return next items (key name, type and value) of iterator iter
+ * using single IPC round trip.
+ *
+ * Items are stored to buf and described by items array. On input, no_items is
+ * number of entries of items array, on output it's number of returned items.
+ * buf should be allocated by malloc (so values are properly aligned) and must be
+ * at least CMAP_ITER_BULK_MIN_BUF_LEN bytes long. Returned items are valid until
+ * buf is reused or freed.
+ *
+ * @param handle cmap handle
+ * @param iter_handle handle of iteration returned by cmap_iter_init
+ * @param buf buffer to store items
+ * @param buf_len length of buf
+ * @param items array to store description of items
+ * @param no_items number of entries of items array on input, number of returned items on output
+ * @return CS_NO_SECTION if there are no more items to iterate
+ */
+extern cs_error_t cmap_iter_next_bulk(
+		cmap_handle_t handle,
+		cmap_iter_handle_t iter_handle,
+		void *buf,
+		size_t buf_len,
+		struct cmap_bulk_item *items,
+		size_t *no_items);
+
 /**
  * @brief Add tracking function for given key_name.
  *
@@ -362,6 +418,29 @@ extern cs_error_t cmap_track_add(
         void *user_data,
         cmap_track_handle_t *cmap_track_handle);
 
+/**
+ * @brief Add coalescing tracking function for given key_name.
+ *
+ * Same as cmap_track_add with CMAP_TRACK_COALESCE, but coalescing window
+ * is set explicitly.
+ *
+ * @param handle cmap handle
+ * @param key_name name of key to track changes on
+ * @param track_type bitwise-or of CMAP_TRACK_* values
+ * @param coalesce_window time (in ms, 1 - 60000) for which changes are collected
+ * @param notify_fn function to be called on change of key
+ * @param user_data given pointer is unchanged passed to notify_fn
+ * @param cmap_track_handle handle used for removing of newly created track
+ */
+extern cs_error_t cmap_track_add_coalesced(
+	cmap_handle_t handle,
+	const char *key_name,
+	int32_t track_type,
+	uint32_t coalesce_window,
+	cmap_notify_fn_t notify_fn,
+	void *user_data,
+	cmap_track_handle_t *cmap_track_handle);
+
 /**
  * Delete track created previously by cmap_track_add
  * @param handle cmap handle
@@ -164,6 +164,25 @@ enum cs_lib_allow_inquorate {
 	CS_LIB_ALLOW_INQUORATE = 1
 };
 
+/**
+ * @brief The cs_sync_dependency enum
+ *
+ * Synchronization of independent service doesn't use state of other services
+ * during sync_process, so it can run concurrently with other independent
+ * services and share barrier with them.
+ */
+enum cs_sync_dependency {
+	CS_SYNC_DEPENDENT = 0, /* default */
+	CS_SYNC_INDEPENDENT = 1
+};
+
+/**
+ * Returned by sync_process when service can't continue until message from
+ * other node is delivered. Sync_process is then not called again until
+ * service calls sync_process_resume.
+ */
+#define CS_SYNC_PROCESS_WAIT 1
+
 #if !defined (COROSYNC_FLOW_CONTROL_STATE)
 /**
  * @brief The cs_flow_control_state enum
@@ -269,6 +288,8 @@ struct corosync_api_v1 {
 
 	void (*ipc_refcnt_dec) (void *conn);
 
+	void (*ipc_disconnect) (void *conn);
+
 	/*
 	 * Totem APIs
 	 */
@@ -379,6 +400,8 @@ struct corosync_api_v1 {
 	int (*sync_request) (
 		const char *service_name);
 
+	void (*sync_process_resume) (void);
+
 	/*
 	 * User plugin-callable functions for quorum
 	 */
@@ -521,6 +544,7 @@ struct corosync_service_engine {
 	int (*sync_process) (void);
 	void (*sync_activate) (void);
 	void (*sync_abort) (void);
+	enum cs_sync_dependency sync_dependency;
 };
 
 #endif /* COROAPI_H_DEFINED */
@@ -190,6 +190,7 @@ typedef struct {
 } cpg_model_data_t;
 
 #define CPG_MODEL_V1_DELIVER_INITIAL_TOTEM_CONF 0x01
+#define CPG_MODEL_V1_DELIVER_ZERO_COPY 0x02
 
 /**
  * @brief The cpg_model_v1_data_t struct
@@ -423,6 +424,22 @@ cs_error_t cpg_iteration_next(
 	cpg_iteration_handle_t handle,
 	struct cpg_iteration_description_t *description);
 
+/**
+ * @brief Get up to max_entries descriptions in as few IPC calls as possible.
+ *
+ * CS_ERR_NO_SECTIONS is returned when there are no more entries.
+ * @param handle
+ * @param descriptions Array with space for max_entries descriptions
+ * @param max_entries
+ * @param entries Number of descriptions stored
+ * @return
+ */
+cs_error_t cpg_iteration_next_bulk(
+	cpg_iteration_handle_t handle,
+	struct cpg_iteration_description_t *descriptions,
+	size_t max_entries,
+	size_t *entries);
+
 /**
  * @brief cpg_iteration_finalize
  * @param handle
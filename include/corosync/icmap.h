@@ -181,6 +181,11 @@ extern int icmap_key_value_eq(
 
 /**
  * @brief Store value with value_len length and type as key_name name in global icmap.
+ *
+ * If key already exists with same type and value length, small values are
+ * changed in place without memory allocation. Trackers still get both new
+ * and old value.
+ *
  * @param key_name
  * @param value
  * @param value_len
@@ -53,6 +53,8 @@ enum req_cmap_types {
 	MESSAGE_REQ_CMAP_TRACK_ADD = 7,
 	MESSAGE_REQ_CMAP_TRACK_DELETE = 8,
 	MESSAGE_REQ_CMAP_SET_CURRENT_MAP = 9,
+	MESSAGE_REQ_CMAP_ITER_NEXT_BULK = 10,
+	MESSAGE_REQ_CMAP_TRACK_ADD_COALESCED = 11,
 };
 
 /**
@@ -70,6 +72,8 @@ enum res_cmap_types {
 	MESSAGE_RES_CMAP_TRACK_DELETE = 8,
 	MESSAGE_RES_CMAP_NOTIFY_CALLBACK = 9,
 	MESSAGE_RES_CMAP_SET_CURRENT_MAP = 10,
+	MESSAGE_RES_CMAP_ITER_NEXT_BULK = 11,
+	MESSAGE_RES_CMAP_NOTIFY_BATCH_CALLBACK = 12,
 };
 
 enum {
@@ -179,6 +183,71 @@ struct res_lib_cmap_iter_next {
 	mar_uint8_t type __attribute__((aligned(8)));
 };
 
+/**
+ * @brief The req_lib_cmap_iter_next_bulk struct
+ */
+struct req_lib_cmap_iter_next_bulk {
+	struct qb_ipc_request_header header __attribute__((aligned(8)));
+	mar_uint64_t iter_handle __attribute__((aligned(8)));
+	mar_uint32_t max_items __attribute__((aligned(8)));
+	mar_uint32_t max_size __attribute__((aligned(8)));
+};
+
+/**
+ * @brief The res_lib_cmap_iter_next_bulk struct
+ *
+ * items contains no_items res_lib_cmap_iter_next_bulk_item entries
+ */
+struct res_lib_cmap_iter_next_bulk {
+	struct qb_ipc_response_header header __attribute__((aligned(8)));
+	mar_uint32_t no_items __attribute__((aligned(8)));
+	mar_uint8_t items[] __attribute__((aligned(8)));
+};
+
+/**
+ * @brief One item of res_lib_cmap_iter_next_bulk
+ *
+ * Header is followed by value (value_len bytes) and key name
+ * (key_name_len bytes including trailing zero). Whole item is padded
+ * to 8 bytes, so value is always aligned.
+ */
+struct res_lib_cmap_iter_next_bulk_item {
+	mar_uint32_t value_len;
+	mar_uint16_t key_name_len;
+	mar_uint8_t type;
+	mar_uint8_t reserved;
+	mar_uint8_t data[];
+};
+
+/**
+ * @brief Size of bulk item with given value and key name (including
+ * trailing zero) length
+ */
+#define CMAP_ITER_BULK_ITEM_SIZE(value_len, key_name_len) \
+	MAR_ALIGN_UP(sizeof(struct res_lib_cmap_iter_next_bulk_item) + (value_len) + (key_name_len), 8)
+
+/**
+ * @brief Longest value stored in any map (same as icmap limit)
+ */
+#define CMAP_ITER_BULK_MAX_VALUE_LEN	(16 * 1024)
+
+/**
+ * @brief Worst case size of single bulk item. Server stops packing
+ * items when less than this is left in the response.
+ */
+#define CMAP_ITER_BULK_MAX_ITEM_SIZE \
+	CMAP_ITER_BULK_ITEM_SIZE(CMAP_ITER_BULK_MAX_VALUE_LEN, CS_MAX_NAME_LENGTH)
+
+/**
+ * @brief Largest bulk response (same as IPC response size of libcmap).
+ * Bigger max_size requested by client is capped to this value.
+ */
+#ifdef HAVE_SMALL_MEMORY_FOOTPRINT
+#define CMAP_ITER_BULK_MAX_RES_SIZE	(1024 * 64)
+#else
+#define CMAP_ITER_BULK_MAX_RES_SIZE	(8192 * 128)
+#endif
+
 /**
  * @brief The req_lib_cmap_iter_finalize struct
  */
@@ -204,6 +273,26 @@ struct req_lib_cmap_track_add {
 	mar_uint64_t track_inst_handle __attribute__((aligned(8)));
 };
 
+/**
+ * @brief The req_lib_cmap_track_add_coalesced struct
+ *
+ * Same as req_lib_cmap_track_add, but changes are collected for window ms
+ * and then sent as one res_lib_cmap_notify_batch_callback.
+ * Reply is res_lib_cmap_track_add.
+ */
+struct req_lib_cmap_track_add_coalesced {
+	struct qb_ipc_request_header header __attribute__((aligned(8)));
+	mar_name_t key_name __attribute__((aligned(8)));
+	mar_int32_t track_type __attribute__((aligned(8)));
+	mar_uint64_t track_inst_handle __attribute__((aligned(8)));
+	mar_uint32_t window __attribute__((aligned(8)));
+};
+
+/**
+ * @brief Maximum coalescing window (in ms)
+ */
+#define CMAP_TRACK_COALESCE_MAX_WINDOW	60000
+
 /**
  * @brief The res_lib_cmap_track_add struct
  */
@@ -250,6 +339,48 @@ struct res_lib_cmap_notify_callback {
 	mar_uint8_t new_value[];
 };
 
+/**
+ * @brief The res_lib_cmap_notify_batch_callback struct
+ *
+ * items contains no_items res_lib_cmap_notify_batch_item entries
+ */
+struct res_lib_cmap_notify_batch_callback {
+	struct qb_ipc_response_header header __attribute__((aligned(8)));
+	mar_uint64_t track_inst_handle __attribute__((aligned(8)));
+	mar_uint32_t no_items __attribute__((aligned(8)));
+	mar_uint8_t items[] __attribute__((aligned(8)));
+};
+
+/**
+ * @brief One item of res_lib_cmap_notify_batch_callback
+ *
+ * Header is followed by new value, old value and key name (key_name_len
+ * bytes including trailing zero). Whole item is padded to 8 bytes.
+ */
+struct res_lib_cmap_notify_batch_item {
+	mar_int32_t event;
+	mar_uint8_t new_value_type;
+	mar_uint8_t old_value_type;
+	mar_uint16_t key_name_len;
+	mar_uint32_t new_value_len;
+	mar_uint32_t old_value_len;
+	mar_uint8_t data[];
+};
+
+/**
+ * @brief Size of batch item with given lengths of values and key name
+ * (including trailing zero)
+ */
+#define CMAP_NOTIFY_BATCH_ITEM_SIZE(new_value_len, old_value_len, key_name_len) \
+	MAR_ALIGN_UP(sizeof(struct res_lib_cmap_notify_batch_item) + \
+	    (new_value_len) + (old_value_len) + (key_name_len), 8)
+
+/**
+ * @brief Maximum size of batch notification. Must fit into smallest
+ * IPC dispatch buffer (64KiB).
+ */
+#define CMAP_NOTIFY_BATCH_MAX_SIZE	(60 * 1024)
+
 /**
  * @brief The req_lib_cmap_set_current_map struct
  * used by cmap_initialize_map()
@@ -42,6 +42,11 @@
 
 #define CPG_ZC_PATH_LEN				128
 
+/*
+ * Maximum number of entries returned by one MESSAGE_REQ_CPG_ITERATIONNEXT_BULK
+ */
+#define CPG_ITERATION_BULK_MAX_ENTRIES		4096
+
 /**
  * @brief The req_cpg_types enum
  */
@@ -59,6 +64,8 @@ enum req_cpg_types {
 	MESSAGE_REQ_CPG_ZC_FREE = 10,
 	MESSAGE_REQ_CPG_ZC_EXECUTE = 11,
 	MESSAGE_REQ_CPG_PARTIAL_MCAST = 12,
+	MESSAGE_REQ_CPG_ZC_RECV_INIT = 13,
+	MESSAGE_REQ_CPG_ITERATIONNEXT_BULK = 14,
 };
 
 /**
@@ -84,6 +91,9 @@ enum res_cpg_types {
 	MESSAGE_RES_CPG_ZC_EXECUTE = 16,
 	MESSAGE_RES_CPG_PARTIAL_DELIVER_CALLBACK = 17,
 	MESSAGE_RES_CPG_PARTIAL_SEND = 18,
+	MESSAGE_RES_CPG_ZC_RECV_INIT = 19,
+	MESSAGE_RES_CPG_ZC_DELIVER_CALLBACK = 20,
+	MESSAGE_RES_CPG_ITERATIONNEXT_BULK = 21,
 };
 
 /**
@@ -339,6 +349,23 @@ struct res_lib_cpg_deliver_callback {
 	mar_uint8_t message[] __attribute__((aligned(8)));
 };
 
+/**
+ * @brief The res_lib_cpg_zc_deliver_callback struct
+ *
+ * Message data are stored in zero copy receive arena at offset (relative
+ * to start of arena data). After callback returns, library sets arena
+ * tail to release.
+ */
+struct res_lib_cpg_zc_deliver_callback {
+	struct qb_ipc_response_header header __attribute__((aligned(8)));
+	mar_cpg_name_t group_name __attribute__((aligned(8)));
+	mar_uint32_t msglen __attribute__((aligned(8)));
+	mar_uint32_t nodeid __attribute__((aligned(8)));
+	mar_uint32_t pid __attribute__((aligned(8)));
+	mar_uint64_t offset __attribute__((aligned(8)));
+	mar_uint64_t release __attribute__((aligned(8)));
+};
+
 /**
  * @brief The res_lib_cpg_partial_deliver_callback struct
  */
@@ -451,6 +478,24 @@ struct res_lib_cpg_iterationnext {
 	mar_cpg_iteration_description_t description __attribute__((aligned(8)));
 };
 
+/**
+ * @brief The req_lib_cpg_iterationnext_bulk struct
+ */
+struct req_lib_cpg_iterationnext_bulk {
+	struct qb_ipc_request_header header __attribute__((aligned(8)));
+	hdb_handle_t iteration_handle __attribute__((aligned(8)));
+	mar_uint32_t max_entries __attribute__((aligned(8)));
+};
+
+/**
+ * @brief The res_lib_cpg_iterationnext_bulk struct
+ */
+struct res_lib_cpg_iterationnext_bulk {
+	struct qb_ipc_response_header header __attribute__((aligned(8)));
+	mar_uint32_t entries __attribute__((aligned(8)));
+	mar_cpg_iteration_description_t description[] __attribute__((aligned(8)));
+};
+
 /**
  * @brief The req_lib_cpg_iterationfinalize struct
  */
@@ -499,4 +544,37 @@ struct coroipcs_zc_header {
 	int map_size;
 	uint64_t server_address;
 };
+
+/**
+ * Zero copy receive arena. Messages bigger than CPG_ZC_RECV_MIN_MSGLEN
+ * are stored by corosync into arena data (ring of map_size -
+ * CPG_ZC_RECV_HEADER_SIZE bytes) and only descriptor is sent thru IPC.
+ * Head (total number of bytes ever written) is private to corosync,
+ * tail (total number of bytes released) is written by library.
+ */
+#define CPG_ZC_RECV_MIN_MSGLEN			1024
+#define CPG_ZC_RECV_HEADER_SIZE			64
+
+/**
+ * @brief coroipcs_zc_recv_header struct
+ */
+struct coroipcs_zc_recv_header {
+	uint64_t tail __attribute__((aligned(8)));
+};
+
+/**
+ * @brief The req_lib_cpg_zc_recv_init struct
+ */
+struct req_lib_cpg_zc_recv_init {
+	struct qb_ipc_request_header header __attribute__((aligned(8)));
+	mar_uint64_t map_size __attribute__((aligned(8)));
+	char path_to_file[CPG_ZC_PATH_LEN] __attribute__((aligned(8)));
+};
+
+/**
+ * @brief The res_lib_cpg_zc_recv_init struct
+ */
+struct res_lib_cpg_zc_recv_init {
+	struct qb_ipc_response_header header __attribute__((aligned(8)));
+};
 #endif /* IPC_CPG_H_DEFINED */
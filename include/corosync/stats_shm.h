@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * All rights reserved.
+ *
+ * This software licensed under BSD license, the text of which follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef COROSYNC_STATS_SHM_H_DEFINED
+#define COROSYNC_STATS_SHM_H_DEFINED
+
+#include <corosync/corotypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @addtogroup stats_shm_corosync
+ *
+ * Statistics published by corosync (when qb.stats_shm is enabled) in POSIX
+ * shared memory object CS_STATS_SHM_NAME. Page is updated by corosync
+ * together with other totem statistics (every 1.5 seconds) and protected by
+ * sequence lock, so readers never block corosync.
+ *
+ * Every statistic is stored as uint64_t, names match keys of the stats map.
+ *
+ * @{
+ */
+
+/**
+ * Name of shared memory object (for shm_open)
+ */
+#define CS_STATS_SHM_NAME		"/corosync-stats"
+
+#define CS_STATS_SHM_MAGIC		0x43535348
+#define CS_STATS_SHM_VERSION		1
+
+/**
+ * Maximum number of knet links stored in page
+ */
+#define CS_STATS_SHM_MAX_KNET_LINKS	1024
+
+/**
+ * stats.pg.*
+ */
+struct cs_stats_shm_pg {
+	uint64_t msg_queue_avail;
+	uint64_t msg_reserved;
+};
+
+/**
+ * stats.srp.*
+ */
+struct cs_stats_shm_srp {
+	uint64_t orf_token_tx;
+	uint64_t orf_token_rx;
+	uint64_t memb_merge_detect_tx;
+	uint64_t memb_merge_detect_rx;
+	uint64_t memb_join_tx;
+	uint64_t memb_join_rx;
+	uint64_t mcast_tx;
+	uint64_t mcast_retx;
+	uint64_t mcast_rx;
+	uint64_t memb_commit_token_tx;
+	uint64_t memb_commit_token_rx;
+	uint64_t token_hold_cancel_tx;
+	uint64_t token_hold_cancel_rx;
+	uint64_t operational_entered;
+	uint64_t operational_token_lost;
+	uint64_t gather_entered;
+	uint64_t gather_token_lost;
+	uint64_t commit_entered;
+	uint64_t commit_token_lost;
+	uint64_t recovery_entered;
+	uint64_t recovery_token_lost;
+	uint64_t consensus_timeouts;
+	uint64_t rx_msg_dropped;
+	uint64_t time_since_token_last_received;
+	uint64_t continuous_gather;
+	uint64_t continuous_sendmsg_failures;
+	uint64_t firewall_enabled_or_nic_failure;
+	uint64_t mtt_rx_token;
+	uint64_t avg_token_workload;
+	uint64_t avg_backlog_calc;
+};
+
+/**
+ * stats.ipcs.global.*
+ */
+struct cs_stats_shm_ipcs {
+	uint64_t active;
+	uint64_t closed;
+	uint64_t queued_bytes;
+	uint64_t outq_overflow;
+};
+
+/**
+ * stats.knet.nodeX.linkY.*
+ */
+struct cs_stats_shm_knet_link {
+	uint32_t nodeid;
+	uint32_t link_no;
+	uint64_t enabled;
+	uint64_t connected;
+	uint64_t mtu;
+	uint64_t tx_data_packets;
+	uint64_t rx_data_packets;
+	uint64_t tx_data_bytes;
+	uint64_t rx_data_bytes;
+	uint64_t tx_ping_packets;
+	uint64_t rx_ping_packets;
+	uint64_t tx_ping_bytes;
+	uint64_t rx_ping_bytes;
+	uint64_t tx_pong_packets;
+	uint64_t rx_pong_packets;
+	uint64_t tx_pong_bytes;
+	uint64_t rx_pong_bytes;
+	uint64_t tx_pmtu_packets;
+	uint64_t rx_pmtu_packets;
+	uint64_t tx_pmtu_bytes;
+	uint64_t rx_pmtu_bytes;
+	uint64_t tx_total_packets;
+	uint64_t rx_total_packets;
+	uint64_t tx_total_bytes;
+	uint64_t rx_total_bytes;
+	uint64_t tx_total_errors;
+	uint64_t rx_total_retries;
+	uint64_t tx_pmtu_errors;
+	uint64_t tx_pmtu_retries;
+	uint64_t tx_ping_errors;
+	uint64_t tx_ping_retries;
+	uint64_t tx_pong_errors;
+	uint64_t tx_pong_retries;
+	uint64_t tx_data_errors;
+	uint64_t tx_data_retries;
+	uint64_t latency_min;
+	uint64_t latency_max;
+	uint64_t latency_ave;
+	uint64_t latency_samples;
+	uint64_t down_count;
+	uint64_t up_count;
+};
+
+/**
+ * Layout of the page
+ */
+struct cs_stats_shm {
+	uint32_t magic;
+	uint32_t version;
+	/*
+	 * Size of whole page
+	 */
+	uint64_t size;
+	/*
+	 * Sequence number. Odd while page is being updated.
+	 */
+	volatile uint64_t seq;
+	/*
+	 * Time of last update (ns since epoch)
+	 */
+	uint64_t update_time;
+	struct cs_stats_shm_pg pg;
+	struct cs_stats_shm_srp srp;
+	struct cs_stats_shm_ipcs ipcs;
+	uint32_t max_knet_links;
+	uint32_t no_knet_links;
+	struct cs_stats_shm_knet_link knet_links[];
+};
+
+/**
+ * Size of page with given maximum number of knet links
+ */
+#define CS_STATS_SHM_SIZE(max_knet_links) \
+	(sizeof(struct cs_stats_shm) + (max_knet_links) * sizeof(struct cs_stats_shm_knet_link))
+
+/**
+ * Callback for cs_stats_shm_iter. key_name is name of the key in stats map.
+ */
+typedef void (*cs_stats_shm_iter_fn_t) (
+	const char *key_name,
+	uint64_t value,
+	void *user_data);
+
+/**
+ * @brief Map page read-only
+ *
+ * @param shm pointer to store mapped page
+ * @return CS_ERR_NOT_EXIST if corosync doesn't publish stats (or isn't running),
+ *         CS_ERR_LIBRARY if page has unsupported version.
+ */
+cs_error_t cs_stats_shm_map(const struct cs_stats_shm **shm);
+
+/**
+ * @brief Unmap page mapped by cs_stats_shm_map
+ */
+void cs_stats_shm_unmap(const struct cs_stats_shm *shm);
+
+/**
+ * @brief Make consistent copy of the page.
+ *
+ * @param shm mapped page
+ * @param copy buffer of at least shm->size bytes
+ * @return CS_ERR_TRY_AGAIN if consistent copy couldn't be made
+ */
+cs_error_t cs_stats_shm_read(const struct cs_stats_shm *shm, struct cs_stats_shm *copy);
+
+/**
+ * @brief Call fn for every statistic stored in copy (made by cs_stats_shm_read)
+ */
+void cs_stats_shm_iter(const struct cs_stats_shm *copy, cs_stats_shm_iter_fn_t fn, void *user_data);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COROSYNC_STATS_SHM_H_DEFINED */
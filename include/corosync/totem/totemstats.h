@@ -50,6 +50,30 @@ typedef struct {
 	int backlog_calc;
 } totemsrp_token_stats_t;
 
+/*
+ * Token metric maintained incrementally for every token. Average is
+ * exponentially weighted moving average (weight of new sample is
+ * 1/2^TOTEM_TOKEN_STATS_EWMA_SHIFT), percentiles are estimated from
+ * histogram (upper bound of bucket, at most max). Times (in ms) use
+ * TOTEM_TOKEN_STATS_HIST_BOUNDS, backlog (number of messages) uses
+ * TOTEM_TOKEN_STATS_BACKLOG_HIST_BOUNDS.
+ */
+#define TOTEM_TOKEN_STATS_EWMA_SHIFT 4
+#define TOTEM_TOKEN_STATS_HIST_BUCKETS 13
+#define TOTEM_TOKEN_STATS_HIST_BOUNDS { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, UINT32_MAX }
+#define TOTEM_TOKEN_STATS_BACKLOG_HIST_BOUNDS { 0, 1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, UINT32_MAX }
+
+typedef struct {
+	uint64_t samples;
+	uint64_t sum;
+	uint64_t ewma; /* average << TOTEM_TOKEN_STATS_EWMA_SHIFT */
+	uint32_t min;
+	uint32_t max;
+	uint32_t p50;
+	uint32_t p99;
+	uint64_t hist[TOTEM_TOKEN_STATS_HIST_BUCKETS];
+} totemsrp_token_metric_t;
+
 typedef struct {
 	totem_stats_header_t hdr;
 	uint64_t orf_token_tx;
@@ -84,6 +108,10 @@ typedef struct {
 	uint32_t avg_token_workload;
 	uint32_t avg_backlog_calc;
 
+	totemsrp_token_metric_t token_rotation;
+	totemsrp_token_metric_t token_workload;
+	totemsrp_token_metric_t token_backlog;
+
 	int earliest_token;
 	int latest_token;
 #define TOTEM_TOKEN_STATS_MAX 100
@@ -103,6 +131,20 @@ extern int totemknet_link_get_status (
 	knet_node_id_t node, uint8_t link,
 	struct knet_link_status *status);
 
+struct totemknet_link_stats {
+	knet_node_id_t nodeid;
+	uint8_t link_no;
+	struct knet_link_status link_status;
+};
+
+/*
+ * Get status of all links configured by corosync. On input no_links is
+ * number of entries of links array, on output number of returned links.
+ */
+extern int totemknet_link_get_status_all (
+	struct totemknet_link_stats *links,
+	size_t *no_links);
+
 int totemknet_handle_get_stats (
 	struct knet_handle_stats *stats);
 
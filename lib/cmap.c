@@ -237,6 +237,12 @@ cs_error_t cmap_dispatch (
 	struct qb_ipc_response_header *dispatch_data;
 	char dispatch_buf[IPC_DISPATCH_SIZE];
 	struct res_lib_cmap_notify_callback *res_lib_cmap_notify_callback;
+	struct res_lib_cmap_notify_batch_callback *res_lib_cmap_notify_batch_callback;
+	struct res_lib_cmap_notify_batch_item *batch_item;
+	size_t batch_offset;
+	size_t batch_item_size;
+	uint32_t i;
+	char *key_name;
 	struct cmap_track_inst *cmap_track_inst;
 	struct cmap_notify_value old_val;
 	struct cmap_notify_value new_val;
@@ -322,6 +328,59 @@ cs_error_t cmap_dispatch (
 
 			(void)hdb_handle_put(&cmap_track_handle_t_db, res_lib_cmap_notify_callback->track_inst_handle);
 			break;
+		case MESSAGE_RES_CMAP_NOTIFY_BATCH_CALLBACK:
+			res_lib_cmap_notify_batch_callback = (struct res_lib_cmap_notify_batch_callback *)dispatch_data;
+
+			error = hdb_error_to_cs(hdb_handle_get(&cmap_track_handle_t_db,
+					res_lib_cmap_notify_batch_callback->track_inst_handle,
+					(void *)&cmap_track_inst));
+			if (error == CS_ERR_BAD_HANDLE) {
+				/*
+				 * User deleted tracker -> ignore error
+				 */
+				 break;
+			}
+			if (error != CS_OK) {
+				goto error_put;
+			}
+
+			batch_offset = sizeof(*res_lib_cmap_notify_batch_callback);
+			for (i = 0; i < res_lib_cmap_notify_batch_callback->no_items; i++) {
+				batch_item = (struct res_lib_cmap_notify_batch_item *)(dispatch_buf + batch_offset);
+
+				if (batch_offset + sizeof(*batch_item) > dispatch_data->size) {
+					break;
+				}
+
+				batch_item_size = CMAP_NOTIFY_BATCH_ITEM_SIZE(batch_item->new_value_len,
+				    batch_item->old_value_len, batch_item->key_name_len);
+				if (batch_offset + batch_item_size > dispatch_data->size ||
+				    batch_item->key_name_len == 0) {
+					break;
+				}
+
+				new_val.type = batch_item->new_value_type;
+				old_val.type = batch_item->old_value_type;
+				new_val.len = batch_item->new_value_len;
+				old_val.len = batch_item->old_value_len;
+				new_val.data = batch_item->data;
+				old_val.data = batch_item->data + new_val.len;
+				key_name = (char *)batch_item->data + new_val.len + old_val.len;
+				key_name[batch_item->key_name_len - 1] = '\0';
+
+				cmap_track_inst->notify_fn(handle,
+						cmap_track_inst->track_handle,
+						batch_item->event,
+						key_name,
+						new_val,
+						old_val,
+						cmap_track_inst->user_data);
+
+				batch_offset += batch_item_size;
+			}
+
+			(void)hdb_handle_put(&cmap_track_handle_t_db, res_lib_cmap_notify_batch_callback->track_inst_handle);
+			break;
 		default:
 			error = CS_ERR_LIBRARY;
 			goto error_put;
@@ -935,6 +994,101 @@ cs_error_t cmap_iter_next(
 	return (error);
 }
 
+cs_error_t cmap_iter_next_bulk(
+		cmap_handle_t handle,
+		cmap_iter_handle_t iter_handle,
+		void *buf,
+		size_t buf_len,
+		struct cmap_bulk_item *items,
+		size_t *no_items)
+{
+	cs_error_t error;
+	struct iovec iov;
+	struct cmap_inst *cmap_inst;
+	struct req_lib_cmap_iter_next_bulk req_lib_cmap_iter_next_bulk;
+	struct res_lib_cmap_iter_next_bulk *res_lib_cmap_iter_next_bulk;
+	struct res_lib_cmap_iter_next_bulk_item *item;
+	size_t offset;
+	size_t item_size;
+	uint32_t i;
+
+	if (buf == NULL || items == NULL || no_items == NULL || *no_items == 0 ||
+	    buf_len < CMAP_ITER_BULK_MIN_BUF_LEN) {
+		return (CS_ERR_INVALID_PARAM);
+	}
+
+	if (buf_len > IPC_RESPONSE_SIZE) {
+		buf_len = IPC_RESPONSE_SIZE;
+	}
+
+	error = hdb_error_to_cs(hdb_handle_get (&cmap_handle_t_db, handle, (void *)&cmap_inst));
+	if (error != CS_OK) {
+		return (error);
+	}
+
+	memset(&req_lib_cmap_iter_next_bulk, 0, sizeof(req_lib_cmap_iter_next_bulk));
+	req_lib_cmap_iter_next_bulk.header.size = sizeof(req_lib_cmap_iter_next_bulk);
+	req_lib_cmap_iter_next_bulk.header.id = MESSAGE_REQ_CMAP_ITER_NEXT_BULK;
+	req_lib_cmap_iter_next_bulk.iter_handle = iter_handle;
+	req_lib_cmap_iter_next_bulk.max_items = (*no_items > UINT32_MAX ? UINT32_MAX : *no_items);
+	req_lib_cmap_iter_next_bulk.max_size = buf_len;
+
+	iov.iov_base = (char *)&req_lib_cmap_iter_next_bulk;
+	iov.iov_len = sizeof(req_lib_cmap_iter_next_bulk);
+
+	res_lib_cmap_iter_next_bulk = buf;
+
+	error = qb_to_cs_error(qb_ipcc_sendv_recv(
+		cmap_inst->c,
+		&iov,
+		1,
+		res_lib_cmap_iter_next_bulk,
+		buf_len, CS_IPC_TIMEOUT_MS));
+
+	if (error == CS_OK) {
+		error = res_lib_cmap_iter_next_bulk->header.error;
+	}
+
+	if (error == CS_OK) {
+		if (res_lib_cmap_iter_next_bulk->no_items > *no_items) {
+			error = CS_ERR_MESSAGE_ERROR;
+			goto error_put;
+		}
+
+		offset = sizeof(*res_lib_cmap_iter_next_bulk);
+		for (i = 0; i < res_lib_cmap_iter_next_bulk->no_items; i++) {
+			item = (struct res_lib_cmap_iter_next_bulk_item *)((char *)buf + offset);
+
+			if (offset + sizeof(*item) > res_lib_cmap_iter_next_bulk->header.size) {
+				error = CS_ERR_MESSAGE_ERROR;
+				goto error_put;
+			}
+
+			item_size = CMAP_ITER_BULK_ITEM_SIZE(item->value_len, item->key_name_len);
+			if (offset + item_size > res_lib_cmap_iter_next_bulk->header.size ||
+			    item->key_name_len == 0 ||
+			    item->data[item->value_len + item->key_name_len - 1] != '\0') {
+				error = CS_ERR_MESSAGE_ERROR;
+				goto error_put;
+			}
+
+			items[i].key_name = (const char *)item->data + item->value_len;
+			items[i].type = item->type;
+			items[i].value_len = item->value_len;
+			items[i].value = item->data;
+
+			offset += item_size;
+		}
+
+		*no_items = res_lib_cmap_iter_next_bulk->no_items;
+	}
+
+error_put:
+	(void)hdb_handle_put (&cmap_handle_t_db, handle);
+
+	return (error);
+}
+
 cs_error_t cmap_iter_finalize(
 		cmap_handle_t handle,
 		cmap_iter_handle_t iter_handle)
@@ -974,10 +1128,11 @@ cs_error_t cmap_iter_finalize(
 	return (error);
 }
 
-cs_error_t cmap_track_add(
+static cs_error_t cmap_track_add_common(
 	cmap_handle_t handle,
 	const char *key_name,
 	int32_t track_type,
+	uint32_t coalesce_window,
 	cmap_notify_fn_t notify_fn,
 	void *user_data,
 	cmap_track_handle_t *cmap_track_handle)
@@ -986,6 +1141,7 @@ cs_error_t cmap_track_add(
 	struct iovec iov;
 	struct cmap_inst *cmap_inst;
 	struct req_lib_cmap_track_add req_lib_cmap_track_add;
+	struct req_lib_cmap_track_add_coalesced req_lib_cmap_track_add_coalesced;
 	struct res_lib_cmap_track_add res_lib_cmap_track_add;
 	struct cmap_track_inst *cmap_track_inst;
 	cmap_track_handle_t cmap_track_inst_handle;
@@ -994,6 +1150,10 @@ cs_error_t cmap_track_add(
 		return (CS_ERR_INVALID_PARAM);
 	}
 
+	if (key_name != NULL && strlen(key_name) >= CS_MAX_NAME_LENGTH) {
+		return (CS_ERR_NAME_TOO_LONG);
+	}
+
 	error = hdb_error_to_cs(hdb_handle_get (&cmap_handle_t_db, handle, (void *)&cmap_inst));
 	if (error != CS_OK) {
 		return (error);
@@ -1015,23 +1175,38 @@ cs_error_t cmap_track_add(
 	cmap_track_inst->notify_fn = notify_fn;
 	cmap_track_inst->c = cmap_inst->c;
 
-	memset(&req_lib_cmap_track_add, 0, sizeof(req_lib_cmap_track_add));
-	req_lib_cmap_track_add.header.size = sizeof(req_lib_cmap_track_add);
-	req_lib_cmap_track_add.header.id = MESSAGE_REQ_CMAP_TRACK_ADD;
+	if (coalesce_window == 0) {
+		memset(&req_lib_cmap_track_add, 0, sizeof(req_lib_cmap_track_add));
+		req_lib_cmap_track_add.header.size = sizeof(req_lib_cmap_track_add);
+		req_lib_cmap_track_add.header.id = MESSAGE_REQ_CMAP_TRACK_ADD;
 
-	if (key_name) {
-		if (strlen(key_name) >= CS_MAX_NAME_LENGTH) {
-			return (CS_ERR_NAME_TOO_LONG);
+		if (key_name) {
+			memcpy(req_lib_cmap_track_add.key_name.value, key_name, strlen(key_name));
+			req_lib_cmap_track_add.key_name.length = strlen(key_name);
 		}
-		memcpy(req_lib_cmap_track_add.key_name.value, key_name, strlen(key_name));
-		req_lib_cmap_track_add.key_name.length = strlen(key_name);
-	}
 
-	req_lib_cmap_track_add.track_type = track_type;
-	req_lib_cmap_track_add.track_inst_handle = cmap_track_inst_handle;
+		req_lib_cmap_track_add.track_type = track_type;
+		req_lib_cmap_track_add.track_inst_handle = cmap_track_inst_handle;
 
-	iov.iov_base = (char *)&req_lib_cmap_track_add;
-	iov.iov_len = sizeof(req_lib_cmap_track_add);
+		iov.iov_base = (char *)&req_lib_cmap_track_add;
+		iov.iov_len = sizeof(req_lib_cmap_track_add);
+	} else {
+		memset(&req_lib_cmap_track_add_coalesced, 0, sizeof(req_lib_cmap_track_add_coalesced));
+		req_lib_cmap_track_add_coalesced.header.size = sizeof(req_lib_cmap_track_add_coalesced);
+		req_lib_cmap_track_add_coalesced.header.id = MESSAGE_REQ_CMAP_TRACK_ADD_COALESCED;
+
+		if (key_name) {
+			memcpy(req_lib_cmap_track_add_coalesced.key_name.value, key_name, strlen(key_name));
+			req_lib_cmap_track_add_coalesced.key_name.length = strlen(key_name);
+		}
+
+		req_lib_cmap_track_add_coalesced.track_type = track_type;
+		req_lib_cmap_track_add_coalesced.track_inst_handle = cmap_track_inst_handle;
+		req_lib_cmap_track_add_coalesced.window = coalesce_window;
+
+		iov.iov_base = (char *)&req_lib_cmap_track_add_coalesced;
+		iov.iov_len = sizeof(req_lib_cmap_track_add_coalesced);
+	}
 
 	error = qb_to_cs_error(qb_ipcc_sendv_recv(
 		cmap_inst->c,
@@ -1065,6 +1240,43 @@ error_put:
 	return (error);
 }
 
+cs_error_t cmap_track_add(
+	cmap_handle_t handle,
+	const char *key_name,
+	int32_t track_type,
+	cmap_notify_fn_t notify_fn,
+	void *user_data,
+	cmap_track_handle_t *cmap_track_handle)
+{
+	uint32_t coalesce_window = 0;
+
+	if (track_type & CMAP_TRACK_COALESCE) {
+		coalesce_window = CMAP_TRACK_COALESCE_DEFAULT_WINDOW;
+		track_type &= ~CMAP_TRACK_COALESCE;
+	}
+
+	return (cmap_track_add_common(handle, key_name, track_type, coalesce_window,
+	    notify_fn, user_data, cmap_track_handle));
+}
+
+cs_error_t cmap_track_add_coalesced(
+	cmap_handle_t handle,
+	const char *key_name,
+	int32_t track_type,
+	uint32_t coalesce_window,
+	cmap_notify_fn_t notify_fn,
+	void *user_data,
+	cmap_track_handle_t *cmap_track_handle)
+{
+
+	if (coalesce_window == 0) {
+		return (CS_ERR_INVALID_PARAM);
+	}
+
+	return (cmap_track_add_common(handle, key_name, track_type & ~CMAP_TRACK_COALESCE, coalesce_window,
+	    notify_fn, user_data, cmap_track_handle));
+}
+
 cs_error_t cmap_track_delete(
 		cmap_handle_t handle,
 		cmap_track_handle_t track_handle)
@@ -51,6 +51,7 @@
 #include <sys/stat.h>
 #include <errno.h>
 #include <limits.h>
+#include <pthread.h>
 
 #include <qb/qblist.h>
 #include <qb/qbdefs.h>
@@ -80,6 +81,21 @@
  */
 #define CPG_MEMORY_MAP_UMASK		077
 
+/*
+ * Freed ZCB buffers are not unmapped but kept (mapped both in library and
+ * in corosync) on per-handle free list of given size class and reused by
+ * next cpg_zcb_alloc. Size classes are powers of two from
+ * 1 << CPG_ZCB_POOL_MIN_SHIFT. Larger buffers are not pooled.
+ */
+#define CPG_ZCB_POOL_MIN_SHIFT		12
+#define CPG_ZCB_POOL_CLASSES		9
+#define CPG_ZCB_POOL_MAX_FREE		8
+
+/*
+ * Size of zero copy receive arena (CPG_MODEL_V1_DELIVER_ZERO_COPY)
+ */
+#define CPG_ZC_RECV_ARENA_SIZE		(8 * 1024 * 1024)
+
 struct cpg_assembly_data
 {
 	struct qb_list_head list;
@@ -100,8 +116,14 @@ struct cpg_inst {
 	struct qb_list_head iteration_list_head;
 	uint32_t max_msg_size;
 	struct qb_list_head assembly_list_head;
+	pthread_mutex_t zcb_pool_mutex;
+	struct qb_list_head zcb_pool_list_head[CPG_ZCB_POOL_CLASSES];
+	unsigned int zcb_pool_entries[CPG_ZCB_POOL_CLASSES];
+	void *zc_recv_addr;
+	size_t zc_recv_size;
 };
 static void cpg_inst_free (void *inst);
+static void cpg_zc_recv_init (struct cpg_inst *cpg_inst);
 
 DECLARE_HDB_DATABASE(cpg_handle_t_db, cpg_inst_free);
 
@@ -141,6 +163,33 @@ static void cpg_inst_free (void *inst)
 {
 	struct cpg_inst *cpg_inst = (struct cpg_inst *)inst;
 	qb_ipcc_disconnect(cpg_inst->c);
+
+	if (cpg_inst->zc_recv_addr != NULL) {
+		munmap (cpg_inst->zc_recv_addr, cpg_inst->zc_recv_size);
+	}
+}
+
+static void cpg_zcb_pool_free (struct cpg_inst *cpg_inst)
+{
+	struct qb_list_head *iter, *tmp_iter;
+	struct coroipcs_zc_header *hdr;
+	int i;
+
+	/*
+	 * Only library side mapping is released. Corosync unmaps its side
+	 * of all buffers of the connection when connection is closed.
+	 */
+	pthread_mutex_lock (&cpg_inst->zcb_pool_mutex);
+	for (i = 0; i < CPG_ZCB_POOL_CLASSES; i++) {
+		qb_list_for_each_safe(iter, tmp_iter, &(cpg_inst->zcb_pool_list_head[i])) {
+			qb_list_del (iter);
+			hdr = (struct coroipcs_zc_header *)((char *)iter -
+			    sizeof (struct coroipcs_zc_header) - sizeof (struct req_lib_cpg_mcast));
+			munmap ((void *)hdr, hdr->map_size);
+		}
+		cpg_inst->zcb_pool_entries[i] = 0;
+	}
+	pthread_mutex_unlock (&cpg_inst->zcb_pool_mutex);
 }
 
 static void cpg_inst_finalize (struct cpg_inst *cpg_inst, hdb_handle_t handle)
@@ -156,6 +205,10 @@ static void cpg_inst_finalize (struct cpg_inst *cpg_inst, hdb_handle_t handle)
 
 		cpg_iteration_instance_finalize (cpg_iteration_instance);
 	}
+
+	cpg_zcb_pool_free (cpg_inst);
+	pthread_mutex_destroy (&cpg_inst->zcb_pool_mutex);
+
 	hdb_handle_destroy (&cpg_handle_t_db, handle);
 }
 
@@ -190,6 +243,7 @@ cs_error_t cpg_model_initialize (
 {
 	cs_error_t error;
 	struct cpg_inst *cpg_inst;
+	int i;
 
 	if (model != CPG_MODEL_V1) {
 		error = CS_ERR_INVALID_PARAM;
@@ -216,7 +270,8 @@ cs_error_t cpg_model_initialize (
 		switch (model) {
 		case CPG_MODEL_V1:
 			memcpy (&cpg_inst->model_v1_data, model_data, sizeof (cpg_model_v1_data_t));
-			if ((cpg_inst->model_v1_data.flags & ~(CPG_MODEL_V1_DELIVER_INITIAL_TOTEM_CONF)) != 0) {
+			if ((cpg_inst->model_v1_data.flags & ~(CPG_MODEL_V1_DELIVER_INITIAL_TOTEM_CONF |
+			    CPG_MODEL_V1_DELIVER_ZERO_COPY)) != 0) {
 				error = CS_ERR_INVALID_PARAM;
 
 				goto error_destroy;
@@ -234,6 +289,16 @@ cs_error_t cpg_model_initialize (
 
 	qb_list_init(&cpg_inst->assembly_list_head);
 
+	pthread_mutex_init (&cpg_inst->zcb_pool_mutex, NULL);
+	for (i = 0; i < CPG_ZCB_POOL_CLASSES; i++) {
+		qb_list_init(&cpg_inst->zcb_pool_list_head[i]);
+		cpg_inst->zcb_pool_entries[i] = 0;
+	}
+
+	if (model == CPG_MODEL_V1 && (cpg_inst->model_v1_data.flags & CPG_MODEL_V1_DELIVER_ZERO_COPY)) {
+		cpg_zc_recv_init (cpg_inst);
+	}
+
 	hdb_handle_put (&cpg_handle_t_db, *handle);
 
 	return (CS_OK);
@@ -377,6 +442,7 @@ cs_error_t cpg_dispatch (
 	struct cpg_inst *cpg_inst;
 	struct res_lib_cpg_confchg_callback *res_cpg_confchg_callback;
 	struct res_lib_cpg_deliver_callback *res_cpg_deliver_callback;
+	struct res_lib_cpg_zc_deliver_callback *res_cpg_zc_deliver_callback;
 	struct res_lib_cpg_partial_deliver_callback *res_cpg_partial_deliver_callback;
 	struct res_lib_cpg_totem_confchg_callback *res_cpg_totem_confchg_callback;
 	struct cpg_inst cpg_inst_copy;
@@ -469,6 +535,36 @@ cs_error_t cpg_dispatch (
 					res_cpg_deliver_callback->msglen);
 				break;
 
+			case MESSAGE_RES_CPG_ZC_DELIVER_CALLBACK:
+				res_cpg_zc_deliver_callback = (struct res_lib_cpg_zc_deliver_callback *)dispatch_data;
+
+				if (cpg_inst->zc_recv_addr == NULL) {
+					error = CS_ERR_LIBRARY;
+					goto error_put;
+				}
+
+				if (cpg_inst_copy.model_v1_data.cpg_deliver_fn != NULL) {
+					marshall_from_mar_cpg_name_t (
+						&group_name,
+						&res_cpg_zc_deliver_callback->group_name);
+
+					cpg_inst_copy.model_v1_data.cpg_deliver_fn (handle,
+						&group_name,
+						res_cpg_zc_deliver_callback->nodeid,
+						res_cpg_zc_deliver_callback->pid,
+						(char *)cpg_inst->zc_recv_addr + CPG_ZC_RECV_HEADER_SIZE +
+						    res_cpg_zc_deliver_callback->offset,
+						res_cpg_zc_deliver_callback->msglen);
+				}
+
+				/*
+				 * Message is no longer needed, return space in arena to corosync
+				 */
+				__sync_synchronize ();
+				((struct coroipcs_zc_recv_header *)cpg_inst->zc_recv_addr)->tail =
+				    res_cpg_zc_deliver_callback->release;
+				break;
+
 			case MESSAGE_RES_CPG_PARTIAL_DELIVER_CALLBACK:
 				res_cpg_partial_deliver_callback = (struct res_lib_cpg_partial_deliver_callback *)dispatch_data;
 
@@ -941,6 +1037,122 @@ error_close_unlink:
 	return -1;
 }
 
+/*
+ * Create zero copy receive arena and pass it to corosync. Failure is not
+ * fatal, messages are then delivered thru regular IPC.
+ */
+static void cpg_zc_recv_init (struct cpg_inst *cpg_inst)
+{
+	char path[PATH_MAX];
+	void *buf = NULL;
+	struct req_lib_cpg_zc_recv_init req_lib_cpg_zc_recv_init;
+	struct res_lib_cpg_zc_recv_init res_lib_cpg_zc_recv_init;
+	struct iovec iov;
+	cs_error_t error;
+
+	if (memory_map (path, "corosync_zerocopy-XXXXXX", &buf, CPG_ZC_RECV_ARENA_SIZE) == -1) {
+		return ;
+	}
+
+	if (strlen(path) >= CPG_ZC_PATH_LEN) {
+		unlink(path);
+		munmap (buf, CPG_ZC_RECV_ARENA_SIZE);
+		return ;
+	}
+
+	memset (&req_lib_cpg_zc_recv_init, 0, sizeof (req_lib_cpg_zc_recv_init));
+	req_lib_cpg_zc_recv_init.header.size = sizeof (req_lib_cpg_zc_recv_init);
+	req_lib_cpg_zc_recv_init.header.id = MESSAGE_REQ_CPG_ZC_RECV_INIT;
+	req_lib_cpg_zc_recv_init.map_size = CPG_ZC_RECV_ARENA_SIZE;
+	strcpy (req_lib_cpg_zc_recv_init.path_to_file, path);
+
+	iov.iov_base = (void *)&req_lib_cpg_zc_recv_init;
+	iov.iov_len = sizeof (req_lib_cpg_zc_recv_init);
+
+	error = coroipcc_msg_send_reply_receive (cpg_inst->c,
+		&iov,
+		1,
+		&res_lib_cpg_zc_recv_init,
+		sizeof (res_lib_cpg_zc_recv_init));
+
+	/*
+	 * Corosync unlinks file after mapping, but it may not be the case
+	 * when request failed
+	 */
+	(void)unlink(path);
+
+	if (error != CS_OK || res_lib_cpg_zc_recv_init.header.error != CS_OK) {
+		munmap (buf, CPG_ZC_RECV_ARENA_SIZE);
+		return ;
+	}
+
+	cpg_inst->zc_recv_addr = buf;
+	cpg_inst->zc_recv_size = CPG_ZC_RECV_ARENA_SIZE;
+}
+
+/*
+ * Returns size class of ZCB with given map_size or -1 if buffer is too big
+ * to be pooled. If exact is set, map_size has to be exactly size of class.
+ */
+static int cpg_zcb_pool_class_get (size_t map_size, int exact, size_t *class_size)
+{
+	size_t csize;
+	int i;
+
+	for (i = 0; i < CPG_ZCB_POOL_CLASSES; i++) {
+		csize = (size_t)1 << (CPG_ZCB_POOL_MIN_SHIFT + i);
+
+		if (map_size <= csize) {
+			if (exact && map_size != csize) {
+				return (-1);
+			}
+
+			*class_size = csize;
+			return (i);
+		}
+	}
+
+	return (-1);
+}
+
+/*
+ * Free list is linked thru list head stored in the (unused) message data of
+ * the free buffer. Smallest class is large enough to hold it.
+ */
+static void *cpg_zcb_pool_get (struct cpg_inst *cpg_inst, int zcb_class)
+{
+	struct qb_list_head *entry;
+	void *buffer = NULL;
+
+	pthread_mutex_lock (&cpg_inst->zcb_pool_mutex);
+	if (!qb_list_empty (&cpg_inst->zcb_pool_list_head[zcb_class])) {
+		entry = cpg_inst->zcb_pool_list_head[zcb_class].next;
+		qb_list_del (entry);
+		cpg_inst->zcb_pool_entries[zcb_class]--;
+		buffer = (void *)entry;
+	}
+	pthread_mutex_unlock (&cpg_inst->zcb_pool_mutex);
+
+	return (buffer);
+}
+
+static int cpg_zcb_pool_put (struct cpg_inst *cpg_inst, int zcb_class, void *buffer)
+{
+	struct qb_list_head *entry = (struct qb_list_head *)buffer;
+	int res = 0;
+
+	pthread_mutex_lock (&cpg_inst->zcb_pool_mutex);
+	if (cpg_inst->zcb_pool_entries[zcb_class] < CPG_ZCB_POOL_MAX_FREE) {
+		qb_list_init (entry);
+		qb_list_add (entry, &cpg_inst->zcb_pool_list_head[zcb_class]);
+		cpg_inst->zcb_pool_entries[zcb_class]++;
+		res = 1;
+	}
+	pthread_mutex_unlock (&cpg_inst->zcb_pool_mutex);
+
+	return (res);
+}
+
 cs_error_t cpg_zcb_alloc (
 	cpg_handle_t handle,
 	size_t size,
@@ -951,6 +1163,8 @@ cs_error_t cpg_zcb_alloc (
 	mar_req_coroipcc_zc_alloc_t req_coroipcc_zc_alloc;
 	struct qb_ipc_response_header res_coroipcs_zc_alloc;
 	size_t map_size;
+	size_t class_size;
+	int zcb_class;
 	struct iovec iovec;
 	struct coroipcs_zc_header *hdr;
 	cs_error_t error;
@@ -962,12 +1176,31 @@ cs_error_t cpg_zcb_alloc (
 	}
 
 	map_size = size + sizeof (struct req_lib_cpg_mcast) + sizeof (struct coroipcs_zc_header);
-	assert(memory_map (path, "corosync_zerocopy-XXXXXX", &buf, map_size) != -1);
+
+	zcb_class = cpg_zcb_pool_class_get (map_size, 0, &class_size);
+	if (zcb_class != -1) {
+		*buffer = cpg_zcb_pool_get (cpg_inst, zcb_class);
+		if (*buffer != NULL) {
+			/*
+			 * Pooled buffer is already known to corosync, no IPC needed
+			 */
+			hdb_handle_put (&cpg_handle_t_db, handle);
+			return (CS_OK);
+		}
+
+		map_size = class_size;
+	}
+
+	if (memory_map (path, "corosync_zerocopy-XXXXXX", &buf, map_size) == -1) {
+		error = CS_ERR_NO_MEMORY;
+		goto error_exit;
+	}
 
 	if (strlen(path) >= CPG_ZC_PATH_LEN) {
 		unlink(path);
 		munmap (buf, map_size);
-		return (CS_ERR_NAME_TOO_LONG);
+		error = CS_ERR_NAME_TOO_LONG;
+		goto error_exit;
 	}
 
 	req_coroipcc_zc_alloc.header.size = sizeof (mar_req_coroipcc_zc_alloc_t);
@@ -986,6 +1219,7 @@ cs_error_t cpg_zcb_alloc (
 		sizeof (struct qb_ipc_response_header));
 
 	if (error != CS_OK) {
+		munmap (buf, map_size);
 		goto error_exit;
 	}
 
@@ -1009,12 +1243,19 @@ cs_error_t cpg_zcb_free (
 	struct qb_ipc_response_header res_coroipcs_zc_free;
 	struct iovec iovec;
 	struct coroipcs_zc_header *header = (struct coroipcs_zc_header *)((char *)buffer - sizeof (struct coroipcs_zc_header) - sizeof (struct req_lib_cpg_mcast));
+	size_t class_size;
+	int zcb_class;
 
 	error = hdb_error_to_cs (hdb_handle_get (&cpg_handle_t_db, handle, (void *)&cpg_inst));
 	if (error != CS_OK) {
 		return (error);
 	}
 
+	zcb_class = cpg_zcb_pool_class_get (header->map_size, 1, &class_size);
+	if (zcb_class != -1 && cpg_zcb_pool_put (cpg_inst, zcb_class, buffer)) {
+		goto error_exit;
+	}
+
 	req_coroipcc_zc_free.header.size = sizeof (mar_req_coroipcc_zc_free_t);
 	req_coroipcc_zc_free.header.id = MESSAGE_REQ_CPG_ZC_FREE;
 	req_coroipcc_zc_free.map_size = header->map_size;
@@ -1380,6 +1621,105 @@ error_exit:
 	return (error);
 }
 
+cs_error_t cpg_iteration_next_bulk(
+	cpg_iteration_handle_t handle,
+	struct cpg_iteration_description_t *descriptions,
+	size_t max_entries,
+	size_t *entries)
+{
+	cs_error_t error;
+	struct cpg_iteration_instance_t *cpg_iteration_instance;
+	struct req_lib_cpg_iterationnext_bulk req_lib_cpg_iterationnext_bulk;
+	struct res_lib_cpg_iterationnext_bulk *res_lib_cpg_iterationnext_bulk;
+	size_t res_size;
+	size_t msg_max_entries;
+	size_t req_entries;
+	uint32_t i;
+
+	if (descriptions == NULL || entries == NULL || max_entries == 0) {
+		return CS_ERR_INVALID_PARAM;
+	}
+
+	*entries = 0;
+
+	error = hdb_error_to_cs (hdb_handle_get (&cpg_iteration_handle_t_db, handle,
+		(void *)&cpg_iteration_instance));
+	if (error != CS_OK) {
+		goto error_exit;
+	}
+
+	msg_max_entries = (IPC_RESPONSE_SIZE - sizeof (struct res_lib_cpg_iterationnext_bulk)) /
+	    sizeof (mar_cpg_iteration_description_t);
+	if (msg_max_entries > CPG_ITERATION_BULK_MAX_ENTRIES) {
+		msg_max_entries = CPG_ITERATION_BULK_MAX_ENTRIES;
+	}
+
+	res_size = sizeof (struct res_lib_cpg_iterationnext_bulk) +
+	    msg_max_entries * sizeof (mar_cpg_iteration_description_t);
+	res_lib_cpg_iterationnext_bulk = malloc (res_size);
+	if (res_lib_cpg_iterationnext_bulk == NULL) {
+		error = CS_ERR_NO_MEMORY;
+		goto error_put;
+	}
+
+	/*
+	 * Fetch entries until caller buffer is full or corosync returns less
+	 * entries than requested (= end of iteration)
+	 */
+	do {
+		req_entries = max_entries - *entries;
+		if (req_entries > msg_max_entries) {
+			req_entries = msg_max_entries;
+		}
+
+		req_lib_cpg_iterationnext_bulk.header.size = sizeof (struct req_lib_cpg_iterationnext_bulk);
+		req_lib_cpg_iterationnext_bulk.header.id = MESSAGE_REQ_CPG_ITERATIONNEXT_BULK;
+		req_lib_cpg_iterationnext_bulk.iteration_handle = cpg_iteration_instance->executive_iteration_handle;
+		req_lib_cpg_iterationnext_bulk.max_entries = req_entries;
+
+		error = qb_to_cs_error (qb_ipcc_send (cpg_iteration_instance->conn,
+					&req_lib_cpg_iterationnext_bulk,
+					req_lib_cpg_iterationnext_bulk.header.size));
+		if (error != CS_OK) {
+			goto error_free;
+		}
+
+		error = qb_to_cs_error (qb_ipcc_recv (cpg_iteration_instance->conn,
+					res_lib_cpg_iterationnext_bulk,
+					res_size, -1));
+		if (error != CS_OK) {
+			goto error_free;
+		}
+
+		error = res_lib_cpg_iterationnext_bulk->header.error;
+		if (error != CS_OK) {
+			break;
+		}
+
+		for (i = 0; i < res_lib_cpg_iterationnext_bulk->entries; i++) {
+			marshall_from_mar_cpg_iteration_description_t(
+					&descriptions[*entries],
+					&res_lib_cpg_iterationnext_bulk->description[i]);
+			(*entries)++;
+		}
+	} while (*entries < max_entries && res_lib_cpg_iterationnext_bulk->entries == req_entries);
+
+	/*
+	 * End of iteration is reported only if there are no entries to return
+	 */
+	if (error == CS_ERR_NO_SECTIONS && *entries > 0) {
+		error = CS_OK;
+	}
+
+error_free:
+	free (res_lib_cpg_iterationnext_bulk);
+error_put:
+	hdb_handle_put (&cpg_iteration_handle_t_db, handle);
+
+error_exit:
+	return (error);
+}
+
 cs_error_t cpg_iteration_finalize (
 	cpg_iteration_handle_t handle)
 {
@@ -43,6 +43,7 @@
 #include <time.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <sys/socket.h>
 #include <sys/select.h>
 #include <sys/uio.h>
@@ -153,18 +154,68 @@ static void* dispatch_thread (void *arg)
 	return NULL;
 }
 
-int main (void) {
+static void usage (const char *cmd)
+{
+	printf("%s [-s size] [-n repetitions] [-p processes]\n", cmd);
+	printf("  -s     send messages of given size only (default is to start with 64 bytes\n");
+	printf("         and multiply size by 5 for every repetition)\n");
+	printf("  -n     number of repetitions (default 10)\n");
+	printf("  -p     number of processes sending in parallel, each with its own\n");
+	printf("         connection (default 1)\n");
+	printf("\n");
+	printf("Use -s 64 -p 8 to measure throughput of bursts of small messages\n");
+}
+
+int main (int argc, char *argv[]) {
 	unsigned int size;
+	unsigned int fixed_size = 0;
+	int repetitions = 10;
+	int processes = 1;
 	int i;
+	int opt;
 	unsigned int res;
 
+	while ((opt = getopt(argc, argv, "s:n:p:h")) != -1) {
+		switch (opt) {
+		case 's':
+			fixed_size = atoi(optarg);
+			if (fixed_size == 0 || fixed_size >= (ONE_MEG - 100)) {
+				fprintf(stderr, "Invalid message size\n");
+				exit(1);
+			}
+			break;
+		case 'n':
+			repetitions = atoi(optarg);
+			break;
+		case 'p':
+			processes = atoi(optarg);
+			if (processes < 1) {
+				processes = 1;
+			}
+			break;
+		case 'h':
+		default:
+			usage(argv[0]);
+			exit(0);
+		}
+	}
+
+	/*
+	 * Every process gets its own IPC connection
+	 */
+	for (i = 1; i < processes; i++) {
+		if (fork() == 0) {
+			break;
+		}
+	}
+
 	qb_log_init("cpgbench", LOG_USER, LOG_EMERG);
 	qb_log_ctl(QB_LOG_SYSLOG, QB_LOG_CONF_ENABLED, QB_FALSE);
 	qb_log_filter_ctl(QB_LOG_STDERR, QB_LOG_FILTER_ADD,
 			  QB_LOG_FILTER_FILE, "*", LOG_DEBUG);
 	qb_log_ctl(QB_LOG_STDERR, QB_LOG_CONF_ENABLED, QB_TRUE);
 
-	size = 64;
+	size = (fixed_size ? fixed_size : 64);
 	signal (SIGALRM, sigalrm_handler);
 	res = cpg_initialize (&handle, &callbacks);
 	if (res != CS_OK) {
@@ -179,10 +230,12 @@ int main (void) {
 		exit (1);
 	}
 
-	for (i = 0; i < 10; i++) { /* number of repetitions - up to 50k */
+	for (i = 0; i < repetitions; i++) { /* number of repetitions - up to 50k */
 		cpg_benchmark (handle, size);
 		signal (SIGALRM, sigalrm_handler);
-		size *= 5;
+		if (!fixed_size) {
+			size *= 5;
+		}
 		if (size >= (ONE_MEG - 100)) {
 			break;
 		}
@@ -193,5 +246,9 @@ int main (void) {
 		printf ("cpg_finalize failed with result %d\n", res);
 		exit (1);
 	}
+
+	while (wait(NULL) > 0) {
+	}
+
 	return (0);
 }
@@ -97,6 +97,11 @@ static cpg_callbacks_t callbacks = {
 
 void *data;
 
+/*
+ * Allocate and free zero copy buffer for every message (-a)
+ */
+static int alloc_per_msg = 0;
+
 static void cpg_benchmark (
 	cpg_handle_t handle,
 	int write_size)
@@ -117,11 +122,21 @@ static void cpg_benchmark (
 		 */
 		cpg_flow_control_state_get (handle, &flow_control_state);
 		if (flow_control_state == CPG_FLOW_CONTROL_DISABLED) {
+			if (alloc_per_msg) {
+				res = cpg_zcb_alloc (handle, write_size, &data);
+				if (res != CS_OK) {
+					printf ("cpg_zcb_alloc returned error %d\n", res);
+					exit (1);
+				}
+			}
 retry:
 			res = cpg_zcb_mcast_joined (handle, CPG_TYPE_AGREED, data, write_size);
 			if (res == CS_ERR_TRY_AGAIN) {
 				goto retry;
 			}
+			if (alloc_per_msg) {
+				cpg_zcb_free (handle, data);
+			}
 		}
 		res = cpg_dispatch (handle, CS_DISPATCH_ALL);
 		if (res != CS_OK) {
@@ -152,13 +167,30 @@ static struct cpg_name group_name = {
 	.length = 6
 };
 
-int main (void) {
+static void usage (const char *cmd)
+{
+	printf("%s [-a]\n", cmd);
+	printf("  -a     allocate and free zero copy buffer for every message\n");
+}
+
+int main (int argc, char *argv[]) {
 	cpg_handle_t handle;
 	unsigned int size;
 	int i;
 	unsigned int res;
-
-
+	int opt;
+
+	while ((opt = getopt(argc, argv, "ah")) != -1) {
+		switch (opt) {
+		case 'a':
+			alloc_per_msg = 1;
+			break;
+		case 'h':
+		default:
+			usage(argv[0]);
+			exit(0);
+		}
+	}
 
 	size = 1000;
 	signal (SIGALRM, sigalrm_handler);
@@ -167,10 +199,12 @@ int main (void) {
 		printf ("cpg_initialize failed with result %d\n", res);
 		exit (1);
 	}
-	cpg_zcb_alloc (handle, 500000, &data);
-	if (res != CS_OK) {
-		printf ("cpg_zcb_alloc couldn't allocate zero copy buffer %d\n", res);
-		exit (1);
+	if (!alloc_per_msg) {
+		res = cpg_zcb_alloc (handle, 500000, &data);
+		if (res != CS_OK) {
+			printf ("cpg_zcb_alloc couldn't allocate zero copy buffer %d\n", res);
+			exit (1);
+		}
 	}
 
 	res = cpg_join (handle, &group_name);
@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * All rights reserved.
+ *
+ * This software licensed under BSD license, the text of which follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Microbenchmark of icmap set/get throughput. Runs directly against
+ * icmap code of corosync (no daemon needed).
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include <corosync/corotypes.h>
+#include <corosync/icmap.h>
+
+#ifndef timersub
+#define timersub(a, b, result)						\
+	do {								\
+		(result)->tv_sec = (a)->tv_sec - (b)->tv_sec;		\
+		(result)->tv_usec = (a)->tv_usec - (b)->tv_usec;	\
+		if ((result)->tv_usec < 0) {				\
+			--(result)->tv_sec;				\
+			(result)->tv_usec += 1000000;			\
+		}							\
+	} while (0)
+#endif /* timersub */
+
+#define DEFAULT_KEYS		10000
+#define DEFAULT_ROUNDS		100
+
+static char **key_names;
+static int keys = DEFAULT_KEYS;
+static int rounds = DEFAULT_ROUNDS;
+static uint64_t notifications;
+
+static struct timeval tv_start;
+
+static void bench_start (void)
+{
+	gettimeofday (&tv_start, NULL);
+}
+
+static void bench_end (const char *name, uint64_t ops)
+{
+	struct timeval tv_end, tv_elapsed;
+	double secs;
+
+	gettimeofday (&tv_end, NULL);
+	timersub (&tv_end, &tv_start, &tv_elapsed);
+	secs = tv_elapsed.tv_sec + (tv_elapsed.tv_usec / 1000000.0);
+
+	printf ("%-32s %10"PRIu64" ops %8.3f s %12.0f ops/s\n",
+		name, ops, secs, (secs > 0.0 ? ops / secs : 0.0));
+}
+
+static void notify_fn (
+	int32_t event,
+	const char *key_name,
+	struct icmap_notify_value new_val,
+	struct icmap_notify_value old_val,
+	void *user_data)
+{
+	notifications++;
+}
+
+static void bench_check (cs_error_t err, const char *what)
+{
+	if (err != CS_OK) {
+		fprintf (stderr, "%s failed: %d\n", what, err);
+		exit (1);
+	}
+}
+
+static void bench_run (const char *suffix)
+{
+	char name[64];
+	char str[16];
+	uint32_t u32;
+	uint64_t u64;
+	int i, r;
+
+	snprintf (name, sizeof (name), "set uint32 (update)%s", suffix);
+	bench_start ();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < keys; i++) {
+			bench_check (icmap_set_uint32 (key_names[i], r + i), "icmap_set_uint32");
+		}
+	}
+	bench_end (name, (uint64_t)rounds * keys);
+
+	snprintf (name, sizeof (name), "set uint64 (type change)%s", suffix);
+	bench_start ();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < keys; i++) {
+			if (r % 2 == 0) {
+				bench_check (icmap_set_uint64 (key_names[i], r + i), "icmap_set_uint64");
+			} else {
+				bench_check (icmap_set_uint32 (key_names[i], r + i), "icmap_set_uint32");
+			}
+		}
+	}
+	bench_end (name, (uint64_t)rounds * keys);
+
+	snprintf (name, sizeof (name), "set string (same length)%s", suffix);
+	bench_start ();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < keys; i++) {
+			snprintf (str, sizeof (str), "%08d", (r * keys + i) % 100000000);
+			bench_check (icmap_set_string (key_names[i], str), "icmap_set_string");
+		}
+	}
+	bench_end (name, (uint64_t)rounds * keys);
+
+	snprintf (name, sizeof (name), "fast_inc%s", suffix);
+	for (i = 0; i < keys; i++) {
+		bench_check (icmap_set_uint64 (key_names[i], 0), "icmap_set_uint64");
+	}
+	bench_start ();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < keys; i++) {
+			bench_check (icmap_fast_inc (key_names[i]), "icmap_fast_inc");
+		}
+	}
+	bench_end (name, (uint64_t)rounds * keys);
+
+	snprintf (name, sizeof (name), "get uint64%s", suffix);
+	bench_start ();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < keys; i++) {
+			bench_check (icmap_get_uint64 (key_names[i], &u64), "icmap_get_uint64");
+		}
+	}
+	bench_end (name, (uint64_t)rounds * keys);
+
+	/*
+	 * Back to uint32 for next run
+	 */
+	for (i = 0; i < keys; i++) {
+		bench_check (icmap_set_uint32 (key_names[i], 0), "icmap_set_uint32");
+	}
+	bench_check (icmap_get_uint32 (key_names[0], &u32), "icmap_get_uint32");
+}
+
+int main (int argc, char *argv[])
+{
+	icmap_track_t track;
+	int opt;
+	int i;
+
+	while ((opt = getopt (argc, argv, "k:r:h")) != -1) {
+		switch (opt) {
+		case 'k':
+			keys = atoi (optarg);
+			break;
+		case 'r':
+			rounds = atoi (optarg);
+			break;
+		case 'h':
+		default:
+			printf ("usage: %s [-k keys] [-r rounds]\n", argv[0]);
+			exit (0);
+		}
+	}
+
+	if (keys < 1 || rounds < 1) {
+		fprintf (stderr, "Invalid number of keys or rounds\n");
+		exit (1);
+	}
+
+	bench_check (icmap_init (), "icmap_init");
+
+	key_names = malloc (sizeof (char *) * keys);
+	if (key_names == NULL) {
+		fprintf (stderr, "Can't allocate memory\n");
+		exit (1);
+	}
+
+	bench_start ();
+	for (i = 0; i < keys; i++) {
+		key_names[i] = malloc (ICMAP_KEYNAME_MAXLEN);
+		if (key_names[i] == NULL) {
+			fprintf (stderr, "Can't allocate memory\n");
+			exit (1);
+		}
+		snprintf (key_names[i], ICMAP_KEYNAME_MAXLEN, "bench.nodelist.node.%d.value", i);
+		bench_check (icmap_set_uint32 (key_names[i], i), "icmap_set_uint32");
+	}
+	bench_end ("set uint32 (insert)", keys);
+
+	bench_run ("");
+
+	bench_check (icmap_track_add ("bench.", ICMAP_TRACK_MODIFY | ICMAP_TRACK_PREFIX,
+		notify_fn, NULL, &track), "icmap_track_add");
+	bench_run (" tracked");
+	bench_check (icmap_track_delete (track), "icmap_track_delete");
+
+	printf ("%"PRIu64" notifications delivered\n", notifications);
+
+	bench_start ();
+	for (i = 0; i < keys; i++) {
+		bench_check (icmap_delete (key_names[i]), "icmap_delete");
+		free (key_names[i]);
+	}
+	bench_end ("delete", keys);
+
+	free (key_names);
+	icmap_fini ();
+
+	return (0);
+}
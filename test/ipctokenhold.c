@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * All rights reserved.
+ *
+ * This software licensed under BSD license, the text of which follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Measures how local IPC load affects token handling. Token stats are
+ * sampled first on idle node and then while client processes flood
+ * corosync with (cheap) cmap requests. Run once with qb.ipc_thread
+ * disabled and once with it enabled to compare.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <corosync/corotypes.h>
+#include <corosync/cmap.h>
+
+#define MAX_CLIENTS		256
+
+struct token_sample {
+	uint32_t samples;
+	uint64_t workload_sum;
+	uint32_t workload_max;
+	uint64_t mtt_sum;
+	uint32_t mtt_max;
+	uint64_t since_last_max;
+};
+
+static volatile sig_atomic_t stop_flood;
+
+static void sigterm_handler (int num)
+{
+	stop_flood = 1;
+}
+
+static void usage (const char *name)
+{
+	printf ("usage: \n");
+	printf ("%s <options>\n", name);
+	printf ("\n");
+	printf ("  -c     Number of client processes generating IPC load (default 16)\n");
+	printf ("  -t     Seconds to sample in each phase (default 15)\n");
+	printf ("  -h     Display this help\n");
+	printf ("\n");
+}
+
+/*
+ * Client process. Sends cmap get requests as fast as possible and
+ * writes number of finished requests to fd when told to stop.
+ */
+static void ipc_flood (int fd)
+{
+	cmap_handle_t handle;
+	uint64_t requests = 0;
+	uint32_t u32;
+	cs_error_t err;
+
+	signal (SIGTERM, sigterm_handler);
+
+	err = cmap_initialize (&handle);
+	if (err != CS_OK) {
+		fprintf (stderr, "cmap_initialize failed: %d\n", err);
+		exit (1);
+	}
+
+	while (!stop_flood) {
+		err = cmap_get_uint32 (handle, "runtime.votequorum.this_node_id", &u32);
+		if (err == CS_OK || err == CS_ERR_NOT_EXIST || err == CS_ERR_TRY_AGAIN) {
+			requests++;
+		} else {
+			fprintf (stderr, "cmap_get failed: %d\n", err);
+			break;
+		}
+	}
+
+	cmap_finalize (handle);
+
+	if (write (fd, &requests, sizeof (requests)) != sizeof (requests)) {
+		exit (1);
+	}
+	exit (0);
+}
+
+static int token_sample_collect (cmap_handle_t stats_handle, int seconds, struct token_sample *ts)
+{
+	uint32_t workload;
+	uint32_t mtt;
+	uint64_t since_last;
+	int i;
+
+	memset (ts, 0, sizeof (*ts));
+
+	for (i = 0; i < seconds; i++) {
+		sleep (1);
+
+		if (cmap_get_uint32 (stats_handle, "stats.srp.avg_token_workload", &workload) != CS_OK ||
+		    cmap_get_uint32 (stats_handle, "stats.srp.mtt_rx_token", &mtt) != CS_OK ||
+		    cmap_get_uint64 (stats_handle, "stats.srp.time_since_token_last_received", &since_last) != CS_OK) {
+			/*
+			 * Stats can be temporarily unavailable under load
+			 */
+			continue;
+		}
+
+		ts->samples++;
+		ts->workload_sum += workload;
+		if (workload > ts->workload_max) {
+			ts->workload_max = workload;
+		}
+		ts->mtt_sum += mtt;
+		if (mtt > ts->mtt_max) {
+			ts->mtt_max = mtt;
+		}
+		if (since_last > ts->since_last_max) {
+			ts->since_last_max = since_last;
+		}
+	}
+
+	return (ts->samples > 0 ? 0 : -1);
+}
+
+static void token_sample_print (const char *phase, const struct token_sample *ts)
+{
+	printf ("%-6s samples %3u  token hold avg %5"PRIu64" max %5u ms  "
+		"rotation avg %5"PRIu64" max %5u ms  since last token max %5"PRIu64" ms\n",
+		phase, ts->samples,
+		ts->workload_sum / ts->samples, ts->workload_max,
+		ts->mtt_sum / ts->samples, ts->mtt_max,
+		ts->since_last_max);
+}
+
+int main (int argc, char *argv[])
+{
+	cmap_handle_t stats_handle;
+	struct token_sample idle, loaded;
+	pid_t pids[MAX_CLIENTS];
+	int clients = 16;
+	int seconds = 15;
+	int pipefd[2];
+	uint64_t requests, total_requests = 0;
+	int opt;
+	int i;
+	cs_error_t err;
+
+	while ((opt = getopt (argc, argv, "c:t:h")) != -1) {
+		switch (opt) {
+		case 'c':
+			clients = atoi (optarg);
+			break;
+		case 't':
+			seconds = atoi (optarg);
+			break;
+		case 'h':
+		default:
+			usage (argv[0]);
+			exit (0);
+		}
+	}
+
+	if (clients < 1 || clients > MAX_CLIENTS || seconds < 1) {
+		usage (argv[0]);
+		exit (1);
+	}
+
+	err = cmap_initialize_map (&stats_handle, CMAP_MAP_STATS);
+	if (err != CS_OK) {
+		fprintf (stderr, "cmap_initialize_map failed: %d\n", err);
+		exit (1);
+	}
+
+	printf ("Sampling idle node for %d seconds\n", seconds);
+	if (token_sample_collect (stats_handle, seconds, &idle) != 0) {
+		fprintf (stderr, "Unable to get token stats\n");
+		exit (1);
+	}
+
+	if (pipe (pipefd) != 0) {
+		perror ("pipe");
+		exit (1);
+	}
+
+	printf ("Starting %d IPC clients, sampling for %d seconds\n", clients, seconds);
+	for (i = 0; i < clients; i++) {
+		pids[i] = fork ();
+		if (pids[i] == -1) {
+			perror ("fork");
+			clients = i;
+			break;
+		}
+		if (pids[i] == 0) {
+			close (pipefd[0]);
+			ipc_flood (pipefd[1]);
+		}
+	}
+	close (pipefd[1]);
+
+	if (token_sample_collect (stats_handle, seconds, &loaded) != 0) {
+		fprintf (stderr, "Unable to get token stats under load\n");
+	}
+
+	for (i = 0; i < clients; i++) {
+		kill (pids[i], SIGTERM);
+	}
+	for (i = 0; i < clients; i++) {
+		if (read (pipefd[0], &requests, sizeof (requests)) == sizeof (requests)) {
+			total_requests += requests;
+		}
+	}
+	for (i = 0; i < clients; i++) {
+		waitpid (pids[i], NULL, 0);
+	}
+
+	token_sample_print ("idle", &idle);
+	if (loaded.samples > 0) {
+		token_sample_print ("loaded", &loaded);
+	}
+	printf ("IPC requests during load: %"PRIu64" (%.1f/s)\n",
+		total_requests, (double)total_requests / seconds);
+
+	cmap_finalize (stats_handle);
+
+	return (0);
+}
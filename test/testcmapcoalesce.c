@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * All rights reserved.
+ *
+ * This software licensed under BSD license, the text of which follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Checks coalescing cmap tracking across forced flush. String key is
+ * changed to longer value when the batch is nearly full, so the batch is
+ * flushed and the change starts new batch with old value of different
+ * length. Every change has to be delivered with intact values.
+ *
+ * Needs running corosync.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <corosync/corotypes.h>
+#include <corosync/cmap.h>
+#include <corosync/ipc_cmap.h>
+
+#define TEST_PREFIX		"testcmapcoalesce."
+#define TEST_KEY		TEST_PREFIX "str"
+#define TEST_WINDOW		1000
+
+#define SHORT_LEN		1000
+#define LONG_LEN		3000
+#define FILL_LEN		1000
+#define FILL_MAX		128
+
+static int key_changes;
+static int key_errors;
+static int fill_changes;
+static int fill_errors;
+
+static int value_check (struct cmap_notify_value val, char c, size_t len)
+{
+	const char *str = val.data;
+	size_t i;
+
+	if (val.type != CMAP_VALUETYPE_STRING || val.len != len + 1 || str[len] != '\0') {
+		return (-1);
+	}
+
+	for (i = 0; i < len; i++) {
+		if (str[i] != c) {
+			return (-1);
+		}
+	}
+
+	return (0);
+}
+
+static void notify_fn (
+	cmap_handle_t cmap_handle,
+	cmap_track_handle_t cmap_track_handle,
+	int32_t event,
+	const char *key_name,
+	struct cmap_notify_value new_val,
+	struct cmap_notify_value old_val,
+	void *user_data)
+{
+	if (strcmp (key_name, TEST_KEY) != 0) {
+		fill_changes++;
+		if (event != CMAP_TRACK_ADD || value_check (new_val, 'f', FILL_LEN) != 0) {
+			printf ("Bad notification of %s\n", key_name);
+			fill_errors++;
+		}
+		return ;
+	}
+
+	key_changes++;
+	switch (key_changes) {
+	case 1:
+		if (event != CMAP_TRACK_ADD || value_check (new_val, 'a', SHORT_LEN) != 0) {
+			key_errors++;
+		}
+		break;
+	case 2:
+		if (event != CMAP_TRACK_MODIFY ||
+		    value_check (old_val, 'a', SHORT_LEN) != 0 ||
+		    value_check (new_val, 'b', LONG_LEN) != 0) {
+			key_errors++;
+		}
+		break;
+	default:
+		key_errors++;
+		break;
+	}
+}
+
+static size_t item_size (const char *key_name, size_t new_len, size_t old_len)
+{
+	return (CMAP_NOTIFY_BATCH_ITEM_SIZE (new_len, old_len, strlen (key_name) + 1));
+}
+
+static char *value_create (char c, size_t len)
+{
+	char *str;
+
+	str = malloc (len + 1);
+	if (str == NULL) {
+		printf ("Can't allocate memory\n");
+		exit (1);
+	}
+	memset (str, c, len);
+	str[len] = '\0';
+
+	return (str);
+}
+
+int main (int argc, char *argv[])
+{
+	cmap_handle_t handle;
+	cmap_track_handle_t track_handle;
+	char key_name[CMAP_KEYNAME_MAXLEN];
+	char *short_str, *long_str, *fill_str;
+	size_t batch_size;
+	int fills = 0;
+	int fills_expected;
+	int i;
+	cs_error_t err;
+
+	short_str = value_create ('a', SHORT_LEN);
+	long_str = value_create ('b', LONG_LEN);
+	fill_str = value_create ('f', FILL_LEN);
+
+	err = cmap_initialize (&handle);
+	if (err != CS_OK) {
+		printf ("Could not initialize cmap, error %d\n", err);
+		exit (1);
+	}
+
+	err = cmap_track_add_coalesced (handle, TEST_PREFIX,
+		CMAP_TRACK_ADD | CMAP_TRACK_DELETE | CMAP_TRACK_MODIFY | CMAP_TRACK_PREFIX,
+		TEST_WINDOW, notify_fn, NULL, &track_handle);
+	if (err != CS_OK) {
+		printf ("Could not add track, error %d\n", err);
+		exit (1);
+	}
+
+	/*
+	 * Fill the batch so the change of TEST_KEY doesn't fit anymore
+	 */
+	err = cmap_set_string (handle, TEST_KEY, short_str);
+	batch_size = sizeof (struct res_lib_cmap_notify_batch_callback) +
+		item_size (TEST_KEY, SHORT_LEN + 1, 0);
+
+	snprintf (key_name, sizeof (key_name), TEST_PREFIX "fill.%03d", fills);
+	while (err == CS_OK && fills < FILL_MAX &&
+	    batch_size + item_size (key_name, FILL_LEN + 1, 0) <= CMAP_NOTIFY_BATCH_MAX_SIZE) {
+		err = cmap_set_string (handle, key_name, fill_str);
+		batch_size += item_size (key_name, FILL_LEN + 1, 0);
+		fills++;
+		snprintf (key_name, sizeof (key_name), TEST_PREFIX "fill.%03d", fills);
+	}
+
+	/*
+	 * Forces flush, change is then the first one of new batch, followed
+	 * by few more
+	 */
+	if (err == CS_OK) {
+		err = cmap_set_string (handle, TEST_KEY, long_str);
+	}
+
+	for (i = 0; err == CS_OK && i < 8 && fills < FILL_MAX; i++) {
+		snprintf (key_name, sizeof (key_name), TEST_PREFIX "fill.%03d", fills);
+		err = cmap_set_string (handle, key_name, fill_str);
+		fills++;
+	}
+
+	if (err != CS_OK) {
+		printf ("Could not set key, error %d\n", err);
+		exit (1);
+	}
+	fills_expected = fills;
+
+	for (i = 0; i < 5 * TEST_WINDOW / 100 &&
+	    (key_changes < 2 || fill_changes < fills_expected); i++) {
+		cmap_dispatch (handle, CS_DISPATCH_ALL);
+		usleep (100000);
+	}
+
+	cmap_track_delete (handle, track_handle);
+
+	cmap_delete (handle, TEST_KEY);
+	for (i = 0; i < fills; i++) {
+		snprintf (key_name, sizeof (key_name), TEST_PREFIX "fill.%03d", i);
+		cmap_delete (handle, key_name);
+	}
+
+	cmap_finalize (handle);
+
+	free (short_str);
+	free (long_str);
+	free (fill_str);
+
+	printf ("%s changes: %d (errors %d), fill changes: %d of %d (errors %d)\n",
+		TEST_KEY, key_changes, key_errors, fill_changes, fills_expected, fill_errors);
+
+	if (key_changes != 2 || key_errors != 0 ||
+	    fill_changes != fills_expected || fill_errors != 0) {
+		printf ("FAIL\n");
+		return (1);
+	}
+
+	printf ("PASS\n");
+	return (0);
+}
@@ -50,6 +50,7 @@
 #include <corosync/corotypes.h>
 #include <corosync/totem/totem.h>
 #include <corosync/cfg.h>
+#include <corosync/cmap.h>
 
 #define cs_repeat(result, max, code)				\
 	do {							\
@@ -73,6 +74,7 @@ enum user_action {
 	ACTION_SHUTDOW,
 	ACTION_SHOWADDR,
 	ACTION_KILL_NODE,
+	ACTION_TIMELINE,
 };
 
 static int
@@ -303,10 +305,81 @@ static void killnode_do(unsigned int nodeid)
 	(void)corosync_cfg_finalize (handle);
 }
 
+static int timeline_do(void)
+{
+	cs_error_t result;
+	cmap_handle_t handle;
+	char key_name[CMAP_KEYNAME_MAXLEN];
+	uint64_t seq, time_us, first_time = 0, prev_time = 0;
+	uint32_t arg, value;
+	char *event;
+	int entries = 0;
+	int i;
+
+	result = cmap_initialize_map (&handle, CMAP_MAP_STATS);
+	if (result != CS_OK) {
+		fprintf (stderr, "Could not initialize corosync cmap API error %s\n", cs_strerror(result));
+		exit (1);
+	}
+
+	/*
+	 * Entries are ordered from the oldest one, unused entries have seq 0
+	 */
+	for (i = 0; ; i++) {
+		snprintf (key_name, sizeof (key_name), "stats.timeline.%02d.seq", i);
+		result = cmap_get_uint64 (handle, key_name, &seq);
+		if (result != CS_OK) {
+			break;
+		}
+		if (seq == 0) {
+			continue;
+		}
+
+		snprintf (key_name, sizeof (key_name), "stats.timeline.%02d.time", i);
+		if (cmap_get_uint64 (handle, key_name, &time_us) != CS_OK) {
+			continue;
+		}
+		snprintf (key_name, sizeof (key_name), "stats.timeline.%02d.arg", i);
+		if (cmap_get_uint32 (handle, key_name, &arg) != CS_OK) {
+			continue;
+		}
+		snprintf (key_name, sizeof (key_name), "stats.timeline.%02d.value", i);
+		if (cmap_get_uint32 (handle, key_name, &value) != CS_OK) {
+			continue;
+		}
+		snprintf (key_name, sizeof (key_name), "stats.timeline.%02d.event", i);
+		if (cmap_get_string (handle, key_name, &event) != CS_OK) {
+			continue;
+		}
+
+		if (entries == 0) {
+			printf ("%8s %12s %10s  %-24s %10s %10s\n",
+				"seq", "time (ms)", "delta (ms)", "event", "arg", "value");
+			first_time = prev_time = time_us;
+		}
+		printf ("%8llu %12.3f %10.3f  %-24s %10u %10u\n",
+			(unsigned long long)seq,
+			(double)(time_us - first_time) / 1000.0,
+			(double)(time_us - prev_time) / 1000.0,
+			event, arg, value);
+		free (event);
+
+		prev_time = time_us;
+		entries++;
+	}
+
+	if (entries == 0) {
+		printf ("No membership events recorded\n");
+	}
+
+	(void)cmap_finalize (handle);
+
+	return (0);
+}
 
 static void usage_do (void)
 {
-	printf ("corosync-cfgtool [[-i <interface ip>] [-b] -s] [-R] [-L] [-k nodeid] [-a nodeid] [-h] [-H]\n\n");
+	printf ("corosync-cfgtool [[-i <interface ip>] [-b] -s] [-R] [-L] [-k nodeid] [-a nodeid] [-t] [-h] [-H]\n\n");
 	printf ("A tool for displaying and configuring active parameters within corosync.\n");
 	printf ("options:\n");
 	printf ("\t-i\tFinds only information about the specified interface IP address when used with -s..\n");
@@ -316,12 +389,13 @@ static void usage_do (void)
 	printf ("\t-L\tTell corosync to reopen all logging files.\n");
 	printf ("\t-k\tKill a node identified by node id.\n");
 	printf ("\t-a\tDisplay the IP address(es) of a node\n");
+	printf ("\t-t\tDisplay timeline of recent membership changes and synchronization.\n");
 	printf ("\t-h\tPrint basic usage.\n");
 	printf ("\t-H\tShutdown corosync cleanly on this node.\n");
 }
 
 int main (int argc, char *argv[]) {
-	const char *options = "i:sbrRLk:a:hH";
+	const char *options = "i:sbrRLk:a:thH";
 	int opt;
 	unsigned int nodeid = 0;
 	char interface_name[128] = "";
@@ -354,6 +428,9 @@ int main (int argc, char *argv[]) {
 		case 'H':
 			action = ACTION_SHUTDOW;
 			break;
+		case 't':
+			action = ACTION_TIMELINE;
+			break;
 		case 'a':
 			nodeid = atoi (optarg);
 			action = ACTION_SHOWADDR;
@@ -385,6 +462,9 @@ int main (int argc, char *argv[]) {
 	case ACTION_SHOWADDR:
 		showaddrs_do(nodeid);
 		break;
+	case ACTION_TIMELINE:
+		rc = timeline_do();
+		break;
 	case ACTION_NOOP:
 	default:
 		usage_do();
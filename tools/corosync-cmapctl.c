@@ -34,12 +34,21 @@
 
 #include <config.h>
 
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
 #include <stdio.h>
 #include <poll.h>
 
 #include <corosync/corotypes.h>
 #include <corosync/cmap.h>
+#include <corosync/stats_shm.h>
 #include "../lib/util.h"
 
 #ifndef INFTIM
@@ -48,6 +57,13 @@
 
 #define MAX_TRY_AGAIN 10
 
+/*
+ * Keys are fetched in bulks. Buffer is large enough to usually get
+ * whole map in few round trips.
+ */
+#define BULK_BUF_LEN		(256 * 1024)
+#define BULK_MAX_ITEMS		1024
+
 enum user_action {
 	ACTION_GET,
 	ACTION_SET,
@@ -57,6 +73,8 @@ enum user_action {
 	ACTION_TRACK,
 	ACTION_LOAD,
 	ACTION_CLEARSTATS,
+	ACTION_PRINT_SHM,
+	ACTION_EXPORT,
 };
 
 struct name_to_type_item {
@@ -97,7 +115,7 @@ static int convert_name_to_type(const char *name)
 static int print_help(void)
 {
 	printf("\n");
-	printf("usage:  corosync-cmapctl [-b] [-DdghsqTCt] [-p filename] [-m map] [params...]\n");
+	printf("usage:  corosync-cmapctl [-b] [-DdghsqSTCt] [-p filename] [-E target [-i interval]] [-m map] [params...]\n");
 	printf("\n");
 	printf("    -b show binary values\n");
 	printf("\n");
@@ -146,6 +164,15 @@ static int print_help(void)
 	printf("Display keys with prefix key_name:\n");
 	printf("    corosync-cmapctl [-b] key_name...\n");
 	printf("\n");
+	printf("Display stats published in shared memory (qb.stats_shm) with prefix key_name:\n");
+	printf("    corosync-cmapctl [-q] -S [key_name...]\n");
+	printf("    No IPC to corosync is used\n");
+	printf("\n");
+	printf("Export stats in OpenMetrics text format:\n");
+	printf("    corosync-cmapctl -E [-|file|unix:socket] [-i interval]\n");
+	printf("    - prints stats once, file is rewritten every interval seconds (default 1)\n");
+	printf("    and unix socket sends current stats to every connected client\n");
+	printf("\n");
 	printf("Track changes on keys with key_name:\n");
 	printf("    corosync-cmapctl [-b] -t key_name\n");
 	printf("\n");
@@ -411,48 +438,147 @@ static void print_key(cmap_handle_t handle,
 	printf("\n");
 }
 
+struct stats_shm_filter {
+	int no_prefixes;
+	char **prefixes;
+};
+
+static void print_stats_shm_key(const char *key_name, uint64_t value, void *user_data)
+{
+	struct stats_shm_filter *filter = (struct stats_shm_filter *)user_data;
+	int i;
+
+	if (filter->no_prefixes > 0) {
+		for (i = 0; i < filter->no_prefixes; i++) {
+			if (strncmp(key_name, filter->prefixes[i], strlen(filter->prefixes[i])) == 0) {
+				break;
+			}
+		}
+		if (i == filter->no_prefixes) {
+			return ;
+		}
+	}
+
+	if (!quiet) {
+		printf("%s (u64) = %"PRIu64"\n", key_name, value);
+	} else {
+		printf("%"PRIu64"\n", value);
+	}
+}
+
+static int print_stats_shm(int argc, char **argv)
+{
+	const struct cs_stats_shm *shm;
+	struct cs_stats_shm *copy;
+	struct stats_shm_filter filter;
+	cs_error_t err;
+	int no_retries;
+
+	err = cs_stats_shm_map(&shm);
+	if (err != CS_OK) {
+		fprintf(stderr, "Failed to map stats shared memory (is qb.stats_shm enabled?). Error %s\n",
+		    cs_strerror(err));
+		return (EXIT_FAILURE);
+	}
+
+	copy = malloc(shm->size);
+	if (copy == NULL) {
+		fprintf(stderr, "Can't alloc memory\n");
+		cs_stats_shm_unmap(shm);
+		return (EXIT_FAILURE);
+	}
+
+	no_retries = 0;
+	while ((err = cs_stats_shm_read(shm, copy)) == CS_ERR_TRY_AGAIN && no_retries++ < MAX_TRY_AGAIN) {
+		sleep(1);
+	}
+
+	if (err == CS_OK) {
+		filter.no_prefixes = argc;
+		filter.prefixes = argv;
+		cs_stats_shm_iter(copy, print_stats_shm_key, &filter);
+	} else {
+		fprintf(stderr, "Can't read stats shared memory. Error %s\n", cs_strerror(err));
+	}
+
+	free(copy);
+	cs_stats_shm_unmap(shm);
+
+	return (err == CS_OK ? 0 : EXIT_FAILURE);
+}
+
 static void print_iter(cmap_handle_t handle, const char *prefix)
 {
 	cmap_iter_handle_t iter_handle;
-	char key_name[CMAP_KEYNAME_MAXLEN + 1];
-	size_t value_len;
-	cmap_value_types_t type;
+	struct cmap_bulk_item items[BULK_MAX_ITEMS];
+	size_t no_items;
+	size_t i;
+	void *buf;
 	cs_error_t err;
 
+	buf = malloc(BULK_BUF_LEN);
+	if (buf == NULL) {
+		fprintf(stderr, "Can't alloc memory\n");
+		exit(EXIT_FAILURE);
+	}
+
 	err = cmap_iter_init(handle, prefix, &iter_handle);
 	if (err != CS_OK) {
 		fprintf (stderr, "Failed to initialize iteration. Error %s\n", cs_strerror(err));
 		exit (EXIT_FAILURE);
 	}
 
-	while ((err = cmap_iter_next(handle, iter_handle, key_name, &value_len, &type)) == CS_OK) {
-		print_key(handle, key_name, value_len, NULL, type);
+	no_items = BULK_MAX_ITEMS;
+	while ((err = cmap_iter_next_bulk(handle, iter_handle, buf, BULK_BUF_LEN, items, &no_items)) == CS_OK) {
+		for (i = 0; i < no_items; i++) {
+			/*
+			 * Empty binary value is fetched again so it's printed as *empty*
+			 */
+			print_key(handle, items[i].key_name, items[i].value_len,
+			    (items[i].value_len > 0 ? items[i].value : NULL), items[i].type);
+		}
+		no_items = BULK_MAX_ITEMS;
 	}
 	cmap_iter_finalize(handle, iter_handle);
+
+	free(buf);
 }
 
 static void delete_with_prefix(cmap_handle_t handle, const char *prefix)
 {
 	cmap_iter_handle_t iter_handle;
-	char key_name[CMAP_KEYNAME_MAXLEN + 1];
-	size_t value_len;
-	cmap_value_types_t type;
+	struct cmap_bulk_item items[BULK_MAX_ITEMS];
+	size_t no_items;
+	size_t i;
+	void *buf;
 	cs_error_t err;
 	cs_error_t err2;
 
+	buf = malloc(BULK_BUF_LEN);
+	if (buf == NULL) {
+		fprintf(stderr, "Can't alloc memory\n");
+		exit(EXIT_FAILURE);
+	}
+
 	err = cmap_iter_init(handle, prefix, &iter_handle);
 	if (err != CS_OK) {
 		fprintf (stderr, "Failed to initialize iteration. Error %s\n", cs_strerror(err));
 		exit (EXIT_FAILURE);
 	}
 
-	while ((err = cmap_iter_next(handle, iter_handle, key_name, &value_len, &type)) == CS_OK) {
-		err2 = cmap_delete(handle, key_name);
-		if (err2 != CS_OK) {
-			fprintf(stderr, "Can't delete key %s. Error %s\n", key_name, cs_strerror(err2));
+	no_items = BULK_MAX_ITEMS;
+	while ((err = cmap_iter_next_bulk(handle, iter_handle, buf, BULK_BUF_LEN, items, &no_items)) == CS_OK) {
+		for (i = 0; i < no_items; i++) {
+			err2 = cmap_delete(handle, items[i].key_name);
+			if (err2 != CS_OK) {
+				fprintf(stderr, "Can't delete key %s. Error %s\n", items[i].key_name, cs_strerror(err2));
+			}
 		}
+		no_items = BULK_MAX_ITEMS;
 	}
 	cmap_iter_finalize(handle, iter_handle);
+
+	free(buf);
 }
 
 static void cmap_notify_fn(
@@ -793,6 +919,729 @@ static void clear_stats(cmap_handle_t handle, char *clear_opt)
 	cmap_set_uint32(handle, key_name, 1);
 }
 
+/*
+ * OpenMetrics exporter (-E). Stats map is fetched using bulk iteration over
+ * one persistent connection and converted to OpenMetrics text format.
+ */
+enum exporter_metric_type {
+	EXPORTER_COUNTER,
+	EXPORTER_GAUGE,
+	EXPORTER_HISTOGRAM,
+};
+
+enum exporter_hist_part {
+	EXPORTER_HIST_BUCKET,
+	EXPORTER_HIST_SUM,
+};
+
+struct exporter_sample {
+	char family[CMAP_KEYNAME_MAXLEN + 16];
+	char labels[CMAP_KEYNAME_MAXLEN];
+	enum exporter_metric_type metric_type;
+	enum exporter_hist_part hist_part;
+	/*
+	 * Upper bound of histogram bucket (UINT64_MAX is +Inf)
+	 */
+	uint64_t le;
+	/*
+	 * Value and le are in 1/10^scale_digits of unit of metric
+	 */
+	int scale_digits;
+	int is_signed;
+	uint64_t value;
+	size_t order;
+};
+
+/*
+ * Histograms of token metrics (stats.srp.NAME_hist_le_X and NAME_sum).
+ * Times are measured in milliseconds but exported in seconds, backlog
+ * is number of messages.
+ */
+struct exporter_hist {
+	const char *name;
+	const char *unit;
+	int scale_digits;
+};
+
+static const struct exporter_hist exporter_hists[] = {
+	{ "mtt_rx_token", "seconds", 3 },
+	{ "token_workload", "seconds", 3 },
+	{ "backlog_calc", "messages", 0 },
+};
+
+struct exporter_samples {
+	struct exporter_sample *samples;
+	size_t no_samples;
+	size_t allocated;
+};
+
+static volatile sig_atomic_t exporter_stop;
+static cmap_handle_t exporter_handle;
+static int exporter_connected;
+
+/*
+ * Stats which are not monotonic counters. Names ending with _min, _max, _ave,
+ * _p50 and _p99 are gauges too.
+ */
+static const char *exporter_gauge_names[] = {
+	"msg_queue_avail", "msg_reserved",
+	"time_since_token_last_received", "continuous_gather",
+	"continuous_sendmsg_failures", "firewall_enabled_or_nic_failure",
+	"mtt_rx_token", "avg_token_workload", "avg_backlog_calc",
+	"enabled", "connected", "mtu", "latency_samples",
+	"active", "queued_bytes", "queueing", "queued", "flush_batch_last",
+	"fc_priority", "fc_credits", "flow_control",
+	"tx_crypt_byte_overhead",
+};
+
+static const char *exporter_gauge_suffixes[] = {
+	"_min", "_max", "_ave", "_p50", "_p99",
+};
+
+#define HIST_LE_STR	"_hist_le_"
+#define HIST_SUM_STR	"_sum"
+
+/*
+ * Client which doesn't read stats is dropped after this many seconds
+ */
+#define EXPORTER_CLIENT_TIMEOUT	5
+
+static void exporter_sigterm_handler(int num)
+{
+	exporter_stop = 1;
+}
+
+static enum exporter_metric_type exporter_get_metric_type(const char *stat_name)
+{
+	size_t i;
+	size_t name_len, suffix_len;
+
+	for (i = 0; i < sizeof(exporter_gauge_names) / sizeof(exporter_gauge_names[0]); i++) {
+		if (strcmp(stat_name, exporter_gauge_names[i]) == 0) {
+			return (EXPORTER_GAUGE);
+		}
+	}
+
+	name_len = strlen(stat_name);
+	for (i = 0; i < sizeof(exporter_gauge_suffixes) / sizeof(exporter_gauge_suffixes[0]); i++) {
+		suffix_len = strlen(exporter_gauge_suffixes[i]);
+		if (name_len > suffix_len &&
+		    strcmp(stat_name + name_len - suffix_len, exporter_gauge_suffixes[i]) == 0) {
+			return (EXPORTER_GAUGE);
+		}
+	}
+
+	return (EXPORTER_COUNTER);
+}
+
+static int exporter_get_value(const struct cmap_bulk_item *item, uint64_t *value, int *is_signed)
+{
+	int8_t i8;
+	uint8_t u8;
+	int16_t i16;
+	uint16_t u16;
+	int32_t i32;
+	uint32_t u32;
+	int64_t i64;
+
+	*is_signed = 0;
+
+	switch (item->type) {
+	case CMAP_VALUETYPE_INT8:
+		memcpy(&i8, item->value, sizeof(i8));
+		*value = (uint64_t)(int64_t)i8;
+		*is_signed = 1;
+		break;
+	case CMAP_VALUETYPE_UINT8:
+		memcpy(&u8, item->value, sizeof(u8));
+		*value = u8;
+		break;
+	case CMAP_VALUETYPE_INT16:
+		memcpy(&i16, item->value, sizeof(i16));
+		*value = (uint64_t)(int64_t)i16;
+		*is_signed = 1;
+		break;
+	case CMAP_VALUETYPE_UINT16:
+		memcpy(&u16, item->value, sizeof(u16));
+		*value = u16;
+		break;
+	case CMAP_VALUETYPE_INT32:
+		memcpy(&i32, item->value, sizeof(i32));
+		*value = (uint64_t)(int64_t)i32;
+		*is_signed = 1;
+		break;
+	case CMAP_VALUETYPE_UINT32:
+		memcpy(&u32, item->value, sizeof(u32));
+		*value = u32;
+		break;
+	case CMAP_VALUETYPE_INT64:
+		memcpy(&i64, item->value, sizeof(i64));
+		*value = (uint64_t)i64;
+		*is_signed = 1;
+		break;
+	case CMAP_VALUETYPE_UINT64:
+		memcpy(value, item->value, sizeof(*value));
+		break;
+	default:
+		/*
+		 * Strings (procname), floats and binary values are not exported
+		 */
+		return (-1);
+	}
+
+	return (0);
+}
+
+static void exporter_sanitize_name(char *name)
+{
+	for (; *name != '\0'; name++) {
+		if (!isalnum(*name) && *name != '_' && *name != ':') {
+			*name = '_';
+		}
+	}
+}
+
+/*
+ * Convert stats map key to metric family, labels and stat name (last part
+ * of key). Returns -1 if key is not recognized.
+ */
+static int exporter_parse_key(const char *key_name,
+	struct exporter_sample *sample,
+	const char **stat_name)
+{
+	unsigned int nodeid, link_no, service, pid;
+	char conn[64];
+	const char *name;
+	int pos;
+
+	name = strrchr(key_name, '.');
+	if (name == NULL || strncmp(key_name, "stats.", strlen("stats.")) != 0) {
+		return (-1);
+	}
+
+	/*
+	 * Timeline is ring of events, not metrics. Its entries are reused, so
+	 * exporting them would produce series with meaningless values.
+	 */
+	if (strncmp(key_name, "stats.timeline.", strlen("stats.timeline.")) == 0) {
+		return (-1);
+	}
+	name++;
+	*stat_name = name;
+	sample->labels[0] = '\0';
+
+	pos = 0;
+	if (sscanf(key_name, "stats.knet.node%u.link%u.%n", &nodeid, &link_no, &pos) == 2 && pos > 0) {
+		snprintf(sample->family, sizeof(sample->family), "corosync_knet_link_%s", name);
+		snprintf(sample->labels, sizeof(sample->labels), "nodeid=\"%u\",link=\"%u\"",
+		    nodeid, link_no);
+	} else if (strncmp(key_name, "stats.knet.handle.", strlen("stats.knet.handle.")) == 0) {
+		snprintf(sample->family, sizeof(sample->family), "corosync_knet_handle_%s", name);
+	} else if (strncmp(key_name, "stats.ipcs.global.", strlen("stats.ipcs.global.")) == 0) {
+		snprintf(sample->family, sizeof(sample->family), "corosync_ipcs_%s", name);
+	} else if (sscanf(key_name, "stats.ipcs.service%u.%u.%63[^.].%n", &service, &pid, conn, &pos) == 3 &&
+	    pos > 0) {
+		snprintf(sample->family, sizeof(sample->family), "corosync_ipcs_conn_%s", name);
+		snprintf(sample->labels, sizeof(sample->labels), "service=\"%u\",pid=\"%u\",conn=\"%s\"",
+		    service, pid, conn);
+	} else {
+		/*
+		 * stats.pg.*, stats.srp.* and anything added later
+		 */
+		snprintf(sample->family, sizeof(sample->family), "corosync_%s", key_name + strlen("stats."));
+	}
+
+	exporter_sanitize_name(sample->family);
+
+	return (0);
+}
+
+static int exporter_add_item(struct exporter_samples *samples, const struct cmap_bulk_item *item)
+{
+	struct exporter_sample *sample;
+	struct exporter_sample *new_samples;
+	const struct exporter_hist *hist;
+	const char *stat_name;
+	const char *hist_str;
+	size_t name_len;
+	size_t family_len;
+	size_t i;
+
+	if (samples->no_samples == samples->allocated) {
+		new_samples = realloc(samples->samples,
+		    sizeof(*samples->samples) * (samples->allocated + BULK_MAX_ITEMS));
+		if (new_samples == NULL) {
+			return (-1);
+		}
+		samples->samples = new_samples;
+		samples->allocated += BULK_MAX_ITEMS;
+	}
+
+	sample = &samples->samples[samples->no_samples];
+	memset(sample, 0, sizeof(*sample));
+
+	if (exporter_get_value(item, &sample->value, &sample->is_signed) != 0 ||
+	    exporter_parse_key(item->key_name, sample, &stat_name) != 0) {
+		return (0);
+	}
+
+	sample->metric_type = exporter_get_metric_type(stat_name);
+
+	/*
+	 * Histogram buckets and sum (like stats.srp.mtt_rx_token_hist_le_10
+	 * and stats.srp.mtt_rx_token_sum) are merged into one histogram
+	 * family with unit (corosync_srp_mtt_rx_token_seconds)
+	 */
+	for (i = 0; i < sizeof(exporter_hists) / sizeof(exporter_hists[0]); i++) {
+		hist = &exporter_hists[i];
+		name_len = strlen(hist->name);
+
+		if (strncmp(stat_name, hist->name, name_len) != 0) {
+			continue;
+		}
+		hist_str = stat_name + name_len;
+
+		if (strncmp(hist_str, HIST_LE_STR, strlen(HIST_LE_STR)) == 0) {
+			hist_str += strlen(HIST_LE_STR);
+			if (strcmp(hist_str, "inf") == 0) {
+				sample->le = UINT64_MAX;
+			} else {
+				sample->le = strtoull(hist_str, NULL, 10);
+			}
+			sample->hist_part = EXPORTER_HIST_BUCKET;
+		} else if (strcmp(hist_str, HIST_SUM_STR) == 0) {
+			sample->hist_part = EXPORTER_HIST_SUM;
+		} else {
+			continue;
+		}
+
+		/*
+		 * Family ends with (sanitized) stat name
+		 */
+		family_len = strlen(sample->family) - strlen(stat_name);
+		snprintf(sample->family + family_len, sizeof(sample->family) - family_len,
+		    "%s_%s", hist->name, hist->unit);
+		sample->scale_digits = hist->scale_digits;
+		sample->metric_type = EXPORTER_HISTOGRAM;
+		break;
+	}
+
+	sample->order = samples->no_samples;
+	samples->no_samples++;
+
+	return (0);
+}
+
+static int exporter_sample_compare(const void *a, const void *b)
+{
+	const struct exporter_sample *sa = a;
+	const struct exporter_sample *sb = b;
+	int res;
+
+	res = strcmp(sa->family, sb->family);
+	if (res != 0) {
+		return (res);
+	}
+
+	if (sa->hist_part != sb->hist_part) {
+		return (sa->hist_part < sb->hist_part ? -1 : 1);
+	}
+
+	if (sa->le != sb->le) {
+		return (sa->le < sb->le ? -1 : 1);
+	}
+
+	return (sa->order < sb->order ? -1 : (sa->order > sb->order ? 1 : 0));
+}
+
+/*
+ * Format value / 10^scale_digits exactly (without floating point)
+ */
+static void exporter_format_scaled(char *str, size_t str_len, uint64_t value, int scale_digits)
+{
+	uint64_t div = 1;
+	int i;
+
+	for (i = 0; i < scale_digits; i++) {
+		div *= 10;
+	}
+
+	if (div == 1) {
+		snprintf(str, str_len, "%"PRIu64, value);
+	} else {
+		snprintf(str, str_len, "%"PRIu64".%0*"PRIu64, value / div, scale_digits, value % div);
+	}
+}
+
+static void exporter_print_value(FILE *out, const struct exporter_sample *sample, uint64_t value)
+{
+	char str[32];
+
+	if (sample->scale_digits > 0) {
+		exporter_format_scaled(str, sizeof(str), value, sample->scale_digits);
+		fprintf(out, " %s\n", str);
+	} else if (sample->is_signed) {
+		fprintf(out, " %"PRId64"\n", (int64_t)value);
+	} else {
+		fprintf(out, " %"PRIu64"\n", value);
+	}
+}
+
+static void exporter_print_labels(FILE *out, const struct exporter_sample *sample, const char *extra)
+{
+	if (sample->labels[0] == '\0' && extra == NULL) {
+		return ;
+	}
+
+	fprintf(out, "{%s%s%s}", sample->labels,
+	    (sample->labels[0] != '\0' && extra != NULL ? "," : ""),
+	    (extra != NULL ? extra : ""));
+}
+
+static void exporter_print_samples(FILE *out, struct exporter_samples *samples)
+{
+	const struct exporter_sample *sample;
+	const char *last_family = "";
+	char le_value[32];
+	char le[48];
+	uint64_t cumulative = 0;
+	size_t i;
+
+	qsort(samples->samples, samples->no_samples, sizeof(*samples->samples), exporter_sample_compare);
+
+	for (i = 0; i < samples->no_samples; i++) {
+		sample = &samples->samples[i];
+
+		if (strcmp(sample->family, last_family) != 0) {
+			fprintf(out, "# TYPE %s %s\n", sample->family,
+			    (sample->metric_type == EXPORTER_COUNTER ? "counter" :
+			     (sample->metric_type == EXPORTER_GAUGE ? "gauge" : "histogram")));
+			last_family = sample->family;
+			cumulative = 0;
+		}
+
+		switch (sample->metric_type) {
+		case EXPORTER_COUNTER:
+			fprintf(out, "%s_total", sample->family);
+			exporter_print_labels(out, sample, NULL);
+			exporter_print_value(out, sample, sample->value);
+			break;
+		case EXPORTER_GAUGE:
+			fprintf(out, "%s", sample->family);
+			exporter_print_labels(out, sample, NULL);
+			exporter_print_value(out, sample, sample->value);
+			break;
+		case EXPORTER_HISTOGRAM:
+			if (sample->hist_part == EXPORTER_HIST_SUM) {
+				fprintf(out, "%s_sum", sample->family);
+				exporter_print_labels(out, sample, NULL);
+				exporter_print_value(out, sample, sample->value);
+				break;
+			}
+
+			cumulative += sample->value;
+			if (sample->le == UINT64_MAX) {
+				snprintf(le, sizeof(le), "le=\"+Inf\"");
+			} else {
+				exporter_format_scaled(le_value, sizeof(le_value), sample->le,
+				    sample->scale_digits);
+				snprintf(le, sizeof(le), "le=\"%s\"", le_value);
+			}
+
+			fprintf(out, "%s_bucket", sample->family);
+			exporter_print_labels(out, sample, le);
+			/*
+			 * Bucket values are counts, never scaled
+			 */
+			fprintf(out, " %"PRIu64"\n", cumulative);
+			if (sample->le == UINT64_MAX) {
+				fprintf(out, "%s_count", sample->family);
+				exporter_print_labels(out, sample, NULL);
+				fprintf(out, " %"PRIu64"\n", cumulative);
+			}
+			break;
+		}
+	}
+
+	fprintf(out, "# EOF\n");
+}
+
+/*
+ * Fetch stats map and store OpenMetrics text into newly allocated buffer
+ */
+static cs_error_t exporter_collect(char **text, size_t *text_len)
+{
+	struct exporter_samples samples;
+	cmap_iter_handle_t iter_handle;
+	struct cmap_bulk_item items[BULK_MAX_ITEMS];
+	size_t no_items;
+	size_t i;
+	void *buf;
+	FILE *out;
+	cs_error_t err;
+
+	if (!exporter_connected) {
+		err = cmap_initialize_map(&exporter_handle, CMAP_MAP_STATS);
+		if (err != CS_OK) {
+			return (err);
+		}
+		exporter_connected = 1;
+	}
+
+	buf = malloc(BULK_BUF_LEN);
+	if (buf == NULL) {
+		return (CS_ERR_NO_MEMORY);
+	}
+	memset(&samples, 0, sizeof(samples));
+
+	err = cmap_iter_init(exporter_handle, "stats.", &iter_handle);
+	if (err != CS_OK) {
+		goto error_free;
+	}
+
+	no_items = BULK_MAX_ITEMS;
+	while ((err = cmap_iter_next_bulk(exporter_handle, iter_handle, buf, BULK_BUF_LEN,
+	    items, &no_items)) == CS_OK) {
+		for (i = 0; i < no_items; i++) {
+			if (exporter_add_item(&samples, &items[i]) != 0) {
+				err = CS_ERR_NO_MEMORY;
+				break;
+			}
+		}
+		if (err != CS_OK) {
+			break;
+		}
+		no_items = BULK_MAX_ITEMS;
+	}
+	cmap_iter_finalize(exporter_handle, iter_handle);
+
+	if (err != CS_ERR_NO_SECTIONS) {
+		goto error_free;
+	}
+
+	out = open_memstream(text, text_len);
+	if (out == NULL) {
+		err = CS_ERR_NO_MEMORY;
+		goto error_free;
+	}
+	exporter_print_samples(out, &samples);
+	fclose(out);
+
+	err = CS_OK;
+
+error_free:
+	if (err != CS_OK && err != CS_ERR_NO_MEMORY && err != CS_ERR_TRY_AGAIN) {
+		/*
+		 * Probably corosync was restarted. Reconnect next time.
+		 */
+		cmap_finalize(exporter_handle);
+		exporter_connected = 0;
+	}
+	free(samples.samples);
+	free(buf);
+
+	return (err);
+}
+
+static int exporter_write_all(int fd, const char *text, size_t text_len)
+{
+	ssize_t res;
+
+	while (text_len > 0) {
+		res = write(fd, text, text_len);
+		if (res < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return (-1);
+		}
+		text += res;
+		text_len -= res;
+	}
+
+	return (0);
+}
+
+static int exporter_write_file(const char *file_name, const char *text, size_t text_len)
+{
+	char tmp_file_name[PATH_MAX];
+	int fd;
+
+	if (snprintf(tmp_file_name, sizeof(tmp_file_name), "%s.tmp", file_name) >= sizeof(tmp_file_name)) {
+		fprintf(stderr, "File name %s is too long\n", file_name);
+		return (-1);
+	}
+
+	fd = open(tmp_file_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1) {
+		fprintf(stderr, "Can't open file %s: %s\n", tmp_file_name, strerror(errno));
+		return (-1);
+	}
+
+	if (exporter_write_all(fd, text, text_len) != 0) {
+		fprintf(stderr, "Can't write file %s: %s\n", tmp_file_name, strerror(errno));
+		close(fd);
+		unlink(tmp_file_name);
+		return (-1);
+	}
+	close(fd);
+
+	/*
+	 * Readers see either old or new content, never partial one
+	 */
+	if (rename(tmp_file_name, file_name) != 0) {
+		fprintf(stderr, "Can't rename file %s: %s\n", tmp_file_name, strerror(errno));
+		unlink(tmp_file_name);
+		return (-1);
+	}
+
+	return (0);
+}
+
+static int exporter_listen(const char *socket_name)
+{
+	struct sockaddr_un addr;
+	struct stat st;
+	mode_t old_umask;
+	int res;
+	int fd;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(socket_name) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Socket name %s is too long\n", socket_name);
+		return (-1);
+	}
+	strcpy(addr.sun_path, socket_name);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd == -1) {
+		perror("socket");
+		return (-1);
+	}
+
+	/*
+	 * Replace only stale socket, never other file given by mistake
+	 */
+	if (lstat(socket_name, &st) == 0) {
+		if (!S_ISSOCK(st.st_mode)) {
+			fprintf(stderr, "%s exists and is not a socket\n", socket_name);
+			close(fd);
+			return (-1);
+		}
+		unlink(socket_name);
+	}
+
+	/*
+	 * Socket is accessible by owner and group
+	 */
+	old_umask = umask(S_IXUSR | S_IXGRP | S_IRWXO);
+	res = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+	umask(old_umask);
+
+	if (res != 0 || listen(fd, 16) != 0) {
+		fprintf(stderr, "Can't listen on socket %s: %s\n", socket_name, strerror(errno));
+		close(fd);
+		return (-1);
+	}
+
+	return (fd);
+}
+
+static int exporter_run(const char *target, int interval)
+{
+	struct pollfd pfd;
+	struct timeval tv;
+	char *text;
+	size_t text_len;
+	const char *socket_name = NULL;
+	int listen_fd = -1;
+	int fd;
+	int res = 0;
+	cs_error_t err;
+
+	signal(SIGINT, exporter_sigterm_handler);
+	signal(SIGTERM, exporter_sigterm_handler);
+	signal(SIGPIPE, SIG_IGN);
+
+	if (strncmp(target, "unix:", strlen("unix:")) == 0) {
+		socket_name = target + strlen("unix:");
+		listen_fd = exporter_listen(socket_name);
+		if (listen_fd == -1) {
+			return (EXIT_FAILURE);
+		}
+	}
+
+	while (!exporter_stop) {
+		if (listen_fd != -1) {
+			/*
+			 * Stats are collected on every connection
+			 */
+			pfd.fd = listen_fd;
+			pfd.events = POLLIN;
+			pfd.revents = 0;
+			if (poll(&pfd, 1, 1000) <= 0) {
+				continue;
+			}
+			fd = accept(listen_fd, NULL, NULL);
+			if (fd == -1) {
+				continue;
+			}
+
+			/*
+			 * Client which stopped reading must not block the exporter
+			 */
+			tv.tv_sec = EXPORTER_CLIENT_TIMEOUT;
+			tv.tv_usec = 0;
+			(void)setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+		} else {
+			fd = -1;
+		}
+
+		text = NULL;
+		err = exporter_collect(&text, &text_len);
+		if (err != CS_OK) {
+			fprintf(stderr, "Can't get stats. Error %s\n", cs_strerror(err));
+		}
+
+		if (fd != -1) {
+			if (err == CS_OK) {
+				(void)exporter_write_all(fd, text, text_len);
+			}
+			close(fd);
+		} else if (strcmp(target, "-") == 0) {
+			/*
+			 * One shot to stdout
+			 */
+			if (err == CS_OK) {
+				fwrite(text, 1, text_len, stdout);
+			} else {
+				res = EXIT_FAILURE;
+			}
+			free(text);
+			break;
+		} else {
+			if (err == CS_OK) {
+				(void)exporter_write_file(target, text, text_len);
+			}
+			sleep(interval);
+		}
+
+		free(text);
+	}
+
+	if (listen_fd != -1) {
+		close(listen_fd);
+		unlink(socket_name);
+	}
+
+	if (exporter_connected) {
+		cmap_finalize(exporter_handle);
+	}
+
+	return (res);
+}
+
 int main(int argc, char *argv[])
 {
 	enum user_action action;
@@ -808,11 +1657,13 @@ int main(int argc, char *argv[])
 	int no_retries;
 	char * clear_opt = NULL;
 	char * settings_file = NULL;
+	char * export_target = NULL;
+	int export_interval = 1;
 
 	action = ACTION_PRINT_PREFIX;
 	track_prefix = 1;
 
-	while ((c = getopt(argc, argv, "m:hqgsdDtTbp:C:")) != -1) {
+	while ((c = getopt(argc, argv, "m:hqgsdDtTSbp:C:E:i:")) != -1) {
 		switch (c) {
 		case 'h':
 			return print_help();
@@ -862,6 +1713,20 @@ int main(int argc, char *argv[])
 		case 'T':
 			action = ACTION_TRACK;
 			break;
+		case 'S':
+			action = ACTION_PRINT_SHM;
+			break;
+		case 'E':
+			action = ACTION_EXPORT;
+			export_target = optarg;
+			break;
+		case 'i':
+			export_interval = atoi(optarg);
+			if (export_interval < 1) {
+				fprintf(stderr, "interval must be positive number of seconds\n");
+				return (EXIT_FAILURE);
+			}
+			break;
 		case 'm':
 			if (strcmp(optarg, "icmap") == 0 ||
 			    strcmp(optarg, "default") == 0) {
@@ -892,11 +1757,21 @@ int main(int argc, char *argv[])
 	if (argc == 0 &&
 	    action != ACTION_LOAD &&
 	    action != ACTION_CLEARSTATS &&
-	    action != ACTION_PRINT_PREFIX) {
+	    action != ACTION_PRINT_PREFIX &&
+	    action != ACTION_PRINT_SHM &&
+	    action != ACTION_EXPORT) {
 		fprintf(stderr, "Expected key after options\n");
 		return (EXIT_FAILURE);
 	}
 
+	if (action == ACTION_PRINT_SHM) {
+		return (print_stats_shm(argc, argv));
+	}
+
+	if (action == ACTION_EXPORT) {
+		return (exporter_run(export_target, export_interval));
+	}
+
 	no_retries = 0;
 
 	while ((err = cmap_initialize_map(&handle, map)) == CS_ERR_TRY_AGAIN && no_retries++ < MAX_TRY_AGAIN) {
@@ -961,6 +1836,12 @@ int main(int argc, char *argv[])
 	case ACTION_CLEARSTATS:
 		clear_stats(handle, clear_opt);
 		break;
+	case ACTION_PRINT_SHM:
+	case ACTION_EXPORT:
+		/*
+		 * Handled before connecting to corosync
+		 */
+		break;
 
 	}
 
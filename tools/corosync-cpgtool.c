@@ -53,15 +53,33 @@
 #include <corosync/cfg.h>
 #include <corosync/cpg.h>
 
+/*
+ * Number of descriptions fetched by one cpg_iteration_next_bulk call
+ */
+#define ITERATION_BULK_ENTRIES	1024
+
 static corosync_cfg_handle_t cfg_handle;
 static cpg_handle_t cpg_handle;
 
+/*
+ * Addresses are printed for every group member, so cache them per nodeid
+ * to not ask cfg for each member again and again. Cache is kept sorted
+ * by nodeid.
+ */
+struct node_addrs_cache_entry {
+	unsigned int nodeid;
+	char *addrs;
+};
+
+static struct node_addrs_cache_entry *node_addrs_cache;
+static size_t node_addrs_cache_entries;
+
 typedef enum {
 	OPER_NAMES_ONLY = 1,
 	OPER_FULL_OUTPUT = 2,
 } operation_t;
 
-static void fprint_addrs(FILE *f, unsigned int nodeid)
+static void fprint_addrs_uncached(FILE *f, unsigned int nodeid)
 {
 	int numaddrs;
 	int i;
@@ -94,6 +112,86 @@ static void fprint_addrs(FILE *f, unsigned int nodeid)
 	}
 }
 
+/*
+ * Returns index of nodeid in cache or index where it should be inserted
+ */
+static size_t node_addrs_cache_find(unsigned int nodeid, int *found)
+{
+	size_t low = 0;
+	size_t high = node_addrs_cache_entries;
+	size_t mid;
+
+	*found = 0;
+
+	while (low < high) {
+		mid = low + (high - low) / 2;
+
+		if (node_addrs_cache[mid].nodeid == nodeid) {
+			*found = 1;
+			return (mid);
+		}
+
+		if (node_addrs_cache[mid].nodeid < nodeid) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return (low);
+}
+
+static void node_addrs_cache_free(void)
+{
+	size_t i;
+
+	for (i = 0; i < node_addrs_cache_entries; i++) {
+		free(node_addrs_cache[i].addrs);
+	}
+	free(node_addrs_cache);
+
+	node_addrs_cache = NULL;
+	node_addrs_cache_entries = 0;
+}
+
+static void fprint_addrs(FILE *f, unsigned int nodeid)
+{
+	struct node_addrs_cache_entry *new_cache;
+	char *buf = NULL;
+	size_t buf_size = 0;
+	FILE *mf;
+	size_t pos;
+	int found;
+
+	pos = node_addrs_cache_find(nodeid, &found);
+	if (found) {
+		fputs(node_addrs_cache[pos].addrs, f);
+		return ;
+	}
+
+	mf = open_memstream(&buf, &buf_size);
+	if (mf == NULL) {
+		fprint_addrs_uncached(f, nodeid);
+		return ;
+	}
+	fprint_addrs_uncached(mf, nodeid);
+	fclose(mf);
+
+	fputs(buf, f);
+
+	new_cache = realloc(node_addrs_cache, (node_addrs_cache_entries + 1) * sizeof(*node_addrs_cache));
+	if (new_cache == NULL) {
+		free(buf);
+		return ;
+	}
+	node_addrs_cache = new_cache;
+	memmove(&node_addrs_cache[pos + 1], &node_addrs_cache[pos],
+	    (node_addrs_cache_entries - pos) * sizeof(*node_addrs_cache));
+	node_addrs_cache[pos].nodeid = nodeid;
+	node_addrs_cache[pos].addrs = buf;
+	node_addrs_cache_entries++;
+}
+
 static void fprint_group (FILE *f, int escape, const struct cpg_name *group) {
 	int i;
 	char c;
@@ -116,24 +214,38 @@ static int display_groups (char delimiter, int escape)
 {
 	cs_error_t res;
 	cpg_iteration_handle_t iter_handle;
-	struct cpg_iteration_description_t description;
+	struct cpg_iteration_description_t *descriptions;
+	size_t entries;
+	size_t i;
+
+	descriptions = malloc(ITERATION_BULK_ENTRIES * sizeof(*descriptions));
+	if (descriptions == NULL) {
+		fprintf (stderr, "Cannot allocate memory for cpg iterator\n");
+
+		return 0;
+	}
 
 	res = cpg_iteration_initialize (cpg_handle, CPG_ITERATION_NAME_ONLY, NULL, &iter_handle);
 	if (res != CS_OK) {
 		fprintf (stderr, "Cannot initialize cpg iterator error %d\n", res);
+		free(descriptions);
 
 		return 0;
 	}
 
-	while ((res = cpg_iteration_next (iter_handle, &description)) == CS_OK) {
-		fprint_group (stdout, escape, &description.group);
-		fputc ((delimiter ? delimiter : '\n'), stdout);
+	while ((res = cpg_iteration_next_bulk (iter_handle, descriptions, ITERATION_BULK_ENTRIES,
+	    &entries)) == CS_OK) {
+		for (i = 0; i < entries; i++) {
+			fprint_group (stdout, escape, &descriptions[i].group);
+			fputc ((delimiter ? delimiter : '\n'), stdout);
+		}
 	}
 
 	if (delimiter)
 		putc ('\n', stdout);
 
 	cpg_iteration_finalize (iter_handle);
+	free(descriptions);
 
 	return 1;
 }
@@ -150,12 +262,23 @@ static inline int group_name_compare (
 static int display_groups_with_members (char delimiter, int escape) {
 	cs_error_t res;
 	cpg_iteration_handle_t iter_handle;
-	struct cpg_iteration_description_t description;
+	struct cpg_iteration_description_t *descriptions;
+	struct cpg_iteration_description_t *description;
 	struct cpg_name old_group;
+	size_t entries;
+	size_t i;
+
+	descriptions = malloc(ITERATION_BULK_ENTRIES * sizeof(*descriptions));
+	if (descriptions == NULL) {
+		fprintf (stderr, "Cannot allocate memory for cpg iterator\n");
+
+		return 0;
+	}
 
 	res = cpg_iteration_initialize (cpg_handle, CPG_ITERATION_ALL, NULL, &iter_handle);
 	if (res != CS_OK) {
 		fprintf (stderr, "Cannot initialize cpg iterator error %d\n", res);
+		free(descriptions);
 
 		return 0;
 	}
@@ -168,24 +291,31 @@ static int display_groups_with_members (char delimiter, int escape) {
 		fprintf (stdout, "Group Name\t%10s\t%10s\n", "PID", "Node ID");
 	}
 
-	while ((res = cpg_iteration_next (iter_handle, &description)) == CS_OK) {
-		if (!delimiter && group_name_compare (&old_group, &description.group) != 0) {
-			fprint_group (stdout, escape, &description.group);
-			fprintf (stdout, "\n");
+	while ((res = cpg_iteration_next_bulk (iter_handle, descriptions, ITERATION_BULK_ENTRIES,
+	    &entries)) == CS_OK) {
+		for (i = 0; i < entries; i++) {
+			description = &descriptions[i];
 
-			memcpy (&old_group, &description.group, sizeof (struct cpg_name));
-		}
+			if (!delimiter && group_name_compare (&old_group, &description->group) != 0) {
+				fprint_group (stdout, escape, &description->group);
+				fprintf (stdout, "\n");
 
-		if (!delimiter) {
-			fprintf (stdout, "\t\t%10u\t%10u (", description.pid, description.nodeid);
-			fprint_addrs (stdout, description.nodeid);
-			fprintf (stdout, ")\n");
-		} else {
-			fprint_group (stdout, escape, &description.group);
-			fprintf (stdout, "%c%u%c%u\n", delimiter, description.pid, delimiter, description.nodeid);
+				memcpy (&old_group, &description->group, sizeof (struct cpg_name));
+			}
+
+			if (!delimiter) {
+				fprintf (stdout, "\t\t%10u\t%10u (", description->pid, description->nodeid);
+				fprint_addrs (stdout, description->nodeid);
+				fprintf (stdout, ")\n");
+			} else {
+				fprint_group (stdout, escape, &description->group);
+				fprintf (stdout, "%c%u%c%u\n", delimiter, description->pid, delimiter, description->nodeid);
+			}
 		}
 	}
 
+	free(descriptions);
+
 	if (res != CS_ERR_NO_SECTIONS) {
 		fprintf (stderr, "cpg iteration error %d\n", res);
 
@@ -272,5 +402,7 @@ int main (int argc, char *argv[]) {
 	cpg_finalize (cpg_handle);
 	corosync_cfg_finalize (cfg_handle);
 
+	node_addrs_cache_free();
+
 	return (result ? EXIT_SUCCESS : EXIT_FAILURE);
 }
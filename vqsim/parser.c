@@ -31,6 +31,8 @@ static void do_usage(void)
 	printf("autofence  on|off\n");
 	printf("           automatically 'down' nodes on inquorate side on netsplit\n");
 	printf("show       Show current nodes status\n");
+	printf("wait       <msec>\n");
+	printf("           let time pass (in-process engine only)\n");
 	printf("exit\n\n");
 }
 
@@ -45,6 +47,7 @@ static void run_exit_cmd(int argc, char **argv);
 static void run_show_cmd(int argc, char **argv);
 static void run_autofence_cmd(int argc, char **argv);
 static void run_qdevice_cmd(int argc, char **argv);
+static void run_wait_cmd(int argc, char **argv);
 
 static struct cmd_list_struct {
 	const char *cmd;
@@ -59,6 +62,7 @@ static struct cmd_list_struct {
 	{ "autofence", 1, run_autofence_cmd},
 	{ "qdevice", 1, run_qdevice_cmd},
 	{ "show", 0, run_show_cmd},
+	{ "wait", 2, run_wait_cmd},
 	{ "exit", 0, run_exit_cmd},
 	{ "quit", 0, run_exit_cmd},
 	{ "q", 0, run_exit_cmd},
@@ -322,6 +326,11 @@ static void run_show_cmd(int argc, char **argv)
 	cmd_show_node_states();
 }
 
+static void run_wait_cmd(int argc, char **argv)
+{
+	cmd_wait(atoi(argv[1]));
+}
+
 static void run_exit_cmd(int argc, char **argv)
 {
 	cmd_stop_all_nodes();
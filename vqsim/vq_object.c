@@ -1,6 +1,6 @@
 /*
   This is a Votequorum object in the parent process. it's really just a conduit for the forked
-  votequorum entity
+  votequorum entity (or for the thread of the in-process engine)
 */
 
 #include <qb/qblog.h>
@@ -16,6 +16,7 @@ struct vq_instance
 	int nodeid;
 	int vq_socket;
 	pid_t pid;
+	struct inproc_node *inproc;
 };
 
 vq_object_t vq_create_instance(qb_loop_t *poll_loop, int nodeid)
@@ -26,6 +27,18 @@ vq_object_t vq_create_instance(qb_loop_t *poll_loop, int nodeid)
 	}
 
 	instance->nodeid = nodeid;
+	instance->vq_socket = -1;
+	instance->pid = 0;
+	instance->inproc = NULL;
+
+	if (inproc_enabled()) {
+		instance->inproc = inproc_new_instance(nodeid);
+		if (!instance->inproc) {
+			free(instance);
+			return NULL;
+		}
+		return instance;
+	}
 
 	if (fork_new_instance(nodeid, &instance->vq_socket, &instance->pid)) {
 		free(instance);
@@ -41,12 +54,28 @@ pid_t vq_get_pid(vq_object_t instance)
 	return vqi->pid;
 }
 
+/* CPU time (usec) used by the node, in-process engine only */
+uint64_t vq_get_cpu_time(vq_object_t instance)
+{
+	struct vq_instance *vqi = instance;
+
+	if (vqi->inproc) {
+		return inproc_node_cpu_time(vqi->inproc);
+	}
+	return 0;
+}
+
 void vq_quit(vq_object_t instance)
 {
 	struct vq_instance *vqi = instance;
 	struct vqsim_msg_header msg;
 	int res;
 
+	if (vqi->inproc) {
+		inproc_quit(vqi->inproc);
+		return;
+	}
+
 	msg.type = VQMSG_QUIT;
 	msg.from_nodeid = 0;
 	msg.param = 0;
@@ -63,6 +92,10 @@ int vq_quit_if_inquorate(vq_object_t instance)
 	struct vqsim_msg_header msg;
 	int res;
 
+	if (vqi->inproc) {
+		return inproc_quit_if_inquorate(vqi->inproc);
+	}
+
 	msg.type = VQMSG_QUORUMQUIT;
 	msg.from_nodeid = 0;
 	msg.param = 0;
@@ -81,6 +114,10 @@ int vq_set_nodelist(vq_object_t instance, struct memb_ring_id *ring_id, int *nod
 	struct vqsim_sync_msg *msg = (void*)msgbuf;
 	int res;
 
+	if (vqi->inproc) {
+		return inproc_set_nodelist(vqi->inproc, ring_id, nodeids, nodeids_entries);
+	}
+
 	msg->header.type = VQMSG_SYNC;
 	msg->header.from_nodeid = 0;
 	msg->header.param = 0;
@@ -102,6 +139,10 @@ int vq_set_qdevice(vq_object_t instance, struct memb_ring_id *ring_id, int onoff
 	struct vqsim_msg_header msg;
 	int res;
 
+	if (vqi->inproc) {
+		return inproc_set_qdevice(vqi->inproc, onoff);
+	}
+
 	msg.type = VQMSG_QDEVICE;
 	msg.from_nodeid = 0;
 	msg.param = onoff;
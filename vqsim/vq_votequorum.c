@@ -0,0 +1,10 @@
+
+/* votequorum for the in-process engine.
+
+   Same code as exec/votequorum.c but with all the state thread local,
+   so each thread of vqsim is a separate votequorum instance.
+*/
+
+#define VOTEQUORUM_THREAD_STATE 1
+
+#include "../exec/votequorum.c"
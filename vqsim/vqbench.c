@@ -0,0 +1,306 @@
+
+/* Benchmark of votequorum quorum recalculation.
+
+   Single votequorum instance (the 'observer' node) is driven directly
+   (no forked nodes, no sockets) thru repeated membership changes of a
+   big cluster. After every change, nodeinfo messages of all members are
+   delivered, same as during the nodeinfo storm following a merge, and
+   time spent in votequorum is measured.
+*/
+
+#include <config.h>
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <qb/qblog.h>
+#include <qb/qbipc_common.h>
+#include "../exec/votequorum.h"
+#include "../exec/service.h"
+#include "../include/corosync/corotypes.h"
+#include "../include/corosync/votequorum.h"
+#include "../include/corosync/ipc_votequorum.h"
+#include <corosync/logsys.h>
+#include <corosync/coroapi.h>
+#include "icmap.h"
+
+#define DEFAULT_NODES	384
+#define DEFAULT_ROUNDS	100
+
+/*
+ * Wire format of votequorum nodeinfo message (exec message 0)
+ */
+struct vqbench_nodeinfo {
+	struct qb_ipc_request_header header __attribute__((aligned(8)));
+	uint32_t nodeid;
+	uint32_t votes;
+	uint32_t expected_votes;
+	uint32_t flags;
+} __attribute__((packed));
+
+#define VQBENCH_NODE_FLAGS_QUORATE 1
+
+static struct corosync_service_engine *engine;
+static char *private_data;
+static void *fake_conn = (void*)1;
+static unsigned int our_nodeid = 1;
+static uint64_t mcast_msgs;
+static uint64_t quorum_changes;
+
+char *get_run_dir(void);
+
+static void api_error_memory_failure(void) __attribute__((noreturn));
+static void api_error_memory_failure()
+{
+	fprintf(stderr, "Out of memory error\n");
+	exit(-1);
+}
+
+static void api_timer_delete(corosync_timer_handle_t th)
+{
+}
+
+static int api_timer_add_duration (
+	unsigned long long nanosec_duration,
+	void *data,
+	void (*timer_fn) (void *data),
+	corosync_timer_handle_t *handle)
+{
+	/* Timers never expire during benchmark */
+	*handle = 0;
+	return 0;
+}
+
+static unsigned int api_totem_nodeid_get(void)
+{
+	return our_nodeid;
+}
+
+static int api_totem_mcast(const struct iovec *iov, unsigned int iovlen, unsigned int type)
+{
+	/* Messages of our node are not needed, nodeinfo of all nodes is generated */
+	mcast_msgs++;
+	return 0;
+}
+
+static void *api_ipc_private_data_get(void *conn)
+{
+	return private_data;
+}
+
+static int api_ipc_response_send(void *conn, const void *msg, size_t len)
+{
+	return 0;
+}
+
+static int api_ipc_dispatch_send(void *conn, const void *msg, size_t len)
+{
+	return 0;
+}
+
+static struct corosync_api_v1 corosync_api = {
+	.error_memory_failure = api_error_memory_failure,
+	.timer_delete = api_timer_delete,
+	.timer_add_duration = api_timer_add_duration,
+	.totem_nodeid_get = api_totem_nodeid_get,
+	.totem_mcast = api_totem_mcast,
+	.ipc_private_data_get = api_ipc_private_data_get,
+	.ipc_response_send = api_ipc_response_send,
+	.ipc_dispatch_send = api_ipc_dispatch_send,
+};
+
+static void quorum_fn(const unsigned int *view_list,
+		      size_t view_list_entries,
+		      int quorate, struct memb_ring_id *ring_id)
+{
+	quorum_changes++;
+}
+
+char *corosync_service_link_and_init(struct corosync_api_v1 *api,
+				     struct default_service *service_engine)
+{
+	/* dummy */
+	return NULL;
+}
+
+char *get_run_dir()
+{
+	static char cwd_buffer[PATH_MAX];
+
+	return getcwd(cwd_buffer, PATH_MAX);
+}
+
+static int load_quorum_instance(void)
+{
+	const char *error_string;
+
+	error_string = votequorum_init(&corosync_api, quorum_fn);
+	if (error_string) {
+		fprintf(stderr, "Votequorum init failed: %s\n", error_string);
+		return -1;
+	}
+
+	engine = votequorum_get_service_engine_ver0();
+	error_string = engine->exec_init_fn(&corosync_api);
+	if (error_string) {
+		fprintf(stderr, "votequorum exec init failed: %s\n", error_string);
+		return -1;
+	}
+
+	private_data = malloc(engine->private_data_size);
+	if (!private_data) {
+		perror("malloc failed");
+		return -1;
+	}
+
+	return engine->lib_init_fn(fake_conn);
+}
+
+static uint64_t time_usec(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return ((uint64_t)tv.tv_sec * 1000000ULL + tv.tv_usec);
+}
+
+/*
+ * Membership change followed by nodeinfo of every member. Returns time
+ * spent in votequorum (usec).
+ */
+static uint64_t run_round(unsigned int *member_list, size_t member_list_entries,
+	unsigned int expected_votes, uint64_t ring_seq, uint32_t flags)
+{
+	struct vqbench_nodeinfo nodeinfo;
+	struct memb_ring_id ring_id;
+	uint64_t start;
+	size_t i;
+
+	ring_id.nodeid = member_list[0];
+	ring_id.seq = ring_seq;
+
+	start = time_usec();
+
+	engine->sync_init(NULL, 0, member_list, member_list_entries, &ring_id);
+	while (engine->sync_process() != 0) {
+		;
+	}
+
+	memset(&nodeinfo, 0, sizeof(nodeinfo));
+	nodeinfo.header.size = sizeof(nodeinfo);
+	nodeinfo.header.id = 0;
+	nodeinfo.votes = 1;
+	nodeinfo.expected_votes = expected_votes;
+	nodeinfo.flags = flags;
+
+	for (i = 0; i < member_list_entries; i++) {
+		nodeinfo.nodeid = member_list[i];
+		engine->exec_engine[0].exec_handler_fn(&nodeinfo, member_list[i]);
+	}
+
+	engine->sync_activate();
+
+	return (time_usec() - start);
+}
+
+static void usage(char *program)
+{
+	printf("Usage:\n");
+	printf("\n");
+	printf("%s [-n <nodes>] [-r <rounds>]\n", program);
+	printf("\n");
+	printf("      -n      number of nodes in cluster (default %d)\n", DEFAULT_NODES);
+	printf("      -r      number of membership changes (default %d)\n", DEFAULT_ROUNDS);
+	printf("      -h      show this help text\n");
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int *member_list;
+	int nodes = DEFAULT_NODES;
+	int rounds = DEFAULT_ROUNDS;
+	uint64_t full_time = 0, half_time = 0;
+	uint64_t full_msgs = 0, half_msgs = 0;
+	uint64_t round_time, max_round_time = 0;
+	int ch;
+	int i;
+
+	while ((ch = getopt (argc, argv, "n:r:h")) != EOF) {
+		switch (ch) {
+		case 'n':
+			nodes = atoi(optarg);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			exit(0);
+		}
+	}
+
+	if (nodes < 2 || nodes > PROCESSOR_COUNT_MAX || rounds < 1) {
+		fprintf(stderr, "Number of nodes must be between 2 and %d, rounds at least 1\n",
+			PROCESSOR_COUNT_MAX);
+		exit(1);
+	}
+
+	if (icmap_init() != CS_OK) {
+		fprintf(stderr, "icmap_init failed\n");
+		exit(1);
+	}
+	icmap_set_uint32("quorum.expected_votes", nodes);
+
+	if (load_quorum_instance() != 0) {
+		exit(1);
+	}
+
+	member_list = malloc(sizeof(unsigned int) * nodes);
+	if (!member_list) {
+		perror("malloc failed");
+		exit(1);
+	}
+	for (i = 0; i < nodes; i++) {
+		member_list[i] = i + 1;
+	}
+
+	/*
+	 * Cluster alternates between all nodes and (quorate) half of nodes,
+	 * so nodes are leaving and (re)joining in every round
+	 */
+	for (i = 0; i < rounds * 2; i++) {
+		if (i % 2 == 0) {
+			round_time = run_round(member_list, nodes, nodes, i + 2,
+				(i == 0 ? 0 : VQBENCH_NODE_FLAGS_QUORATE));
+			full_time += round_time;
+			full_msgs += nodes;
+		} else {
+			round_time = run_round(member_list, nodes / 2 + 1, nodes, i + 2,
+				VQBENCH_NODE_FLAGS_QUORATE);
+			half_time += round_time;
+			half_msgs += nodes / 2 + 1;
+		}
+		if (round_time > max_round_time) {
+			max_round_time = round_time;
+		}
+	}
+
+	printf("nodes: %d, rounds: %d\n", nodes, rounds);
+	printf("%-24s %10"PRIu64" nodeinfo %10.3f ms %8.3f us/nodeinfo\n", "merge (all nodes)",
+		full_msgs, full_time / 1000.0, (double)full_time / full_msgs);
+	printf("%-24s %10"PRIu64" nodeinfo %10.3f ms %8.3f us/nodeinfo\n", "split (half nodes)",
+		half_msgs, half_time / 1000.0, (double)half_time / half_msgs);
+	printf("%-24s %10.3f ms\n", "slowest membership change", max_round_time / 1000.0);
+	printf("%"PRIu64" quorum changes, %"PRIu64" messages sent\n", quorum_changes, mcast_msgs);
+
+	free(member_list);
+
+	return 0;
+}
@@ -1,7 +1,9 @@
 #include <config.h>
 
 #include <stdio.h>
+#include <inttypes.h>
 #include <sys/types.h>
+#include <sys/time.h>
 #include <sys/wait.h>
 #include <qb/qblog.h>
 #include <qb/qbloop.h>
@@ -54,11 +56,14 @@ static int autofence;
 static int check_for_quorum;
 static FILE *output_file;
 static int nosync;
+static int use_inproc;
+static int batch;
 static qb_loop_timer_handle kb_timer;
 static ssize_t wait_count;
 static ssize_t wait_count_to_unblock;
 
 static struct vq_node *find_by_pid(pid_t pid);
+static struct vq_node *find_node(int nodeid);
 static void send_partition_to_nodes(struct vq_partition *partition, int newring);
 static void start_kb_input(void);
 static void start_kb_input_timeout(void *data);
@@ -110,7 +115,7 @@ static void print_quorum_state(struct vq_node *node)
 	}
 
 	fprintf(output_file, "%d:%02d: q=%d ring=[%d/%lld] ", node->partition->num, node->nodeid, node->last_quorate,
-		node->last_ring_id.rep.nodeid, node->last_ring_id.seq);
+		node->last_ring_id.nodeid, node->last_ring_id.seq);
 	fprintf(output_file, "nodes=[");
 	for (i = 0; i < node->last_view_list_entries; i++) {
 		if (i) {
@@ -177,6 +182,19 @@ static int vq_parent_read_fn(int32_t fd, int32_t revents, void *data)
 	return 0;
 }
 
+/* Quorum state of a node of the in-process engine */
+void report_quorum_state(struct vqsim_quorum_msg *qmsg)
+{
+	struct vq_node *vqn;
+
+	vqn = find_node(qmsg->header.from_nodeid);
+	if (vqn) {
+		save_quorum_state(vqn, qmsg);
+		if (!batch) {
+			print_quorum_state(vqn);
+		}
+	}
+}
 
 static int read_corosync_conf(void)
 {
@@ -227,32 +245,52 @@ static void remove_node(struct vq_node *node)
 	send_partition_to_nodes(part, 1);
 }
 
+static void node_exited(struct vq_node *vqn, int exit_code)
+{
+	const char *exit_status="";
+	char text[132];
+
+	switch (exit_code) {
+	case 0:
+		exit_status = "(on request)";
+		break;
+	case 1:
+		exit_status = "(autofenced)";
+		break;
+	default:
+		sprintf(text, "(exit code %d)", exit_code);
+		exit_status = text;
+		break;
+	}
+	if (!batch) {
+		printf("%d:%02d Quit %s\n", vqn->partition->num, vqn->nodeid, exit_status);
+	}
+
+	remove_node(vqn);
+}
+
+/* Node of the in-process engine has quit */
+void report_node_exit(int nodeid, int exit_code)
+{
+	struct vq_node *vqn;
+
+	vqn = find_node(nodeid);
+	if (vqn) {
+		node_exited(vqn, exit_code);
+	}
+}
+
 static int32_t sigchld_handler(int32_t sig, void *data)
 {
 	pid_t pid;
 	int status;
 	struct vq_node *vqn;
-	const char *exit_status="";
-	char text[132];
 
 	pid = wait(&status);
 	if (WIFEXITED(status)) {
 		vqn = find_by_pid(pid);
 		if (vqn) {
-			switch (WEXITSTATUS(status)) {
-			case 0:
-				exit_status = "(on request)";
-				break;
-			case 1:
-				exit_status = "(autofenced)";
-				break;
-			default:
-				sprintf(text, "(exit code %d)", WEXITSTATUS(status));
-				break;
-			}
-			printf("%d:%02d Quit %s\n", vqn->partition->num, vqn->nodeid, exit_status);
-
-			remove_node(vqn);
+			node_exited(vqn, WEXITSTATUS(status));
 		}
 		else {
 			fprintf(stderr, "Unknown child %d exited with status %d\n", pid, WEXITSTATUS(status));
@@ -287,7 +325,7 @@ static void send_partition_to_nodes(struct vq_partition *partition, int newring)
 	TAILQ_FOREACH(vqn, &partition->nodelist, entries) {
 		nodelist[nodes++] = vqn->nodeid;
 		if (first) {
-			partition->ring_id.rep.nodeid = vqn->nodeid;
+			partition->ring_id.nodeid = vqn->nodeid;
 			first = 0;
 		}
 	}
@@ -303,7 +341,7 @@ static void init_partitions(void)
 
 	for (i=0; i<MAX_PARTITIONS; i++) {
 		TAILQ_INIT(&partitions[i].nodelist);
-		partitions[i].ring_id.rep.nodeid = 1000+i;
+		partitions[i].ring_id.nodeid = 1000+i;
 		partitions[i].ring_id.seq = 0;
 		partitions[i].num = i;
 	}
@@ -336,7 +374,9 @@ static pid_t create_node(int nodeid, int partno)
 		newvq->fd = vq_get_parent_fd(newvq->instance);
 		TAILQ_INSERT_TAIL(&partitions[partno].nodelist, newvq, entries);
 
-		if (qb_loop_poll_add(poll_loop,
+		/* In-process nodes don't have a socket */
+		if (newvq->fd >= 0 &&
+		    qb_loop_poll_add(poll_loop,
 				     QB_LOOP_MED,
 				     newvq->fd,
 				     POLLIN | POLLERR,
@@ -474,6 +514,18 @@ void cmd_show_node_states()
 		}
 	}
 	fprintf(output_file, "#autofence: %s\n", autofence?"on":"off");
+	if (use_inproc) {
+		inproc_print_stats(output_file);
+	}
+}
+
+void cmd_wait(int msec)
+{
+	if (!use_inproc) {
+		fprintf(stderr, "ERR: wait is only supported by the in-process engine (-t)\n");
+		return;
+	}
+	inproc_wait(msec);
 }
 
 void cmd_stop_node(int nodeid)
@@ -637,15 +689,209 @@ static void start_kb_input_timeout(void *data)
 	start_kb_input();
 }
 
+/* ---------------------------------- */
+/* Batch mode */
+
+#define MAX_SCENARIO_LINE 4096
+
+static uint64_t time_usec(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return ((uint64_t)tv.tv_sec * 1000000ULL + tv.tv_usec);
+}
+
+/*
+ * Run one command of the scenario and print what it took. All work
+ * of the in-process engine is done by the time the command returns,
+ * so wall time of the command is the time to quorum convergence.
+ */
+static void run_scenario_event(const char *cmd, int event, int iteration)
+{
+	struct vqsim_engine_stats before, after;
+	struct vq_node *vqn;
+	char cmdbuf[MAX_SCENARIO_LINE];
+	uint64_t start, wall_time;
+	int nodes = 0;
+	int quorate = 0;
+	int converged = 1;
+	int i;
+
+	snprintf(cmdbuf, sizeof(cmdbuf), "%s", cmd);
+
+	inproc_get_stats(&before);
+	start = time_usec();
+
+	parse_input_command(cmdbuf);
+	inproc_run_quits();
+
+	wall_time = time_usec() - start;
+	inproc_get_stats(&after);
+
+	for (i=0; i<MAX_PARTITIONS; i++) {
+		TAILQ_FOREACH(vqn, &partitions[i].nodelist, entries) {
+			nodes++;
+			if (vqn->last_quorate == 1) {
+				quorate++;
+			}
+			if (vqn->last_quorate < 0 ||
+			    memcmp(&vqn->last_ring_id, &partitions[i].ring_id, sizeof(struct memb_ring_id)) != 0) {
+				converged = 0;
+			}
+		}
+	}
+
+	fprintf(output_file, "event\t%d\t%d\t%s\t%"PRIu64"\t%"PRIu64"\t%"PRIu64"\t%"PRIu64"\t%"PRIu64"\t%"PRIu64"\t%d\t%d\t%d\n",
+		event, iteration, cmd, wall_time,
+		after.virtual_time_ms - before.virtual_time_ms,
+		after.membership_events - before.membership_events,
+		after.exec_msgs_sent - before.exec_msgs_sent,
+		after.exec_msgs_delivered - before.exec_msgs_delivered,
+		after.cpu_time_us - before.cpu_time_us,
+		nodes, quorate, converged);
+}
+
+/*
+ * Scenario file has the same commands as the interactive mode, one per
+ * line. Lines between 'repeat <count>' and 'end' are run <count> times,
+ * '#' starts a comment.
+ */
+static int run_scenario(const char *file_name)
+{
+	FILE *f;
+	char line[MAX_SCENARIO_LINE];
+	char **lines = NULL;
+	char **new_lines;
+	size_t lines_entries = 0;
+	size_t lines_size = 0;
+	size_t repeat_start = 0;
+	int repeat_count = 0;
+	int in_repeat = 0;
+	int event = 0;
+	int iteration;
+	size_t i, j;
+	char *p;
+	struct vqsim_engine_stats stats;
+	struct vq_node *vqn;
+	uint64_t start;
+	int res = 0;
+
+	f = fopen(file_name, "r");
+	if (!f) {
+		fprintf(stderr, "Unable to open scenario %s: %s\n", file_name, strerror(errno));
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		p = strchr(line, '#');
+		if (p) {
+			*p = '\0';
+		}
+		for (p = line + strlen(line); p > line && strchr(" \t\r\n", *(p - 1)); p--)
+			;
+		*p = '\0';
+		for (p = line; *p == ' ' || *p == '\t'; p++)
+			;
+		if (*p == '\0') {
+			continue;
+		}
+
+		if (lines_entries == lines_size) {
+			lines_size = (lines_size ? lines_size * 2 : 64);
+			new_lines = realloc(lines, sizeof(char *) * lines_size);
+			if (!new_lines) {
+				fprintf(stderr, "Out of memory reading scenario\n");
+				res = -1;
+				goto out;
+			}
+			lines = new_lines;
+		}
+		lines[lines_entries] = strdup(p);
+		if (!lines[lines_entries]) {
+			fprintf(stderr, "Out of memory reading scenario\n");
+			res = -1;
+			goto out;
+		}
+		lines_entries++;
+	}
+
+	fprintf(output_file, "#event\tevent\titeration\tcommand\twall_us\tvirtual_ms\tmembership_events\t"
+		"exec_msgs_sent\texec_msgs_delivered\tcpu_us\tnodes\tquorate\tconverged\n");
+
+	start = time_usec();
+	for (i = 0; i < lines_entries; i++) {
+		if (strncmp(lines[i], "repeat", 6) == 0 && (lines[i][6] == ' ' || lines[i][6] == '\t')) {
+			if (in_repeat) {
+				fprintf(stderr, "Nested repeat is not supported\n");
+				res = -1;
+				goto out;
+			}
+			repeat_count = atoi(lines[i] + 7);
+			repeat_start = i + 1;
+			in_repeat = 1;
+			continue;
+		}
+		if (strcmp(lines[i], "end") == 0) {
+			if (!in_repeat) {
+				fprintf(stderr, "'end' without 'repeat'\n");
+				res = -1;
+				goto out;
+			}
+			for (iteration = 1; iteration <= repeat_count; iteration++) {
+				for (j = repeat_start; j < i; j++) {
+					run_scenario_event(lines[j], ++event, iteration);
+				}
+			}
+			in_repeat = 0;
+			continue;
+		}
+		if (!in_repeat) {
+			run_scenario_event(lines[i], ++event, 0);
+		}
+	}
+	if (in_repeat) {
+		fprintf(stderr, "'repeat' without 'end'\n");
+		res = -1;
+		goto out;
+	}
+
+	inproc_get_stats(&stats);
+	fprintf(output_file, "#node\tnodeid\tpartition\tquorate\tcpu_us\n");
+	for (i = 0; i < MAX_PARTITIONS; i++) {
+		TAILQ_FOREACH(vqn, &partitions[i].nodelist, entries) {
+			fprintf(output_file, "node\t%d\t%d\t%d\t%"PRIu64"\n",
+				vqn->nodeid, vqn->partition->num, vqn->last_quorate,
+				vq_get_cpu_time(vqn->instance));
+		}
+	}
+	fprintf(output_file, "#total\tevents\twall_us\tvirtual_ms\tmembership_events\t"
+		"exec_msgs_sent\texec_msgs_delivered\tcpu_us\n");
+	fprintf(output_file, "total\t%d\t%"PRIu64"\t%"PRIu64"\t%"PRIu64"\t%"PRIu64"\t%"PRIu64"\t%"PRIu64"\n",
+		event, time_usec() - start, stats.virtual_time_ms, stats.membership_events,
+		stats.exec_msgs_sent, stats.exec_msgs_delivered, stats.cpu_time_us);
+
+out:
+	for (i = 0; i < lines_entries; i++) {
+		free(lines[i]);
+	}
+	free(lines);
+	fclose(f);
+	fflush(output_file);
+	return res;
+}
+
 static void usage(char *program)
 {
 	printf("Usage:\n");
 	printf("\n");
-	printf("%s [-f <config-file>] [-o <output-file>]\n", program);
+	printf("%s [-f <config-file>] [-o <output-file>] [-n] [-t] [-s <scenario-file>]\n", program);
 	printf("\n");
 	printf("    -f     config file. defaults to /etc/corosync/corosync.conf\n");
 	printf("    -o     output file. defaults to stdout\n");
 	printf("    -n     no synchronization (on adding a node)\n");
+	printf("    -t     run all nodes as threads of vqsim (in-process engine)\n");
+	printf("    -s     run commands from scenario file and print timings (implies -t)\n");
 	printf("    -h     display this help text\n");
 	printf("\n");
 }
@@ -656,9 +902,10 @@ int main(int argc, char **argv)
 	int ch;
 	char *config_file_name = NULL;
 	char *output_file_name = NULL;
+	char *scenario_file_name = NULL;
 	char envstring[PATH_MAX];
 
-	while ((ch = getopt (argc, argv, "f:o:nh")) != EOF) {
+	while ((ch = getopt (argc, argv, "f:o:nts:h")) != EOF) {
 		switch (ch) {
 		case 'f':
 			config_file_name = optarg;
@@ -669,6 +916,14 @@ int main(int argc, char **argv)
 		case 'n':
 			nosync = 1;
 			break;
+		case 't':
+			use_inproc = 1;
+			break;
+		case 's':
+			scenario_file_name = optarg;
+			batch = 1;
+			use_inproc = 1;
+			break;
 		default:
 			usage(argv[0]);
 			exit(0);
@@ -702,6 +957,16 @@ int main(int argc, char **argv)
 
 	poll_loop = qb_loop_create();
 
+	if (use_inproc) {
+		/* Nodes report their state before we get back, nothing to wait for */
+		nosync = 1;
+		/* Batch mode runs quits itself, poll loop is never run */
+		if (inproc_init(batch ? NULL : poll_loop)) {
+			fprintf(stderr, "Unable to initialize in-process engine\n");
+			exit(1);
+		}
+	}
+
 	/* SIGCHLD handler to reap sub-processes and reconfigure the cluster */
 	qb_loop_signal_add(poll_loop,
 			   QB_LOOP_MED,
@@ -712,6 +977,11 @@ int main(int argc, char **argv)
 
 	/* Create a full cluster of nodes from corosync.conf */
 	read_corosync_conf();
+	if (batch) {
+		create_nodes_from_config();
+		inproc_run_quits();
+		exit(run_scenario(scenario_file_name) ? 1 : 0);
+	}
 	if (create_nodes_from_config() && !nosync) {
 		/* Delay kb input handling by 1 second when we've just
 		   added the nodes from corosync.conf; expect that
@@ -9,6 +9,8 @@ typedef enum {VQMSG_QUIT=1,
 
 typedef struct vq_instance *vq_object_t;
 
+struct inproc_node;
+
 struct vqsim_msg_header
 {
 	vqsim_msg_type_t type;
@@ -47,6 +49,17 @@ struct vqsim_lib_msg
 	char libmsg[];
 };
 
+/* Counters of the in-process engine */
+struct vqsim_engine_stats
+{
+	uint64_t membership_events;
+	uint64_t exec_msgs_sent;
+	uint64_t exec_msgs_delivered;
+	uint64_t timers_fired;
+	uint64_t virtual_time_ms;
+	uint64_t cpu_time_us; /* all node threads, including the ones which quit */
+};
+
 #define MAX_NODES 1024
 #define MAX_PARTITIONS 16
 
@@ -58,10 +71,25 @@ int vq_get_parent_fd(vq_object_t instance);
 int vq_set_qdevice(vq_object_t instance, struct memb_ring_id *ring_id, int onoff);
 int vq_quit_if_inquorate(vq_object_t instance);
 pid_t vq_get_pid(vq_object_t instance);
+uint64_t vq_get_cpu_time(vq_object_t instance);
 
 /* in vqsim_vq_engine.c - effectively the constructor */
 int fork_new_instance(int nodeid, int *vq_sock, pid_t *child_pid);
 
+/* In vqsim_inproc.c - in-process engine, all nodes are threads of vqsim */
+int inproc_init(qb_loop_t *poll_loop);
+int inproc_enabled(void);
+struct inproc_node *inproc_new_instance(int nodeid);
+void inproc_quit(struct inproc_node *node);
+int inproc_quit_if_inquorate(struct inproc_node *node);
+int inproc_set_nodelist(struct inproc_node *node, struct memb_ring_id *ring_id, int *nodeids, int nodeids_entries);
+int inproc_set_qdevice(struct inproc_node *node, int onoff);
+void inproc_wait(unsigned long long msec);
+void inproc_print_stats(FILE *f);
+void inproc_run_quits(void);
+uint64_t inproc_node_cpu_time(struct inproc_node *node);
+void inproc_get_stats(struct vqsim_engine_stats *stats);
+
 /* In parser.c */
 void parse_input_command(char *cmd);
 
@@ -75,3 +103,8 @@ void cmd_join_partitions(int part1, int part2);
 void cmd_update_all_partitions(int newring);
 void cmd_qdevice_poll(int nodeid, int onoff);
 void cmd_show_node_states(void);
+void cmd_wait(int msec);
+
+/* Called by the in-process engine, also in vqmain.c */
+void report_quorum_state(struct vqsim_quorum_msg *qmsg);
+void report_node_exit(int nodeid, int exit_code);
@@ -0,0 +1,1060 @@
+
+/* In-process engine of VQSIM.
+
+   Every 'node' is a votequorum instance running in its own thread of the
+   vqsim process (all votequorum state is thread local, see vq_votequorum.c),
+   so there are no forked processes and no sockets.
+
+   Only one thread runs at a time. The controller (main thread) hands
+   a piece of work to a node thread and waits until it's done, so runs are
+   fully deterministic and icmap/logsys, which are shared by all the nodes,
+   need no locking.
+
+   Messages sent by votequorum are queued on an in-memory bus and delivered
+   in order to all members of the sender's ring. Timers run on virtual time
+   which only moves forward when there is nothing else left to do, so
+   waiting for (eg.) qdevice timeouts costs no real time.
+*/
+
+#include <config.h>
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/queue.h>
+#include <pthread.h>
+#include <errno.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <qb/qblog.h>
+#include <qb/qbloop.h>
+#include <qb/qbipc_common.h>
+
+#include "../exec/votequorum.h"
+#include "../exec/service.h"
+#include "../include/corosync/corotypes.h"
+#include "../include/corosync/votequorum.h"
+#include "../include/corosync/ipc_votequorum.h"
+#include <corosync/logsys.h>
+#include <corosync/coroapi.h>
+
+#include "icmap.h"
+#include "vqsim.h"
+
+#define QDEVICE_NAME			"VQsim_qdevice"
+
+#define INPROC_THREAD_STACK_SIZE	(256 * 1024)
+#define INPROC_NODE_HASH_SIZE		4096
+
+/* Same as the sync timer of the forked engine */
+#define INPROC_SYNC_INTERVAL		10000000ULL
+
+struct inproc_node;
+
+typedef void (*inproc_work_fn_t)(struct inproc_node *node, void *arg);
+
+/* Membership, shared by all nodes of the ring and by the messages sent in it */
+struct inproc_ring {
+	int refcount;
+	struct memb_ring_id ring_id;
+	size_t entries;
+	unsigned int nodeids[];
+};
+
+struct inproc_timer {
+	uint64_t expire;
+	uint64_t seq;
+	corosync_timer_handle_t handle;
+	struct inproc_node *node;
+	void (*timer_fn)(void *data);
+	void *data;
+	int cancelled;
+	LIST_ENTRY(inproc_timer) entries;
+};
+
+struct inproc_msg {
+	TAILQ_ENTRY(inproc_msg) entries;
+	struct inproc_ring *ring;
+	unsigned int from_nodeid;
+	size_t len;
+	char data[] __attribute__((aligned(8)));
+};
+
+struct inproc_report {
+	TAILQ_ENTRY(inproc_report) entries;
+	struct vqsim_quorum_msg *qmsg;
+};
+
+struct inproc_node {
+	int nodeid;
+	struct inproc_node *hash_next;
+
+	/* Thread and the work handed over to it */
+	pthread_t thread;
+	pthread_cond_t cond;
+	inproc_work_fn_t work_fn;
+	void *work_arg;
+	int work_res;
+	int exiting;
+
+	/* votequorum instance */
+	char *private_data;
+	cs_error_t last_lib_error;
+	int quorate;
+	struct memb_ring_id quorum_ring_id;
+	LIST_HEAD(, inproc_timer) timers;
+
+	/* Current ring and the one we are waiting to sync to */
+	struct inproc_ring *ring;
+	int sync_done;
+	int sync_pending;
+	struct memb_ring_id pending_ring_id;
+
+	/* qdevice */
+	int qdevice_registered;
+	corosync_timer_handle_t qdevice_timer;
+	unsigned int qdevice_timeout;
+
+	int quit_pending;
+	int exit_code;
+	TAILQ_ENTRY(inproc_node) quit_entries;
+
+	/* CPU time of the thread, saved when it exits */
+	uint64_t cpu_time_us;
+};
+
+static int inproc_active;
+static qb_loop_t *poll_loop;
+static struct corosync_service_engine *engine;
+
+static pthread_mutex_t inproc_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t inproc_done_cond = PTHREAD_COND_INITIALIZER;
+static __thread struct inproc_node *current_node;
+
+static struct inproc_node *node_hash[INPROC_NODE_HASH_SIZE];
+static size_t node_count;
+
+static TAILQ_HEAD(, inproc_msg) msg_bus = TAILQ_HEAD_INITIALIZER(msg_bus);
+static TAILQ_HEAD(, inproc_report) reports = TAILQ_HEAD_INITIALIZER(reports);
+static TAILQ_HEAD(, inproc_node) quit_list = TAILQ_HEAD_INITIALIZER(quit_list);
+static int quit_job_scheduled;
+
+/* Timers of all the nodes, binary heap ordered by (expire, seq) */
+static struct inproc_timer **timer_heap;
+static size_t timer_heap_entries;
+static size_t timer_heap_size;
+static uint64_t last_timer_seq;
+
+/* Virtual time (ns) */
+static uint64_t virtual_time;
+
+static struct {
+	uint64_t membership_events;
+	uint64_t exec_msgs_sent;
+	uint64_t exec_msgs_delivered;
+	uint64_t timers_fired;
+	uint64_t sync_time_us;
+	uint64_t exited_cpu_time_us;
+} inproc_stats;
+
+static void inproc_run_on_node(struct inproc_node *node, inproc_work_fn_t work_fn, void *arg);
+static void inproc_run_bus(void);
+static void start_qdevice_poll(struct inproc_node *node, int longwait);
+
+static uint64_t time_usec(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return ((uint64_t)tv.tv_sec * 1000000ULL + tv.tv_usec);
+}
+
+static uint64_t clock_usec(clockid_t clock_id)
+{
+	struct timespec ts;
+
+	if (clock_gettime(clock_id, &ts) != 0) {
+		return 0;
+	}
+	return ((uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+/* -------------------- Nodes -------------------- */
+
+static struct inproc_node *find_node(unsigned int nodeid)
+{
+	struct inproc_node *node;
+
+	for (node = node_hash[nodeid % INPROC_NODE_HASH_SIZE]; node; node = node->hash_next) {
+		if (node->nodeid == nodeid) {
+			return node;
+		}
+	}
+	return NULL;
+}
+
+static void node_hash_add(struct inproc_node *node)
+{
+	unsigned int bucket = node->nodeid % INPROC_NODE_HASH_SIZE;
+
+	node->hash_next = node_hash[bucket];
+	node_hash[bucket] = node;
+	node_count++;
+}
+
+static void node_hash_del(struct inproc_node *node)
+{
+	struct inproc_node **prev;
+
+	for (prev = &node_hash[node->nodeid % INPROC_NODE_HASH_SIZE]; *prev; prev = &(*prev)->hash_next) {
+		if (*prev == node) {
+			*prev = node->hash_next;
+			node_count--;
+			return;
+		}
+	}
+}
+
+/* -------------------- Rings -------------------- */
+
+static struct inproc_ring *ring_create(struct memb_ring_id *ring_id, const int *nodeids, size_t entries)
+{
+	struct inproc_ring *ring;
+	size_t i;
+
+	ring = malloc(sizeof(struct inproc_ring) + sizeof(unsigned int) * entries);
+	if (!ring) {
+		return NULL;
+	}
+	ring->refcount = 1;
+	memcpy(&ring->ring_id, ring_id, sizeof(struct memb_ring_id));
+	ring->entries = entries;
+	for (i = 0; i < entries; i++) {
+		ring->nodeids[i] = nodeids[i];
+	}
+	return ring;
+}
+
+static void ring_get(struct inproc_ring *ring)
+{
+	ring->refcount++;
+}
+
+static void ring_put(struct inproc_ring *ring)
+{
+	if (ring && --ring->refcount == 0) {
+		free(ring);
+	}
+}
+
+/* -------------------- Timers (virtual time) -------------------- */
+
+static int timer_before(const struct inproc_timer *a, const struct inproc_timer *b)
+{
+	return (a->expire < b->expire || (a->expire == b->expire && a->seq < b->seq));
+}
+
+static int timer_heap_push(struct inproc_timer *timer)
+{
+	struct inproc_timer **new_heap;
+	struct inproc_timer *tmp;
+	size_t i;
+
+	if (timer_heap_entries == timer_heap_size) {
+		new_heap = realloc(timer_heap, sizeof(struct inproc_timer *) *
+			(timer_heap_size ? timer_heap_size * 2 : 1024));
+		if (!new_heap) {
+			return -1;
+		}
+		timer_heap = new_heap;
+		timer_heap_size = (timer_heap_size ? timer_heap_size * 2 : 1024);
+	}
+
+	i = timer_heap_entries++;
+	timer_heap[i] = timer;
+	while (i > 0 && timer_before(timer_heap[i], timer_heap[(i - 1) / 2])) {
+		tmp = timer_heap[i];
+		timer_heap[i] = timer_heap[(i - 1) / 2];
+		timer_heap[(i - 1) / 2] = tmp;
+		i = (i - 1) / 2;
+	}
+	return 0;
+}
+
+static void timer_heap_pop(void)
+{
+	struct inproc_timer *tmp;
+	size_t i = 0;
+	size_t child;
+
+	timer_heap[0] = timer_heap[--timer_heap_entries];
+	for (;;) {
+		child = i * 2 + 1;
+		if (child >= timer_heap_entries) {
+			break;
+		}
+		if (child + 1 < timer_heap_entries && timer_before(timer_heap[child + 1], timer_heap[child])) {
+			child++;
+		}
+		if (!timer_before(timer_heap[child], timer_heap[i])) {
+			break;
+		}
+		tmp = timer_heap[i];
+		timer_heap[i] = timer_heap[child];
+		timer_heap[child] = tmp;
+		i = child;
+	}
+}
+
+/* Returns first timer to expire, deleted timers are freed on the way */
+static struct inproc_timer *timer_next(void)
+{
+	struct inproc_timer *timer;
+
+	while (timer_heap_entries) {
+		timer = timer_heap[0];
+		if (!timer->cancelled) {
+			return timer;
+		}
+		timer_heap_pop();
+		free(timer);
+	}
+	return NULL;
+}
+
+static void timer_cancel_all(struct inproc_node *node)
+{
+	struct inproc_timer *timer;
+
+	while ((timer = LIST_FIRST(&node->timers)) != NULL) {
+		LIST_REMOVE(timer, entries);
+		timer->cancelled = 1;
+	}
+}
+
+/* -------------------- corosync_api support routines -------------------- */
+/* These are always called in the thread of the node */
+
+static void api_error_memory_failure(void) __attribute__((noreturn));
+static void api_error_memory_failure()
+{
+	fprintf(stderr, "Out of memory error\n");
+	exit(-1);
+}
+
+static void api_timer_delete(corosync_timer_handle_t th)
+{
+	struct inproc_timer *timer;
+
+	LIST_FOREACH(timer, &current_node->timers, entries) {
+		if (timer->handle == th) {
+			LIST_REMOVE(timer, entries);
+			timer->cancelled = 1;
+			return;
+		}
+	}
+}
+
+static int api_timer_add_duration (
+	unsigned long long nanosec_duration,
+	void *data,
+	void (*timer_fn) (void *data),
+	corosync_timer_handle_t *handle)
+{
+	struct inproc_timer *timer;
+
+	timer = malloc(sizeof(struct inproc_timer));
+	if (!timer) {
+		return -1;
+	}
+	timer->expire = virtual_time + nanosec_duration;
+	timer->seq = ++last_timer_seq;
+	timer->handle = (corosync_timer_handle_t)timer->seq;
+	timer->node = current_node;
+	timer->timer_fn = timer_fn;
+	timer->data = data;
+	timer->cancelled = 0;
+
+	if (timer_heap_push(timer)) {
+		free(timer);
+		return -1;
+	}
+	LIST_INSERT_HEAD(&current_node->timers, timer, entries);
+
+	*handle = timer->handle;
+	return 0;
+}
+
+static unsigned int api_totem_nodeid_get(void)
+{
+	return current_node->nodeid;
+}
+
+static int api_totem_mcast(const struct iovec *iov, unsigned int iovlen, unsigned int type)
+{
+	struct inproc_msg *msg;
+	size_t len = 0;
+	size_t pos = 0;
+	unsigned int i;
+
+	if (!current_node->ring) {
+		return -1;
+	}
+
+	for (i = 0; i < iovlen; i++) {
+		len += iov[i].iov_len;
+	}
+
+	msg = malloc(sizeof(struct inproc_msg) + len);
+	if (!msg) {
+		return -1;
+	}
+	msg->ring = current_node->ring;
+	ring_get(msg->ring);
+	msg->from_nodeid = current_node->nodeid;
+	msg->len = len;
+	for (i = 0; i < iovlen; i++) {
+		memcpy(msg->data + pos, iov[i].iov_base, iov[i].iov_len);
+		pos += iov[i].iov_len;
+	}
+
+	TAILQ_INSERT_TAIL(&msg_bus, msg, entries);
+	inproc_stats.exec_msgs_sent++;
+	return 0;
+}
+
+/* Connection of the simulated lib user is the node itself */
+static void *api_ipc_private_data_get(void *conn)
+{
+	struct inproc_node *node = conn;
+
+	return node->private_data;
+}
+
+static int api_ipc_response_send(void *conn, const void *msg, size_t len)
+{
+	struct inproc_node *node = conn;
+	const struct qb_ipc_response_header *qb_header = msg;
+
+	/* Save the error so we can return it */
+	node->last_lib_error = qb_header->error;
+	return 0;
+}
+
+static int api_ipc_dispatch_send(void *conn, const void *msg, size_t len)
+{
+	return 0;
+}
+
+static struct corosync_api_v1 corosync_api = {
+	.error_memory_failure = api_error_memory_failure,
+	.timer_delete = api_timer_delete,
+	.timer_add_duration = api_timer_add_duration,
+	.totem_nodeid_get = api_totem_nodeid_get,
+	.totem_mcast = api_totem_mcast,
+	.ipc_private_data_get = api_ipc_private_data_get,
+	.ipc_response_send = api_ipc_response_send,
+	.ipc_dispatch_send = api_ipc_dispatch_send,
+};
+
+/* Callback from Votequorum to tell us about the quorum state */
+static void quorum_fn(const unsigned int *view_list,
+		      size_t view_list_entries,
+		      int quorate, struct memb_ring_id *ring_id)
+{
+	struct inproc_node *node = current_node;
+	struct inproc_report *report;
+
+	node->quorate = quorate;
+	memcpy(&node->quorum_ring_id, ring_id, sizeof(*ring_id));
+
+	/* Passed to vqmain by the controller once the node is done */
+	report = malloc(sizeof(struct inproc_report));
+	if (!report) {
+		return;
+	}
+	report->qmsg = malloc(sizeof(struct vqsim_quorum_msg) + sizeof(unsigned int) * view_list_entries);
+	if (!report->qmsg) {
+		free(report);
+		return;
+	}
+	report->qmsg->header.type = VQMSG_QUORUM;
+	report->qmsg->header.from_nodeid = node->nodeid;
+	report->qmsg->header.param = 0;
+	report->qmsg->quorate = quorate;
+	memcpy(&report->qmsg->ring_id, ring_id, sizeof(*ring_id));
+	report->qmsg->view_list_entries = view_list_entries;
+	memcpy(report->qmsg->view_list, view_list, sizeof(unsigned int) * view_list_entries);
+
+	TAILQ_INSERT_TAIL(&reports, report, entries);
+}
+
+/* -------------------- Work done in the node threads -------------------- */
+
+static void work_init(struct inproc_node *node, void *arg)
+{
+	const char *error_string;
+
+	node->work_res = -1;
+
+	if (icmap_get_uint32("quorum.device.timeout", &node->qdevice_timeout) != CS_OK) {
+		node->qdevice_timeout = VOTEQUORUM_QDEVICE_DEFAULT_TIMEOUT;
+	}
+
+	error_string = votequorum_init(&corosync_api, quorum_fn);
+	if (error_string) {
+		fprintf(stderr, "Votequorum init failed: %s\n", error_string);
+		return;
+	}
+
+	engine = votequorum_get_service_engine_ver0();
+	error_string = engine->exec_init_fn(&corosync_api);
+	if (error_string) {
+		fprintf(stderr, "votequorum exec init failed: %s\n", error_string);
+		return;
+	}
+
+	node->private_data = malloc(engine->private_data_size);
+	if (!node->private_data) {
+		perror("malloc failed");
+		return;
+	}
+
+	node->work_res = engine->lib_init_fn(node);
+}
+
+static void work_sync_init(struct inproc_node *node, void *arg)
+{
+	struct inproc_ring *ring = arg;
+
+	/* Votequorum doesn't use the transitional node list :-) */
+	engine->sync_init(NULL, 0, ring->nodeids, ring->entries, &ring->ring_id);
+}
+
+static void work_sync_process(struct inproc_node *node, void *arg)
+{
+	node->sync_done = (engine->sync_process() == 0);
+}
+
+static void work_sync_activate(struct inproc_node *node, void *arg)
+{
+	engine->sync_activate();
+}
+
+static void work_exec(struct inproc_node *node, void *arg)
+{
+	struct inproc_msg *msg = arg;
+	struct qb_ipc_request_header *qb_header = (void *)msg->data;
+
+	engine->exec_engine[qb_header->id & 0xFFFF].exec_handler_fn(msg->data, msg->from_nodeid);
+}
+
+static void work_timer(struct inproc_node *node, void *arg)
+{
+	struct inproc_timer *timer = arg;
+
+	timer->timer_fn(timer->data);
+}
+
+static int send_lib_msg(struct inproc_node *node, int type, void *msg)
+{
+	/* Clear this as not all lib functions return a response immediately */
+	node->last_lib_error = CS_OK;
+
+	engine->lib_engine[type].lib_handler_fn(node, msg);
+
+	return node->last_lib_error;
+}
+
+static int poll_qdevice(struct inproc_node *node, int onoff)
+{
+	struct req_lib_votequorum_qdevice_poll pollmsg;
+	int res;
+
+	pollmsg.cast_vote = onoff;
+	pollmsg.ring_id.nodeid = node->quorum_ring_id.nodeid;
+	pollmsg.ring_id.seq = node->quorum_ring_id.seq;
+	strcpy(pollmsg.name, QDEVICE_NAME);
+
+	res = send_lib_msg(node, MESSAGE_REQ_VOTEQUORUM_QDEVICE_POLL, &pollmsg);
+	if (res != CS_OK) {
+		fprintf(stderr, "%d: qdevice poll failed: %d\n", node->nodeid, res);
+	}
+	return res;
+}
+
+static void qdevice_dispatch_fn(void *data)
+{
+	struct inproc_node *node = data;
+
+	node->qdevice_timer = 0;
+	if (poll_qdevice(node, 1) == CS_OK) {
+		start_qdevice_poll(node, 0);
+	}
+}
+
+static void start_qdevice_poll(struct inproc_node *node, int longwait)
+{
+	unsigned long long timeout;
+
+	timeout = (unsigned long long)node->qdevice_timeout*500000; /* Half the corosync timeout */
+	if (longwait) {
+		timeout *= 2;
+	}
+
+	api_timer_add_duration(timeout, node, qdevice_dispatch_fn, &node->qdevice_timer);
+}
+
+static void stop_qdevice_poll(struct inproc_node *node)
+{
+	api_timer_delete(node->qdevice_timer);
+	node->qdevice_timer = 0;
+}
+
+static void work_qdevice(struct inproc_node *node, void *arg)
+{
+	int onoff = (arg != NULL);
+	int res;
+
+	if (onoff) {
+		if (!node->qdevice_registered) {
+			struct req_lib_votequorum_qdevice_register regmsg;
+
+			strcpy(regmsg.name, QDEVICE_NAME);
+			if ( (res=send_lib_msg(node, MESSAGE_REQ_VOTEQUORUM_QDEVICE_REGISTER, &regmsg)) == CS_OK) {
+				node->qdevice_registered = 1;
+				start_qdevice_poll(node, 1);
+			}
+			else {
+				fprintf(stderr, "%d: qdevice registration failed: %d\n", node->nodeid, res);
+			}
+		}
+		else {
+			if (!node->qdevice_timer) {
+				start_qdevice_poll(node, 0);
+			}
+		}
+	}
+	else {
+		poll_qdevice(node, 0);
+		stop_qdevice_poll(node);
+	}
+}
+
+static void work_exit(struct inproc_node *node, void *arg)
+{
+	node->cpu_time_us = clock_usec(CLOCK_THREAD_CPUTIME_ID);
+	node->exiting = 1;
+}
+
+static void *inproc_node_thread(void *arg)
+{
+	struct inproc_node *node = arg;
+	inproc_work_fn_t work_fn;
+	int exiting = 0;
+
+	current_node = node;
+
+	pthread_mutex_lock(&inproc_mutex);
+	while (!exiting) {
+		while (!node->work_fn) {
+			pthread_cond_wait(&node->cond, &inproc_mutex);
+		}
+		work_fn = node->work_fn;
+		pthread_mutex_unlock(&inproc_mutex);
+
+		work_fn(node, node->work_arg);
+		exiting = node->exiting;
+
+		pthread_mutex_lock(&inproc_mutex);
+		node->work_fn = NULL;
+		pthread_cond_signal(&inproc_done_cond);
+	}
+	pthread_mutex_unlock(&inproc_mutex);
+
+	return NULL;
+}
+
+/* -------------------- Controller -------------------- */
+
+/* Pass quorum state reported by the nodes to vqmain */
+static void inproc_flush_reports(void)
+{
+	struct inproc_report *report;
+
+	while ((report = TAILQ_FIRST(&reports)) != NULL) {
+		TAILQ_REMOVE(&reports, report, entries);
+		report_quorum_state(report->qmsg);
+		free(report->qmsg);
+		free(report);
+	}
+}
+
+/* Run work_fn in the thread of node and wait for it to finish */
+static void inproc_run_on_node(struct inproc_node *node, inproc_work_fn_t work_fn, void *arg)
+{
+	pthread_mutex_lock(&inproc_mutex);
+	node->work_fn = work_fn;
+	node->work_arg = arg;
+	pthread_cond_signal(&node->cond);
+	while (node->work_fn) {
+		pthread_cond_wait(&inproc_done_cond, &inproc_mutex);
+	}
+	pthread_mutex_unlock(&inproc_mutex);
+
+	inproc_flush_reports();
+}
+
+/*
+ * Deliver message to all members of the ring it was sent in. Nodes which
+ * moved to another ring (or quit) since don't get it, same as in totem.
+ */
+static void inproc_deliver(struct inproc_msg *msg)
+{
+	struct inproc_node *node;
+	size_t i;
+
+	for (i = 0; i < msg->ring->entries; i++) {
+		node = find_node(msg->ring->nodeids[i]);
+		if (node && node->ring == msg->ring) {
+			inproc_run_on_node(node, work_exec, msg);
+			inproc_stats.exec_msgs_delivered++;
+		}
+	}
+}
+
+/* Deliver all queued messages and run all expired timers */
+static void inproc_run_bus(void)
+{
+	struct inproc_msg *msg;
+	struct inproc_timer *timer;
+
+	for (;;) {
+		msg = TAILQ_FIRST(&msg_bus);
+		if (msg) {
+			TAILQ_REMOVE(&msg_bus, msg, entries);
+			inproc_deliver(msg);
+			ring_put(msg->ring);
+			free(msg);
+			continue;
+		}
+
+		timer = timer_next();
+		if (timer && timer->expire <= virtual_time) {
+			timer_heap_pop();
+			LIST_REMOVE(timer, entries);
+			inproc_run_on_node(timer->node, work_timer, timer);
+			inproc_stats.timers_fired++;
+			free(timer);
+			continue;
+		}
+		break;
+	}
+}
+
+/* Move virtual time forward, firing all timers on the way */
+static void inproc_advance_time(uint64_t target)
+{
+	struct inproc_timer *timer;
+
+	inproc_run_bus();
+	while ((timer = timer_next()) != NULL && timer->expire <= target) {
+		if (timer->expire > virtual_time) {
+			virtual_time = timer->expire;
+		}
+		inproc_run_bus();
+	}
+	if (target > virtual_time) {
+		virtual_time = target;
+	}
+	inproc_run_bus();
+}
+
+/* Sync all members of ring, same sequence as sync.c does */
+static void inproc_run_sync(struct inproc_ring *ring)
+{
+	struct inproc_node *nodes[ring->entries];
+	uint64_t start;
+	int done;
+	size_t i;
+
+	start = time_usec();
+
+	for (i = 0; i < ring->entries; i++) {
+		nodes[i] = find_node(ring->nodeids[i]);
+		nodes[i]->sync_pending = 0;
+		nodes[i]->sync_done = 0;
+		ring_get(ring);
+		ring_put(nodes[i]->ring);
+		nodes[i]->ring = ring;
+	}
+
+	for (i = 0; i < ring->entries; i++) {
+		inproc_run_on_node(nodes[i], work_sync_init, ring);
+	}
+
+	for (;;) {
+		done = 1;
+		for (i = 0; i < ring->entries; i++) {
+			if (!nodes[i]->sync_done) {
+				inproc_run_on_node(nodes[i], work_sync_process, NULL);
+				if (!nodes[i]->sync_done) {
+					done = 0;
+				}
+			}
+		}
+		inproc_run_bus();
+		if (done) {
+			break;
+		}
+		/* Someone is waiting (for qdevice), let the time pass */
+		inproc_advance_time(virtual_time + INPROC_SYNC_INTERVAL);
+	}
+
+	for (i = 0; i < ring->entries; i++) {
+		inproc_run_on_node(nodes[i], work_sync_activate, NULL);
+	}
+	inproc_run_bus();
+
+	inproc_stats.membership_events++;
+	inproc_stats.sync_time_us += time_usec() - start;
+}
+
+static void inproc_node_exit(struct inproc_node *node)
+{
+	inproc_run_on_node(node, work_exit, NULL);
+	pthread_join(node->thread, NULL);
+	inproc_stats.exited_cpu_time_us += node->cpu_time_us;
+
+	timer_cancel_all(node);
+	node_hash_del(node);
+	ring_put(node->ring);
+	pthread_cond_destroy(&node->cond);
+
+	report_node_exit(node->nodeid, node->exit_code);
+
+	free(node->private_data);
+	free(node);
+}
+
+static void inproc_quit_job(void *data)
+{
+	quit_job_scheduled = 0;
+	inproc_run_quits();
+}
+
+static void inproc_schedule_quit(struct inproc_node *node, int exit_code)
+{
+	if (node->quit_pending) {
+		return;
+	}
+	node->quit_pending = 1;
+	node->exit_code = exit_code;
+
+	/* Not now, caller may be walking the list of nodes */
+	TAILQ_INSERT_TAIL(&quit_list, node, quit_entries);
+	if (poll_loop && !quit_job_scheduled) {
+		qb_loop_job_add(poll_loop, QB_LOOP_MED, NULL, inproc_quit_job);
+		quit_job_scheduled = 1;
+	}
+}
+
+/* -------------------- Interface for vq_object.c -------------------- */
+
+/*
+ * Without poll loop (batch mode) the caller has to run
+ * inproc_run_quits() after every command
+ */
+int inproc_init(qb_loop_t *loop)
+{
+	poll_loop = loop;
+	inproc_active = 1;
+
+	return 0;
+}
+
+int inproc_enabled(void)
+{
+	return inproc_active;
+}
+
+struct inproc_node *inproc_new_instance(int nodeid)
+{
+	struct inproc_node *node;
+	struct memb_ring_id ring_id;
+	pthread_attr_t attr;
+	int res;
+
+	if (find_node(nodeid)) {
+		return NULL;
+	}
+
+	node = calloc(1, sizeof(struct inproc_node));
+	if (!node) {
+		return NULL;
+	}
+	node->nodeid = nodeid;
+	LIST_INIT(&node->timers);
+	pthread_cond_init(&node->cond, NULL);
+
+	/* Cluster with just us in it */
+	ring_id.nodeid = nodeid;
+	ring_id.seq = 1;
+	node->ring = ring_create(&ring_id, &nodeid, 1);
+	if (!node->ring) {
+		goto free_node;
+	}
+
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, INPROC_THREAD_STACK_SIZE);
+	res = pthread_create(&node->thread, &attr, inproc_node_thread, node);
+	pthread_attr_destroy(&attr);
+	if (res) {
+		fprintf(stderr, "Can't create thread for node %d: %s\n", nodeid, strerror(res));
+		goto free_ring;
+	}
+	node_hash_add(node);
+
+	inproc_run_on_node(node, work_init, NULL);
+	if (node->work_res) {
+		/* Just keep the (idle) thread, votequorum state is not cleaned up anyway */
+		node->quit_pending = 1;
+		node_hash_del(node);
+		return NULL;
+	}
+	inproc_run_bus();
+
+	inproc_run_sync(node->ring);
+
+	return node;
+
+free_ring:
+	ring_put(node->ring);
+free_node:
+	pthread_cond_destroy(&node->cond);
+	free(node);
+	return NULL;
+}
+
+void inproc_quit(struct inproc_node *node)
+{
+	inproc_schedule_quit(node, 0);
+}
+
+int inproc_quit_if_inquorate(struct inproc_node *node)
+{
+	if (!node->quorate) {
+		/* Autofenced */
+		inproc_schedule_quit(node, 1);
+	}
+	return 0;
+}
+
+/*
+ * Membership changes when all nodes of the new ring have been told
+ * about it (vqmain tells all nodes of the partition one by one)
+ */
+int inproc_set_nodelist(struct inproc_node *node, struct memb_ring_id *ring_id, int *nodeids, int nodeids_entries)
+{
+	struct inproc_node *member;
+	struct inproc_ring *ring;
+	int i;
+
+	if (nodeids_entries > PROCESSOR_COUNT_MAX) {
+		fprintf(stderr, "ERR: %d nodes in partition, maximum is %d\n",
+			nodeids_entries, PROCESSOR_COUNT_MAX);
+		return -1;
+	}
+
+	node->sync_pending = 1;
+	memcpy(&node->pending_ring_id, ring_id, sizeof(struct memb_ring_id));
+
+	for (i = 0; i < nodeids_entries; i++) {
+		member = find_node(nodeids[i]);
+		if (!member || !member->sync_pending ||
+		    memcmp(&member->pending_ring_id, ring_id, sizeof(struct memb_ring_id)) != 0) {
+			return 0;
+		}
+	}
+
+	ring = ring_create(ring_id, nodeids, nodeids_entries);
+	if (!ring) {
+		return -1;
+	}
+	inproc_run_sync(ring);
+	ring_put(ring);
+
+	return 0;
+}
+
+int inproc_set_qdevice(struct inproc_node *node, int onoff)
+{
+	inproc_run_on_node(node, work_qdevice, onoff ? (void *)1 : NULL);
+	inproc_run_bus();
+
+	return 0;
+}
+
+/* Let msec of virtual time pass */
+void inproc_wait(unsigned long long msec)
+{
+	inproc_advance_time(virtual_time + msec * 1000000ULL);
+}
+
+void inproc_print_stats(FILE *f)
+{
+	fprintf(f, "#engine: in-process, %zu nodes, virtual time %"PRIu64" ms\n",
+		node_count, virtual_time / (uint64_t)1000000);
+	fprintf(f, "#membership events: %"PRIu64" in %.3f ms (%.1f/s)\n",
+		inproc_stats.membership_events, inproc_stats.sync_time_us / 1000.0,
+		(inproc_stats.sync_time_us ?
+		 inproc_stats.membership_events * 1000000.0 / inproc_stats.sync_time_us : 0.0));
+	fprintf(f, "#exec messages: %"PRIu64" sent, %"PRIu64" delivered, %"PRIu64" timers fired\n",
+		inproc_stats.exec_msgs_sent, inproc_stats.exec_msgs_delivered,
+		inproc_stats.timers_fired);
+}
+
+/* Stop nodes which were asked to quit (this may make more nodes quit) */
+void inproc_run_quits(void)
+{
+	struct inproc_node *node;
+
+	while ((node = TAILQ_FIRST(&quit_list)) != NULL) {
+		TAILQ_REMOVE(&quit_list, node, quit_entries);
+		inproc_node_exit(node);
+	}
+}
+
+/* CPU time used by the thread of node so far */
+uint64_t inproc_node_cpu_time(struct inproc_node *node)
+{
+	clockid_t clock_id;
+
+	if (pthread_getcpuclockid(node->thread, &clock_id) != 0) {
+		return 0;
+	}
+	return clock_usec(clock_id);
+}
+
+void inproc_get_stats(struct vqsim_engine_stats *stats)
+{
+	struct inproc_node *node;
+	size_t i;
+
+	stats->membership_events = inproc_stats.membership_events;
+	stats->exec_msgs_sent = inproc_stats.exec_msgs_sent;
+	stats->exec_msgs_delivered = inproc_stats.exec_msgs_delivered;
+	stats->timers_fired = inproc_stats.timers_fired;
+	stats->virtual_time_ms = virtual_time / (uint64_t)1000000;
+
+	stats->cpu_time_us = inproc_stats.exited_cpu_time_us;
+	for (i = 0; i < INPROC_NODE_HASH_SIZE; i++) {
+		for (node = node_hash[i]; node; node = node->hash_next) {
+			stats->cpu_time_us += inproc_node_cpu_time(node);
+		}
+	}
+}